@@ -0,0 +1,65 @@
+/**
+ * @file stetris_args.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Strict parsing of the numeric command line options.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * strtoul() alone takes "12abc" as 12 and "-1" as ULONG_MAX. These helpers
+ * take only a whole number in range, and clear *ok otherwise, so a parsing
+ * loop can set every option and check once whether all of them were valid.
+ * Header only, so the programs that do not link the engine can use it too.
+ */
+
+#ifndef STETRIS_ARGS_H
+#define STETRIS_ARGS_H
+
+#include <ctype.h>                      // for isalnum()
+#include <errno.h>                      // for errno, ERANGE
+#include <limits.h>                     // for UINT_MAX, ULONG_MAX
+#include <math.h>                       // for isfinite()
+#include <stdbool.h>                    // for bool type
+#include <stdint.h>                     // for UINT32_MAX
+#include <stdlib.h>                     // for strtoull(), strtod()
+
+/**
+ * Returns the unsigned number text, in any base strtoull() takes with base
+ * (0 for decimal, 0x hexadecimal and 0 octal). Returns 0 and clears *ok if
+ * text is empty, signed, has characters after the number or is above max.
+ */
+static inline unsigned long long parseNumberArg(char const *text, unsigned long long max, int base, bool *ok)
+{
+    char *end;
+    // strtoull() skips blanks and takes a sign
+    if (!isalnum((unsigned char)*text))
+    {
+        *ok = false;
+        return 0;
+    }
+    errno = 0;
+    unsigned long long const n = strtoull(text, &end, base);
+    if (end == text || *end != '\0' || errno == ERANGE || n > max)
+    {
+        *ok = false;
+        return 0;
+    }
+    return n;
+}
+
+/**
+ * Returns the finite real number text. Returns 0 and clears *ok if text is
+ * empty, not finite or has characters after the number.
+ */
+static inline double parseRealArg(char const *text, bool *ok)
+{
+    char *end;
+    double const x = strtod(text, &end);
+    if (end == text || *end != '\0' || !isfinite(x))
+    {
+        *ok = false;
+        return 0;
+    }
+    return x;
+}
+
+#endif // STETRIS_ARGS_H
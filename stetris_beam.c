@@ -0,0 +1,142 @@
+/**
+ * @file stetris_beam.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Beam search bot with lookahead over the following tiles.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Starting from the placements of the current tile, every depth places one
+ * more tile (spawned at the top center like addNewTile()) on each board of
+ * the beam and keeps the width best boards. The boards of a depth are
+ * expanded in parallel on the bot's thread pool, each parent writing its
+ * children into its own slice of the reused scratch buffer.
+ * All tiles are single cells and colors do not matter for play, so the
+ * following tiles are known exactly; only the tick period is assumed to
+ * stay at its current value.
+ */
+
+#include "stetris_bot.h"
+
+#include <float.h>                      // for FLT_MAX
+#include <stdlib.h>                     // for qsort()
+
+typedef struct
+{
+    bot const *b;
+    searchNode const *beam;             // parents of this depth
+    searchNode *children;               // MAX_PLACEMENTS slots per parent
+    unsigned int *counts;               // children written per parent
+    unsigned int period;                // keys per row of the new tiles
+    unsigned long long nodes;           // boards evaluated (atomic)
+} beamDepth;
+
+/**
+ * Places a new tile on one board of the beam and evaluates all results.
+ * Boards where the game is over are dropped.
+ */
+static void expandNode(void *arg, unsigned int index)
+{
+    beamDepth *d = arg;
+    searchNode const *parent = &d->beam[index];
+    searchNode *out = &d->children[index * MAX_PLACEMENTS];
+    placement moves[MAX_PLACEMENTS];
+    float score[MAX_PLACEMENTS];
+    unsigned int count = 0;
+
+    int const n = engineGenPlacements(parent->board, SPAWN_X, 0, d->period, d->period, moves);
+    botEvaluatePlacements(d->b, moves, n, parent->lines, score);
+    for (int i = 0; i < n; i++)
+    {
+        if (score[i] == -FLT_MAX)
+            continue;
+        out[count].board = moves[i].board;
+        out[count].score = score[i];
+        out[count].lines = parent->lines + moves[i].lines;
+        out[count].root = parent->root;
+        count++;
+    }
+    d->counts[index] = count;
+    __atomic_fetch_add(&d->nodes, n, __ATOMIC_RELAXED);
+}
+
+/**
+ * Orders search nodes by descending score.
+ */
+static int compareNodes(void const *a, void const *b)
+{
+    float const sa = ((searchNode const *)a)->score;
+    float const sb = ((searchNode const *)b)->score;
+    return (sa < sb) - (sa > sb);
+}
+
+/**
+ * Sorts nodes and keeps at most width of them in beam.
+ * Returns the number of nodes kept.
+ */
+static unsigned int keepBest(searchNode *beam, searchNode *nodes, unsigned int n, unsigned int width)
+{
+    qsort(nodes, n, sizeof(searchNode), compareNodes);
+    if (n > width)
+        n = width;
+    for (unsigned int i = 0; i < n; i++)
+        beam[i] = nodes[i];
+    return n;
+}
+
+/**
+ * Chooses a placement for the current tile by beam search over
+ * options.depth following tiles, keeping options.width boards per depth.
+ * Returns the index of the chosen candidate, or -1 if there is none.
+ */
+int beamChoose(bot *b, placement const *candidates, int n, unsigned int period)
+{
+    unsigned int const width = b->options.width;
+    searchNode *const beam = b->scratch;
+    searchNode *const children = b->scratch + width;
+    float score[MAX_PLACEMENTS];
+    unsigned int count = 0;
+
+    // Depth 0: the placements of the current tile
+    botEvaluatePlacements(b, candidates, n, 0, score);
+    for (int i = 0; i < n; i++)
+    {
+        if (score[i] == -FLT_MAX)
+            continue;
+        children[count].board = candidates[i].board;
+        children[count].score = score[i];
+        children[count].lines = candidates[i].lines;
+        children[count].root = i;
+        count++;
+    }
+    b->nodes += n;
+    if (count == 0)
+        return (n > 0) ? 0 : -1;
+    count = keepBest(beam, children, count, width);
+
+    for (unsigned int depth = 0; depth < b->options.depth; depth++)
+    {
+        beamDepth d = {
+            .b = b,
+            .beam = beam,
+            .children = children,
+            .counts = b->scratchCount,
+            .period = period,
+        };
+        poolFor(b->pool, expandNode, &d, count);
+        b->nodes += d.nodes;
+
+        // Compact the children slices, then keep the best
+        unsigned int total = 0;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            searchNode const *slice = &children[i * MAX_PLACEMENTS];
+            for (unsigned int j = 0; j < d.counts[i]; j++)
+                children[total++] = slice[j];
+        }
+        if (total == 0)
+            break;      // every line of play ends the game, trust the previous depth
+        count = keepBest(beam, children, total, width);
+    }
+
+    return beam[0].root;
+}
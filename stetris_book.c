@@ -0,0 +1,137 @@
+/**
+ * @file stetris_book.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Opening book of precomputed placements written by stetris_bookgen.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A lookup costs a few probes into the mapped entries, which stay in the
+ * page cache shared by all games and processes using the book.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() with -std=c99
+
+#include "stetris_book.h"
+
+#include <fcntl.h>                      // for open()
+#include <stdio.h>                      // for FILE, fwrite()
+#include <stdlib.h>                     // for qsort()
+#include <string.h>                     // for memcmp, memcpy, memset
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/stat.h>                   // for fstat()
+#include <unistd.h>                     // for close()
+
+#define LINEAR_RANGE 8                  // entries left when interpolation stops
+
+/**
+ * Maps a book file. Returns false if it cannot be read or is not a book.
+ */
+bool bookLoad(openingBook *book, char const *path)
+{
+    memset(book, 0, sizeof(*book));
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(bookHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    bookHeader const *header = map;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0 || header->version != BOOK_VERSION ||
+        (size_t)st.st_size != sizeof(bookHeader) + header->entries * sizeof(bookEntry))
+    {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    book->map = map;
+    book->size = st.st_size;
+    book->pieces = header->pieces;
+    book->count = header->entries;
+    book->entries = (bookEntry const *)(header + 1);
+    return true;
+}
+
+void bookUnload(openingBook *book)
+{
+    if (book->map)
+        munmap(book->map, book->size);
+    book->map = NULL;
+}
+
+/**
+ * Returns the key of the decision for a tile spawned on board at the given
+ * nextGameTick (splitmix64 finalizer, so keys spread evenly).
+ */
+uint64_t bookKey(uint64_t board, unsigned int period)
+{
+    uint64_t z = board + 0x9E3779B97F4A7C15ULL * (period + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Returns the entry with this key, or NULL if the book has none.
+ * Interpolation search: the next probe is where the key would be if the
+ * keys between the bounds were evenly spaced, which they nearly are.
+ */
+bookEntry const *bookLookup(openingBook const *book, uint64_t key)
+{
+    bookEntry const *e = book->entries;
+    uint64_t low = 0, high = book->count;       // key is in [low, high) if present
+
+    while (high - low > LINEAR_RANGE)
+    {
+        uint64_t const lowKey = e[low].key, highKey = e[high - 1].key;
+        if (key < lowKey || key > highKey)
+            return NULL;
+        uint64_t probe = low + (uint64_t)((double)(key - lowKey) / ((double)(highKey - lowKey) + 1) * (high - low));
+        if (probe >= high)
+            probe = high - 1;
+        if (e[probe].key == key)
+            return &e[probe];
+        if (e[probe].key < key)
+            low = probe + 1;
+        else
+            high = probe;
+    }
+    for (uint64_t i = low; i < high; i++)
+    {
+        if (e[i].key == key)
+            return &e[i];
+    }
+    return NULL;
+}
+
+static int compareEntries(void const *x, void const *y)
+{
+    bookEntry const *a = x, *b = y;
+    return (a->key > b->key) - (a->key < b->key);
+}
+
+/**
+ * Sorts count entries by key and writes them as a book.
+ * Returns false if the file cannot be written.
+ */
+bool bookWrite(char const *path, unsigned int pieces, bookEntry *entries, uint64_t count)
+{
+    bookHeader header = {.version = BOOK_VERSION, .pieces = pieces, .entries = count};
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    qsort(entries, count, sizeof(bookEntry), compareEntries);
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool const ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                    fwrite(entries, sizeof(bookEntry), count, f) == count;
+    return (fclose(f) == 0) && ok;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file stetris_book.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Opening book of precomputed placements written by stetris_bookgen.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every game starts from the same empty board, so the first tiles meet the
+ * same few thousand boards again and again. The book maps the key of such
+ * a decision (board and speed) to the placement a slow, deep search chose
+ * for it. The file is mapped read-only:
+ *   bookHeader, then entries bookEntry sorted by key
+ * Keys are a 64 bit hash and therefore close to uniform, which lets the
+ * lookup interpolate the position of a key instead of bisecting.
+ */
+
+#ifndef STETRIS_BOOK_H
+#define STETRIS_BOOK_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for fixed width integer types
+
+#define BOOK_MAGIC "SBOK"
+#define BOOK_VERSION 1
+
+typedef struct
+{
+    char magic[4];                      // BOOK_MAGIC
+    uint32_t version;                   // BOOK_VERSION
+    uint32_t pieces;                    // tiles of the openings covered
+    uint32_t reserved;
+    uint64_t entries;
+} bookHeader;
+
+typedef struct
+{
+    uint64_t key;                       // bookKey() of the decision
+    uint8_t x;                          // lock cell of the chosen placement
+    uint8_t y;
+    uint8_t orphan;                     // placement.orphan
+    uint8_t depth;                      // search depth the choice was made with
+    uint32_t nodes;                     // boards the search evaluated for it
+} bookEntry;
+
+typedef struct
+{
+    void *map;                          // mapped book file
+    size_t size;
+    uint32_t pieces;
+    uint64_t count;
+    bookEntry const *entries;
+} openingBook;
+
+bool bookLoad(openingBook *book, char const *path);
+void bookUnload(openingBook *book);
+uint64_t bookKey(uint64_t board, unsigned int period);
+bookEntry const *bookLookup(openingBook const *book, uint64_t key);
+bool bookWrite(char const *path, unsigned int pieces, bookEntry *entries, uint64_t count);
+
+#endif // STETRIS_BOOK_H
@@ -0,0 +1,217 @@
+/**
+ * @file stetris_bookgen.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Builds the opening book of the bots (--book).
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Enumerates every board a tile can spawn on within the first --pieces
+ * tiles of a game and lets a bot with a generous search budget choose its
+ * placement. The choices are written as a sorted, mappable book (see
+ * stetris_book.h), so in play the common openings cost a lookup instead of
+ * a search. All openings are played at the starting speed: the first level
+ * up needs two cleared rows, which takes at least 16 tiles.
+ * The decisions are spread over the threads of a pool, each chunk with its
+ * own single threaded bot.
+ */
+
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for malloc(), qsort(), exit()
+#include <string.h>                     // for strcmp
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_book.h"
+#include "stetris_args.h"
+
+#define MAX_PIECES 16                   // last tile before the first level up
+#define START_PERIOD 50                 // initNextGameTick of a new game
+#define CHUNK 16                        // decisions per pool task
+
+typedef struct
+{
+    unsigned int pieces;                // openings covered, in tiles
+    unsigned int threads;               // 0 for one per CPU
+    char const *out;                    // book file
+} bookgenOptions;
+
+/**
+ * All decisions of the book, computed in parallel on the pool.
+ */
+typedef struct
+{
+    botOptions const *botOpt;
+    uint64_t const *boards;
+    bookEntry *entries;
+    uint64_t count;
+    bool failed;                        // a bot could not be created (atomic)
+} bookRun;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--pieces N] [--threads N] [--out FILE] " BOT_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static int compareBoards(void const *x, void const *y)
+{
+    uint64_t const a = *(uint64_t const *)x, b = *(uint64_t const *)y;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Sorts boards and removes duplicates. Returns the number left.
+ */
+static uint64_t uniqueBoards(uint64_t *boards, uint64_t n)
+{
+    uint64_t kept = 0;
+    qsort(boards, n, sizeof(uint64_t), compareBoards);
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (kept == 0 || boards[kept - 1] != boards[i])
+            boards[kept++] = boards[i];
+    }
+    return kept;
+}
+
+/**
+ * Lets a fresh bot choose the placements of one chunk of boards.
+ */
+static void decideTask(void *arg, unsigned int index)
+{
+    bookRun *r = arg;
+    uint64_t const begin = (uint64_t)index * CHUNK;
+    uint64_t const end = (r->count - begin < CHUNK) ? r->count : begin + CHUNK;
+    bot b;
+
+    if (!botCreate(&b, r->botOpt))
+    {
+        __atomic_store_n(&r->failed, true, __ATOMIC_RELAXED);
+        return;
+    }
+    for (uint64_t i = begin; i < end; i++)
+    {
+        engineState s;
+        engineInit(&s, 1);
+        engineNewGame(&s);
+        s.nextGameTick = START_PERIOD;
+        engineSetBoard(&s, r->boards[i]);
+
+        unsigned long long const nodes = b.nodes, depth = b.depthSum;
+        b.planned = false;
+        botNextKey(&b, &s);
+        bookEntry *e = &r->entries[i];
+        e->key = bookKey(r->boards[i], START_PERIOD);
+        e->x = b.target.x;
+        e->y = b.target.y;
+        e->orphan = b.target.orphan;
+        e->depth = (b.options.kind == BOT_EXPECTIMAX) ? b.depthSum - depth : b.options.depth;
+        e->nodes = (uint32_t)(b.nodes - nodes);
+        if (!b.planned)
+            e->key = 0;     // no placement, dropped below
+    }
+    botDestroy(&b);
+}
+
+
+int main(int argc, char **argv)
+{
+    bookgenOptions opt = {
+        .pieces = 8,
+        .threads = 0,
+        .out = "stetris_book.bin",
+    };
+    botOptions botOpt = defaultBotOptions;
+    botOpt.kind = BOT_EXPECTIMAX;       // deeper and slower than in play
+    botOpt.depth = 3;
+    botOpt.budget = 20000;
+    botOpt.threads = 1;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--pieces") == 0)
+            opt.pieces = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--out") == 0)
+            opt.out = argv[++i];
+        else if (!botParseOption(&botOpt, argc, argv, &i))
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.pieces == 0 || opt.pieces > MAX_PIECES || botOpt.kind == BOT_PLUGIN || botOpt.kind == BOT_REMOTE)
+        usage(argv[0]);
+
+    // Boards a tile spawns on, layer by layer; layer k holds those of tile k + 1
+    uint64_t capacity = 1024, count = 1, layerBegin = 0;
+    uint64_t *boards = malloc(capacity * sizeof(uint64_t));
+    if (!boards)
+        return EXIT_FAILURE;
+    boards[0] = 0;
+    for (unsigned int piece = 1; piece < opt.pieces; piece++)
+    {
+        uint64_t const layerEnd = count;
+        for (uint64_t i = layerBegin; i < layerEnd; i++)
+        {
+            placement moves[MAX_PLACEMENTS];
+            int const n = engineGenPlacements(boards[i], SPAWN_X, 0, START_PERIOD, START_PERIOD, moves);
+            if (count + n > capacity)
+            {
+                capacity *= 2;
+                boards = realloc(boards, capacity * sizeof(uint64_t));
+                if (!boards)
+                    return EXIT_FAILURE;
+            }
+            for (int m = 0; m < n; m++)
+            {
+                if (!boardOccupied(moves[m].board, SPAWN_X, 0))
+                    boards[count++] = moves[m].board;
+            }
+        }
+        count = layerEnd + uniqueBoards(boards + layerEnd, count - layerEnd);
+        layerBegin = layerEnd;
+    }
+    // A row clear can lead back to a board of an earlier layer
+    count = uniqueBoards(boards, count);
+
+    threadPool *pool = poolCreate(opt.threads);
+    bookRun run = {
+        .botOpt = &botOpt,
+        .boards = boards,
+        .entries = calloc(count, sizeof(bookEntry)),
+        .count = count,
+    };
+    if (!pool || !run.entries)
+    {
+        fprintf(stderr, "ERROR: could not start the book generator\n");
+        return EXIT_FAILURE;
+    }
+    printf("Searching %llu openings of %u tiles on %u threads\n", (unsigned long long)count, opt.pieces,
+           poolThreads(pool));
+
+    double const start = botNow();
+    poolFor(pool, decideTask, &run, (unsigned int)((count + CHUNK - 1) / CHUNK));
+    poolDestroy(pool);
+    if (run.failed)
+        return EXIT_FAILURE;
+
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (run.entries[i].key)
+            run.entries[kept++] = run.entries[i];
+    }
+    if (!bookWrite(opt.out, opt.pieces, run.entries, kept))
+    {
+        fprintf(stderr, "ERROR: could not write %s\n", opt.out);
+        return EXIT_FAILURE;
+    }
+    printf("Book:         %10s (%llu entries, %.1f KB) in %.1f s\n", opt.out, (unsigned long long)kept,
+           (sizeof(bookHeader) + kept * sizeof(bookEntry)) / 1e3, (botNow() - start) / 1e6);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,570 @@
+/**
+ * @file stetris_bot.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Autoplayers that choose the key input for sTetris().
+ * @version 1.1
+ * This file is part of the Stetris project.
+ * A greedy decision enumerates at most MAX_PLACEMENTS boards and evaluates
+ * each with a few bit operations per column, which takes a few microseconds
+ * and is far below one game tick (uSecTickTime). The searches in the other
+ * bot files spend more of the tick to look further ahead.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_gettime() with -std=c99
+
+#include "stetris_bot.h"
+#include "stetris_args.h"
+
+#include <float.h>                      // for FLT_MAX
+#include <stdio.h>                      // for fprintf()
+#include <stdlib.h>                     // for malloc(), free()
+#include <string.h>                     // for memset, strcmp
+#include <time.h>                       // for clock_gettime
+
+
+/**
+ * Weights found by hand, in the order of enum botFeature.
+ */
+botWeights const defaultBotWeights = {
+    .weight = {-0.51f, -0.36f, -0.18f, 0.76f},
+};
+
+botOptions const defaultBotOptions = {
+    .enabled = false,
+    .kind = BOT_GREEDY,
+    .depth = 2,
+    .width = 32,
+    .threads = 0,
+    .budget = 2000,
+    .trees = 1,
+    .ttMegabytes = 1,
+};
+
+// Names used with --bot=NAME, in the order of botKind
+static char const *const botKindNames[NUM_BOT_KINDS] = {"greedy", "beam", "expectimax", "mcts", "plugin", "remote"};
+
+// Names used in weights files, in the order of enum botFeature
+static char const *const featureNames[NUM_FEATURES] = {"height", "holes", "bumpiness", "lines"};
+
+/**
+ * Consumes the bot option at argv[*i] (and its value), see BOT_USAGE.
+ * Returns false if argv[*i] is not a bot option or its value is invalid.
+ */
+bool botParseOption(botOptions *o, int argc, char **argv, int *i)
+{
+    char const *arg = argv[*i];
+
+    if (strcmp(arg, "--bot") == 0)
+    {
+        o->enabled = true;
+        o->kind = BOT_GREEDY;
+        return true;
+    }
+    if (strncmp(arg, "--bot=", 6) == 0)
+    {
+        for (int kind = 0; kind < NUM_BOT_KINDS; kind++)
+        {
+            if (strcmp(arg + 6, botKindNames[kind]) == 0)
+            {
+                o->enabled = true;
+                o->kind = kind;
+                return true;
+            }
+        }
+        return false;
+    }
+    if (*i + 1 >= argc)
+        return false;
+    if (strcmp(arg, "--weights") == 0)
+    {
+        o->weightsFile = argv[++(*i)];
+        return true;
+    }
+    if (strcmp(arg, "--mlp") == 0)
+    {
+        o->mlpFile = argv[++(*i)];
+        return true;
+    }
+    if (strcmp(arg, "--oracle") == 0)
+    {
+        o->oracleFile = argv[++(*i)];
+        return true;
+    }
+    if (strcmp(arg, "--book") == 0)
+    {
+        o->bookFile = argv[++(*i)];
+        return true;
+    }
+    if (strcmp(arg, "--bot-plugin") == 0)
+    {
+        o->enabled = true;
+        o->kind = BOT_PLUGIN;
+        o->pluginFile = argv[++(*i)];
+        return true;
+    }
+    if (strcmp(arg, "--plugin-args") == 0)
+    {
+        o->pluginArgs = argv[++(*i)];
+        return true;
+    }
+    if (strcmp(arg, "--bot-remote") == 0 || strcmp(arg, "--bot-socket") == 0)
+    {
+        o->enabled = true;
+        o->kind = BOT_REMOTE;
+        if (arg[6] == 'r')
+            o->remoteCommand = argv[++(*i)];
+        else
+            o->remoteSocket = argv[++(*i)];
+        return true;
+    }
+
+    unsigned int *value = NULL;
+    if (strcmp(arg, "--depth") == 0)
+        value = &o->depth;
+    else if (strcmp(arg, "--width") == 0)
+        value = &o->width;
+    else if (strcmp(arg, "--threads") == 0)
+        value = &o->threads;
+    else if (strcmp(arg, "--budget") == 0)
+        value = &o->budget;
+    else if (strcmp(arg, "--trees") == 0)
+        value = &o->trees;
+    else if (strcmp(arg, "--tt-mb") == 0)
+        value = &o->ttMegabytes;
+    else
+        return false;
+
+    bool ok = true;
+    *value = (unsigned int)parseNumberArg(argv[++(*i)], UINT_MAX, 0, &ok);
+    return ok && (*value != 0 || value == &o->depth || value == &o->threads || value == &o->budget);
+}
+
+/**
+ * Sets up a bot with the default weights, starting the search threads and
+ * allocating the search buffers the selected kind needs.
+ * Returns false if the resources cannot be allocated.
+ */
+bool botCreate(bot *b, botOptions const *o)
+{
+    memset(b, 0, sizeof(*b));
+    b->options = *o;
+    b->weights = defaultBotWeights;
+    if (o->weightsFile && !botLoadWeights(&b->weights, o->weightsFile))
+    {
+        fprintf(stderr, "ERROR: could not load bot weights from %s\n", o->weightsFile);
+        return false;
+    }
+    if (o->mlpFile && !mlpLoad(&b->mlp, o->mlpFile))
+    {
+        fprintf(stderr, "ERROR: could not load bot network from %s\n", o->mlpFile);
+        return false;
+    }
+    if (o->oracleFile && !solveLoad(&b->oracle, o->oracleFile))
+    {
+        fprintf(stderr, "ERROR: could not load solver table from %s\n", o->oracleFile);
+        mlpUnload(&b->mlp);
+        return false;
+    }
+    if (o->bookFile && !bookLoad(&b->book, o->bookFile))
+    {
+        fprintf(stderr, "ERROR: could not load opening book from %s\n", o->bookFile);
+        mlpUnload(&b->mlp);
+        solveUnload(&b->oracle);
+        return false;
+    }
+
+    // Snapshots carry the period in one byte (stetris_plugin.h, the DECIDE
+    // frame); periods only shrink from the start period with the levels
+    if ((o->kind == BOT_PLUGIN || o->kind == BOT_REMOTE) && gameRules.initNextGameTick > UINT8_MAX)
+    {
+        fprintf(stderr, "ERROR: plugin and remote bots take a start period of at most %d\n", UINT8_MAX);
+        botDestroy(b);
+        return false;
+    }
+    if (o->kind != BOT_GREEDY && o->kind != BOT_PLUGIN && o->kind != BOT_REMOTE)
+    {
+        b->pool = poolCreate(o->threads);
+        if (!b->pool)
+        {
+            fprintf(stderr, "ERROR: could not start bot search threads\n");
+            botDestroy(b);
+            return false;
+        }
+    }
+    if (o->kind == BOT_BEAM)
+    {
+        // Current beam followed by the children of every beam node
+        b->scratch = malloc(sizeof(searchNode) * o->width * (MAX_PLACEMENTS + 1));
+        b->scratchCount = malloc(sizeof(unsigned int) * o->width);
+        if (!b->scratch || !b->scratchCount)
+        {
+            fprintf(stderr, "ERROR: could not allocate bot search buffers\n");
+            botDestroy(b);
+            return false;
+        }
+    }
+    if (o->kind == BOT_EXPECTIMAX)
+    {
+        if (!ttCreate(&b->tt, o->ttMegabytes))
+        {
+            fprintf(stderr, "ERROR: could not allocate bot transposition table\n");
+            botDestroy(b);
+            return false;
+        }
+    }
+    if (o->kind == BOT_PLUGIN && (!o->pluginFile || !pluginOpen(b)))
+    {
+        if (!o->pluginFile)
+            fprintf(stderr, "ERROR: --bot=plugin needs --bot-plugin FILE.so\n");
+        botDestroy(b);
+        return false;
+    }
+    if (o->kind == BOT_REMOTE && ((!o->remoteCommand && !o->remoteSocket) || !remoteOpen(b)))
+    {
+        if (!o->remoteCommand && !o->remoteSocket)
+            fprintf(stderr, "ERROR: --bot=remote needs --bot-remote CMD or --bot-socket PATH\n");
+        botDestroy(b);
+        return false;
+    }
+    if (o->kind == BOT_MCTS && !mctsCreate(b))
+    {
+        fprintf(stderr, "ERROR: could not allocate bot search trees\n");
+        botDestroy(b);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Stops the search threads and frees the search buffers.
+ */
+void botDestroy(bot *b)
+{
+    mctsDestroy(b);
+    poolDestroy(b->pool);
+    free(b->scratch);
+    free(b->scratchCount);
+    ttDestroy(&b->tt);
+    mlpUnload(&b->mlp);
+    solveUnload(&b->oracle);
+    bookUnload(&b->book);
+    pluginClose(b);
+    remoteClose(b);
+    b->pool = NULL;
+    b->scratch = NULL;
+    b->scratchCount = NULL;
+}
+
+/**
+ * Returns the current monotonic time in microseconds.
+ */
+double botNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Reads evaluation weights written by botSaveWeights(): one "feature value"
+ * pair per line, lines starting with '#' are comments. Features missing from
+ * the file keep their value in w. Returns false if the file cannot be read
+ * or names an unknown feature.
+ */
+bool botLoadWeights(botWeights *w, char const *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+
+    botWeights loaded = *w;
+    char line[128], name[32];
+    float value;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f))
+    {
+        if (line[0] == '#' || sscanf(line, "%31s", name) != 1)
+            continue;
+        ok = false;
+        for (int i = 0; i < NUM_FEATURES; i++)
+        {
+            if (strcmp(name, featureNames[i]) == 0 && sscanf(line, "%*s %f", &value) == 1)
+            {
+                loaded.weight[i] = value;
+                ok = true;
+            }
+        }
+    }
+    fclose(f);
+    if (ok)
+        *w = loaded;
+    return ok;
+}
+
+/**
+ * Writes evaluation weights in the format read by botLoadWeights().
+ * Returns false if the file cannot be written.
+ */
+bool botSaveWeights(botWeights const *w, char const *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    fprintf(f, "# Stetris bot evaluation weights\n");
+    for (int i = 0; i < NUM_FEATURES; i++)
+        fprintf(f, "%s %.9g\n", featureNames[i], w->weight[i]);
+    return fclose(f) == 0;
+}
+
+/**
+ * Scores a board after a placement; higher is better.
+ * Full rows at the bottom are removed first, since the following game ticks
+ * clear them. A board where the next tile cannot spawn scores -FLT_MAX.
+ */
+float botEvaluate(botWeights const *w, uint64_t board, unsigned int lines)
+{
+    if (boardOccupied(board, SPAWN_X, 0))
+        return -FLT_MAX;
+    while (board && BOTTOM_ROW_FULL(board))
+        board = boardShiftDown(board);
+
+    unsigned int height[GRID_X];
+    unsigned int aggregateHeight = 0, holes = 0, bumpiness = 0;
+    for (unsigned int x = 0; x < GRID_X; x++)
+    {
+        unsigned int y = 0;
+        while (y < GRID_Y && !boardOccupied(board, x, y))
+            y++;
+        height[x] = GRID_Y - y;
+        aggregateHeight += height[x];
+        for (; y < GRID_Y; y++)
+        {
+            if (!boardOccupied(board, x, y))
+                holes++;
+        }
+        if (x > 0)
+            bumpiness += (height[x] > height[x - 1]) ? height[x] - height[x - 1] : height[x - 1] - height[x];
+    }
+
+    return w->weight[FEATURE_HEIGHT] * aggregateHeight +
+           w->weight[FEATURE_HOLES] * holes +
+           w->weight[FEATURE_BUMPINESS] * bumpiness +
+           w->weight[FEATURE_LINES] * lines;
+}
+
+/**
+ * Scores a board with the bot's evaluator: the network if one is loaded,
+ * otherwise botEvaluate(). Lines are weighted by the heuristic weights in both cases.
+ */
+float botEvaluateBoard(bot const *b, uint64_t board, unsigned int lines)
+{
+    float value;
+    if (!b->mlp.map)
+        return botEvaluate(&b->weights, board, lines);
+    if (boardOccupied(board, SPAWN_X, 0))
+        return -FLT_MAX;
+    mlpEvaluate(&b->mlp, &board, 1, &value);
+    return value + b->weights.weight[FEATURE_LINES] * lines;
+}
+
+/**
+ * Scores the boards of n placements in one batch, each with lines plus the
+ * lines of the placement, into out.
+ */
+void botEvaluatePlacements(bot const *b, placement const *moves, int n, unsigned int lines, float *out)
+{
+    float const lineWeight = b->weights.weight[FEATURE_LINES];
+    uint64_t boards[MAX_PLACEMENTS];
+
+    if (!b->mlp.map || n <= 0)
+    {
+        for (int i = 0; i < n; i++)
+            out[i] = botEvaluate(&b->weights, moves[i].board, lines + moves[i].lines);
+        return;
+    }
+    for (int i = 0; i < n; i++)
+        boards[i] = moves[i].board;
+    mlpEvaluate(&b->mlp, boards, n, out);
+    for (int i = 0; i < n; i++)
+    {
+        if (boardOccupied(moves[i].board, SPAWN_X, 0))
+            out[i] = -FLT_MAX;
+        else
+            out[i] += lineWeight * (lines + moves[i].lines);
+    }
+}
+
+/**
+ * Returns the index of the candidate with the best evaluation, or -1 if there is none.
+ */
+static int greedyChoose(bot *b, placement const *candidates, int n)
+{
+    float score[MAX_PLACEMENTS];
+    int best = -1;
+
+    botEvaluatePlacements(b, candidates, n, 0, score);
+    for (int i = 0; i < n; i++)
+    {
+        if (best < 0 || score[i] > score[best])
+            best = i;
+    }
+    b->nodes += n;
+    return best;
+}
+
+/**
+ * Picks the placement with the most tiles left according to the solver
+ * table, breaking ties by the evaluation. Returns -1 if the table does not
+ * cover the decision: another speed, a tile that has moved already or a
+ * board the solver has not reached, for the decision or for one of its
+ * placements (a truncated table), which might be better than all known ones.
+ */
+static int oracleChoose(bot *b, engineState const *s, uint64_t board, placement const *candidates, int n)
+{
+    solveTable const *t = &b->oracle;
+    float score[MAX_PLACEMENTS];
+    int value[MAX_PLACEMENTS];
+    int best = -1;
+
+    if (n <= 0 || s->nextGameTick != t->period || engineKeysToGravity(s) != t->period ||
+        s->activeX != SPAWN_X || s->activeY != 0 || solveLookup(t, board) < 0)
+        return -1;
+    for (int i = 0; i < n; i++)
+    {
+        value[i] = boardOccupied(candidates[i].board, SPAWN_X, 0) ? 0 : solveLookup(t, candidates[i].board);
+        if (value[i] < 0)
+            return -1;
+    }
+
+    botEvaluatePlacements(b, candidates, n, 0, score);
+    for (int i = 0; i < n; i++)
+    {
+        if (best < 0 || value[i] > value[best] || (value[i] == value[best] && score[i] > score[best]))
+            best = i;
+    }
+    b->oracleDecisions++;
+    return best;
+}
+
+/**
+ * Returns the candidate the opening book lists for this decision, or -1 if
+ * the book has no entry for it.
+ */
+static int bookChoose(bot *b, engineState const *s, uint64_t board, placement const *candidates, int n)
+{
+    if (s->activeX != SPAWN_X || s->activeY != 0 || engineKeysToGravity(s) != s->nextGameTick)
+        return -1;
+    bookEntry const *e = bookLookup(&b->book, bookKey(board, s->nextGameTick));
+    for (int i = 0; e && i < n; i++)
+    {
+        if (candidates[i].x == e->x && candidates[i].y == e->y && candidates[i].orphan == e->orphan)
+        {
+            b->bookDecisions++;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Chooses the best placement for the active tile of s and plans the path to it.
+ */
+static void plan(bot *b, engineState const *s)
+{
+    placement candidates[MAX_PLACEMENTS];
+    uint64_t const board = s->occupied & ~CELL_MASK(s->activeX, s->activeY);
+    unsigned int const keysLeft = engineKeysToGravity(s);
+    int const n = engineGenMoves(s, candidates);
+
+    double const start = botNow();
+    int best = b->oracle.map ? oracleChoose(b, s, board, candidates, n) : -1;
+    if (best < 0 && b->book.map)
+        best = bookChoose(b, s, board, candidates, n);
+    switch (best < 0 ? b->options.kind : NUM_BOT_KINDS)
+    {
+    case BOT_BEAM:
+        best = beamChoose(b, candidates, n, s->nextGameTick);
+        break;
+    case BOT_EXPECTIMAX:
+        best = expectimaxChoose(b, candidates, n, s->nextGameTick);
+        break;
+    case BOT_MCTS:
+        best = mctsChoose(b, s, candidates, n);
+        break;
+    case NUM_BOT_KINDS:
+        break;      // taken from the oracle or the book
+    default:
+        best = greedyChoose(b, candidates, n);
+    }
+    b->uSecSearching += botNow() - start;
+    b->decisions++;
+
+    b->planned = best >= 0 &&
+                 enginePlanPath(board, s->activeX, s->activeY, keysLeft, s->nextGameTick, &candidates[best], b->path);
+    if (b->planned)
+        b->target = candidates[best];
+    b->tiles = s->tiles;
+}
+
+/**
+ * Returns the key the bot presses in this tick, or 0 for no key.
+ * In GAMEOVER state the bot presses KEY_UP to start a new game.
+ */
+int botNextKey(bot *b, engineState const *s)
+{
+    if (botIsExternal(b))
+    {
+        if (s->state == GAMEOVER)
+        {
+            botEndExternalGame(b, &b->game, 0);
+            return KEY_UP;
+        }
+        if (pluginNeedsDecision(&b->game, s))
+            botDecideExternal(b, s, &b->game, &(uint32_t){0}, 1);
+        return pluginNextKey(&b->game);
+    }
+    if (s->state == GAMEOVER)
+    {
+        b->planned = false;
+        return KEY_UP;
+    }
+    if (!b->planned || b->tiles != s->tiles)
+        plan(b, s);
+    if (!b->planned)
+        return 0;
+    return enginePathKey(s, &b->target, b->path);
+}
+
+/**
+ * Returns true if the bot's decisions are made by a plugin or a remote bot,
+ * which return input sequences instead of lock positions.
+ */
+bool botIsExternal(bot const *b)
+{
+    return b->options.kind == BOT_PLUGIN || b->options.kind == BOT_REMOTE;
+}
+
+/**
+ * Asks the plugin or remote bot for the input sequences of n games,
+ * see pluginDecide().
+ */
+void botDecideExternal(bot *b, engineState const *states, pluginGame *games, uint32_t const *index, unsigned int n)
+{
+    if (b->options.kind == BOT_REMOTE)
+        remoteDecide(b, states, games, index, n);
+    else
+        pluginDecide(b, states, games, index, n);
+}
+
+/**
+ * Tells the plugin or remote bot that the game with this id has ended.
+ */
+void botEndExternalGame(bot *b, pluginGame *g, uint32_t id)
+{
+    if (b->options.kind == BOT_REMOTE)
+        remoteEndGame(b, g, id);
+    else
+        pluginEndGame(b, g, id);
+}
+
@@ -0,0 +1,177 @@
+/**
+ * @file stetris_bot.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Autoplayers that choose the key input for sTetris().
+ * @version 1.2
+ * This file is part of the Stetris project.
+ * A bot is asked for one key per game tick. When a new tile appears it
+ * enumerates all reachable lock positions, lets the selected search pick
+ * one of them and then steers the tile there.
+ */
+
+#ifndef STETRIS_BOT_H
+#define STETRIS_BOT_H
+
+#include "stetris_book.h"
+#include "stetris_engine.h"
+#include "stetris_mlp.h"
+#include "stetris_plugin.h"
+#include "stetris_pool.h"
+#include "stetris_solve.h"
+#include "stetris_tt.h"
+
+// Command line help for the options understood by botParseOption()
+#define BOT_USAGE "[--bot[=greedy|beam|expectimax|mcts]] [--bot-plugin FILE.so] [--plugin-args ARGS]" \
+                  " [--bot-remote CMD] [--bot-socket PATH]" \
+                  " [--depth K] [--width W] [--threads N] [--budget USEC] [--trees R] [--tt-mb MB] [--weights FILE] [--mlp FILE]" \
+                  " [--oracle FILE] [--book FILE]"
+
+/**
+ * Indices of the board features in botWeights.
+ */
+enum botFeature
+{
+    FEATURE_HEIGHT,                     // aggregate column height
+    FEATURE_HOLES,                      // free cells below the top of their column
+    FEATURE_BUMPINESS,                  // sum of height differences of neighbouring columns
+    FEATURE_LINES,                      // bottom rows completed by the placement
+    NUM_FEATURES
+};
+
+typedef enum
+{
+    BOT_GREEDY,                         // best evaluation of the current tile only
+    BOT_BEAM,                           // beam search over the following tiles
+    BOT_EXPECTIMAX,                     // expectimax over the randomizer of new tiles
+    BOT_MCTS,                           // Monte Carlo tree search with random playouts
+    BOT_PLUGIN,                         // bot loaded from a shared object
+    BOT_REMOTE,                         // bot in another process, see stetris_protocol.h
+    NUM_BOT_KINDS
+} botKind;
+
+typedef struct
+{
+    float weight[NUM_FEATURES];
+} botWeights;
+
+typedef struct
+{
+    bool enabled;                       // --bot was given
+    botKind kind;
+    unsigned int depth;                 // tiles of lookahead after the current one
+    unsigned int width;                 // boards kept per depth by the beam search
+    unsigned int threads;               // search threads, 0 for one per CPU
+    unsigned int budget;                // search time per decision in microseconds
+    unsigned int trees;                 // independent MCTS trees (root parallelism)
+    unsigned int ttMegabytes;           // size of the transposition table
+    char const *weightsFile;            // evaluation weights to load, NULL for the defaults
+    char const *mlpFile;                // network replacing the heuristic, NULL for none
+    char const *oracleFile;             // stetris_solver table consulted before searching
+    char const *bookFile;               // stetris_bookgen opening book consulted before searching
+    char const *pluginFile;             // shared object of BOT_PLUGIN
+    char const *pluginArgs;             // passed to the plugin's create()
+    char const *remoteCommand;          // shell command starting a BOT_REMOTE bot
+    char const *remoteSocket;           // Unix socket of a running BOT_REMOTE bot
+} botOptions;
+
+/**
+ * Board reached by the search, with the root placement it started from.
+ */
+typedef struct
+{
+    uint64_t board;
+    float score;
+    uint16_t lines;                     // bottom rows completed on the way
+    uint8_t root;                       // index of the placement of the current tile
+} searchNode;
+
+typedef struct mctsTree mctsTree;
+typedef struct remoteBot remoteBot;
+
+// Games passed to a plugin per decide() call, or to a remote bot per DECIDE frame
+#define PLUGIN_BATCH 64
+
+/**
+ * Input sequence of a plugin or remote bot for one game and the position replayed so far.
+ */
+typedef struct
+{
+    stetrisInput input;
+    uint8_t position;                   // next key of input
+    bool planned;                       // input belongs to the current tile
+    uint32_t tiles;                     // tile counter the input was made for
+} pluginGame;
+
+typedef struct
+{
+    botOptions options;
+    botWeights weights;                 // evaluation weights
+    mlpModel mlp;                       // board evaluator if mlp.map is set
+    solveTable oracle;                  // exact survival values if oracle.map is set
+    openingBook book;                   // precomputed openings if book.map is set
+    threadPool *pool;                   // search threads, NULL for single threaded
+    searchNode *scratch;                // node buffers reused between decisions
+    unsigned int *scratchCount;
+    transpositionTable tt;              // shared by the expectimax search threads
+    mctsTree *trees;                    // node arenas of the MCTS search
+    void *pluginHandle;                 // dlopen() handle of BOT_PLUGIN
+    stetrisPlugin const *plugin;
+    void *pluginBot;                    // instance created by the plugin
+    remoteBot *remote;                  // connection of BOT_REMOTE
+    pluginGame game;                    // plugin input of the game played by botNextKey()
+
+    bool planned;                       // a target has been chosen for the current tile
+    uint32_t tiles;                     // tile counter the plan was made for
+    placement target;                   // chosen lock position
+    uint8_t path[GRID_Y];               // column to be in at each gravity step
+
+    unsigned long long nodes;           // boards evaluated by all decisions
+    unsigned long long decisions;
+    ttStats probeStats;                 // transposition table probes of all decisions
+    unsigned long long depthSum;        // completed search depth summed over decisions
+    unsigned long long playouts;        // MCTS playouts run by all decisions
+    unsigned long long oracleDecisions; // decisions taken from the oracle table
+    unsigned long long bookDecisions;   // decisions taken from the opening book
+    unsigned long long lateDecisions;   // plugin decisions returned after their deadline
+    double maxRequestUSec;              // slowest reply of a remote bot
+    double uSecSearching;               // time spent in all decisions
+} bot;
+
+extern botWeights const defaultBotWeights;
+extern botOptions const defaultBotOptions;
+
+bool botParseOption(botOptions *o, int argc, char **argv, int *i);
+bool botCreate(bot *b, botOptions const *o);
+void botDestroy(bot *b);
+bool botLoadWeights(botWeights *w, char const *path);
+bool botSaveWeights(botWeights const *w, char const *path);
+float botEvaluate(botWeights const *w, uint64_t board, unsigned int lines);
+float botEvaluateBoard(bot const *b, uint64_t board, unsigned int lines);
+void botEvaluatePlacements(bot const *b, placement const *moves, int n, unsigned int lines, float *out);
+int botNextKey(bot *b, engineState const *s);
+bool botIsExternal(bot const *b);
+void botDecideExternal(bot *b, engineState const *states, pluginGame *games, uint32_t const *index, unsigned int n);
+void botEndExternalGame(bot *b, pluginGame *g, uint32_t id);
+
+double botNow();
+
+int beamChoose(bot *b, placement const *candidates, int n, unsigned int period);
+int expectimaxChoose(bot *b, placement const *candidates, int n, unsigned int period);
+bool mctsCreate(bot *b);
+void mctsDestroy(bot *b);
+int mctsChoose(bot *b, engineState const *s, placement const *candidates, int n);
+bool pluginOpen(bot *b);
+void pluginClose(bot *b);
+void pluginDecide(bot *b, engineState const *states, pluginGame *games, uint32_t const *index, unsigned int n);
+bool pluginNeedsDecision(pluginGame const *g, engineState const *s);
+int pluginNextKey(pluginGame *g);
+void pluginEndGame(bot *b, pluginGame *g, uint32_t id);
+bool remoteOpen(bot *b);
+void remoteClose(bot *b);
+void remoteDecide(bot *b, engineState const *states, pluginGame *games, uint32_t const *index, unsigned int n);
+void remoteEndGame(bot *b, pluginGame *g, uint32_t id);
+char const *remoteName(bot const *b);
+double remoteCpuUSec(bot const *b);
+
+#endif // STETRIS_BOT_H
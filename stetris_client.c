@@ -0,0 +1,334 @@
+/**
+ * @file stetris_client.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief STATE frames of the stetrisd protocol and the client side of a session.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The frontends use the client with --connect PATH: they send the keys they
+ * read and render the state they get back instead of running the game
+ * themselves. The encoding of STATE frames is shared with stetrisd.
+ */
+
+#include "stetris_server.h"
+
+#include <errno.h>                      // for errno, EINTR, EAGAIN
+#include <poll.h>                       // for poll()
+#include <signal.h>                     // for signal(), SIGPIPE
+#include <stdio.h>                      // for fprintf()
+#include <string.h>                     // for memcpy, memmove, strlen, strcpy
+#include <sys/socket.h>                 // for socket(), connect()
+#include <sys/un.h>                     // for struct sockaddr_un
+#include <unistd.h>                     // for read(), write(), close()
+
+#define WELCOME_TIMEOUT_MSEC 2000       // time the server gets to answer JOIN
+
+/**
+ * Writes the fields of flags of game s into payload after serverTick.
+ * Returns the payload length, at most SESSION_STATE_MAX.
+ */
+size_t sessionPutState(uint8_t *payload, uint16_t flags, uint32_t serverTick, engineState const *s)
+{
+    uint8_t *p = payload;
+
+    stetrisPut32(p, serverTick);
+    p += 4;
+    if (flags & SESSION_DELTA_BOARD)
+    {
+        stetrisPut64(p, s->occupied);
+        for (unsigned int i = 0; i < 3; i++)
+            stetrisPut64(p + 8 + 8 * i, s->colorPlane[i]);
+        p += 32;
+    }
+    if (flags & SESSION_DELTA_ACTIVE)
+    {
+        *p++ = s->activeX;
+        *p++ = s->activeY;
+    }
+    if (flags & SESSION_DELTA_STATE)
+        *p++ = s->state;
+    if (flags & SESSION_DELTA_COUNTERS)
+    {
+        stetrisPut32(p, s->tiles);
+        stetrisPut32(p + 4, s->rows);
+        stetrisPut32(p + 8, s->score);
+        stetrisPut32(p + 12, s->level);
+        p += 16;
+    }
+    if (flags & SESSION_DELTA_SPEED)
+    {
+        stetrisPut32(p, s->tick);
+        stetrisPut32(p + 4, s->nextGameTick);
+        p += 8;
+    }
+    return p - payload;
+}
+
+/**
+ * Applies the fields of flags in payload to game s. Returns false if the
+ * payload is too short for them.
+ */
+bool sessionGetState(uint8_t const *payload, uint32_t length, uint16_t flags, engineState *s)
+{
+    uint8_t const *p = payload + 4;
+    uint8_t const *const end = payload + length;
+
+    if (length < 4)
+        return false;
+    if (flags & SESSION_DELTA_BOARD)
+    {
+        if (end - p < 32)
+            return false;
+        s->occupied = stetrisGet64(p);
+        for (unsigned int i = 0; i < 3; i++)
+            s->colorPlane[i] = stetrisGet64(p + 8 + 8 * i);
+        p += 32;
+    }
+    if (flags & SESSION_DELTA_ACTIVE)
+    {
+        if (end - p < 2)
+            return false;
+        s->activeX = *p++;
+        s->activeY = *p++;
+    }
+    if (flags & SESSION_DELTA_STATE)
+    {
+        if (end - p < 1)
+            return false;
+        s->state = *p++;
+    }
+    if (flags & SESSION_DELTA_COUNTERS)
+    {
+        if (end - p < 16)
+            return false;
+        s->tiles = stetrisGet32(p);
+        s->rows = stetrisGet32(p + 4);
+        s->score = stetrisGet32(p + 8);
+        s->level = stetrisGet32(p + 12);
+        p += 16;
+    }
+    if (flags & SESSION_DELTA_SPEED)
+    {
+        if (end - p < 8)
+            return false;
+        s->tick = stetrisGet32(p);
+        s->nextGameTick = stetrisGet32(p + 4);
+    }
+    return true;
+}
+
+/**
+ * Returns the flags of the fields in which s differs from sent, with
+ * SESSION_DELTA_SPEED added if any does.
+ */
+uint16_t sessionDelta(engineState const *sent, engineState const *s)
+{
+    uint16_t flags = 0;
+
+    if (s->occupied != sent->occupied || memcmp(s->colorPlane, sent->colorPlane, sizeof(s->colorPlane)) != 0)
+        flags |= SESSION_DELTA_BOARD;
+    if (s->activeX != sent->activeX || s->activeY != sent->activeY)
+        flags |= SESSION_DELTA_ACTIVE;
+    if (s->state != sent->state)
+        flags |= SESSION_DELTA_STATE;
+    if (s->tiles != sent->tiles || s->rows != sent->rows || s->score != sent->score || s->level != sent->level)
+        flags |= SESSION_DELTA_COUNTERS;
+    if (flags || s->nextGameTick != sent->nextGameTick)
+        flags |= SESSION_DELTA_SPEED;
+    return flags;
+}
+
+/**
+ * Writes all bytes to the server. Returns false and disconnects on errors.
+ */
+static bool sendAll(serverClient *c, uint8_t const *data, size_t size)
+{
+    while (c->fd >= 0 && size > 0)
+    {
+        ssize_t const n = write(c->fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            clientClose(c);
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+    return c->fd >= 0;
+}
+
+/**
+ * Reads what the server has sent, waiting up to timeout milliseconds for
+ * the first byte. Returns false when the server is gone.
+ */
+static bool receive(serverClient *c, int timeout)
+{
+    struct pollfd p = {.fd = c->fd, .events = POLLIN};
+    if (c->fd < 0)
+        return false;
+    if (poll(&p, 1, timeout) <= 0)
+        return true;
+
+    ssize_t const n = read(c->fd, c->buffer + c->buffered, sizeof(c->buffer) - c->buffered);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return true;
+    if (n <= 0)
+    {
+        clientClose(c);
+        return false;
+    }
+    c->buffered += n;
+    return true;
+}
+
+/**
+ * Returns the size of the first frame in the buffer, or 0 if it has not
+ * arrived completely. Disconnects on frames that are too long.
+ */
+static size_t peekFrame(serverClient *c, uint16_t *type, uint16_t *count, uint32_t *length)
+{
+    if (c->buffered < STETRIS_FRAME_HEADER)
+        return 0;
+    *length = stetrisGet32(c->buffer);
+    *type = stetrisGet16(c->buffer + 4);
+    *count = stetrisGet16(c->buffer + 6);
+    if (*length > STETRIS_MAX_PAYLOAD)
+    {
+        clientClose(c);
+        return 0;
+    }
+    return (c->buffered >= STETRIS_FRAME_HEADER + *length) ? STETRIS_FRAME_HEADER + *length : 0;
+}
+
+static void dropFrame(serverClient *c, size_t size)
+{
+    c->buffered -= size;
+    memmove(c->buffer, c->buffer + size, c->buffered);
+}
+
+/**
+ * Connects to stetrisd on the Unix socket path and joins a new session,
+ * which starts in the GAMEOVER state like a local game.
+ * Returns false and prints the reason if that fails.
+ */
+bool clientConnect(serverClient *c, char const *path, uint32_t seed)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    // A server that goes away must not kill the frontend with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+    if (strlen(path) >= sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path, path);
+    c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "ERROR: could not connect to %s\n", path);
+        clientClose(c);
+        return false;
+    }
+
+    uint8_t join[STETRIS_FRAME_HEADER + 8];
+    stetrisPutHeader(join, 8, STETRIS_MSG_JOIN, 0);
+    stetrisPut32(join + STETRIS_FRAME_HEADER, STETRIS_SESSION_VERSION);
+    stetrisPut32(join + STETRIS_FRAME_HEADER + 4, seed);
+    sendAll(c, join, sizeof(join));
+
+    uint16_t type, count;
+    uint32_t length;
+    size_t size;
+    for (int waited = 0; !(size = peekFrame(c, &type, &count, &length)) && waited < WELCOME_TIMEOUT_MSEC; waited += 10)
+    {
+        if (!receive(c, 10))
+            break;
+    }
+    uint8_t const *payload = c->buffer + STETRIS_FRAME_HEADER;
+    if (!size || type != STETRIS_MSG_WELCOME || length < 12 || stetrisGet32(payload) != STETRIS_SESSION_VERSION)
+    {
+        fprintf(stderr, "ERROR: server did not answer JOIN with session version %d\n", STETRIS_SESSION_VERSION);
+        clientClose(c);
+        return false;
+    }
+    c->session = stetrisGet32(payload + 4);
+    c->uSecTickTime = stetrisGet32(payload + 8);
+    dropFrame(c, size);
+    engineInit(&c->state, seed);
+    return true;
+}
+
+/**
+ * Sends one key to the session. Returns false when the server is gone.
+ */
+bool clientSendKey(serverClient *c, int key)
+{
+    uint8_t frame[STETRIS_FRAME_HEADER + 1];
+    stetrisPutHeader(frame, 1, STETRIS_MSG_KEYS, 1);
+    frame[STETRIS_FRAME_HEADER] = (uint8_t)key;
+    return sendAll(c, frame, sizeof(frame));
+}
+
+/**
+ * Holds key down on the server until the next call, which repeats LEFT and
+ * RIGHT without a frame per repeat; key 0 releases it. Returns false when
+ * the server is gone.
+ */
+bool clientHoldKey(serverClient *c, int key)
+{
+    uint8_t frame[STETRIS_FRAME_HEADER + 1];
+    stetrisPutHeader(frame, 1, STETRIS_MSG_HOLD, 0);
+    frame[STETRIS_FRAME_HEADER] = (uint8_t)key;
+    return sendAll(c, frame, sizeof(frame));
+}
+
+/**
+ * Applies the STATE frames that have arrived, without waiting.
+ * Returns 1 if the state changed, 0 if not and -1 when the server is gone.
+ */
+int clientPoll(serverClient *c)
+{
+    bool changed = false;
+    uint16_t type, count;
+    uint32_t length;
+    size_t size;
+
+    if (!receive(c, 0))
+        return -1;
+    while ((size = peekFrame(c, &type, &count, &length)))
+    {
+        uint8_t const *payload = c->buffer + STETRIS_FRAME_HEADER;
+        if (type == STETRIS_MSG_BYE || (type == STETRIS_MSG_STATE && !sessionGetState(payload, length, count, &c->state)))
+        {
+            clientClose(c);
+            return -1;
+        }
+        if (type == STETRIS_MSG_STATE)
+        {
+            c->serverTick = stetrisGet32(payload);
+            changed = true;
+        }
+        dropFrame(c, size);
+    }
+    return (c->fd < 0) ? -1 : changed;
+}
+
+/**
+ * Says BYE and closes the connection.
+ */
+void clientClose(serverClient *c)
+{
+    if (c->fd < 0)
+        return;
+    int const fd = c->fd;
+    uint8_t bye[STETRIS_FRAME_HEADER];
+    stetrisPutHeader(bye, 0, STETRIS_MSG_BYE, 0);
+    c->fd = -1;
+    if (write(fd, bye, sizeof(bye)) < 0)
+    {
+        // The server is gone already
+    }
+    close(fd);
+}
@@ -0,0 +1,736 @@
+/**
+ * @file stetris_difficulty.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Analytic difficulty model: the game under a bot policy as a Markov chain.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Tiles are single cells and only their color is random, so the player is
+ * the only source of chance. The player is modelled as the bot making a
+ * mistake with probability --mistakes per tile: then it takes one of the
+ * placements of the tile at random, all equally likely, else the bot's own.
+ * With --think TICKS it lets the tile fall that long before it moves it,
+ * which is what makes the speed of a level matter to the bot.
+ * As in stetris_solver, the future of a game depends on nothing but the
+ * settled board when a tile spawns, plus the level (which sets the fall
+ * period through the level schedule) and the rows cleared since the last
+ * level up. These three compress a game into one state of the chain;
+ * colors, score and the tick phase are dropped, the score follows from the
+ * rows. Levels from --max-level on are merged into one.
+ * The distribution over states is pushed forward one tile at a time,
+ * p(t+1) = p(t) P, which gives the probability of every game length, row
+ * count and score exactly, up to the mass of states below --epsilon that
+ * is dropped and reported. The rows of P (successors and probabilities of
+ * a state, with the bot's decision) are computed the first time a state is
+ * reached and kept; expansion and the sparse products run in parallel in a
+ * thread pool, with the states in a lock-free hash set.
+ * --simulate N plays N games through the engine with the same player for
+ * comparison with sampling.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() flags with -std=c99
+
+#include <math.h>                       // for sqrt()
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for calloc(), exit()
+#include <string.h>                     // for strcmp
+#include <sys/mman.h>                   // for mmap(), munmap()
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_pool.h"
+#include "stetris_args.h"
+
+#define CHUNK 1024                      // active states per pool task
+#define NO_STATE UINT32_MAX             // successor cut off by --max-states
+#define DEAD_END (UINT32_MAX - 1)       // successor where no new tile can spawn
+#define CLAIMED UINT32_MAX              // hash slot taken, index not published yet
+#define MAX_BOTS 256                    // threads with a bot of their own
+#define SURVIVAL_POINTS 6
+#define MAX_DROPPED 1e-4                // dropped mass above which the chain gives no results
+
+typedef struct
+{
+    double mistakes;                    // chance of a random placement per tile
+    unsigned long think;                // ticks without a key after each new tile
+    unsigned long maxTiles;             // horizon of the iteration
+    unsigned int maxLevel;              // levels from here on are merged
+    double epsilon;                     // states with less probability are dropped
+    double tolerance;                   // stop once less probability is left in play
+    unsigned long maxStates;
+    unsigned int threads;               // 0 for one per CPU
+    unsigned long simulate;             // games to play through the engine, 0 for none
+    unsigned long seed;                 // of the mistakes of the simulated games
+} modelOptions;
+
+/**
+ * Edge of the chain: the successor state and its probability.
+ */
+typedef struct
+{
+    uint32_t target;                    // state index, NO_STATE or DEAD_END
+    uint8_t lines;                      // rows completed by the placement
+    double probability;
+} chainEdge;
+
+/**
+ * Distribution of the end of a game, from the chain or from simulated games.
+ */
+typedef struct
+{
+    double *byTiles;                    // mass of games ending with t tiles, t <= maxTiles
+    double *byRows;                     // mass of ended games by rows cleared
+    unsigned int rowBuckets;            // the last one holds all games at the merged level
+    double survived;                    // mass still playing after maxTiles
+    double dropped;                     // mass lost to --epsilon and --max-states
+} endDistribution;
+
+/**
+ * The chain: states in breadth-first order of discovery with their edges,
+ * the hash set of the states and the probability vectors of the iteration.
+ * Arrays are reserved for --max-states and backed by memory once touched.
+ */
+typedef struct
+{
+    modelOptions const *opt;
+    botOptions const *botOpt;
+    uint32_t period[256];               // nextGameTick of each level
+    uint32_t *slots;                    // state index + 1, 0 if empty or CLAIMED
+    uint64_t mask;                      // hash slots - 1
+    uint64_t *boards;                   // by state index
+    uint16_t *levels;
+    uint8_t *phases;                    // rows cleared since the last level up
+    uint32_t *edgeStart;                // first edge + 1, 0 until expanded
+    uint8_t *edgeCount;
+    chainEdge *edges;
+    uint32_t states;                    // (atomic)
+    uint64_t edgeTotal;                 // (atomic)
+    double *mass;                       // probability of each state at the current tile
+    double *next;                       // at the next tile
+    uint32_t *stamp;                    // tile a state was last added to the next active list
+    uint32_t *active, *nextActive;      // states with probability at the current and next tile
+    uint32_t activeCount, nextCount;    // (nextCount atomic)
+    uint32_t tile;
+    endDistribution *end;
+    bool truncated;                     // --max-states was reached (atomic)
+    bot *bots[MAX_BOTS];                // one per thread, see threadBot()
+    uint32_t botCount;                  // (atomic)
+} chain;
+
+static __thread bot *ownBot;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--mistakes P] [--think TICKS] [--max-tiles N] [--max-level L] [--epsilon E] [--tolerance T]"
+                    " [--max-states N] [--threads N] [--simulate GAMES [--seed S]] " ENGINE_USAGE " " BOT_USAGE "\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Reserves zero filled memory that is only backed by pages once they are touched.
+ */
+static void *reserve(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/**
+ * Adds value to *target atomically.
+ */
+static void atomicAddDouble(double *target, double value)
+{
+    uint64_t *const bits = (uint64_t *)target;
+    uint64_t current = __atomic_load_n(bits, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        double sum;
+        uint64_t wanted;
+        memcpy(&sum, &current, sizeof(sum));
+        sum += value;
+        memcpy(&wanted, &sum, sizeof(wanted));
+        if (__atomic_compare_exchange_n(bits, &current, wanted, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return;
+    }
+}
+
+/**
+ * Returns the bot of the calling thread, created on first use.
+ */
+static bot *threadBot(chain *c)
+{
+    if (ownBot)
+        return ownBot;
+    uint32_t const i = __atomic_fetch_add(&c->botCount, 1, __ATOMIC_RELAXED);
+    bot *b = malloc(sizeof(bot));
+    if (i >= MAX_BOTS || !b || !botCreate(b, c->botOpt))
+    {
+        fprintf(stderr, "ERROR: could not create the bot of a thread\n");
+        exit(EXIT_FAILURE);
+    }
+    c->bots[i] = b;
+    ownBot = b;
+    return b;
+}
+
+/**
+ * Lets --think ticks pass without a key after a tile spawned in s. Returns
+ * true if the tile locked meanwhile, with the board at the next spawn and
+ * the rows completed in forced; the spawn cell is set if the game ended.
+ */
+static bool think(chain const *c, engineState *s, placement *forced)
+{
+    engineState const before = *s;
+
+    for (unsigned long t = 0; t < c->opt->think; t++)
+    {
+        engineStep(s, 0);
+        if (s->state == GAMEOVER || s->tiles != before.tiles)
+        {
+            forced->board = (s->state == GAMEOVER) ? s->occupied | CELL_MASK(SPAWN_X, 0)
+                                                   : s->occupied & ~CELL_MASK(s->activeX, s->activeY);
+            forced->lines = (uint8_t)(s->rows - before.rows);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Generates the placements of the active tile of s and returns the index of
+ * the one bot b takes, or -1 if it has no plan.
+ */
+static int botChoice(bot *b, engineState const *s, placement *moves, int *n)
+{
+    *n = engineGenMoves(s, moves);
+    b->planned = false;
+    botNextKey(b, s);
+    for (int i = 0; b->planned && i < *n; i++)
+    {
+        if (moves[i].x == b->target.x && moves[i].y == b->target.y && moves[i].orphan == b->target.orphan)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Returns the placements of a tile spawned on board at level in moves, and
+ * the index of the one the bot takes, or -1 if it has no plan. A tile that
+ * locks while the player thinks has the one placement it fell into.
+ */
+static int decide(chain *c, uint64_t board, unsigned int level, placement *moves, int *n)
+{
+    engineState s;
+
+    engineInit(&s, 1);
+    s.nextGameTick = c->period[level];
+    s.level = level;
+    engineSetBoard(&s, board);
+    if (think(c, &s, &moves[0]))
+    {
+        *n = 1;
+        return 0;
+    }
+    return botChoice(threadBot(c), &s, moves, n);
+}
+
+/**
+ * Returns the index of the state (board, level, phase), adding it if it is
+ * not known. Returns NO_STATE if it is new and the state limit has been reached.
+ */
+static uint32_t findOrAdd(chain *c, uint64_t board, unsigned int level, unsigned int phase)
+{
+    uint64_t const key = board ^ ((uint64_t)(level << 8 | phase) * 0xD1B54A32D192ED03ULL);
+    uint64_t slot = boardHash(key) & c->mask;
+
+    for (;;)
+    {
+        uint32_t id = __atomic_load_n(&c->slots[slot], __ATOMIC_ACQUIRE);
+        // A new state past the limit claims no slot, so the set never fills
+        if (id == 0 && __atomic_load_n(&c->states, __ATOMIC_RELAXED) >= c->opt->maxStates)
+        {
+            __atomic_store_n(&c->truncated, true, __ATOMIC_RELAXED);
+            return NO_STATE;
+        }
+        if (id == 0 &&
+            __atomic_compare_exchange_n(&c->slots[slot], &id, CLAIMED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            uint32_t const state = __atomic_fetch_add(&c->states, 1, __ATOMIC_RELAXED);
+            if (state >= c->opt->maxStates)
+            {
+                // Lost the race for the last state: the slot stays claimed
+                // by a key that is never published, once per thread at most
+                __atomic_store_n(&c->truncated, true, __ATOMIC_RELAXED);
+                return NO_STATE;
+            }
+            c->boards[state] = board;
+            c->levels[state] = (uint16_t)level;
+            c->phases[state] = (uint8_t)phase;
+            __atomic_store_n(&c->slots[slot], state + 1, __ATOMIC_RELEASE);
+            return state;
+        }
+        // Another thread may have claimed the slot and not published the index yet
+        while (id == CLAIMED && __atomic_load_n(&c->states, __ATOMIC_RELAXED) <= c->opt->maxStates)
+            id = __atomic_load_n(&c->slots[slot], __ATOMIC_ACQUIRE);
+        if (id != CLAIMED && c->boards[id - 1] == board && c->levels[id - 1] == level && c->phases[id - 1] == phase)
+            return id - 1;
+        slot = (slot + 1) & c->mask;
+    }
+}
+
+/**
+ * Computes the edges of state s: every placement with probability
+ * mistakes / n, plus 1 - mistakes for the one of the bot.
+ */
+static void expand(chain *c, uint32_t s)
+{
+    unsigned int const level = c->levels[s], phase = c->phases[s];
+    unsigned int const rowsPerLevel = gameRules.rowsPerLevel;
+    placement moves[MAX_PLACEMENTS];
+    int n;
+    int const choice = decide(c, c->boards[s], level, moves, &n);
+    double const random = (choice < 0) ? 1.0 : c->opt->mistakes;
+
+    uint64_t const first = __atomic_fetch_add(&c->edgeTotal, n, __ATOMIC_RELAXED);
+    for (int i = 0; i < n; i++)
+    {
+        chainEdge *e = &c->edges[first + i];
+        unsigned int const rows = phase + moves[i].lines;
+        unsigned int const nextLevel = (rows == rowsPerLevel && level < c->opt->maxLevel) ? level + 1 : level;
+        e->lines = moves[i].lines;
+        e->probability = random / n + (i == choice ? 1.0 - random : 0.0);
+        e->target = boardOccupied(moves[i].board, SPAWN_X, 0)
+                        ? DEAD_END
+                        : findOrAdd(c, moves[i].board, nextLevel, rows % rowsPerLevel);
+    }
+    c->edgeCount[s] = (uint8_t)n;
+    c->edgeStart[s] = (uint32_t)first + 1;
+}
+
+/**
+ * Returns the row bucket of a game that ends in state s after completing
+ * lines more rows.
+ */
+static unsigned int rowBucket(chain const *c, uint32_t s, unsigned int lines)
+{
+    unsigned int const rows = c->levels[s] * gameRules.rowsPerLevel + c->phases[s] + lines;
+    return (rows < c->end->rowBuckets) ? rows : c->end->rowBuckets - 1;
+}
+
+/**
+ * Pushes the probability of a chunk of active states along their edges,
+ * expanding the states that have no edges yet.
+ */
+static void pushTask(void *arg, unsigned int index)
+{
+    chain *c = arg;
+    uint32_t const begin = index * CHUNK;
+    uint32_t const end = (c->activeCount - begin < CHUNK) ? c->activeCount : begin + CHUNK;
+    double ended = 0, dropped = 0;
+
+    for (uint32_t a = begin; a < end; a++)
+    {
+        uint32_t const s = c->active[a];
+        double const mass = c->mass[s];
+        c->mass[s] = 0;
+        if (c->edgeStart[s] == 0)
+            expand(c, s);
+
+        chainEdge const *e = &c->edges[c->edgeStart[s] - 1];
+        for (unsigned int i = 0; i < c->edgeCount[s]; i++)
+        {
+            double const p = mass * e[i].probability;
+            if (e[i].target == DEAD_END)
+            {
+                ended += p;
+                atomicAddDouble(&c->end->byRows[rowBucket(c, s, e[i].lines)], p);
+            }
+            else if (e[i].target == NO_STATE)
+                dropped += p;
+            else
+            {
+                uint32_t const t = e[i].target;
+                if (__atomic_exchange_n(&c->stamp[t], c->tile + 1, __ATOMIC_RELAXED) != c->tile + 1)
+                    c->nextActive[__atomic_fetch_add(&c->nextCount, 1, __ATOMIC_RELAXED)] = t;
+                atomicAddDouble(&c->next[t], p);
+            }
+        }
+    }
+    atomicAddDouble(&c->end->byTiles[c->tile], ended);
+    atomicAddDouble(&c->end->dropped, dropped);
+}
+
+/**
+ * Runs the chain from the empty board at level 0 until less than
+ * --tolerance is left in play or --max-tiles is reached, or more than
+ * MAX_DROPPED has been dropped. Returns false if the memory could not be
+ * reserved.
+ */
+static bool runChain(chain *c, threadPool *pool)
+{
+    modelOptions const *opt = c->opt;
+    uint64_t slots = 1;
+
+    while (slots < 2 * (opt->maxStates + poolThreads(pool) + 1))
+        slots *= 2;
+    c->mask = slots - 1;
+    c->slots = reserve(slots * sizeof(uint32_t));
+    c->boards = reserve(opt->maxStates * sizeof(uint64_t));
+    c->levels = reserve(opt->maxStates * sizeof(uint16_t));
+    c->phases = reserve(opt->maxStates);
+    c->edgeStart = reserve(opt->maxStates * sizeof(uint32_t));
+    c->edgeCount = reserve(opt->maxStates);
+    c->edges = reserve(opt->maxStates * MAX_PLACEMENTS * sizeof(chainEdge));
+    c->mass = reserve(opt->maxStates * sizeof(double));
+    c->next = reserve(opt->maxStates * sizeof(double));
+    c->stamp = reserve(opt->maxStates * sizeof(uint32_t));
+    c->active = reserve(opt->maxStates * sizeof(uint32_t));
+    c->nextActive = reserve(opt->maxStates * sizeof(uint32_t));
+    if (!c->slots || !c->boards || !c->levels || !c->phases || !c->edgeStart || !c->edgeCount || !c->edges ||
+        !c->mass || !c->next || !c->stamp || !c->active || !c->nextActive)
+        return false;
+
+    // The first tile spawns on the empty board
+    uint32_t const start = findOrAdd(c, 0, 0, 0);
+    c->mass[start] = 1.0;
+    c->active[0] = start;
+    c->activeCount = 1;
+    double playing = 1.0;
+    for (c->tile = 1; c->tile <= opt->maxTiles && playing >= opt->tolerance && c->end->dropped <= MAX_DROPPED;
+         c->tile++)
+    {
+        c->nextCount = 0;
+        poolFor(pool, pushTask, c, (c->activeCount + CHUNK - 1) / CHUNK);
+
+        // Drop the states below --epsilon
+        uint32_t kept = 0;
+        playing = 0;
+        for (uint32_t a = 0; a < c->nextCount; a++)
+        {
+            uint32_t const s = c->nextActive[a];
+            if (c->next[s] < opt->epsilon)
+            {
+                c->end->dropped += c->next[s];
+                c->next[s] = 0;
+                continue;
+            }
+            playing += c->next[s];
+            c->nextActive[kept++] = s;
+        }
+        double *swapMass = c->mass;
+        c->mass = c->next;
+        c->next = swapMass;
+        uint32_t *swapActive = c->active;
+        c->active = c->nextActive;
+        c->nextActive = swapActive;
+        c->activeCount = kept;
+    }
+    c->end->survived = playing;
+    return true;
+}
+
+static uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * Plays the games of --simulate through the engine with the player of the
+ * chain, a game ending or reaching --max-tiles, and counts their ends.
+ * Levels are not merged here; rows above the last bucket go into it.
+ */
+static void simulate(chain *c, endDistribution *end)
+{
+    modelOptions const *opt = c->opt;
+    uint64_t const threshold = (uint64_t)(opt->mistakes * (double)UINT64_MAX);
+    uint64_t rng = (opt->seed + 1) * 0x9E3779B97F4A7C15ULL;
+    bot *b = threadBot(c);
+    placement moves[MAX_PLACEMENTS];
+
+    for (unsigned long g = 0; g < opt->simulate; g++)
+    {
+        engineState s;
+        engineInit(&s, (uint32_t)(g + 1));
+        engineStep(&s, KEY_UP);     // any key starts a new game
+        for (;;)
+        {
+            if (s.tiles > opt->maxTiles)
+            {
+                end->survived++;
+                break;
+            }
+            placement forced;
+            uint32_t const tiles = s.tiles;
+            if (think(c, &s, &forced))
+            {
+                if (s.state != GAMEOVER)
+                    continue;
+                end->byTiles[tiles]++;
+                end->byRows[(s.rows < end->rowBuckets) ? s.rows : end->rowBuckets - 1]++;
+                break;
+            }
+            int n;
+            int choice = botChoice(b, &s, moves, &n);
+            if (choice < 0 || nextRandom(&rng) < threshold)
+                choice = (int)(nextRandom(&rng) % n);
+
+            engineState const before = s;
+            if (!engineApply(&s, &moves[choice]))
+            {
+                unsigned int const rows = before.rows + moves[choice].lines;
+                end->byTiles[before.tiles]++;
+                end->byRows[(rows < end->rowBuckets) ? rows : end->rowBuckets - 1]++;
+                break;
+            }
+        }
+    }
+    for (unsigned long t = 0; t <= opt->maxTiles; t++)
+        end->byTiles[t] /= opt->simulate;
+    for (unsigned int r = 0; r < end->rowBuckets; r++)
+        end->byRows[r] /= opt->simulate;
+    end->survived /= opt->simulate;
+}
+
+/**
+ * Returns the score after clearing rows, with a level up every rowsPerLevel rows.
+ */
+static unsigned long scoreOfRows(unsigned int rows)
+{
+    unsigned long score = 0, level = 0;
+    for (unsigned int r = 1; r <= rows; r++)
+    {
+        score += level + 1;
+        if (r % gameRules.rowsPerLevel == 0)
+            level++;
+    }
+    return score;
+}
+
+/**
+ * Prints the quantiles q of a distribution over 0..size-1 with the mass
+ * beyond it in rest, as values of f.
+ */
+static void printQuantiles(double const *mass, unsigned long size, double rest, unsigned long (*f)(unsigned long))
+{
+    static double const q[3] = {0.1, 0.5, 0.9};
+    double total = rest, cumulative = 0;
+    unsigned long i = 0;
+
+    for (unsigned long j = 0; j < size; j++)
+        total += mass[j];
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        while (i < size && cumulative + mass[i] < q[k] * total)
+            cumulative += mass[i++];
+        if (i < size)
+            printf(" %8lu", f(i));
+        else
+            printf(" %7s%lu", ">", f(size - 1));
+    }
+}
+
+static unsigned long identity(unsigned long x)
+{
+    return x;
+}
+
+static unsigned long rowsToScore(unsigned long rows)
+{
+    return scoreOfRows((unsigned int)rows);
+}
+
+/**
+ * Prints the end distribution under a title. Returns false, with the
+ * reason instead of the distribution, if too much mass has been dropped
+ * for it to mean anything.
+ */
+static bool printEnd(chain const *c, endDistribution const *end, char const *title)
+{
+    modelOptions const *opt = c->opt;
+    unsigned int const rowsPerLevel = gameRules.rowsPerLevel;
+    double ended = 0, tiles = 0, rows = 0, score = 0, level = 0, square = 0;
+
+    for (unsigned long t = 0; t <= opt->maxTiles; t++)
+    {
+        ended += end->byTiles[t];
+        tiles += t * end->byTiles[t];
+        square += (double)t * t * end->byTiles[t];
+    }
+    for (unsigned int r = 0; r < end->rowBuckets; r++)
+    {
+        rows += r * end->byRows[r];
+        score += scoreOfRows(r) * end->byRows[r];
+        level += (r / rowsPerLevel) * end->byRows[r];
+    }
+    double const mean = ended > 0 ? tiles / ended : 0;
+
+    printf("%s\n", title);
+    printf("Ended:        %11.6f%% within %lu tiles, %.6f%% still playing, %.2g dropped\n", 100 * ended,
+           opt->maxTiles, 100 * end->survived, end->dropped);
+    if (end->dropped > MAX_DROPPED)
+    {
+        printf("WARNING: more than %g of the mass dropped after %u tiles%s, no distribution given;\n"
+               "         lower --max-tiles or --epsilon, or raise --max-states\n",
+               MAX_DROPPED, c->tile - 1, c->truncated ? " at --max-states" : "");
+        return false;
+    }
+    if (ended == 0)
+        return true;
+    printf("Tiles:        %11.2f mean, %.2f sd, p10/p50/p90", mean, sqrt(square / ended - mean * mean));
+    printQuantiles(end->byTiles, opt->maxTiles + 1, end->survived, identity);
+    printf("\nRows:         %11.2f mean,           p10/p50/p90", rows / ended);
+    printQuantiles(end->byRows, end->rowBuckets, 0, identity);
+    printf("\nScore:        %11.2f mean,           p10/p50/p90", score / ended);
+    printQuantiles(end->byRows, end->rowBuckets, 0, rowsToScore);
+    printf("\nLevel:        %11.2f mean", level / ended);
+    if (end->byRows[end->rowBuckets - 1] > 0)
+        printf(", %.4f%% reach level %u, counted as %u", 100 * end->byRows[end->rowBuckets - 1] / ended,
+               opt->maxLevel, opt->maxLevel);
+
+    // Survival function at round numbers of tiles
+    static unsigned long const points[SURVIVAL_POINTS] = {10, 50, 100, 500, 1000, 5000};
+    double cumulative = 0;
+    unsigned long t = 0;
+    printf("\nSurvival:    ");
+    for (unsigned int k = 0; k < SURVIVAL_POINTS && points[k] <= opt->maxTiles; k++)
+    {
+        while (t < points[k])
+            cumulative += end->byTiles[t++];
+        printf(" P(>=%lu) %.4f", points[k], 1 - cumulative);
+    }
+    printf("\n");
+    return true;
+}
+
+static bool allocateEnd(endDistribution *end, unsigned long maxTiles, unsigned int rowBuckets)
+{
+    end->byTiles = calloc(maxTiles + 1, sizeof(double));
+    end->byRows = calloc(rowBuckets, sizeof(double));
+    end->rowBuckets = rowBuckets;
+    return end->byTiles && end->byRows;
+}
+
+
+int main(int argc, char **argv)
+{
+    modelOptions opt = {
+        .mistakes = 0.05,
+        .think = 0,
+        .maxTiles = 200,                // about 12 million states with the default rules
+        .maxLevel = 30,
+        .epsilon = 1e-12,
+        .tolerance = 1e-9,
+        .maxStates = 1UL << 24,
+        .threads = 0,
+        .simulate = 0,
+        .seed = 1,
+    };
+    botOptions botOpt = defaultBotOptions;
+    static chain c;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--mistakes") == 0)
+            opt.mistakes = parseRealArg(argv[++i], &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--think") == 0)
+            opt.think = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--max-tiles") == 0)
+            opt.maxTiles = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--max-level") == 0)
+            opt.maxLevel = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--epsilon") == 0)
+            opt.epsilon = parseRealArg(argv[++i], &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--tolerance") == 0)
+            opt.tolerance = parseRealArg(argv[++i], &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--max-states") == 0)
+            opt.maxStates = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--simulate") == 0)
+            opt.simulate = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0)
+            opt.seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (!engineParseRule(&gameRules, argc, argv, &i) && !botParseOption(&botOpt, argc, argv, &i))
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.mistakes < 0 || opt.mistakes > 1 || opt.maxTiles == 0 || opt.maxTiles >= UINT32_MAX ||
+        opt.maxLevel == 0 || opt.maxLevel > 255 || opt.maxStates == 0 || opt.maxStates >= DEAD_END)
+        usage(argv[0]);
+    if (botOpt.kind == BOT_PLUGIN || botOpt.kind == BOT_REMOTE)
+    {
+        fprintf(stderr, "ERROR: plugin and remote bots decide by key sequences, which the model does not follow\n");
+        return EXIT_FAILURE;
+    }
+    // The chain runs one decision per thread
+    botOpt.threads = 1;
+
+    c.opt = &opt;
+    c.botOpt = &botOpt;
+    c.period[0] = gameRules.initNextGameTick;
+    for (unsigned int l = 1; l <= opt.maxLevel; l++)
+        c.period[l] = engineNextPeriod(c.period[l - 1]);
+
+    char levels[96];
+    engineFormatLevels(&gameRules, levels, sizeof(levels));
+    printf("Player:       bot with %.2f%% mistakes per tile, thinking %lu ticks\n", 100 * opt.mistakes, opt.think);
+    printf("Rules:        start period %u, %u rows per level, levels %s, period %u at level %u\n",
+           gameRules.initNextGameTick, gameRules.rowsPerLevel, levels, c.period[opt.maxLevel], opt.maxLevel);
+
+    unsigned int const rowBuckets = opt.maxLevel * gameRules.rowsPerLevel + 1;
+    endDistribution chainEnd = {0}, simulatedEnd = {0};
+    threadPool *pool = poolCreate(opt.threads);
+    if (!pool || !allocateEnd(&chainEnd, opt.maxTiles, rowBuckets))
+    {
+        fprintf(stderr, "ERROR: could not allocate the distributions\n");
+        return EXIT_FAILURE;
+    }
+    c.end = &chainEnd;
+    double start = botNow();
+    if (!runChain(&c, pool))
+    {
+        fprintf(stderr, "ERROR: could not reserve memory for %lu states\n", opt.maxStates);
+        return EXIT_FAILURE;
+    }
+    double seconds = (botNow() - start) / 1e6;
+    uint32_t const states = c.states < opt.maxStates ? c.states : (uint32_t)opt.maxStates;
+    printf("States:       %11u%s, %llu edges (%.1f per state)\n", states,
+           c.truncated ? " (cut by --max-states)" : "", (unsigned long long)c.edgeTotal,
+           (double)c.edgeTotal / states);
+    printf("Iteration:    %11u tiles in %.2f s on %u threads\n", c.tile - 1, seconds, poolThreads(pool));
+    bool const complete = printEnd(&c, &chainEnd, "\nMarkov chain");
+
+    if (opt.simulate)
+    {
+        if (!allocateEnd(&simulatedEnd, opt.maxTiles, rowBuckets))
+        {
+            fprintf(stderr, "ERROR: could not allocate the distributions\n");
+            return EXIT_FAILURE;
+        }
+        start = botNow();
+        simulate(&c, &simulatedEnd);
+        seconds = (botNow() - start) / 1e6;
+        char title[64];
+        snprintf(title, sizeof(title), "\nSimulation of %lu games (%.2f s)", opt.simulate, seconds);
+        printEnd(&c, &simulatedEnd, title);
+    }
+
+    for (uint32_t i = 0; i < c.botCount && i < MAX_BOTS; i++)
+    {
+        botDestroy(c.bots[i]);
+        free(c.bots[i]);
+    }
+    poolDestroy(pool);
+    return complete ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,756 @@
+/**
+ * @file stetris_engine.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Reentrant bitboard implementation of the sTetris() game rules.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every function here mirrors its counterpart in the interactive binaries
+ * (moveLeft(), clearRow(), advanceLevel(), sTetris(), ...), including the
+ * order in which a game tick clears the bottom row before moving the active
+ * tile. Keep both in sync when the rules change.
+ */
+
+#include "stetris_engine.h"
+#include "stetris_args.h"
+
+#include <stdio.h>                      // for snprintf()
+#include <stdlib.h>                     // for abs, strtoul()
+#include <string.h>                     // for memset, strcmp
+
+
+/**
+ * Returns the next value of the per-game color generator (xorshift32).
+ */
+static inline uint32_t nextRandom(engineState *s)
+{
+    uint32_t x = s->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s->rng = x;
+    return x;
+}
+
+/**
+ * Copies the tile (occupancy and color) at bit index from to bit index to.
+ */
+static inline void copyCell(engineState *s, unsigned int const to, unsigned int const from)
+{
+    uint64_t const toMask = (uint64_t)1 << to;
+    uint64_t *const planes[4] = {&s->occupied, &s->colorPlane[0], &s->colorPlane[1], &s->colorPlane[2]};
+
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        if ((*planes[i] >> from) & 1)
+            *planes[i] |= toMask;
+        else
+            *planes[i] &= ~toMask;
+    }
+}
+
+/**
+ * Resets the tile at bit index target by marking it as unoccupied.
+ */
+static inline void resetCell(engineState *s, unsigned int const target)
+{
+    uint64_t const mask = ~((uint64_t)1 << target);
+    s->occupied &= mask;
+    s->colorPlane[0] &= mask;
+    s->colorPlane[1] &= mask;
+    s->colorPlane[2] &= mask;
+}
+
+/**
+ * Moves the active tile by (dx, dy) if the target is inside the playfield and free.
+ * Returns true if the move was successful, false otherwise.
+ */
+static bool moveTile(engineState *s, int const dx, int const dy)
+{
+    int const x = s->activeX + dx;
+    int const y = s->activeY + dy;
+    if (x < 0 || x >= GRID_X || y < 0 || y >= GRID_Y || boardOccupied(s->occupied, x, y))
+        return false;
+
+    copyCell(s, y * GRID_X + x, s->activeY * GRID_X + s->activeX);
+    resetCell(s, s->activeY * GRID_X + s->activeX);
+    s->activeX = x;
+    s->activeY = y;
+    return true;
+}
+
+/**
+ * Adds a new tile with a random color at the top center position.
+ * Returns false if the position is already occupied (game over condition).
+ */
+static bool addNewTile(engineState *s)
+{
+    s->activeX = SPAWN_X;
+    s->activeY = 0;
+    if (boardOccupied(s->occupied, SPAWN_X, 0))
+        return false;
+
+    unsigned int const color = nextRandom(s) % NUM_COLORS;
+    uint64_t const mask = CELL_MASK(SPAWN_X, 0);
+    s->occupied |= mask;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if ((color >> i) & 1)
+            s->colorPlane[i] |= mask;
+    }
+    return true;
+}
+
+/**
+ * Clears the bottom row if it is fully occupied and shifts all rows above it down.
+ * Returns true if a row was cleared, false otherwise.
+ */
+static bool clearRow(engineState *s)
+{
+    if (!BOTTOM_ROW_FULL(s->occupied))
+        return false;
+
+    s->occupied = boardShiftDown(s->occupied);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        s->colorPlane[i] = boardShiftDown(s->colorPlane[i]);
+    }
+    return true;
+}
+
+/**
+ * The rules of the original game: 10 ms ticks, a level every 2 rows,
+ * 50 ticks per gravity step at first and the schedule of advanceLevel().
+ */
+engineRules gameRules = {
+    .uSecTickTime = 10000,
+    .rowsPerLevel = 2,
+    .initNextGameTick = 50,
+    .levelBands = 4,
+    .levelUpTo = {1, 10, 20, UINT32_MAX},
+    .levelStep = {0, 1, 2, 10},
+};
+
+/**
+ * Parses a level schedule, "UPTO:STEP,...,*:STEP" with increasing UPTO,
+ * e.g. ENGINE_LEVELS_DEFAULT. Returns false, leaving r as it was, if the
+ * text is not a valid schedule.
+ */
+bool engineParseLevels(engineRules *r, char const *text)
+{
+    engineRules parsed = *r;
+    unsigned int bands = 0;
+
+    for (;;)
+    {
+        char *end;
+        unsigned long upTo;
+        if (bands == MAX_LEVEL_BANDS)
+            return false;
+        if (*text == '*')
+        {
+            upTo = UINT32_MAX;
+            end = (char *)text + 1;
+        }
+        else
+            upTo = strtoul(text, &end, 10);
+        if (end == text || *end != ':' || upTo > UINT32_MAX || (bands && upTo <= parsed.levelUpTo[bands - 1]))
+            return false;
+        text = end + 1;
+        unsigned long const step = strtoul(text, &end, 10);
+        if (end == text || step > UINT32_MAX)
+            return false;
+        parsed.levelUpTo[bands] = upTo;
+        parsed.levelStep[bands++] = step;
+        text = end;
+        if (*text == '\0')
+            break;
+        if (*text++ != ',')
+            return false;
+    }
+    parsed.levelUpTo[bands - 1] = UINT32_MAX;   // the last band takes the rest
+    parsed.levelBands = bands;
+    *r = parsed;
+    return true;
+}
+
+/**
+ * Writes the level schedule in the form engineParseLevels() reads.
+ */
+void engineFormatLevels(engineRules const *r, char *text, unsigned int size)
+{
+    unsigned int used = 0;
+    for (unsigned int b = 0; b < r->levelBands && used < size; b++)
+    {
+        if (b + 1 < r->levelBands)
+            used += snprintf(text + used, size - used, "%u:%u,", r->levelUpTo[b], r->levelStep[b]);
+        else
+            used += snprintf(text + used, size - used, "*:%u", r->levelStep[b]);
+    }
+}
+
+/**
+ * Parses the rule option at argv[*i] into r, advancing *i past its value.
+ * Returns false if argv[*i] is not a rule option or its value is invalid.
+ */
+bool engineParseRule(engineRules *r, int argc, char **argv, int *i)
+{
+    char const *arg = argv[*i];
+    if (*i + 1 >= argc)
+        return false;
+    char const *value = argv[*i + 1];
+    bool number = true;
+    unsigned long long const n = parseNumberArg(value, ULONG_MAX, 0, &number);
+
+    if (strcmp(arg, "--tick-usec") == 0 && number && n > 0)
+        r->uSecTickTime = n;
+    else if (strcmp(arg, "--rows-per-level") == 0 && number && n > 0 && n <= UINT8_MAX)
+        r->rowsPerLevel = n;
+    else if (strcmp(arg, "--start-period") == 0 && number && n > 0 && n <= UINT32_MAX)
+        r->initNextGameTick = n;
+    else if (strcmp(arg, "--levels") != 0 || !engineParseLevels(r, value))
+        return false;
+    (*i)++;
+    return true;
+}
+
+/**
+ * Returns the nextGameTick of the level after one played at period, with
+ * the level schedule of gameRules.
+ */
+unsigned int engineNextPeriod(unsigned int period)
+{
+    unsigned int b = 0;
+    while (b + 1 < gameRules.levelBands && period > gameRules.levelUpTo[b])
+        b++;
+    uint32_t const step = gameRules.levelStep[b];
+    return period > step ? period - step : (period < 1 ? period : 1);
+}
+
+/**
+ * Advances the game to the next level, same schedule as advanceLevel().
+ */
+static void advanceLevel(engineState *s)
+{
+    s->level++;
+    s->nextGameTick = engineNextPeriod(s->nextGameTick);
+}
+
+/**
+ * Sets the game state to GAMEOVER and resets nextGameTick to its initial value.
+ */
+static void gameOver(engineState *s)
+{
+    s->state = GAMEOVER;
+    s->nextGameTick = s->initNextGameTick;
+}
+
+/**
+ * Initializes a game in the GAMEOVER state with an empty playfield,
+ * the same way main() prepares the global game. The seed drives the
+ * color of new tiles and must not be 0.
+ */
+void engineInit(engineState *s, uint32_t seed)
+{
+    memset(s, 0, sizeof(*s));
+    s->rng = seed ? seed : 1;
+    s->rowsPerLevel = gameRules.rowsPerLevel;
+    s->initNextGameTick = gameRules.initNextGameTick;
+    gameOver(s);
+}
+
+/**
+ * Starts a new game and adds the first tile, like a key press in GAMEOVER state.
+ */
+void engineNewGame(engineState *s)
+{
+    s->occupied = 0;
+    memset(s->colorPlane, 0, sizeof(s->colorPlane));
+    s->state = ACTIVE;
+    s->tiles = 0;
+    s->rows = 0;
+    s->score = 0;
+    s->tick = 0;
+    s->level = 0;
+    addNewTile(s);
+    s->state |= TILE_ADDED;
+    s->tiles++;
+}
+
+/**
+ * Plays one tick of an active game with the key, like sTetris() before it
+ * restarts a lost game. Returns true if the playfield has changed.
+ */
+static bool playTick(engineState *s, int const key)
+{
+    bool playfieldChanged = false;
+
+    if (s->state & ACTIVE)
+    {
+        if (key)
+        {
+            playfieldChanged = true;
+            switch (key)
+            {
+            case KEY_LEFT:
+                moveTile(s, -1, 0);
+                break;
+            case KEY_RIGHT:
+                moveTile(s, 1, 0);
+                break;
+            case KEY_DOWN:
+                while (moveTile(s, 0, 1))
+                {
+                };
+                s->tick = 0;
+                break;
+            default:
+                playfieldChanged = false;
+            }
+        }
+
+        if (s->tick == 0)
+        {
+            s->state &= ~(ROW_CLEAR | TILE_ADDED);
+            playfieldChanged = true;
+
+            if (clearRow(s))
+            {
+                s->state |= ROW_CLEAR;
+                s->rows++;
+                s->score += s->level + 1;
+                if ((s->rows % s->rowsPerLevel) == 0)
+                {
+                    advanceLevel(s);
+                }
+            }
+
+            if (!boardOccupied(s->occupied, s->activeX, s->activeY) || !moveTile(s, 0, 1))
+            {
+                if (addNewTile(s))
+                {
+                    s->state |= TILE_ADDED;
+                    s->tiles++;
+                }
+                else
+                {
+                    gameOver(s);
+                }
+            }
+        }
+    }
+
+    return playfieldChanged;
+}
+
+/**
+ * Runs one iteration of the main loop: processes the key exactly like sTetris()
+ * and then advances the tick counter.
+ * Returns true if the playfield has changed, false otherwise.
+ */
+bool engineStep(engineState *s, int const key)
+{
+    bool playfieldChanged = playTick(s, key);
+
+    // Press any key to start a new game
+    if ((s->state == GAMEOVER) && key)
+    {
+        playfieldChanged = true;
+        engineNewGame(s);
+    }
+
+    s->tick = (s->tick + 1) % s->nextGameTick;
+    return playfieldChanged;
+}
+
+/**
+ * Runs one iteration like engineStep(), except that the key never starts a
+ * new game: a game that ends in this step, also by the hard drop of the key,
+ * stays in the GAMEOVER state with its own counters.
+ * Returns true if the playfield has changed, false otherwise.
+ */
+bool engineStepNoRestart(engineState *s, int const key)
+{
+    bool const playfieldChanged = playTick(s, key);
+    s->tick = (s->tick + 1) % s->nextGameTick;
+    return playfieldChanged;
+}
+
+/**
+ * Returns the blockColor[] index of the tile at (x, y), or -1 if unoccupied.
+ */
+int engineColorAt(engineState const *s, unsigned int x, unsigned int y)
+{
+    unsigned int const bit = y * GRID_X + x;
+    if (!((s->occupied >> bit) & 1))
+        return -1;
+    return (int)(((s->colorPlane[0] >> bit) & 1) |
+                 (((s->colorPlane[1] >> bit) & 1) << 1) |
+                 (((s->colorPlane[2] >> bit) & 1) << 2));
+}
+
+/**
+ * Returns how many keys are still processed before the next gravity step,
+ * counting the key of the tick in which gravity happens.
+ */
+unsigned int engineKeysToGravity(engineState const *s)
+{
+    return (s->tick == 0) ? 1 : s->nextGameTick - s->tick + 1;
+}
+
+/**
+ * Returns the 8 bit mask of free cells in row y.
+ */
+static inline uint8_t emptyRow(uint64_t const board, unsigned int const y)
+{
+    return (uint8_t)~(board >> (y * GRID_X));
+}
+
+/**
+ * Grows a set of columns within one row by at most steps sideways moves
+ * through free cells.
+ */
+static inline uint8_t dilateRow(uint8_t reach, uint8_t const empty, unsigned int steps)
+{
+    reach &= empty;
+    while (steps--)
+    {
+        uint8_t const grown = (uint8_t)((reach | (reach << 1) | (reach >> 1)) & empty);
+        if (grown == reach)
+            break;
+        reach = grown;
+    }
+    return reach;
+}
+
+/**
+ * Returns the row where a tile at (x, y) comes to rest when it falls straight down.
+ */
+static inline unsigned int dropRow(uint64_t const board, unsigned int const x, unsigned int y)
+{
+    while (y < GRID_Y - 1 && !boardOccupied(board, x, y + 1))
+        y++;
+    return y;
+}
+
+/**
+ * Computes the columns the tile can be in at the gravity step of every row,
+ * starting at (x0, y0) with keysLeft keys before the first gravity step and
+ * period keys per row afterwards. dropReach gets the columns that are reached
+ * with one key to spare, where the tile can still be hard dropped before the
+ * gravity step. Rows the tile cannot reach stay 0.
+ */
+static void reachRows(uint64_t const board, unsigned int const x0, unsigned int const y0,
+                      unsigned int const keysLeft, unsigned int const period,
+                      uint8_t reach[GRID_Y], uint8_t dropReach[GRID_Y])
+{
+    memset(reach, 0, GRID_Y);
+    memset(dropReach, 0, GRID_Y);
+    reach[y0] = dilateRow((uint8_t)(1 << x0), emptyRow(board, y0), keysLeft);
+    dropReach[y0] = dilateRow((uint8_t)(1 << x0), emptyRow(board, y0), keysLeft - 1);
+    for (unsigned int y = y0; y < GRID_Y - 1; y++)
+    {
+        uint8_t const entries = reach[y] & emptyRow(board, y + 1);
+        if (!entries)
+            break;
+        reach[y + 1] = dilateRow(entries, emptyRow(board, y + 1), period);
+        dropReach[y + 1] = dilateRow(entries, emptyRow(board, y + 1), period - 1);
+    }
+}
+
+/**
+ * Appends a placement for a tile locking at (x, y), unless it is already listed.
+ */
+static int addPlacement(placement *out, int n, uint64_t const board, unsigned int const x,
+                        unsigned int const y, bool const orphan)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (out[i].board == board)
+            return n;
+    }
+    out[n].board = board;
+    out[n].x = x;
+    out[n].y = y;
+    out[n].orphan = orphan;
+    out[n].lines = BOTTOM_ROW_FULL(board);
+    out[n].cleared = true;
+    return n + 1;
+}
+
+/**
+ * Enumerates every distinct position where the active tile can lock, reached
+ * through moveLeft(), moveRight() and moveDown() from (x0, y0).
+ * board is the occupancy without the active tile, keysLeft the number of keys
+ * before the next gravity step (see engineKeysToGravity()) and period the
+ * current nextGameTick.
+ * If the bottom row of board is full, the next gravity step clears it before
+ * the tile moves. The tile then either is hard dropped and locks before the
+ * clear, or it is left behind in row 0 while a new tile spawns.
+ * Returns the number of placements written to out (at most MAX_PLACEMENTS).
+ */
+int engineGenPlacements(uint64_t board, unsigned int x0, unsigned int y0,
+                        unsigned int keysLeft, unsigned int period, placement *out)
+{
+    int n = 0;
+
+    if (BOTTOM_ROW_FULL(board))
+    {
+        // Lateral moves, then a hard drop as the last key before the clear
+        uint8_t const dropReach = dilateRow((uint8_t)(1 << x0), emptyRow(board, y0), keysLeft - 1);
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            if ((dropReach >> x) & 1)
+            {
+                unsigned int const y = dropRow(board, x, y0);
+                n = addPlacement(out, n, boardShiftDown(board | CELL_MASK(x, y)), x, y, false);
+            }
+        }
+        if (y0 == 0)
+        {
+            uint8_t const orphanReach = dilateRow((uint8_t)(1 << x0), emptyRow(board, 0), keysLeft);
+            for (unsigned int x = 0; x < GRID_X; x++)
+            {
+                if ((orphanReach >> x) & 1)
+                    n = addPlacement(out, n, boardShiftDown(board | CELL_MASK(x, 0)), x, 0, true);
+            }
+        }
+        return n;
+    }
+
+    uint8_t reach[GRID_Y], dropReach[GRID_Y];
+    reachRows(board, x0, y0, keysLeft, period, reach, dropReach);
+    for (unsigned int y = y0; y < GRID_Y; y++)
+    {
+        uint8_t const below = (y == GRID_Y - 1) ? 0xFF : (uint8_t)~emptyRow(board, y + 1);
+        uint8_t const locks = reach[y] & below;
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            if (!((locks >> x) & 1))
+                continue;
+            out[n].board = board | CELL_MASK(x, y);
+            out[n].x = x;
+            out[n].y = y;
+            out[n].orphan = false;
+            out[n].lines = BOTTOM_ROW_FULL(out[n].board);
+            // A hard drop clears the completed row in the same tick, a
+            // lock by gravity leaves it for the next gravity step
+            out[n].cleared = out[n].lines && ((dropReach[y] >> x) & 1);
+            if (out[n].cleared)
+                out[n].board = boardShiftDown(out[n].board);
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * Enumerates every distinct lock position of the active tile of s, see
+ * engineGenPlacements(). The tile is a single cell, so there are no
+ * rotations; placements that differ only in the path taken are listed once.
+ * Returns the number of placements written to out, 0 if no tile is active.
+ */
+int engineGenMoves(engineState const *s, placement *out)
+{
+    if (!(s->state & ACTIVE))
+        return 0;
+    uint64_t const board = s->occupied & ~CELL_MASK(s->activeX, s->activeY);
+    return engineGenPlacements(board, s->activeX, s->activeY, engineKeysToGravity(s), s->nextGameTick, out);
+}
+
+/**
+ * Computes the column the tile has to be in at the gravity step of each row
+ * to reach target, a placement returned by engineGenPlacements() for the same
+ * arguments. Rows above y0 and below the target are set to 0xFF.
+ * Returns false if target is not reachable.
+ */
+bool enginePlanPath(uint64_t board, unsigned int x0, unsigned int y0,
+                    unsigned int keysLeft, unsigned int period,
+                    placement const *target, uint8_t path[GRID_Y])
+{
+    memset(path, 0xFF, GRID_Y);
+
+    if (BOTTOM_ROW_FULL(board) || target->orphan)
+    {
+        path[y0] = target->x;
+        return true;
+    }
+
+    uint8_t reach[GRID_Y], dropReach[GRID_Y];
+    reachRows(board, x0, y0, keysLeft, period, reach, dropReach);
+    // A tile that clears the row must arrive with a key left for the hard drop
+    uint8_t const *const targetReach = target->cleared ? dropReach : reach;
+    if (target->y < y0 || !((targetReach[target->y] >> target->x) & 1))
+        return false;
+
+    path[target->y] = target->x;
+    for (unsigned int y = target->y; y > y0; y--)
+    {
+        // Pick the entry column closest to where the tile has to go in row y
+        uint8_t const entries = reach[y - 1] & emptyRow(board, y);
+        unsigned int const steps = (y == target->y && target->cleared) ? period - 1 : period;
+        int best = -1;
+        for (unsigned int e = 0; e < GRID_X; e++)
+        {
+            if (!((entries >> e) & 1))
+                continue;
+            if (!((dilateRow((uint8_t)(1 << e), emptyRow(board, y), steps) >> path[y]) & 1))
+                continue;
+            if (best < 0 || abs((int)e - path[y]) < abs(best - path[y]))
+                best = e;
+        }
+        if (best < 0)
+            return false;
+        path[y - 1] = best;
+    }
+    return true;
+}
+
+/**
+ * Returns the next key that moves the active tile of s along a path computed
+ * by enginePlanPath(), hard dropping as soon as the tile is above its target.
+ * Returns 0 if the tile has to wait for gravity or has left the path.
+ */
+int enginePathKey(engineState const *s, placement const *target, uint8_t const path[GRID_Y])
+{
+    unsigned int const x = s->activeX;
+    unsigned int const y = s->activeY;
+    if (!(s->state & ACTIVE) || y >= GRID_Y || path[y] == 0xFF)
+        return 0;
+
+    if (x < path[y])
+        return KEY_RIGHT;
+    if (x > path[y])
+        return KEY_LEFT;
+    if (target->orphan || x != target->x)
+        return 0;
+
+    uint64_t const board = s->occupied & ~CELL_MASK(x, y);
+    if (dropRow(board, x, y) == target->y)
+        return KEY_DOWN;
+    return 0;
+}
+
+/**
+ * Replaces the playfield by board and spawns a new tile the way a gravity
+ * step does, keeping the counters. Tile colors are cleared.
+ * Returns false if the tile cannot spawn, which ends the game.
+ */
+bool engineSetBoard(engineState *s, uint64_t board)
+{
+    s->occupied = board;
+    memset(s->colorPlane, 0, sizeof(s->colorPlane));
+    s->state = ACTIVE;
+    s->tick = 1 % s->nextGameTick;      // the gravity step that spawned the tile has passed
+    if (!addNewTile(s))
+    {
+        gameOver(s);
+        return false;
+    }
+    s->state |= TILE_ADDED;
+    return true;
+}
+
+/**
+ * Returns a starting board with a column of random height up to rows in
+ * every column, the same for every call with this seed. Only the bottom row
+ * is ever cleared, so the garbage has no holes that could never be filled.
+ */
+uint64_t engineGarbageBoard(uint32_t seed, unsigned int rows)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (seed + 1ULL);
+    uint64_t board = 0;
+
+    if (rows > GRID_Y - 2)
+        rows = GRID_Y - 2;      // leave room for the spawned tile to move
+    for (unsigned int x = 0; x < GRID_X; x++)
+    {
+        state ^= state << 13;   // xorshift64
+        state ^= state >> 7;
+        state ^= state << 17;
+        unsigned int const height = state % (rows + 1);
+        for (unsigned int y = GRID_Y - height; y < GRID_Y; y++)
+            board |= CELL_MASK(x, y);
+    }
+    return board;
+}
+
+/**
+ * Pushes the settled tiles up by rows and fills the rows below them with
+ * garbage, full except for column hole, the way the versus mode attacks an
+ * opponent. Garbage has color index 0. The active tile keeps its cell or is
+ * pushed up with the tiles under it.
+ * Returns false if the game is not running or ends because tiles are
+ * pushed out of the top row.
+ */
+bool engineAddGarbage(engineState *s, unsigned int rows, unsigned int hole)
+{
+    if (!(s->state & ACTIVE))
+        return false;
+    if (rows == 0)
+        return true;
+    if (rows > GRID_Y - 1)
+        rows = GRID_Y - 1;
+
+    // A row clear can leave the active cell empty, then there is no tile to keep
+    uint64_t const active = CELL_MASK(s->activeX, s->activeY) & s->occupied;
+    unsigned int const shift = rows * GRID_X;
+    uint64_t const garbage = (~(uint64_t)0 << ((GRID_Y - rows) * GRID_X)) & ~(0x0101010101010101ULL << hole);
+    int const color = active ? engineColorAt(s, s->activeX, s->activeY) : 0;
+
+    if ((s->occupied & ~active) & ((CELL_MASK(0, rows)) - 1))
+    {
+        gameOver(s);
+        return false;
+    }
+    s->occupied = ((s->occupied & ~active) >> shift) | garbage;
+    for (unsigned int i = 0; i < 3; i++)
+        s->colorPlane[i] = (s->colorPlane[i] & ~active) >> shift;
+    if (!active)
+        return true;
+
+    unsigned int y = s->activeY;
+    while (y > 0 && boardOccupied(s->occupied, s->activeX, y))
+        y--;
+    if (boardOccupied(s->occupied, s->activeX, y))
+    {
+        gameOver(s);
+        return false;
+    }
+    uint64_t const mask = CELL_MASK(s->activeX, y);
+    s->activeY = y;
+    s->occupied |= mask;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if ((color >> i) & 1)
+            s->colorPlane[i] |= mask;
+    }
+    return true;
+}
+
+/**
+ * Plays the active tile into target, a placement generated for the current
+ * state, by running the main loop until the next tile spawns. Ticks without
+ * input are skipped, which gives the same result as stepping through them.
+ * Returns false if target is not reachable or the game ended; the game is
+ * then left in the GAMEOVER state.
+ */
+bool engineApply(engineState *s, placement const *target)
+{
+    uint64_t const board = s->occupied & ~CELL_MASK(s->activeX, s->activeY);
+    uint8_t path[GRID_Y];
+    if (!(s->state & ACTIVE) ||
+        !enginePlanPath(board, s->activeX, s->activeY, engineKeysToGravity(s), s->nextGameTick, target, path))
+        return false;
+
+    uint32_t const tiles = s->tiles;
+    while (s->state != GAMEOVER && s->tiles == tiles)
+    {
+        int const key = enginePathKey(s, target, path);
+        if (!key && s->tick != 0)
+            s->tick = 0;
+        else
+            engineStepNoRestart(s, key);
+    }
+    return s->state != GAMEOVER && s->tiles == tiles + 1;
+}
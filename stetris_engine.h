@@ -0,0 +1,150 @@
+/**
+ * @file stetris_engine.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Reentrant bitboard implementation of the sTetris() game rules.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The interactive binaries keep their game in the global gameConfig. Bots,
+ * the headless simulator and the tools need many independent, cheaply
+ * copyable games, so this module re-implements exactly the same rules
+ * (tile movement, bottom row clearing, level schedule, game over) on a
+ * plain struct without pointers. The 8x8 playfield is stored as a 64 bit
+ * occupancy bitboard where bit (y * 8 + x) is the tile at column x, row y.
+ */
+
+#ifndef STETRIS_ENGINE_H
+#define STETRIS_ENGINE_H
+
+#include <stdbool.h>                    // for bool type
+#include <stdint.h>                     // for fixed width integer types
+#include <linux/input.h>                // for KEY_* codes shared with the frontends
+
+#define GRID_X 8                        // playfield width, fixed by the Sense HAT matrix
+#define GRID_Y 8                        // playfield height
+#define SPAWN_X ((GRID_X - 1) / 2)      // column where addNewTile() places new tiles
+#define NUM_COLORS 6                    // number of entries in blockColor[]
+
+/**
+ * Game state bits, identical to the definitions in the frontends.
+ */
+#define GAMEOVER 0
+#define ACTIVE (1 << 0)
+#define ROW_CLEAR (1 << 1)
+#define TILE_ADDED (1 << 2)
+
+#define ROW_MASK(y) ((uint64_t)0xFF << ((y) * GRID_X))
+#define CELL_MASK(x, y) ((uint64_t)1 << ((y) * GRID_X + (x)))
+#define BOTTOM_ROW_FULL(board) (((board) >> ((GRID_Y - 1) * GRID_X)) == 0xFF)
+
+// Upper bound of distinct lock positions returned by engineGenPlacements()
+#define MAX_PLACEMENTS (GRID_X * GRID_Y)
+
+/**
+ * Complete state of one game. Contains no pointers, so it can be copied
+ * with plain assignment, written to disk or placed in shared memory.
+ */
+typedef struct
+{
+    uint64_t occupied;              // occupancy bitboard, bit (y * 8 + x)
+    uint64_t colorPlane[3];         // blockColor[] index of each tile, one bit per plane
+    uint32_t rng;                   // per-game color generator state (xorshift32)
+    uint8_t activeX;                // current tile
+    uint8_t activeY;
+    uint8_t state;                  // GAMEOVER or ACTIVE | ROW_CLEAR | TILE_ADDED
+    uint8_t rowsPerLevel;           // speed up after clearing rows
+    uint32_t tiles;                 // number of tiles played
+    uint32_t rows;                  // number of rows cleared
+    uint32_t score;                 // game score
+    uint32_t level;                 // game level
+    uint32_t tick;                  // wraps at nextGameTick, next game state calculated at 0
+    uint32_t nextGameTick;          // lowers with increasing level, never reaches 0
+    uint32_t initNextGameTick;      // initial value of nextGameTick
+} engineState;
+
+/**
+ * One distinct position where the active tile can come to rest.
+ */
+typedef struct
+{
+    uint64_t board;                 // occupancy after the lock (and a row clear in the same tick)
+    uint8_t x;                      // lock cell, in the coordinates before any row clear
+    uint8_t y;
+    uint8_t orphan;                 // tile is left behind in row 0 by a pending row clear
+    uint8_t lines;                  // 1 if the lock fills the bottom row
+    uint8_t cleared;                // a row is cleared in the tick the tile locks
+} placement;
+
+#define MAX_LEVEL_BANDS 8
+
+/**
+ * Rules that can be changed per run with ENGINE_USAGE. A period (the
+ * nextGameTick of a level) up to levelUpTo[i], in the first band that
+ * includes it, is lowered by levelStep[i] at a level up, but never below 1.
+ * The last band includes every period.
+ */
+typedef struct
+{
+    unsigned long uSecTickTime;         // tick rate of the interactive binaries
+    unsigned int rowsPerLevel;          // speed up after clearing rows
+    unsigned int initNextGameTick;      // nextGameTick of a new game
+    unsigned int levelBands;            // bands of the level schedule in use
+    uint32_t levelUpTo[MAX_LEVEL_BANDS];
+    uint32_t levelStep[MAX_LEVEL_BANDS];
+} engineRules;
+
+#define ENGINE_USAGE "[--tick-usec USEC] [--rows-per-level N] [--start-period TICKS] [--levels SCHEDULE]"
+#define ENGINE_LEVELS_DEFAULT "1:0,10:1,20:2,*:10"
+
+extern engineRules gameRules;           // used by engineInit() and engineNextPeriod()
+
+bool engineParseRule(engineRules *r, int argc, char **argv, int *i);
+bool engineParseLevels(engineRules *r, char const *text);
+void engineFormatLevels(engineRules const *r, char *text, unsigned int size);
+void engineInit(engineState *s, uint32_t seed);
+void engineNewGame(engineState *s);
+bool engineStep(engineState *s, int const key);
+bool engineStepNoRestart(engineState *s, int const key);
+int engineColorAt(engineState const *s, unsigned int x, unsigned int y);
+unsigned int engineKeysToGravity(engineState const *s);
+unsigned int engineNextPeriod(unsigned int period);
+int engineGenPlacements(uint64_t board, unsigned int x0, unsigned int y0,
+                        unsigned int keysLeft, unsigned int period, placement *out);
+int engineGenMoves(engineState const *s, placement *out);
+bool enginePlanPath(uint64_t board, unsigned int x0, unsigned int y0,
+                    unsigned int keysLeft, unsigned int period,
+                    placement const *target, uint8_t path[GRID_Y]);
+int enginePathKey(engineState const *s, placement const *target, uint8_t const path[GRID_Y]);
+bool engineSetBoard(engineState *s, uint64_t board);
+uint64_t engineGarbageBoard(uint32_t seed, unsigned int rows);
+bool engineAddGarbage(engineState *s, unsigned int rows, unsigned int hole);
+bool engineApply(engineState *s, placement const *target);
+
+/**
+ * Checks if the cell at (x, y) of a bitboard is occupied.
+ */
+static inline bool boardOccupied(uint64_t const board, unsigned int const x, unsigned int const y)
+{
+    return (board >> (y * GRID_X + x)) & 1;
+}
+
+/**
+ * Shifts all rows of a bitboard down by one, the way clearRow() does.
+ */
+static inline uint64_t boardShiftDown(uint64_t const board)
+{
+    return board << GRID_X;
+}
+
+/**
+ * Hashes a bitboard for hash table slots (splitmix64 finalizer). Every bit of
+ * the board reaches the low bits, so slots can be taken with a mask.
+ */
+static inline uint64_t boardHash(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+#endif // STETRIS_ENGINE_H
@@ -0,0 +1,326 @@
+/**
+ * @file stetris_env.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Vectorised reinforcement learning environment of many games.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Games are stepped LANES at a time with lanesStepNoRestart(), and any left
+ * over one by one: loaded from the arrays into an engineState on the stack,
+ * stepped with engineStepNoRestart() and stored back. Both play by exactly the rules of the
+ * engine. Tile colors are not kept, they do not change the game. Large
+ * batches are split into chunks of games stepped in parallel on the thread
+ * pool.
+ */
+
+#include "stetris_env.h"
+#include "stetris_lanes.h"
+
+#include <stdlib.h>                     // for malloc(), free()
+#include <string.h>                     // for memcpy, memset
+
+#define ENV_CHUNK 256                   // games per pool task
+
+/**
+ * Arguments of one parallel envStep() or envReset().
+ */
+typedef struct
+{
+    envBatch *env;
+    uint32_t const *seeds;              // envReset() only, NULL for 1, 2, ...
+    uint8_t const *actions;             // envStep() only
+    float *obs;
+    float *rewards;
+    uint8_t *dones;
+} envRun;
+
+static int const actionKeys[NUM_ENV_ACTIONS] = {0, KEY_LEFT, KEY_RIGHT, KEY_DOWN};
+
+/**
+ * The 8 cells of a row as floats, for every value of the row.
+ */
+static float rowPlanes[256][GRID_X];    // filled by envCreate(), the same every time
+
+static void initRowPlanes(void)
+{
+    for (unsigned int row = 0; row < 256; row++)
+    {
+        for (unsigned int x = 0; x < GRID_X; x++)
+            rowPlanes[row][x] = (float)((row >> x) & 1);
+    }
+}
+
+/**
+ * Allocates the arrays of size games in one block and, unless threads is 1,
+ * a pool of that many threads (0 for one per CPU). The games are in the
+ * GAMEOVER state until envReset().
+ * Returns false if out of memory.
+ */
+bool envCreate(envBatch *env, unsigned int size, unsigned int threads)
+{
+    engineState defaults;
+    engineInit(&defaults, 1);
+
+    if (rowPlanes[1][0] == 0.0f)
+        initRowPlanes();
+    memset(env, 0, sizeof(*env));
+    env->size = size;
+    env->gameOverReward = -1.0f;
+    env->rowsPerLevel = defaults.rowsPerLevel;
+    env->initNextGameTick = defaults.initNextGameTick;
+
+    // Widest fields first, so every array stays aligned
+    size_t const bytes = (size_t)size * (sizeof(uint64_t) + 8 * sizeof(uint32_t) + 3 * sizeof(uint8_t));
+    char *block = malloc(bytes ? bytes : 1);
+    if (!block)
+        return false;
+    memset(block, 0, bytes);
+    env->occupied = (uint64_t *)block;
+    env->rng = (uint32_t *)(env->occupied + size);
+    env->seed = env->rng + size;
+    env->tiles = env->seed + size;
+    env->rows = env->tiles + size;
+    env->score = env->rows + size;
+    env->level = env->score + size;
+    env->tick = env->level + size;
+    env->nextGameTick = env->tick + size;
+    env->activeX = (uint8_t *)(env->nextGameTick + size);
+    env->activeY = env->activeX + size;
+    env->state = env->activeY + size;
+
+    if (threads != 1 && size > ENV_CHUNK)
+    {
+        env->pool = poolCreate(threads);
+        if (!env->pool)
+        {
+            free(block);
+            return false;
+        }
+    }
+    return true;
+}
+
+void envDestroy(envBatch *env)
+{
+    if (env->pool)
+        poolDestroy(env->pool);
+    free(env->occupied);
+    env->occupied = NULL;
+    env->pool = NULL;
+}
+
+static inline void loadGame(envBatch const *env, unsigned int i, engineState *s)
+{
+    s->occupied = env->occupied[i];
+    s->rng = env->rng[i];
+    s->activeX = env->activeX[i];
+    s->activeY = env->activeY[i];
+    s->state = env->state[i];
+    s->rowsPerLevel = env->rowsPerLevel;
+    s->tiles = env->tiles[i];
+    s->rows = env->rows[i];
+    s->score = env->score[i];
+    s->level = env->level[i];
+    s->tick = env->tick[i];
+    s->nextGameTick = env->nextGameTick[i];
+    s->initNextGameTick = env->initNextGameTick;
+}
+
+static inline void storeGame(envBatch *env, unsigned int i, engineState const *s)
+{
+    env->occupied[i] = s->occupied;
+    env->rng[i] = s->rng;
+    env->activeX[i] = s->activeX;
+    env->activeY[i] = s->activeY;
+    env->state[i] = s->state;
+    env->tiles[i] = s->tiles;
+    env->rows[i] = s->rows;
+    env->score[i] = s->score;
+    env->level[i] = s->level;
+    env->tick[i] = s->tick;
+    env->nextGameTick[i] = s->nextGameTick;
+}
+
+/**
+ * Starts a new game with the given seed, with the settings of the batch.
+ */
+static void startGame(envBatch *env, unsigned int i, uint32_t seed)
+{
+    engineState s;
+    engineInit(&s, seed);
+    s.rowsPerLevel = env->rowsPerLevel;
+    s.initNextGameTick = env->initNextGameTick;
+    s.nextGameTick = env->initNextGameTick;
+    engineNewGame(&s);
+    env->seed[i] = seed;
+    storeGame(env, i, &s);
+}
+
+/**
+ * Writes the observation of game i, see stetris_env.h.
+ */
+static void observe(envBatch const *env, unsigned int i, float *o)
+{
+    uint64_t const active = (env->state[i] & ACTIVE) ? CELL_MASK(env->activeX[i], env->activeY[i]) : 0;
+    uint64_t const board = env->occupied[i] & ~active;
+
+    for (unsigned int y = 0; y < GRID_Y; y++)
+    {
+        memcpy(o + ENV_OBS_BOARD + y * GRID_X, rowPlanes[(board >> (y * GRID_X)) & 0xFF], sizeof(rowPlanes[0]));
+        memcpy(o + ENV_OBS_ACTIVE + y * GRID_X, rowPlanes[(active >> (y * GRID_X)) & 0xFF], sizeof(rowPlanes[0]));
+    }
+    for (unsigned int x = 0; x < GRID_X; x++)
+    {
+        // The lowest set bit of a column is its top cell
+        uint64_t const column = board & (0x0101010101010101ULL << x);
+        unsigned int const top = column ? (unsigned int)__builtin_ctzll(column) / GRID_X : GRID_Y;
+        o[ENV_OBS_HEIGHTS + x] = (float)(GRID_Y - top) / GRID_Y;
+    }
+    uint32_t const period = env->nextGameTick[i];
+    uint32_t const tick = env->tick[i];
+    o[ENV_OBS_GRAVITY] = (float)(tick ? period - tick + 1 : 1) / period;     // engineKeysToGravity()
+    o[ENV_OBS_PERIOD] = (float)period / env->initNextGameTick;
+    o[ENV_OBS_LEVEL] = (float)env->level[i];
+}
+
+static void resetChunk(void *arg, unsigned int index)
+{
+    envRun const *r = arg;
+    envBatch *env = r->env;
+    unsigned int const begin = index * ENV_CHUNK;
+    unsigned int const end = (env->size - begin < ENV_CHUNK) ? env->size : begin + ENV_CHUNK;
+
+    for (unsigned int i = begin; i < end; i++)
+    {
+        startGame(env, i, r->seeds ? r->seeds[i] : i + 1);
+        if (r->obs)
+            observe(env, i, r->obs + (size_t)i * ENV_OBS_SIZE);
+    }
+}
+
+/**
+ * Finishes the step of game i, already stored in the arrays: restarts it if
+ * it ended and writes its reward, done flag and observation.
+ */
+static void finishStep(envRun const *r, unsigned int i, uint32_t score)
+{
+    envBatch *env = r->env;
+
+    bool const ended = env->state[i] == GAMEOVER;
+    if (r->rewards)
+        r->rewards[i] = ended ? env->gameOverReward : (float)(env->score[i] - score);
+    if (r->dones)
+        r->dones[i] = ended;
+    if (ended)
+        startGame(env, i, env->seed[i] + env->size);
+    if (r->obs)
+        observe(env, i, r->obs + (size_t)i * ENV_OBS_SIZE);
+    if (env->publish)
+    {
+        engineState s;
+        loadGame(env, i, &s);
+        shmPublish(env->publish, i, &s);
+    }
+}
+
+/**
+ * Steps the LANES games from i on together with lanesStepNoRestart().
+ */
+static void stepLanes(envRun const *r, unsigned int i)
+{
+    envBatch *env = r->env;
+    laneGames g;
+    laneVector keys;
+    uint32_t score[LANES];
+
+    for (unsigned int l = 0; l < LANES; l++)
+    {
+        uint8_t const action = r->actions[i + l];
+        keys[l] = action < NUM_ENV_ACTIONS ? actionKeys[action] : 0;
+        g.occupied[l] = env->occupied[i + l];
+        g.active[l] = CELL_MASK(env->activeX[i + l], env->activeY[i + l]);
+        g.state[l] = env->state[i + l];
+        g.tick[l] = env->tick[i + l];
+        g.nextGameTick[l] = env->nextGameTick[i + l];
+        g.tiles[l] = env->tiles[i + l];
+        g.rows[l] = env->rows[i + l];
+        g.score[l] = score[l] = env->score[i + l];
+        g.level[l] = env->level[i + l];
+        g.rng[l] = env->rng[i + l];
+    }
+    lanesStepNoRestart(&g, &keys, env->rowsPerLevel, env->initNextGameTick);
+    for (unsigned int l = 0; l < LANES; l++)
+    {
+        unsigned int const cell = (unsigned int)__builtin_ctzll(g.active[l]);
+        env->occupied[i + l] = g.occupied[l];
+        env->activeX[i + l] = cell % GRID_X;
+        env->activeY[i + l] = cell / GRID_X;
+        env->state[i + l] = (uint8_t)g.state[l];
+        env->tick[i + l] = (uint32_t)g.tick[l];
+        env->nextGameTick[i + l] = (uint32_t)g.nextGameTick[l];
+        env->tiles[i + l] = (uint32_t)g.tiles[l];
+        env->rows[i + l] = (uint32_t)g.rows[l];
+        env->score[i + l] = (uint32_t)g.score[l];
+        env->level[i + l] = (uint32_t)g.level[l];
+        env->rng[i + l] = (uint32_t)g.rng[l];
+        finishStep(r, i + l, score[l]);
+    }
+}
+
+static void stepChunk(void *arg, unsigned int index)
+{
+    envRun const *r = arg;
+    envBatch *env = r->env;
+    unsigned int const begin = index * ENV_CHUNK;
+    unsigned int const end = (env->size - begin < ENV_CHUNK) ? env->size : begin + ENV_CHUNK;
+    unsigned int i = begin;
+    engineState s;
+
+    for (; i + LANES <= end; i += LANES)
+        stepLanes(r, i);
+
+    // The rest of the chunk, one game at a time
+    memset(&s, 0, sizeof(s));
+    for (; i < end; i++)
+    {
+        loadGame(env, i, &s);
+        uint32_t const score = s.score;
+        uint8_t const action = r->actions[i];
+        engineStepNoRestart(&s, action < NUM_ENV_ACTIONS ? actionKeys[action] : 0);
+        storeGame(env, i, &s);
+        finishStep(r, i, score);
+    }
+}
+
+/**
+ * Starts a new game in every slot, slot i with seeds[i] (1, 2, ... if seeds
+ * is NULL; a seed must not be 0), and writes the first observations to obs
+ * unless it is NULL.
+ */
+void envReset(envBatch *env, uint32_t const *seeds, float *obs)
+{
+    envRun run = {.env = env, .seeds = seeds, .obs = obs};
+    unsigned int const chunks = (env->size + ENV_CHUNK - 1) / ENV_CHUNK;
+    if (env->pool)
+        poolFor(env->pool, resetChunk, &run, chunks);
+    else
+        for (unsigned int c = 0; c < chunks; c++)
+            resetChunk(&run, c);
+}
+
+/**
+ * Advances every game by one tick with actions[i], an envAction, and writes
+ * the observation after the tick, the score gained (or gameOverReward) and
+ * whether the game ended. Ended games start over with their next seed.
+ * obs, rewards and dones may be NULL when not needed.
+ */
+void envStep(envBatch *env, uint8_t const *actions, float *obs, float *rewards, uint8_t *dones)
+{
+    envRun run = {.env = env, .actions = actions, .obs = obs, .rewards = rewards, .dones = dones};
+    unsigned int const chunks = (env->size + ENV_CHUNK - 1) / ENV_CHUNK;
+    if (env->pool)
+        poolFor(env->pool, stepChunk, &run, chunks);
+    else
+        for (unsigned int c = 0; c < chunks; c++)
+            stepChunk(&run, c);
+}
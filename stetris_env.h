@@ -0,0 +1,87 @@
+/**
+ * @file stetris_env.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Vectorised reinforcement learning environment of many games.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * An envBatch holds the state of size independent games as a structure of
+ * arrays in one allocation. envStep() advances every game by one tick of the
+ * main loop with one action each and writes the observations, rewards and
+ * done flags into buffers of the caller; nothing is allocated per step.
+ * A game that ends is started again right away with its next seed, and the
+ * observation returned for it is the first one of the new game, like the
+ * vector environments of Gym.
+ * Observations are ENV_OBS_SIZE floats per game, at the ENV_OBS_* offsets:
+ *   ENV_OBS_BOARD    settled cells, 1 if occupied, row by row from the top
+ *   ENV_OBS_ACTIVE   the active tile, 1 at its cell
+ *   ENV_OBS_HEIGHTS  height of every column, in rows / GRID_Y
+ *   ENV_OBS_GRAVITY  engineKeysToGravity() / nextGameTick
+ *   ENV_OBS_PERIOD   nextGameTick / initNextGameTick
+ *   ENV_OBS_LEVEL    level
+ * The shared library libstetris_env.so exports this API for training code
+ * in other languages. With publish set to a ring from shmCreate(), every
+ * game is also published after each step, as game i, for agents in other
+ * processes (see stetris_shm.h).
+ */
+
+#ifndef STETRIS_ENV_H
+#define STETRIS_ENV_H
+
+#include <stdbool.h>                    // for bool type
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_engine.h"
+#include "stetris_pool.h"
+#include "stetris_shm.h"
+
+#define ENV_OBS_BOARD 0
+#define ENV_OBS_ACTIVE (ENV_OBS_BOARD + GRID_X * GRID_Y)
+#define ENV_OBS_HEIGHTS (ENV_OBS_ACTIVE + GRID_X * GRID_Y)
+#define ENV_OBS_GRAVITY (ENV_OBS_HEIGHTS + GRID_X)
+#define ENV_OBS_PERIOD (ENV_OBS_GRAVITY + 1)
+#define ENV_OBS_LEVEL (ENV_OBS_PERIOD + 1)
+#define ENV_OBS_SIZE (ENV_OBS_LEVEL + 1)
+
+/**
+ * Actions, one per game and step: the key pressed in that tick.
+ */
+typedef enum
+{
+    ENV_NONE = 0,
+    ENV_LEFT,
+    ENV_RIGHT,
+    ENV_DROP,
+    NUM_ENV_ACTIONS
+} envAction;
+
+typedef struct
+{
+    unsigned int size;                  // games in the batch
+    float gameOverReward;               // reward of the step that ends a game, instead of its score
+    uint8_t rowsPerLevel;               // of every game, as in engineInit()
+    uint32_t initNextGameTick;
+    threadPool *pool;                   // NULL when stepping on the calling thread
+    shmRing *publish;                   // NULL, or the ring every stepped game is published to
+
+    // One entry per game, the engineState fields that drive the rules
+    uint64_t *occupied;
+    uint32_t *rng;
+    uint32_t *seed;                     // seed of the current game, the next one is seed + size
+    uint32_t *tiles;
+    uint32_t *rows;
+    uint32_t *score;
+    uint32_t *level;
+    uint32_t *tick;
+    uint32_t *nextGameTick;
+    uint8_t *activeX;
+    uint8_t *activeY;
+    uint8_t *state;
+} envBatch;
+
+bool envCreate(envBatch *env, unsigned int size, unsigned int threads);
+void envDestroy(envBatch *env);
+void envReset(envBatch *env, uint32_t const *seeds, float *obs);
+void envStep(envBatch *env, uint8_t const *actions, float *obs, float *rewards, uint8_t *dones);
+
+#endif // STETRIS_ENV_H
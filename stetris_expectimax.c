@@ -0,0 +1,239 @@
+/**
+ * @file stetris_expectimax.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Expectimax bot over the randomizer of new tiles.
+ * @version 1.1
+ * This file is part of the Stetris project.
+ * The search alternates placement nodes, which take the best placement of a
+ * tile, and chance nodes, which average over the outcomes of newTile(). It
+ * deepens iteratively until options.depth or until the time budget of the
+ * decision runs out, and then plays the choice of the last completed depth.
+ * The candidates of a depth are searched in parallel on the bot's thread
+ * pool. Values of boards that are reached through different placement
+ * orders or by other threads are shared in the lock-free transposition table.
+ */
+
+#include "stetris_bot.h"
+
+#include <float.h>                      // for FLT_MAX
+
+#define CHECK_INTERVAL 256              // nodes between checks of the deadline
+
+typedef struct
+{
+    bot *b;
+    unsigned int period;                // keys per row of new tiles
+    double deadline;                    // botNow() when the search has to stop
+    bool aborted;
+    unsigned int sinceCheck;            // nodes since the deadline was checked
+    unsigned long long nodes;           // boards evaluated by this thread
+    ttStats stats;                      // transposition table probes of this thread
+} expectimaxSearch;
+
+/**
+ * One depth of the iterative deepening, searched in parallel per candidate.
+ */
+typedef struct
+{
+    bot *b;
+    placement const *candidates;
+    unsigned int depth;
+    unsigned int period;
+    double deadline;
+    float value[MAX_PLACEMENTS];        // value of each candidate
+    bool aborted;                       // some candidate ran out of time (atomic)
+} expectimaxDepth;
+
+/**
+ * Outcome of a chance node: board a new tile is placed on, with its probability.
+ */
+typedef struct
+{
+    uint64_t board;
+    float probability;
+} chanceOutcome;
+
+static float chanceValue(expectimaxSearch *e, uint64_t board, unsigned int depth);
+
+/**
+ * Lists the distinct boards a new tile can appear on, with their probability.
+ * newTile() draws one of NUM_COLORS colors uniformly; the color does not
+ * change which cells are occupied, so all draws merge into one outcome.
+ * Returns the number of outcomes.
+ */
+static int chanceOutcomes(uint64_t const board, chanceOutcome out[NUM_COLORS])
+{
+    int n = 0;
+    for (unsigned int color = 0; color < NUM_COLORS; color++)
+    {
+        int i = 0;
+        while (i < n && out[i].board != board)
+            i++;
+        if (i == n)
+        {
+            out[n].board = board;
+            out[n].probability = 0;
+            n++;
+        }
+        out[i].probability += 1.0f / NUM_COLORS;
+    }
+    return n;
+}
+
+/**
+ * Returns true once the time budget of the decision is used up.
+ */
+static inline bool outOfTime(expectimaxSearch *e)
+{
+    if (++e->sinceCheck >= CHECK_INTERVAL)
+    {
+        e->sinceCheck = 0;
+        if (botNow() > e->deadline)
+            e->aborted = true;
+    }
+    return e->aborted;
+}
+
+/**
+ * Placement node: value of the best placement of a new tile on board,
+ * searching depth - 1 further tiles below it. Stores the index of the best
+ * placement in *move.
+ */
+static float placementValue(expectimaxSearch *e, uint64_t const board, unsigned int const depth, uint8_t *move)
+{
+    placement moves[MAX_PLACEMENTS];
+    float leaf[MAX_PLACEMENTS];
+    float const lineWeight = e->b->weights.weight[FEATURE_LINES];
+    int const n = engineGenPlacements(board, SPAWN_X, 0, e->period, e->period, moves);
+    float best = -FLT_MAX;
+
+    *move = TT_NO_MOVE;
+    e->nodes += n;
+    if (depth == 1)
+        botEvaluatePlacements(e->b, moves, n, 0, leaf);
+    for (int i = 0; i < n && !outOfTime(e); i++)
+    {
+        float value;
+        if (depth == 1)
+            value = leaf[i];
+        else if (boardOccupied(moves[i].board, SPAWN_X, 0))
+            value = -FLT_MAX;
+        else
+            value = lineWeight * moves[i].lines + chanceValue(e, moves[i].board, depth - 1);
+        if (value > best || *move == TT_NO_MOVE)
+        {
+            best = value;
+            *move = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Chance node: expected value of board over the randomizer, with depth
+ * further tiles to place. Looks the value up in the transposition table first.
+ */
+static float chanceValue(expectimaxSearch *e, uint64_t const board, unsigned int const depth)
+{
+    ttData entry;
+    if (ttProbe(&e->b->tt, board, depth, e->period, &entry, &e->stats))
+        return entry.value;
+
+    chanceOutcome outcomes[NUM_COLORS];
+    int const n = chanceOutcomes(board, outcomes);
+    float value = 0;
+    uint8_t move = TT_NO_MOVE;
+    for (int i = 0; i < n; i++)
+    {
+        float const v = placementValue(e, outcomes[i].board, depth, &move);
+        if (v == -FLT_MAX)
+        {
+            value = -FLT_MAX;
+            break;
+        }
+        value += outcomes[i].probability * v;
+    }
+
+    // Values of an aborted search are incomplete and must not be stored
+    if (!e->aborted)
+    {
+        entry.value = value;
+        entry.depth = depth;
+        entry.period = e->period;
+        entry.move = (n == 1) ? move : TT_NO_MOVE;
+        ttStore(&e->b->tt, board, &entry);
+    }
+    return value;
+}
+
+/**
+ * Searches one candidate placement of the current tile to d->depth tiles.
+ */
+static void searchCandidate(void *arg, unsigned int index)
+{
+    expectimaxDepth *d = arg;
+    placement const *c = &d->candidates[index];
+    expectimaxSearch e = {
+        .b = d->b,
+        .period = d->period,
+        .deadline = d->deadline,
+    };
+
+    if (d->depth == 0)
+        d->value[index] = botEvaluateBoard(d->b, c->board, c->lines);
+    else if (boardOccupied(c->board, SPAWN_X, 0))
+        d->value[index] = -FLT_MAX;
+    else if (__atomic_load_n(&d->aborted, __ATOMIC_RELAXED))
+        return;     // another candidate ran out of time, this depth is lost anyway
+    else
+        d->value[index] = d->b->weights.weight[FEATURE_LINES] * c->lines + chanceValue(&e, c->board, d->depth);
+
+    if (e.aborted)
+        __atomic_store_n(&d->aborted, true, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&d->b->nodes, e.nodes + 1, __ATOMIC_RELAXED);
+    ttAddStats(&d->b->probeStats, &e.stats);
+}
+
+/**
+ * Chooses a placement for the current tile by iteratively deepened expectimax
+ * search, bounded by options.depth following tiles and options.budget
+ * microseconds. Returns the index of the chosen candidate, or -1 if there is none.
+ */
+int expectimaxChoose(bot *b, placement const *candidates, int n, unsigned int period)
+{
+    // From GRID_X keys per row on the tile reaches every column of each row,
+    // so longer periods generate the same placements and fit ttData.period
+    expectimaxDepth d = {
+        .b = b,
+        .candidates = candidates,
+        .period = period < UINT8_MAX ? period : UINT8_MAX,
+        .deadline = botNow() + b->options.budget,
+    };
+    int best = -1;
+    unsigned int completed = 0;
+
+    ttNewSearch(&b->tt);
+    for (unsigned int depth = 0; depth <= b->options.depth; depth++)
+    {
+        d.depth = depth;
+        poolFor(b->pool, searchCandidate, &d, n);
+
+        // Depth 0 always completes; deeper searches only count if finished
+        if (d.aborted && depth > 0)
+            break;
+        int depthBest = -1;
+        for (int i = 0; i < n; i++)
+        {
+            if (depthBest < 0 || d.value[i] > d.value[depthBest])
+                depthBest = i;
+        }
+        best = depthBest;
+        completed = depth;
+        if (best < 0 || d.value[best] == -FLT_MAX)
+            break;      // every line of play ends the game, nothing to refine
+    }
+
+    b->depthSum += completed;
+    return best;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file stetris_lanes.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief The game rules applied to LANES games at once in vector registers.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * lanesStepNoRestart() follows engineStepNoRestart() and its helpers line
+ * by line; where they branch, both sides are computed and merged with
+ * laneSelect(). Keep the two in sync when the rules change.
+ */
+
+#include "stetris_lanes.h"
+
+#define COLUMN_LEFT 0x0101010101010101ULL   // cells with x == 0
+#define COLUMN_RIGHT (COLUMN_LEFT << (GRID_X - 1))
+#define BOTTOM_ROW ROW_MASK(GRID_Y - 1)
+#define SPAWN_CELL CELL_MASK(SPAWN_X, 0)
+
+/**
+ * Turns a vector comparison into a lane mask, all ones where it holds.
+ */
+#define LANE_MASK(comparison) ((laneVector)(comparison))
+
+static inline laneVector laneSelect(laneVector const mask, laneVector const a, laneVector const b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+/**
+ * Copies game s into one lane.
+ */
+void lanesLoad(laneGames *g, unsigned int lane, engineState const *s)
+{
+    g->occupied[lane] = s->occupied;
+    g->active[lane] = CELL_MASK(s->activeX, s->activeY);
+    g->state[lane] = s->state;
+    g->tick[lane] = s->tick;
+    g->nextGameTick[lane] = s->nextGameTick;
+    g->tiles[lane] = s->tiles;
+    g->rows[lane] = s->rows;
+    g->score[lane] = s->score;
+    g->level[lane] = s->level;
+    g->rng[lane] = s->rng;
+}
+
+/**
+ * Copies one lane back into game s. The colors of s are left as they were.
+ */
+void lanesStore(laneGames const *g, unsigned int lane, engineState *s)
+{
+    unsigned int const cell = (unsigned int)__builtin_ctzll(g->active[lane]);
+    s->occupied = g->occupied[lane];
+    s->activeX = cell % GRID_X;
+    s->activeY = cell / GRID_X;
+    s->state = (uint8_t)g->state[lane];
+    s->tick = (uint32_t)g->tick[lane];
+    s->nextGameTick = (uint32_t)g->nextGameTick[lane];
+    s->tiles = (uint32_t)g->tiles[lane];
+    s->rows = (uint32_t)g->rows[lane];
+    s->score = (uint32_t)g->score[lane];
+    s->level = (uint32_t)g->level[lane];
+    s->rng = (uint32_t)g->rng[lane];
+}
+
+/**
+ * moveTile() in the lanes of mask: the cell of the active tile, occupied or
+ * not, is copied to target and reset.
+ */
+static inline void moveTo(laneGames *g, laneVector const mask, laneVector const target)
+{
+    laneVector const carried = LANE_MASK((g->occupied & g->active) != 0);
+    g->occupied = laneSelect(mask, (g->occupied & ~g->active) | (target & carried), g->occupied);
+    g->active = laneSelect(mask, target, g->active);
+}
+
+/**
+ * Returns the lanes of mask in which the active tile can move to target,
+ * a shift of the active mask that is 0 where the move leaves the playfield.
+ */
+static inline laneVector canMove(laneGames const *g, laneVector const mask, laneVector const target)
+{
+    return mask & LANE_MASK(target != 0) & LANE_MASK((g->occupied & target) == 0);
+}
+
+/**
+ * addNewTile() in the lanes of mask. Returns the lanes where the spawn cell
+ * was free.
+ */
+static inline laneVector addNewTile(laneGames *g, laneVector const mask)
+{
+    laneVector const added = mask & LANE_MASK((g->occupied & SPAWN_CELL) == 0);
+    laneVector x = g->rng;      // nextRandom(), xorshift32 on the low half
+
+    x = (x ^ (x << 13)) & 0xFFFFFFFFULL;
+    x ^= x >> 17;
+    x = (x ^ (x << 5)) & 0xFFFFFFFFULL;
+    g->active = laneSelect(mask, (laneVector){0} + SPAWN_CELL, g->active);
+    g->occupied |= added & SPAWN_CELL;
+    g->rng = laneSelect(added, x, g->rng);
+    return added;
+}
+
+/**
+ * engineNextPeriod() for all lanes, with the level schedule of gameRules.
+ */
+static inline laneVector nextPeriod(laneVector const period)
+{
+    laneVector const zero = {0};
+    unsigned int const last = gameRules.levelBands - 1;
+    laneVector step = zero + gameRules.levelStep[last];
+
+    for (unsigned int b = last; b-- > 0;)
+        step = laneSelect(LANE_MASK(period <= gameRules.levelUpTo[b]), zero + gameRules.levelStep[b], step);
+    return laneSelect(LANE_MASK(period > step), period - step, laneSelect(LANE_MASK(period < 1), period, zero + 1));
+}
+
+/**
+ * Runs engineStepNoRestart() for every lane with the key of that lane in
+ * keys. Lanes whose game ends stay in the GAMEOVER state.
+ */
+void lanesStepNoRestart(laneGames *g, laneVector const *keys, unsigned int rowsPerLevel, unsigned int initNextGameTick)
+{
+    laneVector const zero = {0};
+    laneVector const playing = LANE_MASK((g->state & ACTIVE) != 0);
+
+    // Keys
+    laneVector const left = playing & LANE_MASK(*keys == KEY_LEFT);
+    laneVector const leftTarget = (g->active & ~COLUMN_LEFT) >> 1;
+    moveTo(g, canMove(g, left, leftTarget), leftTarget);
+
+    laneVector const right = playing & LANE_MASK(*keys == KEY_RIGHT);
+    laneVector const rightTarget = (g->active & ~COLUMN_RIGHT) << 1;
+    moveTo(g, canMove(g, right, rightTarget), rightTarget);
+
+    laneVector const drop = playing & LANE_MASK(*keys == KEY_DOWN);
+    for (unsigned int y = 1; y < GRID_Y; y++)
+    {
+        laneVector const downTarget = (g->active & ~BOTTOM_ROW) << GRID_X;
+        moveTo(g, canMove(g, drop, downTarget), downTarget);
+    }
+    g->tick = laneSelect(drop, zero, g->tick);
+
+    // Gravity step
+    laneVector const gravity = playing & LANE_MASK(g->tick == 0);
+    g->state = laneSelect(gravity, g->state & ~(uint64_t)(ROW_CLEAR | TILE_ADDED), g->state);
+
+    laneVector const cleared = gravity & LANE_MASK((g->occupied & BOTTOM_ROW) == BOTTOM_ROW);
+    g->occupied = laneSelect(cleared, g->occupied << GRID_X, g->occupied);
+    g->state |= cleared & ROW_CLEAR;
+    g->rows -= cleared;                 // a mask is -1 where set
+    g->score += cleared & (g->level + 1);
+    laneVector const levelUp = cleared & LANE_MASK(g->rows % rowsPerLevel == 0);
+    g->level -= levelUp;
+    g->nextGameTick = laneSelect(levelUp, nextPeriod(g->nextGameTick), g->nextGameTick);
+
+    laneVector const downTarget = (g->active & ~BOTTOM_ROW) << GRID_X;
+    laneVector const falls = canMove(g, gravity & LANE_MASK((g->occupied & g->active) != 0), downTarget);
+    moveTo(g, falls, downTarget);
+    laneVector const spawn = gravity & ~falls;
+    laneVector const added = addNewTile(g, spawn);
+    g->state |= added & TILE_ADDED;
+    g->tiles -= added;
+    laneVector const ended = spawn & ~added;
+    g->state = laneSelect(ended, zero, g->state);
+    g->nextGameTick = laneSelect(ended, zero + initNextGameTick, g->nextGameTick);
+
+    // tick < nextGameTick holds before every step, so the wrap is a compare
+    g->tick += 1;
+    g->tick = laneSelect(LANE_MASK(g->tick >= g->nextGameTick), zero, g->tick);
+}
@@ -0,0 +1,57 @@
+/**
+ * @file stetris_lanes.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief The game rules applied to LANES games at once in vector registers.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A laneGames holds one field of LANES games per vector, one game per lane.
+ * lanesStepNoRestart() runs engineStepNoRestart() for all of them with the
+ * same instruction stream: every branch of the rules becomes a lane mask,
+ * computed for all lanes and applied only where it is set. The vectors use the GCC vector
+ * extensions, so the compiler maps them to AVX2 or AVX-512 on x86 and to
+ * NEON on the Raspberry Pi, whatever -march allows; LANES follows it.
+ * All fields are 64 bits wide so that the masks of every comparison fit
+ * every field. The active tile is kept as a one-hot mask of its cell.
+ * Tile colors are not simulated, they do not change the game.
+ */
+
+#ifndef STETRIS_LANES_H
+#define STETRIS_LANES_H
+
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_engine.h"
+
+// Games per vector, as many 64 bit lanes as the widest vector unit -march allows
+#ifndef LANES
+#if defined(__AVX512F__)
+#define LANES 8
+#elif defined(__AVX2__)
+#define LANES 4
+#else
+#define LANES 2                         // SSE2 on x86-64, NEON on the Raspberry Pi
+#endif
+#endif
+
+typedef uint64_t laneVector __attribute__((vector_size(LANES * sizeof(uint64_t))));
+
+typedef struct
+{
+    laneVector occupied;                // as engineState
+    laneVector active;                  // CELL_MASK(activeX, activeY)
+    laneVector state;
+    laneVector tick;
+    laneVector nextGameTick;
+    laneVector tiles;
+    laneVector rows;
+    laneVector score;
+    laneVector level;
+    laneVector rng;
+} laneGames;
+
+void lanesLoad(laneGames *g, unsigned int lane, engineState const *s);
+void lanesStore(laneGames const *g, unsigned int lane, engineState *s);
+void lanesStepNoRestart(laneGames *g, laneVector const *keys, unsigned int rowsPerLevel, unsigned int initNextGameTick);
+
+#endif // STETRIS_LANES_H
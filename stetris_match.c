@@ -0,0 +1,217 @@
+/**
+ * @file stetris_match.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Rules of a versus match: garbage rows between the games and rounds.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Used by the local versus mode (stetris_versus.c), which plays every game
+ * on a thread of its own, and by the rollback sessions of netplay, which
+ * replay ticks with matchStep().
+ */
+
+#include "stetris_match.h"
+
+#include <string.h>                     // for memset
+
+/**
+ * Starts a match of players games that plays on until m->rounds is set;
+ * the first tick starts the first round.
+ */
+void matchInit(versusMatch *m, unsigned int players, uint32_t seed)
+{
+    memset(m, 0, sizeof(*m));
+    m->players = players;
+    m->seed = seed;
+    m->winner = -1;
+    m->restart = true;
+    m->holes = seed ? seed : 1;
+    for (unsigned int i = 0; i < players; i++)
+        engineInit(&m->game[i], seed);
+}
+
+/**
+ * Returns true once the last round of m has ended.
+ */
+bool matchOver(versusMatch const *m)
+{
+    return m->restart && m->rounds && m->round >= m->rounds;
+}
+
+/**
+ * Fills in[] with what happens to every game in the next tick before the
+ * keys: the start of a round or the garbage that arrives.
+ */
+void matchPrepare(versusMatch *m, matchInput *in)
+{
+    memset(in, 0, m->players * sizeof(*in));
+    if (m->restart)
+    {
+        for (unsigned int i = 0; i < m->players; i++)
+        {
+            in[i].restart = true;
+            in[i].seed = m->seed + m->round;
+            m->incoming[i] = 0;
+        }
+        m->restart = false;
+        m->round++;
+        m->winner = -1;
+        return;
+    }
+
+    // Garbage arrives when a tile of the receiver has locked
+    for (unsigned int i = 0; i < m->players; i++)
+    {
+        if (!m->incoming[i] || !(m->game[i].state & TILE_ADDED))
+            continue;
+        m->holes ^= m->holes << 13;
+        m->holes ^= m->holes >> 17;
+        m->holes ^= m->holes << 5;
+        in[i].garbage = (uint8_t)(m->incoming[i] < GRID_Y - 1 ? m->incoming[i] : GRID_Y - 1);
+        in[i].hole = m->holes % GRID_X;
+        m->incoming[i] -= in[i].garbage;
+    }
+}
+
+/**
+ * Plays one tick of game s with in and key. Touches nothing but s, so the
+ * games of a match can be played in parallel.
+ * Returns the rows cleared in the tick.
+ */
+unsigned int matchPlay(engineState *s, matchInput const *in, int key)
+{
+    if (in->restart)
+    {
+        engineInit(s, in->seed);
+        engineNewGame(s);
+    }
+    if (in->garbage)
+        engineAddGarbage(s, in->garbage, in->hole);
+
+    uint32_t const rows = s->rows;
+    // A key must not restart a lost game before the round ends
+    if (s->state & ACTIVE)
+        engineStep(s, key);
+    return s->rows - rows;
+}
+
+/**
+ * Returns the next opponent of player i that is still playing, in turn,
+ * or i itself if there is none.
+ */
+static unsigned int nextTarget(versusMatch *m, unsigned int i)
+{
+    for (unsigned int k = 1; k <= m->players; k++)
+    {
+        unsigned int const t = (m->target[i] + k) % m->players;
+        if (t != i && m->game[t].state != GAMEOVER)
+        {
+            m->target[i] = t;
+            return t;
+        }
+    }
+    return i;
+}
+
+/**
+ * Ends a tick after the games in m have been played: routes the cleared
+ * rows as garbage and ends or starts rounds.
+ * Returns true if garbage was sent or a round ended.
+ */
+bool matchFinish(versusMatch *m, unsigned int const *cleared)
+{
+    unsigned int attack[MATCH_MAX_PLAYERS];
+    unsigned int alive = 0;
+    bool changed = false;
+
+    // Cleared rows cancel the garbage waiting before this tick first, the
+    // rest attacks
+    for (unsigned int i = 0; i < m->players; i++)
+    {
+        unsigned int const cancel = cleared[i] < m->incoming[i] ? cleared[i] : m->incoming[i];
+        m->incoming[i] -= cancel;
+        attack[i] = cleared[i] - cancel;
+        alive += m->game[i].state != GAMEOVER;
+    }
+    for (unsigned int i = 0; i < m->players; i++)
+    {
+        unsigned int const t = attack[i] ? nextTarget(m, i) : i;
+        if (t != i)
+        {
+            m->incoming[t] += attack[i];
+            m->sent[i] += attack[i];
+            changed = true;
+        }
+    }
+
+    if (!m->pause && alive <= 1)
+    {
+        for (unsigned int i = 0; i < m->players; i++)
+        {
+            if (m->game[i].state != GAMEOVER)
+                m->winner = i;
+        }
+        if (m->winner >= 0)
+            m->wins[m->winner]++;
+        m->pause = MATCH_ROUND_PAUSE;
+        changed = true;
+    }
+    else if (m->pause && --m->pause == 0)
+        m->restart = true;
+    return changed;
+}
+
+/**
+ * Plays one tick of all games of m with keys, one per player, unless the
+ * match is over.
+ * Returns true if garbage was sent or a round ended.
+ */
+bool matchStep(versusMatch *m, uint8_t const *keys)
+{
+    matchInput in[MATCH_MAX_PLAYERS];
+    unsigned int cleared[MATCH_MAX_PLAYERS];
+
+    if (matchOver(m))
+        return false;
+    matchPrepare(m, in);
+    for (unsigned int i = 0; i < m->players; i++)
+        cleared[i] = matchPlay(&m->game[i], &in[i], keys[i]);
+    return matchFinish(m, cleared);
+}
+
+static inline uint64_t mix(uint64_t hash, uint64_t value)
+{
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        hash ^= (value >> (8 * i)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Returns a hash (FNV-1a) of the fields of m and its games, to find out
+ * whether two copies of a match went apart. Padding is left out.
+ */
+uint64_t matchHash(versusMatch const *m)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    hash = mix(hash, ((uint64_t)m->round << 32) | m->pause);
+    hash = mix(hash, ((uint64_t)(uint32_t)m->winner << 32) | m->holes);
+    hash = mix(hash, ((uint64_t)m->rounds << 32) | m->restart);
+    for (unsigned int i = 0; i < m->players; i++)
+    {
+        engineState const *s = &m->game[i];
+        hash = mix(hash, s->occupied);
+        for (unsigned int c = 0; c < 3; c++)
+            hash = mix(hash, s->colorPlane[c]);
+        hash = mix(hash, ((uint64_t)s->rng << 32) | ((uint64_t)s->activeX << 16) | ((uint64_t)s->activeY << 8) | s->state);
+        hash = mix(hash, ((uint64_t)s->tiles << 32) | s->rows);
+        hash = mix(hash, ((uint64_t)s->score << 32) | s->level);
+        hash = mix(hash, ((uint64_t)s->tick << 32) | s->nextGameTick);
+        hash = mix(hash, ((uint64_t)m->incoming[i] << 32) | m->target[i]);
+        hash = mix(hash, ((uint64_t)m->sent[i] << 32) | m->wins[i]);
+    }
+    return hash;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file stetris_match.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Rules of a versus match: garbage rows between the games and rounds.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every row a player clears sends a garbage row to the next opponent still
+ * playing (engineAddGarbage()). Garbage waits until the receiver's next
+ * tile locks, and rows the receiver clears first cancel it. The last player
+ * standing wins the round and the next one starts MATCH_ROUND_PAUSE ticks
+ * later, until m->rounds have been played. A match is a plain struct
+ * without pointers and its ticks depend only on the keys, so it can be
+ * copied as a snapshot and replayed, which the rollback of
+ * stetris_rollback.c relies on.
+ * A tick is matchPrepare(), matchPlay() for every player, which may run on
+ * threads of their own, and matchFinish(); matchStep() does all of it.
+ */
+
+#ifndef STETRIS_MATCH_H
+#define STETRIS_MATCH_H
+
+#include <stdbool.h>                    // for bool type
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_engine.h"
+
+#define MATCH_MAX_PLAYERS 4
+#define MATCH_ROUND_PAUSE 100           // ticks between the end of a round and the next
+
+/**
+ * What happens to the game of one player in a tick before its key.
+ */
+typedef struct
+{
+    bool restart;                       // start a new game with seed
+    uint32_t seed;
+    uint8_t garbage;                    // rows to add
+    uint8_t hole;                       // column left open in them
+} matchInput;
+
+typedef struct
+{
+    uint32_t players;
+    uint32_t seed;                      // seed of the games of the first round
+    uint32_t rounds;                    // rounds to play, 0 to play on
+    uint32_t round;                     // rounds started
+    uint32_t pause;                     // ticks until the next round, 0 while one runs
+    int32_t winner;                     // of the last round, -1 for none
+    bool restart;                       // the next tick starts a round
+    uint32_t holes;                     // xorshift32 of the garbage holes
+    engineState game[MATCH_MAX_PLAYERS];
+    uint32_t incoming[MATCH_MAX_PLAYERS];   // garbage rows waiting for the next lock
+    uint32_t target[MATCH_MAX_PLAYERS];     // opponent of the next attack
+    uint32_t sent[MATCH_MAX_PLAYERS];       // garbage rows sent in all rounds
+    uint32_t wins[MATCH_MAX_PLAYERS];
+} versusMatch;
+
+void matchInit(versusMatch *m, unsigned int players, uint32_t seed);
+bool matchOver(versusMatch const *m);
+void matchPrepare(versusMatch *m, matchInput *in);
+unsigned int matchPlay(engineState *s, matchInput const *in, int key);
+bool matchFinish(versusMatch *m, unsigned int const *cleared);
+bool matchStep(versusMatch *m, uint8_t const *keys);
+uint64_t matchHash(versusMatch const *m);
+
+#endif // STETRIS_MATCH_H
@@ -0,0 +1,351 @@
+/**
+ * @file stetris_mcts.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Parallel Monte Carlo tree search bot with random playouts.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every node of a tree is the board after one more placed tile. An iteration
+ * selects a path with UCB1, expands the leaf on its second visit, plays
+ * random placements on a copy of the engine state and backs the reward up.
+ * Batches of iterations run as tasks on the bot's work-stealing pool: all
+ * threads share a tree (tree parallelism), and options.trees independent
+ * trees are searched side by side and merged at the root (root parallelism).
+ * Threads that walk the same path are spread by a virtual loss. Node memory
+ * is a fixed arena per tree and playouts run on stack copies, so the search
+ * does not allocate after botCreate().
+ */
+
+#include "stetris_bot.h"
+
+#include <float.h>                      // for FLT_MAX
+#include <math.h>                       // for sqrtf(), logf(), expf()
+#include <stdlib.h>                     // for malloc(), free()
+
+#define TREE_NODES (1 << 16)            // node arena per tree
+#define PLAYOUT_TILES 8                 // random tiles placed by a playout
+#define BATCH 16                        // iterations per pool task
+#define TASKS_PER_THREAD 4              // tasks per thread and round
+#define EXPLORATION 0.7f                // UCB1 exploration constant
+#define REWARD_SCALE 1000000.0          // fixed point scale of valueSum
+#define REWARD_TEMPERATURE 4.0f         // evaluation difference for a reward of 0.73
+#define MAX_PATH (GRID_X * GRID_Y)      // deepest selection path
+
+enum nodeState
+{
+    NODE_LEAF,                          // not expanded yet
+    NODE_EXPANDING,                     // a thread is creating the children
+    NODE_EXPANDED,                      // firstChild and childCount are valid
+    NODE_TERMINAL,                      // the game is over on this board
+};
+
+typedef struct
+{
+    uint64_t board;                     // board after the tile of this node locked
+    uint64_t valueSum;                  // sum of rewards * REWARD_SCALE (atomic)
+    uint32_t visits;                    // completed iterations through the node (atomic)
+    uint32_t virtualLoss;               // iterations currently in flight (atomic)
+    uint32_t firstChild;                // arena index of the first child
+    uint16_t childCount;
+    uint8_t state;                      // enum nodeState (atomic)
+} mctsNode;
+
+struct mctsTree
+{
+    mctsNode *nodes;                    // node 0 is the root
+    uint32_t used;                      // nodes handed out (atomic)
+};
+
+typedef struct
+{
+    bot *b;
+    engineState origin;                 // decision state, template of all playouts
+    double deadline;                    // botNow() when the search has to stop
+    float baseline;                     // evaluation that maps to a reward of 0.5
+    unsigned int trees;
+    uint64_t seed;                      // decision specific seed of the task generators
+    uint64_t round;                     // poolFor() rounds run so far, each with new generators
+    unsigned long long nodes;           // placements generated (atomic)
+    unsigned long long playouts;        // playouts run (atomic)
+} mctsSearch;
+
+/**
+ * Returns the next value of a task local xorshift64 generator.
+ */
+static inline uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * Allocates one node arena per tree. Returns false on failure.
+ */
+bool mctsCreate(bot *b)
+{
+    b->trees = calloc(b->options.trees, sizeof(mctsTree));
+    if (!b->trees)
+        return false;
+    for (unsigned int i = 0; i < b->options.trees; i++)
+    {
+        b->trees[i].nodes = malloc(sizeof(mctsNode) * TREE_NODES);
+        if (!b->trees[i].nodes)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Frees the node arenas.
+ */
+void mctsDestroy(bot *b)
+{
+    if (!b->trees)
+        return;
+    for (unsigned int i = 0; i < b->options.trees; i++)
+        free(b->trees[i].nodes);
+    free(b->trees);
+    b->trees = NULL;
+}
+
+/**
+ * Initializes an arena node for a board.
+ */
+static inline void initNode(mctsNode *node, uint64_t const board)
+{
+    node->board = board;
+    node->valueSum = 0;
+    node->visits = 0;
+    node->virtualLoss = 0;
+    node->firstChild = 0;
+    node->childCount = 0;
+    node->state = boardOccupied(board, SPAWN_X, 0) ? NODE_TERMINAL : NODE_LEAF;
+}
+
+/**
+ * Picks the child with the highest UCB1 score. Iterations in flight count as
+ * visits with reward 0 (virtual loss), so other threads prefer other paths.
+ */
+static mctsNode *selectChild(mctsTree *t, mctsNode const *parent)
+{
+    mctsNode *const children = &t->nodes[parent->firstChild];
+    float const parentVisits = __atomic_load_n(&parent->visits, __ATOMIC_RELAXED) +
+                               __atomic_load_n(&parent->virtualLoss, __ATOMIC_RELAXED) + 1;
+    float const logParent = logf(parentVisits);
+    mctsNode *best = NULL;
+    float bestScore = -FLT_MAX;
+
+    for (unsigned int i = 0; i < parent->childCount; i++)
+    {
+        mctsNode *const c = &children[i];
+        if (__atomic_load_n(&c->state, __ATOMIC_ACQUIRE) == NODE_TERMINAL)
+            continue;
+        uint32_t const n = __atomic_load_n(&c->visits, __ATOMIC_RELAXED) +
+                           __atomic_load_n(&c->virtualLoss, __ATOMIC_RELAXED);
+        if (n == 0)
+            return c;
+        float const q = __atomic_load_n(&c->valueSum, __ATOMIC_RELAXED) / REWARD_SCALE / n;
+        float const score = q + EXPLORATION * sqrtf(logParent / n);
+        if (score > bestScore)
+        {
+            best = c;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+/**
+ * Creates the children of a leaf: one per placement of a new tile.
+ * Only the thread that wins the LEAF -> EXPANDING transition expands;
+ * if the arena is full the node stays a leaf.
+ */
+static void expand(mctsSearch *m, mctsTree *t, mctsNode *node)
+{
+    uint8_t expected = NODE_LEAF;
+    if (!__atomic_compare_exchange_n(&node->state, &expected, NODE_EXPANDING, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+
+    unsigned int const period = m->origin.nextGameTick;
+    placement moves[MAX_PLACEMENTS];
+    int const n = engineGenPlacements(node->board, SPAWN_X, 0, period, period, moves);
+    __atomic_fetch_add(&m->nodes, n, __ATOMIC_RELAXED);
+
+    uint32_t const first = __atomic_fetch_add(&t->used, n, __ATOMIC_RELAXED);
+    if (n == 0 || first + n > TREE_NODES)
+    {
+        __atomic_store_n(&node->state, n ? NODE_LEAF : NODE_TERMINAL, __ATOMIC_RELEASE);
+        return;
+    }
+    for (int i = 0; i < n; i++)
+        initNode(&t->nodes[first + i], moves[i].board);
+    node->firstChild = first;
+    node->childCount = n;
+    __atomic_store_n(&node->state, NODE_EXPANDED, __ATOMIC_RELEASE);
+}
+
+/**
+ * Plays PLAYOUT_TILES random placements after board on a copy of the
+ * decision state. Returns a reward in [0, 1]; 0 if the game ends.
+ */
+static float playout(mctsSearch *m, uint64_t const board, uint64_t *rng)
+{
+    engineState s = m->origin;
+    placement moves[MAX_PLACEMENTS];
+    unsigned int generated = 0;
+
+    if (!engineSetBoard(&s, board))
+        return 0;
+    for (unsigned int tile = 0; tile < PLAYOUT_TILES; tile++)
+    {
+        int n = engineGenMoves(&s, moves);
+        generated += n;
+
+        // Only consider placements that keep the game running
+        int alive = 0;
+        for (int i = 0; i < n; i++)
+        {
+            if (!boardOccupied(moves[i].board, SPAWN_X, 0))
+                moves[alive++] = moves[i];
+        }
+        if (alive == 0 || !engineApply(&s, &moves[nextRandom(rng) % alive]))
+        {
+            __atomic_fetch_add(&m->nodes, generated, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    __atomic_fetch_add(&m->nodes, generated, __ATOMIC_RELAXED);
+
+    uint64_t const final = s.occupied & ~CELL_MASK(s.activeX, s.activeY);
+    float const value = botEvaluateBoard(m->b, final, s.rows - m->origin.rows);
+    return 1.0f / (1.0f + expf((m->baseline - value) / REWARD_TEMPERATURE));
+}
+
+/**
+ * Runs one select - expand - playout - backup iteration on a tree.
+ */
+static void iterate(mctsSearch *m, mctsTree *t, uint64_t *rng)
+{
+    mctsNode *path[MAX_PATH];
+    unsigned int depth = 0;
+    mctsNode *node = &t->nodes[0];
+
+    path[depth++] = node;
+    __atomic_fetch_add(&node->virtualLoss, 1, __ATOMIC_RELAXED);
+    while (depth < MAX_PATH && __atomic_load_n(&node->state, __ATOMIC_ACQUIRE) == NODE_EXPANDED)
+    {
+        mctsNode *const child = selectChild(t, node);
+        if (!child)
+            break;
+        node = child;
+        path[depth++] = node;
+        __atomic_fetch_add(&node->virtualLoss, 1, __ATOMIC_RELAXED);
+    }
+
+    float reward = 0;
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != NODE_TERMINAL && node != &t->nodes[0])
+    {
+        if (__atomic_load_n(&node->visits, __ATOMIC_RELAXED) > 0)
+            expand(m, t, node);
+        reward = playout(m, node->board, rng);
+        __atomic_fetch_add(&m->playouts, 1, __ATOMIC_RELAXED);
+    }
+
+    uint64_t const scaled = (uint64_t)(reward * REWARD_SCALE);
+    for (unsigned int i = 0; i < depth; i++)
+    {
+        __atomic_fetch_add(&path[i]->valueSum, scaled, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&path[i]->visits, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&path[i]->virtualLoss, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Pool task: runs a batch of iterations on one of the trees. Every task of
+ * the first round runs at least one, so even --budget 0 searches.
+ */
+static void searchTask(void *arg, unsigned int index)
+{
+    mctsSearch *const m = arg;
+    mctsTree *const t = &m->b->trees[index % m->trees];
+    uint64_t rng = m->seed ^ (((m->round << 32) + index + 1) * 0x9E3779B97F4A7C15ULL);
+
+    for (unsigned int i = 0; i < BATCH && ((i == 0 && m->round == 0) || botNow() < m->deadline); i++)
+        iterate(m, t, &rng);
+}
+
+/**
+ * Chooses a placement for the current tile of s by Monte Carlo tree search
+ * within options.budget microseconds. The root children of all trees are the
+ * candidates in the same order; the candidate with most visits summed over
+ * all trees is played. Returns the index of the chosen candidate, or -1.
+ */
+int mctsChoose(bot *b, engineState const *s, placement const *candidates, int n)
+{
+    if (n <= 1)
+        return n - 1;
+
+    mctsSearch m = {
+        .b = b,
+        .origin = *s,
+        .deadline = botNow() + b->options.budget,
+        .trees = b->options.trees,
+        .seed = (b->decisions + 1) * 0xD1B54A32D192ED03ULL,
+    };
+    // Deadly candidates are left out, one -FLT_MAX would drag the mean down
+    int alive = 0;
+    for (int i = 0; i < n; i++)
+    {
+        float const value = botEvaluateBoard(b, candidates[i].board, candidates[i].lines);
+        if (value > -FLT_MAX)
+        {
+            m.baseline += value;
+            alive++;
+        }
+    }
+    m.baseline = alive ? m.baseline / alive : 0;
+    if (m.baseline != m.baseline)
+        m.baseline = 0;
+
+    for (unsigned int i = 0; i < m.trees; i++)
+    {
+        mctsTree *const t = &b->trees[i];
+        initNode(&t->nodes[0], s->occupied);
+        t->nodes[0].state = NODE_EXPANDED;
+        t->nodes[0].firstChild = 1;
+        t->nodes[0].childCount = n;
+        for (int c = 0; c < n; c++)
+            initNode(&t->nodes[1 + c], candidates[c].board);
+        t->used = 1 + n;
+    }
+
+    unsigned int const tasks = poolThreads(b->pool) * TASKS_PER_THREAD * m.trees;
+    do
+    {
+        poolFor(b->pool, searchTask, &m, tasks);
+        m.round++;
+    } while (botNow() < m.deadline);
+
+    int best = -1;
+    unsigned long long bestVisits = 0;
+    for (int c = 0; c < n; c++)
+    {
+        unsigned long long visits = 0;
+        for (unsigned int i = 0; i < m.trees; i++)
+            visits += b->trees[i].nodes[1 + c].visits;
+        if (best < 0 || visits > bestVisits)
+        {
+            best = c;
+            bestVisits = visits;
+        }
+    }
+
+    b->nodes += m.nodes;
+    b->playouts += m.playouts;
+    return best;
+}
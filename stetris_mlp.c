@@ -0,0 +1,329 @@
+/**
+ * @file stetris_mlp.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Small neural network evaluator for the bot boards.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The occupancy inputs are 0 or 1, so the hidden layer is computed by adding
+ * the weight rows of the set bits instead of a full matrix product. The
+ * hidden layer is held in vector registers: 4 AVX2 or 8 SSE/NEON registers
+ * of floats. The AVX2 kernel is compiled with a target attribute and picked
+ * at load time if the CPU supports it, so the Makefile flags stay portable.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() with -std=c99
+
+#include "stetris_mlp.h"
+
+#include <fcntl.h>                      // for open()
+#include <stdio.h>                      // for FILE, fwrite()
+#include <string.h>                     // for memcmp, memcpy
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/stat.h>                   // for fstat()
+#include <unistd.h>                     // for close()
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>                  // for SSE2 and AVX2 intrinsics
+#define MLP_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>                   // for NEON intrinsics
+#endif
+
+#define MLP_FLOATS (MLP_INPUTS * MLP_HIDDEN + MLP_HIDDEN + MLP_HIDDEN + 1)
+#define COLUMN_MASK 0x0101010101010101ULL
+
+// Keeps the hidden layer in registers at -O2 by unrolling the loops over it
+#define UNROLL _Pragma("GCC unroll 8")
+
+/**
+ * Removes full bottom rows like botEvaluate() and computes the column heights.
+ */
+static inline uint64_t prepareBoard(uint64_t board, float heights[GRID_X])
+{
+    while (board && BOTTOM_ROW_FULL(board))
+        board = boardShiftDown(board);
+    for (unsigned int x = 0; x < GRID_X; x++)
+    {
+        uint64_t const column = board & (COLUMN_MASK << x);
+        heights[x] = column ? GRID_Y - __builtin_ctzll(column) / GRID_X : 0;
+    }
+    return board;
+}
+
+static void evaluateScalar(mlpModel const *m, uint64_t const *boards, int n, float *out)
+{
+    for (int i = 0; i < n; i++)
+    {
+        float heights[GRID_X], hidden[MLP_HIDDEN];
+        uint64_t bits = prepareBoard(boards[i], heights);
+
+        memcpy(hidden, m->hiddenBias, sizeof(hidden));
+        for (; bits; bits &= bits - 1)
+        {
+            float const *row = &m->hiddenWeights[__builtin_ctzll(bits) * MLP_HIDDEN];
+            for (int h = 0; h < MLP_HIDDEN; h++)
+                hidden[h] += row[h];
+        }
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            float const *row = &m->hiddenWeights[(GRID_X * GRID_Y + x) * MLP_HIDDEN];
+            for (int h = 0; h < MLP_HIDDEN; h++)
+                hidden[h] += heights[x] * row[h];
+        }
+
+        float value = m->outputBias;
+        for (int h = 0; h < MLP_HIDDEN; h++)
+            value += (hidden[h] > 0 ? hidden[h] : 0) * m->outputWeights[h];
+        out[i] = value;
+    }
+}
+
+#ifdef MLP_X86
+
+static void evaluateSse(mlpModel const *m, uint64_t const *boards, int n, float *out)
+{
+    enum { LANES = 4, REGS = MLP_HIDDEN / LANES };
+    __m128 const zero = _mm_setzero_ps();
+
+    for (int i = 0; i < n; i++)
+    {
+        float heights[GRID_X];
+        uint64_t bits = prepareBoard(boards[i], heights);
+        __m128 acc[REGS];
+
+        UNROLL
+        for (int r = 0; r < REGS; r++)
+            acc[r] = _mm_loadu_ps(&m->hiddenBias[r * LANES]);
+        for (; bits; bits &= bits - 1)
+        {
+            float const *row = &m->hiddenWeights[__builtin_ctzll(bits) * MLP_HIDDEN];
+            UNROLL
+            for (int r = 0; r < REGS; r++)
+                acc[r] = _mm_add_ps(acc[r], _mm_loadu_ps(&row[r * LANES]));
+        }
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            float const *row = &m->hiddenWeights[(GRID_X * GRID_Y + x) * MLP_HIDDEN];
+            __m128 const h = _mm_set1_ps(heights[x]);
+            UNROLL
+            for (int r = 0; r < REGS; r++)
+                acc[r] = _mm_add_ps(acc[r], _mm_mul_ps(h, _mm_loadu_ps(&row[r * LANES])));
+        }
+
+        __m128 sum = zero;
+        UNROLL
+        for (int r = 0; r < REGS; r++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_max_ps(acc[r], zero), _mm_loadu_ps(&m->outputWeights[r * LANES])));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        out[i] = _mm_cvtss_f32(sum) + m->outputBias;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void evaluateAvx2(mlpModel const *m, uint64_t const *boards, int n, float *out)
+{
+    enum { LANES = 8, REGS = MLP_HIDDEN / LANES };
+    __m256 const zero = _mm256_setzero_ps();
+
+    for (int i = 0; i < n; i++)
+    {
+        float heights[GRID_X];
+        uint64_t bits = prepareBoard(boards[i], heights);
+        __m256 acc[REGS];
+
+        UNROLL
+        for (int r = 0; r < REGS; r++)
+            acc[r] = _mm256_loadu_ps(&m->hiddenBias[r * LANES]);
+        for (; bits; bits &= bits - 1)
+        {
+            float const *row = &m->hiddenWeights[__builtin_ctzll(bits) * MLP_HIDDEN];
+            UNROLL
+            for (int r = 0; r < REGS; r++)
+                acc[r] = _mm256_add_ps(acc[r], _mm256_loadu_ps(&row[r * LANES]));
+        }
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            float const *row = &m->hiddenWeights[(GRID_X * GRID_Y + x) * MLP_HIDDEN];
+            __m256 const h = _mm256_set1_ps(heights[x]);
+            UNROLL
+            for (int r = 0; r < REGS; r++)
+                acc[r] = _mm256_fmadd_ps(h, _mm256_loadu_ps(&row[r * LANES]), acc[r]);
+        }
+
+        __m256 sum = zero;
+        UNROLL
+        for (int r = 0; r < REGS; r++)
+            sum = _mm256_fmadd_ps(_mm256_max_ps(acc[r], zero), _mm256_loadu_ps(&m->outputWeights[r * LANES]), sum);
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        out[i] = _mm_cvtss_f32(s) + m->outputBias;
+    }
+}
+
+#elif defined(__ARM_NEON)
+
+static void evaluateNeon(mlpModel const *m, uint64_t const *boards, int n, float *out)
+{
+    enum { LANES = 4, REGS = MLP_HIDDEN / LANES };
+    float32x4_t const zero = vdupq_n_f32(0);
+
+    for (int i = 0; i < n; i++)
+    {
+        float heights[GRID_X];
+        uint64_t bits = prepareBoard(boards[i], heights);
+        float32x4_t acc[REGS];
+
+        UNROLL
+        for (int r = 0; r < REGS; r++)
+            acc[r] = vld1q_f32(&m->hiddenBias[r * LANES]);
+        for (; bits; bits &= bits - 1)
+        {
+            float const *row = &m->hiddenWeights[__builtin_ctzll(bits) * MLP_HIDDEN];
+            UNROLL
+            for (int r = 0; r < REGS; r++)
+                acc[r] = vaddq_f32(acc[r], vld1q_f32(&row[r * LANES]));
+        }
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            float const *row = &m->hiddenWeights[(GRID_X * GRID_Y + x) * MLP_HIDDEN];
+            UNROLL
+            for (int r = 0; r < REGS; r++)
+                acc[r] = vmlaq_n_f32(acc[r], vld1q_f32(&row[r * LANES]), heights[x]);
+        }
+
+        float32x4_t sum = zero;
+        UNROLL
+        for (int r = 0; r < REGS; r++)
+            sum = vmlaq_f32(sum, vmaxq_f32(acc[r], zero), vld1q_f32(&m->outputWeights[r * LANES]));
+        float32x2_t const half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        out[i] = vget_lane_f32(vpadd_f32(half, half), 0) + m->outputBias;
+    }
+}
+
+#endif
+
+/**
+ * Maps a weights file and selects the inference kernel.
+ * Returns false if the file cannot be mapped or has the wrong shape.
+ */
+bool mlpLoad(mlpModel *m, char const *path)
+{
+    memset(m, 0, sizeof(*m));
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    size_t const expected = sizeof(mlpHeader) + MLP_FLOATS * sizeof(float);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != expected)
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    mlpHeader const *header = map;
+    if (memcmp(header->magic, MLP_MAGIC, sizeof(header->magic)) != 0 || header->version != MLP_VERSION ||
+        header->inputs != MLP_INPUTS || header->hidden != MLP_HIDDEN)
+    {
+        munmap(map, expected);
+        return false;
+    }
+
+    float const *weights = (float const *)(header + 1);
+    m->map = map;
+    m->size = expected;
+    m->hiddenWeights = weights;
+    m->hiddenBias = weights + MLP_INPUTS * MLP_HIDDEN;
+    m->outputWeights = m->hiddenBias + MLP_HIDDEN;
+    m->outputBias = m->outputWeights[MLP_HIDDEN];
+
+    m->kernel = evaluateScalar;
+    m->kernelName = "scalar";
+#ifdef MLP_X86
+    m->kernel = evaluateSse;
+    m->kernelName = "sse";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        m->kernel = evaluateAvx2;
+        m->kernelName = "avx2";
+    }
+#elif defined(__ARM_NEON)
+    m->kernel = evaluateNeon;
+    m->kernelName = "neon";
+#endif
+    return true;
+}
+
+void mlpUnload(mlpModel *m)
+{
+    if (m->map)
+        munmap(m->map, m->size);
+    m->map = NULL;
+}
+
+/**
+ * Evaluates a batch of boards; full bottom rows are removed first.
+ */
+void mlpEvaluate(mlpModel const *m, uint64_t const *boards, int n, float *out)
+{
+    m->kernel(m, boards, n, out);
+}
+
+/**
+ * Writes a network that computes the linear heuristic of botEvaluate()
+ * without the lines term, as a starting point for training.
+ * Holes are the free cells below the column tops, which is the sum of the
+ * heights minus the occupied cells, so height and holes form one linear
+ * term; it and every height difference take two ReLU units each.
+ * Returns false if the file cannot be written.
+ */
+bool mlpWriteLinear(char const *path, float heightWeight, float holeWeight, float bumpinessWeight)
+{
+    static float w[MLP_FLOATS];
+    float *hidden = w, *output = w + MLP_INPUTS * MLP_HIDDEN + MLP_HIDDEN;
+    mlpHeader header = {.version = MLP_VERSION, .inputs = MLP_INPUTS, .hidden = MLP_HIDDEN};
+
+    memcpy(header.magic, MLP_MAGIC, sizeof(header.magic));
+    memset(w, 0, sizeof(w));
+
+    // Units 0 and 1: +-(heightWeight * heights + holeWeight * (heights - cells))
+    for (unsigned int i = 0; i < GRID_X * GRID_Y; i++)
+    {
+        hidden[i * MLP_HIDDEN + 0] = -holeWeight;
+        hidden[i * MLP_HIDDEN + 1] = holeWeight;
+    }
+    for (unsigned int x = 0; x < GRID_X; x++)
+    {
+        float *row = &hidden[(GRID_X * GRID_Y + x) * MLP_HIDDEN];
+        row[0] = heightWeight + holeWeight;
+        row[1] = -(heightWeight + holeWeight);
+    }
+    output[0] = 1;
+    output[1] = -1;
+
+    // Units 2 + 2x and 3 + 2x: +-(heights[x + 1] - heights[x])
+    for (unsigned int x = 0; x + 1 < GRID_X; x++)
+    {
+        unsigned int const unit = 2 + 2 * x;
+        hidden[(GRID_X * GRID_Y + x + 1) * MLP_HIDDEN + unit] = 1;
+        hidden[(GRID_X * GRID_Y + x) * MLP_HIDDEN + unit] = -1;
+        hidden[(GRID_X * GRID_Y + x + 1) * MLP_HIDDEN + unit + 1] = -1;
+        hidden[(GRID_X * GRID_Y + x) * MLP_HIDDEN + unit + 1] = 1;
+        output[unit] = bumpinessWeight;
+        output[unit + 1] = bumpinessWeight;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool const ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(w, sizeof(w), 1, f) == 1;
+    return (fclose(f) == 0) && ok;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file stetris_mlp.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Small neural network evaluator for the bot boards.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A fixed size multilayer perceptron with one ReLU hidden layer. Its inputs
+ * are the 64 occupancy bits and the 8 column heights of a board. Weights are
+ * mapped read-only from a flat binary file:
+ *   mlpHeader, then little endian floats
+ *   hidden weights [MLP_INPUTS][MLP_HIDDEN], hidden bias [MLP_HIDDEN],
+ *   output weights [MLP_HIDDEN], output bias.
+ */
+
+#ifndef STETRIS_MLP_H
+#define STETRIS_MLP_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for uint64_t, uint32_t
+
+#include "stetris_engine.h"
+
+#define MLP_MAGIC "SMLP"
+#define MLP_VERSION 1
+#define MLP_INPUTS (GRID_X * GRID_Y + GRID_X)   // occupancy bits, then column heights
+#define MLP_HIDDEN 32
+
+typedef struct
+{
+    char magic[4];                      // MLP_MAGIC
+    uint32_t version;                   // MLP_VERSION
+    uint32_t inputs;                    // MLP_INPUTS
+    uint32_t hidden;                    // MLP_HIDDEN
+} mlpHeader;
+
+typedef struct mlpModel mlpModel;
+
+/**
+ * Inference kernel: evaluates n boards into out.
+ */
+typedef void (*mlpKernel)(mlpModel const *m, uint64_t const *boards, int n, float *out);
+
+struct mlpModel
+{
+    void *map;                          // mapped weights file
+    size_t size;
+    float const *hiddenWeights;         // [MLP_INPUTS][MLP_HIDDEN]
+    float const *hiddenBias;            // [MLP_HIDDEN]
+    float const *outputWeights;         // [MLP_HIDDEN]
+    float outputBias;
+    mlpKernel kernel;                   // fastest inference kernel of this CPU
+    char const *kernelName;
+};
+
+bool mlpLoad(mlpModel *m, char const *path);
+void mlpUnload(mlpModel *m);
+void mlpEvaluate(mlpModel const *m, uint64_t const *boards, int n, float *out);
+bool mlpWriteLinear(char const *path, float heightWeight, float holeWeight, float bumpinessWeight);
+
+#endif // STETRIS_MLP_H
@@ -0,0 +1,141 @@
+/**
+ * @file stetris_observe.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Example reader of the game states published with --publish.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Follows the ring of a game or simulation started with --publish FILE,
+ * as an external agent would, for
+ *   ./stetris_console --publish /dev/shm/stetris &
+ *   ./stetris_observe --ring /dev/shm/stetris --show
+ * Every second it prints the frames read per second, the frames lost by
+ * falling a ring behind and the reads torn by a publisher overwriting the
+ * slot. --show draws the board of every frame instead. It stops after
+ * --frames frames or when nothing is published for --timeout milliseconds.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_gettime() with -std=c99
+
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for exit()
+#include <string.h>                     // for strcmp
+#include <time.h>                       // for clock_gettime()
+
+#include "stetris_shm.h"
+#include "stetris_args.h"
+
+typedef struct
+{
+    char const *ring;                   // ring file of the publisher
+    unsigned long frames;               // frames to read, 0 for no limit
+    int timeout;                        // milliseconds without a frame before stopping
+    bool show;                          // draw every frame
+} observeOptions;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--ring FILE] [--frames N] [--timeout MS] [--show]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static double secondsNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Draws the board of a copied slot, # for settled cells and @ for the
+ * active tile.
+ */
+static void showFrame(shmSlot const *f)
+{
+    uint64_t const active = (f->state & ACTIVE) ? CELL_MASK(f->activeX, f->activeY) : 0;
+
+    printf("game %u  tiles %u  rows %u  score %u  level %u  tick %u/%u\n",
+           f->game, f->tiles, f->rows, f->score, f->level, f->tick, f->nextGameTick);
+    for (unsigned int y = 0; y < GRID_Y; y++)
+    {
+        for (unsigned int x = 0; x < GRID_X; x++)
+        {
+            uint64_t const cell = CELL_MASK(x, y);
+            putchar((active & cell) ? '@' : (f->occupied & cell) ? '#' : '.');
+        }
+        putchar('\n');
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    observeOptions opt = {
+        .ring = "/dev/shm/stetris",
+        .frames = 0,
+        .timeout = 5000,
+        .show = false,
+    };
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--ring") == 0)
+            opt.ring = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--frames") == 0)
+            opt.frames = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--timeout") == 0)
+            opt.timeout = (int)parseNumberArg(argv[++i], INT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--show") == 0)
+            opt.show = true;
+        else
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+
+    shmRing ring;
+    if (!shmAttach(&ring, opt.ring))
+    {
+        fprintf(stderr, "ERROR: could not attach to the ring in %s\n", opt.ring);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long read = 0, torn = 0, lastRead = 0;
+    uint32_t lost = 0, lastLost = 0;
+    double last = secondsNow();
+    while (opt.frames == 0 || read < opt.frames)
+    {
+        shmSlot const *slot = shmNext(&ring, opt.timeout, &lost);
+        if (!slot)
+            break;
+
+        // The slot is read in place; a copy is only needed to keep it
+        shmSlot frame = *slot;
+        if (!shmValid(&ring, slot))
+        {
+            torn++;
+            continue;
+        }
+        read++;
+        if (opt.show)
+            showFrame(&frame);
+
+        double const now = secondsNow();
+        if (!opt.show && now - last >= 1.0)
+        {
+            printf("%10.0f frames/s  %8u lost  %8lu torn\n", (read - lastRead) / (now - last), lost - lastLost, torn);
+            last = now;
+            lastRead = read;
+            lastLost = lost;
+        }
+    }
+    printf("Frames:       %10lu\n", read);
+    printf("Lost:         %10u\n", lost);
+    printf("Torn:         %10lu\n", torn);
+    shmDetach(&ring);
+    return EXIT_SUCCESS;
+}
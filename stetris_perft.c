@@ -0,0 +1,297 @@
+/**
+ * @file stetris_perft.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Perft for the placement generator: counts placement sequences to depth D.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Like perft in chess engines, the tool walks the tree of all placements
+ * of the following tiles and counts its leaves for every depth up to
+ * --depth, which both benchmarks engineGenPlacements() and, compared with
+ * known counts, catches changes to its results. A placement that ends the
+ * game is a leaf. The fall speed is fixed at --period for the whole tree.
+ * --divide prints the count below every placement of the first tile.
+ * --verify checks every generated node against a reference that plays all
+ * key sequences through engineStep() until the next tile spawns.
+ */
+
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for qsort(), exit()
+#include <string.h>                     // for strcmp, memset
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_args.h"
+
+#define MAX_DEPTH 16
+#define REFERENCE_SLOTS 32768           // states of one tile seen by the reference, power of two
+
+typedef struct
+{
+    unsigned int depth;                 // deepest tile counted
+    unsigned int period;                // nextGameTick of every tile
+    uint64_t board;                     // settled board the first tile spawns on
+    unsigned int threads;               // 0 for one per CPU
+    bool divide;                        // counts per placement of the first tile
+    bool verify;                        // compare with the engineStep() reference
+} perftOptions;
+
+/**
+ * Subtrees of the placements of the first tile, counted in parallel.
+ */
+typedef struct
+{
+    perftOptions const *opt;
+    placement const *roots;
+    unsigned int depth;
+    unsigned long long leaves[MAX_PLACEMENTS];
+    unsigned long long generated;       // placements generated (atomic)
+    unsigned long long mismatches;      // nodes where --verify failed (atomic)
+} perftRun;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--depth D] [--period P] [--board HEX | --garbage ROWS --seed S] [--threads N]"
+                    " [--divide] [--verify]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Returns a state with a tile just spawned on board at the given speed.
+ */
+static engineState spawnOn(uint64_t board, unsigned int period)
+{
+    engineState s;
+    engineInit(&s, 1);
+    engineNewGame(&s);
+    s.nextGameTick = period;
+    engineSetBoard(&s, board);
+    return s;
+}
+
+static uint64_t stateKey(engineState const *s)
+{
+    uint64_t k = s->occupied ^ ((uint64_t)s->activeX << 3 | s->activeY | (uint64_t)s->tick << 6) * 0x9E3779B97F4A7C15ULL;
+    return k ^ (k >> 29) ^ ((uint64_t)s->nextGameTick << 40);
+}
+
+static int compareBoards(void const *x, void const *y)
+{
+    uint64_t const a = *(uint64_t const *)x, b = *(uint64_t const *)y;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Reference generator: searches all key sequences from s breadth-first with
+ * engineStep() until a new tile spawns, and writes the distinct settled
+ * boards the next tile spawns on, sorted. Sequences that end the game are
+ * left out, since the restart that follows wipes the board.
+ * Returns the number of boards.
+ */
+static int referenceMoves(engineState const *s, uint64_t *out)
+{
+    static __thread engineState queue[REFERENCE_SLOTS];
+    static __thread uint64_t seen[REFERENCE_SLOTS];
+    static int const keys[] = {0, KEY_LEFT, KEY_RIGHT, KEY_DOWN};
+    unsigned int head = 0, tail = 0;
+    int n = 0;
+
+    memset(seen, 0, sizeof(seen));
+    queue[tail] = *s;
+    queue[tail++].tiles = UINT32_MAX / 2;   // so a restart, which counts from 0, shows as fewer tiles
+    while (head < tail)
+    {
+        engineState const current = queue[head++];
+        for (unsigned int k = 0; k < sizeof(keys) / sizeof(keys[0]); k++)
+        {
+            engineState t = current;
+            engineStep(&t, keys[k]);
+            if (t.state == GAMEOVER || t.tiles < current.tiles)
+                continue;
+            if (t.tiles != current.tiles)
+            {
+                uint64_t const board = t.occupied & ~CELL_MASK(t.activeX, t.activeY);
+                bool known = false;
+                for (int i = 0; i < n && !known; i++)
+                    known = out[i] == board;
+                if (!known)
+                    out[n++] = board;
+                continue;
+            }
+
+            // Open addressing on the state key; 0 marks a free slot
+            uint64_t const key = stateKey(&t) | 1;
+            unsigned int slot = (unsigned int)(key >> 17) & (REFERENCE_SLOTS - 1);
+            while (seen[slot] && seen[slot] != key)
+                slot = (slot + 1) & (REFERENCE_SLOTS - 1);
+            if (!seen[slot] && tail < REFERENCE_SLOTS)
+            {
+                seen[slot] = key;
+                queue[tail++] = t;
+            }
+        }
+    }
+    qsort(out, n, sizeof(uint64_t), compareBoards);
+    return n;
+}
+
+/**
+ * Compares the placements generated for a tile spawned on board with the
+ * reference. Returns false and prints both lists if they differ.
+ */
+static bool verifyNode(uint64_t board, unsigned int period, placement const *moves, int n)
+{
+    uint64_t generated[MAX_PLACEMENTS], reference[MAX_PLACEMENTS * 4];
+    int live = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (!boardOccupied(moves[i].board, SPAWN_X, 0))
+            generated[live++] = moves[i].board;
+    }
+    qsort(generated, live, sizeof(uint64_t), compareBoards);
+
+    engineState const s = spawnOn(board, period);
+    int const expected = referenceMoves(&s, reference);
+    if (expected == live && memcmp(generated, reference, sizeof(uint64_t) * live) == 0)
+        return true;
+
+    fprintf(stderr, "Mismatch on board 0x%016llx:\n  generated:", (unsigned long long)board);
+    for (int i = 0; i < live; i++)
+        fprintf(stderr, " %016llx", (unsigned long long)generated[i]);
+    fprintf(stderr, "\n  reference:");
+    for (int i = 0; i < expected; i++)
+        fprintf(stderr, " %016llx", (unsigned long long)reference[i]);
+    fprintf(stderr, "\n");
+    return false;
+}
+
+/**
+ * Counts the placement sequences of depth tiles from a tile spawned on board.
+ * The last tile is counted without generating the tiles below it (bulk
+ * counting), unless every node is verified.
+ */
+static unsigned long long perft(perftRun *r, uint64_t board, unsigned int depth)
+{
+    placement moves[MAX_PLACEMENTS];
+    unsigned int const period = r->opt->period;
+
+    if (depth == 0)
+        return 1;
+    int const n = engineGenPlacements(board, SPAWN_X, 0, period, period, moves);
+    __atomic_fetch_add(&r->generated, n, __ATOMIC_RELAXED);
+    if (r->opt->verify && !verifyNode(board, period, moves, n))
+        __atomic_fetch_add(&r->mismatches, 1, __ATOMIC_RELAXED);
+    if (depth == 1)
+        return n;
+
+    unsigned long long leaves = 0;
+    for (int i = 0; i < n; i++)
+    {
+        // A placement that blocks the spawn cell ends the game
+        leaves += boardOccupied(moves[i].board, SPAWN_X, 0) ? 1 : perft(r, moves[i].board, depth - 1);
+    }
+    return leaves;
+}
+
+static void rootTask(void *arg, unsigned int index)
+{
+    perftRun *r = arg;
+    uint64_t const board = r->roots[index].board;
+    r->leaves[index] = boardOccupied(board, SPAWN_X, 0) ? 1 : perft(r, board, r->depth - 1);
+}
+
+
+int main(int argc, char **argv)
+{
+    perftOptions opt = {
+        .depth = 5,
+        .period = 50,
+        .board = 0,
+        .threads = 0,
+    };
+    unsigned long garbage = 0, seed = 1;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--divide") == 0)
+            opt.divide = true;
+        else if (strcmp(argv[i], "--verify") == 0)
+            opt.verify = true;
+        else if (i + 1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "--depth") == 0)
+            opt.depth = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--period") == 0)
+            opt.period = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--board") == 0)
+            opt.board = parseNumberArg(argv[++i], UINT64_MAX, 16, &ok);
+        else if (strcmp(argv[i], "--garbage") == 0)
+            garbage = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--seed") == 0)
+            seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (garbage)
+        opt.board = engineGarbageBoard((uint32_t)seed, (unsigned int)garbage);
+    if (opt.depth == 0 || opt.depth > MAX_DEPTH || opt.period == 0 || boardOccupied(opt.board, SPAWN_X, 0))
+        usage(argv[0]);
+
+    threadPool *pool = poolCreate(opt.threads);
+    if (!pool)
+    {
+        fprintf(stderr, "ERROR: could not start the perft threads\n");
+        return EXIT_FAILURE;
+    }
+    printf("Perft from board 0x%016llx at period %u on %u threads\n", (unsigned long long)opt.board, opt.period,
+           poolThreads(pool));
+
+    // The first tile comes from engineGenMoves() on a real game state
+    engineState const root = spawnOn(opt.board, opt.period);
+    placement roots[MAX_PLACEMENTS];
+    int const n = engineGenMoves(&root, roots);
+    unsigned long long mismatches = 0;
+
+    for (unsigned int depth = 1; depth <= opt.depth; depth++)
+    {
+        perftRun run = {.opt = &opt, .roots = roots, .depth = depth, .generated = n};
+        if (opt.verify && !verifyNode(opt.board, opt.period, roots, n))
+            run.mismatches++;
+
+        double const start = botNow();
+        unsigned long long leaves = n;
+        if (depth > 1)
+        {
+            poolFor(pool, rootTask, &run, n);
+            leaves = 0;
+            for (int i = 0; i < n; i++)
+                leaves += run.leaves[i];
+        }
+        double const seconds = (botNow() - start) / 1e6;
+        printf("Depth %2u: %16llu leaves %9.3f s %8.2f M placements/s\n", depth, leaves, seconds,
+               seconds > 0 ? run.generated / seconds / 1e6 : 0.0);
+        mismatches += run.mismatches;
+
+        if (opt.divide && depth == opt.depth)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                printf("  (%u,%u)%s %llu\n", roots[i].x, roots[i].y, roots[i].orphan ? " orphan" : "",
+                       depth > 1 ? run.leaves[i] : 1ULL);
+            }
+        }
+    }
+    poolDestroy(pool);
+
+    if (opt.verify)
+        printf("Verify:   %16llu mismatches\n", mismatches);
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
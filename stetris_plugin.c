@@ -0,0 +1,157 @@
+/**
+ * @file stetris_plugin.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Host side of bots loaded as shared objects (--bot-plugin).
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The plugin is loaded with dlopen() and called directly in the game
+ * process, so a decision costs a function call instead of a round trip to
+ * another process. Games waiting for a decision are passed to the plugin
+ * in one batch; their input sequences are then replayed one key per tick.
+ */
+
+#include "stetris_bot.h"
+
+#include <dlfcn.h>                      // for dlopen(), dlsym(), dlclose()
+#include <stdio.h>                      // for fprintf()
+
+// Linux key codes of enum stetrisKey
+static int const pluginKeys[] = {0, KEY_LEFT, KEY_RIGHT, KEY_DOWN};
+
+/**
+ * Loads options.pluginFile and creates the plugin's bot instance.
+ * Returns false and prints the reason if that fails.
+ */
+bool pluginOpen(bot *b)
+{
+    char const *path = b->options.pluginFile;
+
+    b->pluginHandle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!b->pluginHandle)
+    {
+        fprintf(stderr, "ERROR: could not load bot plugin: %s\n", dlerror());
+        return false;
+    }
+
+    // Object to function pointer conversion through a union, as dlsym() requires
+    union
+    {
+        void *object;
+        stetrisPluginEntryFunction entry;
+    } symbol = {.object = dlsym(b->pluginHandle, STETRIS_PLUGIN_ENTRY)};
+    b->plugin = symbol.object ? symbol.entry() : NULL;
+    if (!b->plugin || b->plugin->abi != STETRIS_PLUGIN_ABI || !b->plugin->create || !b->plugin->decide)
+    {
+        fprintf(stderr, "ERROR: %s is not a bot plugin for interface version %d\n", path, STETRIS_PLUGIN_ABI);
+        pluginClose(b);
+        return false;
+    }
+
+    b->pluginBot = b->plugin->create(b->options.pluginArgs);
+    if (!b->pluginBot)
+    {
+        fprintf(stderr, "ERROR: bot plugin %s failed to start\n", b->plugin->name);
+        pluginClose(b);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Destroys the plugin's bot instance and unloads the plugin.
+ */
+void pluginClose(bot *b)
+{
+    if (b->pluginBot && b->plugin->destroy)
+        b->plugin->destroy(b->pluginBot);
+    if (b->pluginHandle)
+        dlclose(b->pluginHandle);
+    b->pluginBot = NULL;
+    b->plugin = NULL;
+    b->pluginHandle = NULL;
+}
+
+/**
+ * Asks the plugin for the input sequences of n games in one call.
+ * Game i is states[index[i]] with the replay state games[index[i]], and is
+ * identified to the plugin by index[i].
+ */
+void pluginDecide(bot *b, engineState const *states, pluginGame *games, uint32_t const *index, unsigned int n)
+{
+    stetrisSnapshot snapshots[PLUGIN_BATCH];
+    stetrisInput inputs[PLUGIN_BATCH];
+
+    for (unsigned int first = 0; first < n; first += PLUGIN_BATCH)
+    {
+        unsigned int const count = (n - first < PLUGIN_BATCH) ? n - first : PLUGIN_BATCH;
+        double const start = botNow();
+        uint64_t const deadline = (uint64_t)start + b->options.budget;
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            engineState const *s = &states[index[first + i]];
+            snapshots[i] = (stetrisSnapshot){
+                .board = s->occupied & ~CELL_MASK(s->activeX, s->activeY),
+                .activeX = s->activeX,
+                .activeY = s->activeY,
+                .keysToGravity = engineKeysToGravity(s),
+                .period = s->nextGameTick,
+                .game = index[first + i],
+                .tiles = s->tiles,
+                .rows = s->rows,
+                .score = s->score,
+                .level = s->level,
+                .deadline = deadline,
+            };
+            inputs[i].length = 0;
+        }
+        b->plugin->decide(b->pluginBot, count, snapshots, inputs);
+
+        double const end = botNow();
+        if (end > deadline)
+            b->lateDecisions += count;
+        b->uSecSearching += end - start;
+        b->decisions += count;
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            pluginGame *g = &games[index[first + i]];
+            g->input = inputs[i];
+            if (g->input.length > STETRIS_MAX_INPUT)
+                g->input.length = STETRIS_MAX_INPUT;
+            g->position = 0;
+            g->tiles = states[index[first + i]].tiles;
+            g->planned = true;
+        }
+    }
+}
+
+/**
+ * Returns true if the game needs a new input sequence before its next key.
+ */
+bool pluginNeedsDecision(pluginGame const *g, engineState const *s)
+{
+    return s->state != GAMEOVER && (!g->planned || g->tiles != s->tiles);
+}
+
+/**
+ * Returns the next key of the game's input sequence, or 0 when it is used up.
+ */
+int pluginNextKey(pluginGame *g)
+{
+    if (g->position >= g->input.length)
+        return 0;
+    uint8_t const key = g->input.keys[g->position++];
+    return (key < sizeof(pluginKeys) / sizeof(pluginKeys[0])) ? pluginKeys[key] : 0;
+}
+
+/**
+ * Tells the plugin that the game with this id has ended.
+ */
+void pluginEndGame(bot *b, pluginGame *g, uint32_t id)
+{
+    if (g->planned && b->plugin->endGame)
+        b->plugin->endGame(b->pluginBot, id);
+    g->planned = false;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file stetris_plugin.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Stable C interface of bots loaded as shared objects.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A plugin is a shared object exporting STETRIS_PLUGIN_ENTRY, which returns
+ * a stetrisPlugin table. This header is all a plugin needs; it does not
+ * depend on the game engine, and only fields at the end of the structs
+ * are ever added, together with a new STETRIS_PLUGIN_ABI.
+ *
+ * Build a plugin with:  gcc -shared -fPIC -o mybot.so mybot.c
+ * and load it with:     --bot-plugin ./mybot.so
+ */
+
+#ifndef STETRIS_PLUGIN_H
+#define STETRIS_PLUGIN_H
+
+#include <stdint.h>                     // for fixed width integer types
+
+#define STETRIS_PLUGIN_ABI 1
+#define STETRIS_PLUGIN_ENTRY "stetrisPluginEntry"
+#define STETRIS_MAX_INPUT 64            // keys in one input sequence
+
+/**
+ * Keys of an input sequence, one per game tick.
+ */
+enum stetrisKey
+{
+    STETRIS_KEY_NONE,                   // wait for one tick
+    STETRIS_KEY_LEFT,
+    STETRIS_KEY_RIGHT,
+    STETRIS_KEY_DOWN,                   // hard drop
+};
+
+/**
+ * Game state at the moment a new tile appeared. The playfield is 8x8; bit
+ * (y * 8 + x) of a board is the cell at column x, row y, with row 0 at the top.
+ */
+typedef struct
+{
+    uint64_t board;                     // settled tiles, without the active tile
+    uint8_t activeX;                    // new tile
+    uint8_t activeY;
+    uint8_t keysToGravity;              // keys until the tile falls one row
+    uint8_t period;                     // keys per row after that; hosts refuse start periods above 255
+    uint32_t game;                      // id of the game, stable until it ends
+    uint32_t tiles;                     // tiles played, including the new one
+    uint32_t rows;                      // rows cleared
+    uint32_t score;
+    uint32_t level;
+    uint64_t deadline;                  // CLOCK_MONOTONIC microseconds to return by
+} stetrisSnapshot;
+
+/**
+ * Keys to press in the following ticks. Keys left over when the tile locks
+ * are dropped; after the last key the host presses nothing.
+ */
+typedef struct
+{
+    uint8_t length;
+    uint8_t keys[STETRIS_MAX_INPUT];    // enum stetrisKey
+} stetrisInput;
+
+typedef struct
+{
+    uint32_t abi;                       // STETRIS_PLUGIN_ABI the plugin was built with
+    char const *name;
+
+    // Creates a bot instance; args is the --plugin-args string or NULL
+    void *(*create)(char const *args);
+    void (*destroy)(void *bot);
+
+    // New piece callback: fills inputs[i] for the games of snapshots[i].
+    // The host batches all games waiting for a decision into one call.
+    void (*decide)(void *bot, uint32_t count, stetrisSnapshot const *snapshots, stetrisInput *inputs);
+
+    // Optional, may be NULL: the game with this id has ended
+    void (*endGame)(void *bot, uint32_t game);
+} stetrisPlugin;
+
+// Exported by every plugin under the name STETRIS_PLUGIN_ENTRY
+stetrisPlugin const *stetrisPluginEntry(void);
+typedef stetrisPlugin const *(*stetrisPluginEntryFunction)(void);
+
+#endif // STETRIS_PLUGIN_H
@@ -0,0 +1,93 @@
+/**
+ * @file stetris_plugin_example.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Example bot plugin: drops every tile into the lowest column.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Shows the plugin interface of stetris_plugin.h without using the game
+ * engine. Build it with "make plugins" and run it with
+ *   ./stetris_sim --bot-plugin ./stetris_plugin_example.so
+ * Passing --plugin-args right makes it prefer the rightmost of equally low
+ * columns instead of the one closest to the tile.
+ */
+
+#include <stdlib.h>                     // for calloc(), free()
+#include <string.h>                     // for strcmp
+
+#include "stetris_plugin.h"
+
+#define GRID_X 8
+#define GRID_Y 8
+
+typedef struct
+{
+    int preferRight;                    // break ties towards the right wall
+} exampleBot;
+
+static void *create(char const *args)
+{
+    exampleBot *bot = calloc(1, sizeof(*bot));
+    if (bot && args && strcmp(args, "right") == 0)
+        bot->preferRight = 1;
+    return bot;
+}
+
+static void destroy(void *bot)
+{
+    free(bot);
+}
+
+/**
+ * Returns the number of occupied cells from the top of column x to the floor.
+ */
+static int columnHeight(uint64_t board, int x)
+{
+    for (int y = 0; y < GRID_Y; y++)
+    {
+        if (board & ((uint64_t)1 << (y * GRID_X + x)))
+            return GRID_Y - y;
+    }
+    return 0;
+}
+
+static void decide(void *arg, uint32_t count, stetrisSnapshot const *snapshots, stetrisInput *inputs)
+{
+    exampleBot const *bot = arg;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        stetrisSnapshot const *s = &snapshots[i];
+        int target = s->activeX, best = GRID_Y + 1;
+        for (int x = 0; x < GRID_X; x++)
+        {
+            int const height = columnHeight(s->board, x);
+            int const distance = abs(x - s->activeX), bestDistance = abs(target - s->activeX);
+            if (height < best || (height == best && (bot->preferRight ? x > target : distance < bestDistance)))
+            {
+                target = x;
+                best = height;
+            }
+        }
+
+        stetrisInput *in = &inputs[i];
+        in->length = 0;
+        for (int x = s->activeX; x != target; x += (target > x) ? 1 : -1)
+            in->keys[in->length++] = (target > x) ? STETRIS_KEY_RIGHT : STETRIS_KEY_LEFT;
+        in->keys[in->length++] = STETRIS_KEY_DOWN;
+    }
+}
+
+static stetrisPlugin const plugin = {
+    .abi = STETRIS_PLUGIN_ABI,
+    .name = "lowest column example",
+    .create = create,
+    .destroy = destroy,
+    .decide = decide,
+    .endGame = NULL,
+};
+
+stetrisPlugin const *stetrisPluginEntry(void)
+{
+    return &plugin;
+}
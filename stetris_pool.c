@@ -0,0 +1,294 @@
+/**
+ * @file stetris_pool.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Minimal work-stealing pthread pool for parallel loops in the search bots.
+ * @version 1.1
+ * This file is part of the Stetris project.
+ * poolFor() splits the loop into one index range per thread, publishes it
+ * as a new generation, wakes the workers and takes part in it from the
+ * calling thread. A thread takes indices from the front of its own range;
+ * when it runs dry it steals the upper half of the largest other range.
+ * Ranges are packed into one 64 bit word (begin << 32 | end), so taking
+ * and stealing are single compare-and-swap operations.
+ */
+
+#define _GNU_SOURCE                     // Enables sysconf(_SC_NPROCESSORS_ONLN)
+
+#include "stetris_pool.h"
+
+#include <pthread.h>                    // for threads, mutex and condition variables
+#include <stdbool.h>                    // for bool type
+#include <stdint.h>                     // for uint64_t
+#include <stdlib.h>                     // for calloc(), free()
+#include <time.h>                       // for clock_gettime()
+#include <unistd.h>                     // for sysconf()
+
+#define CACHE_LINE 64
+
+/**
+ * Index range owned by one thread, padded to its own cache line.
+ */
+typedef struct
+{
+    uint64_t range;                     // begin << 32 | end, accessed atomically
+    char pad[CACHE_LINE - sizeof(uint64_t)];
+} workQueue;
+
+typedef struct
+{
+    threadPool *pool;
+    unsigned int id;                    // index of the thread's workQueue
+} workerArg;
+
+struct threadPool
+{
+    unsigned int threads;               // worker threads plus the calling thread
+    pthread_t *workers;
+    workerArg *args;
+    workQueue *queues;                  // one per thread, queue 0 is the caller's
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;               // signalled when a new generation is published
+    pthread_cond_t done;                // signalled when the last worker finished
+    unsigned long generation;           // incremented for every poolFor() call
+    unsigned int running;               // workers still busy with the current generation
+    bool quit;
+
+    poolTask task;                      // current loop
+    void *arg;
+};
+
+static inline uint64_t packRange(uint32_t const begin, uint32_t const end)
+{
+    return ((uint64_t)begin << 32) | end;
+}
+
+/**
+ * Takes the first index of a thread's own range.
+ * Returns false if the range is empty.
+ */
+static bool takeOwn(workQueue *q, uint32_t *index)
+{
+    uint64_t r = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    while (true)
+    {
+        uint32_t const begin = r >> 32, end = (uint32_t)r;
+        if (begin >= end)
+            return false;
+        if (__atomic_compare_exchange_n(&q->range, &r, packRange(begin + 1, end), true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            *index = begin;
+            return true;
+        }
+    }
+}
+
+/**
+ * Steals the upper half of the largest range of another thread and makes
+ * it the own range of thread self. Returns false if all ranges are empty.
+ */
+static bool steal(threadPool *p, unsigned int const self)
+{
+    while (true)
+    {
+        unsigned int victim = self;
+        uint32_t largest = 0;
+        uint64_t r = 0;
+        for (unsigned int i = 0; i < p->threads; i++)
+        {
+            uint64_t const v = __atomic_load_n(&p->queues[i].range, __ATOMIC_ACQUIRE);
+            uint32_t const begin = v >> 32, end = (uint32_t)v;
+            if (i != self && begin < end && end - begin > largest)
+            {
+                victim = i;
+                largest = end - begin;
+                r = v;
+            }
+        }
+        if (victim == self)
+            return false;
+
+        uint32_t const begin = r >> 32, end = (uint32_t)r;
+        uint32_t const mid = end - (end - begin + 1) / 2;
+        if (__atomic_compare_exchange_n(&p->queues[victim].range, &r, packRange(begin, mid), false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(&p->queues[self].range, packRange(mid, end), __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+}
+
+/**
+ * Runs loop indices on thread self until no range has work left.
+ */
+static void runTasks(threadPool *p, unsigned int const self)
+{
+    uint32_t i;
+    do
+    {
+        while (takeOwn(&p->queues[self], &i))
+            p->task(p->arg, i);
+    } while (steal(p, self));
+}
+
+/**
+ * Worker thread: waits for a new generation, helps with it and reports back.
+ */
+static void *worker(void *arg)
+{
+    workerArg *const w = arg;
+    threadPool *const p = w->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (true)
+    {
+        while (!p->quit && p->generation == seen)
+            pthread_cond_wait(&p->start, &p->lock);
+        if (p->quit)
+            break;
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        runTasks(p, w->id);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->running == 0)
+            pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/**
+ * Creates a pool with the given number of threads including the caller.
+ * 0 selects one thread per online CPU. Returns NULL on failure.
+ */
+threadPool *poolCreate(unsigned int threads)
+{
+    if (threads == 0)
+    {
+        long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (unsigned int)cpus : 1;
+    }
+
+    threadPool *p = calloc(1, sizeof(*p));
+    if (!p)
+        return NULL;
+    p->workers = calloc(threads, sizeof(pthread_t));
+    p->args = calloc(threads, sizeof(workerArg));
+    if (posix_memalign((void **)&p->queues, CACHE_LINE, threads * sizeof(workQueue)) != 0)
+        p->queues = NULL;
+    if (!p->workers || !p->args || !p->queues)
+    {
+        free(p->workers);
+        free(p->args);
+        free(p->queues);
+        free(p);
+        return NULL;
+    }
+    for (unsigned int i = 0; i < threads; i++)
+        p->queues[i].range = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    // The calling thread is worker 0
+    p->threads = 1;
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        p->args[i].pool = p;
+        p->args[i].id = i;
+        if (pthread_create(&p->workers[i], NULL, worker, &p->args[i]) != 0)
+            break;
+        p->threads++;
+    }
+    return p;
+}
+
+/**
+ * Stops all workers and frees the pool.
+ */
+void poolDestroy(threadPool *p)
+{
+    if (!p)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->quit = true;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    for (unsigned int i = 1; i < p->threads; i++)
+        pthread_join(p->workers[i], NULL);
+
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->start);
+    pthread_mutex_destroy(&p->lock);
+    free(p->workers);
+    free(p->args);
+    free(p->queues);
+    free(p);
+}
+
+/**
+ * Returns the number of threads including the calling thread.
+ */
+unsigned int poolThreads(threadPool const *p)
+{
+    return p ? p->threads : 1;
+}
+
+/**
+ * Returns the CPU time the worker threads of p have used since they started
+ * in microseconds, without the calling thread.
+ */
+double poolCpuUSec(threadPool const *p)
+{
+    double uSec = 0;
+    for (unsigned int i = 1; p && i < p->threads; i++)
+    {
+        clockid_t clock;
+        struct timespec ts;
+        if (pthread_getcpuclockid(p->workers[i], &clock) == 0 && clock_gettime(clock, &ts) == 0)
+            uSec += ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+    }
+    return uSec;
+}
+
+/**
+ * Calls task(arg, i) for every i in [0, count) on all threads of the pool
+ * and returns when all calls have finished. A NULL pool runs the loop inline.
+ */
+void poolFor(threadPool *p, poolTask task, void *arg, unsigned int count)
+{
+    if (!p || p->threads == 1 || count <= 1)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            task(arg, i);
+        return;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->task = task;
+    p->arg = arg;
+    for (unsigned int i = 0; i < p->threads; i++)
+    {
+        uint32_t const begin = (uint64_t)count * i / p->threads;
+        uint32_t const end = (uint64_t)count * (i + 1) / p->threads;
+        __atomic_store_n(&p->queues[i].range, packRange(begin, end), __ATOMIC_RELAXED);
+    }
+    p->running = p->threads - 1;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    runTasks(p, 0);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->running > 0)
+        pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,25 @@
+/**
+ * @file stetris_pool.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Minimal pthread pool for running parallel loops in the search bots.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The threads are started once and sleep between calls, so a bot can fan
+ * out work every decision without paying for thread creation.
+ */
+
+#ifndef STETRIS_POOL_H
+#define STETRIS_POOL_H
+
+typedef void (*poolTask)(void *arg, unsigned int index);
+
+typedef struct threadPool threadPool;
+
+threadPool *poolCreate(unsigned int threads);
+void poolDestroy(threadPool *p);
+unsigned int poolThreads(threadPool const *p);
+double poolCpuUSec(threadPool const *p);
+void poolFor(threadPool *p, poolTask task, void *arg, unsigned int count);
+
+#endif // STETRIS_POOL_H
@@ -0,0 +1,91 @@
+/**
+ * @file stetris_protocol.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Binary protocol between the game and bots running as separate programs.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The game talks to a bot over a byte stream: the bot's stdin/stdout pipes
+ * (--bot-remote CMD) or a Unix socket (--bot-socket PATH). Every message is
+ * a frame of an 8 byte header and a payload; all integers are little endian.
+ *
+ *   header    u32 payload length, u16 type, u16 count
+ *   HELLO     u32 STETRIS_PROTOCOL_VERSION, then the bot's name (bot to game only)
+ *   DECIDE    u32 timeout in microseconds, then count snapshots of 24 bytes:
+ *             u32 request, u16 game, u16 level, u64 board,
+ *             u8 activeX, u8 activeY, u8 keysToGravity, u8 period, u32 tiles
+ *   INPUT     count replies: u32 request, u8 length, length keys (enum stetrisKey)
+ *   END_GAME  count games: u32 game
+ *   BYE       no payload, the game closes the stream
+ *
+ * The game sends HELLO first and waits for the bot's HELLO. A DECIDE frame
+ * asks for the input sequences of count games; replies may come in any
+ * order and spread over several INPUT frames. Requests not answered within
+ * the timeout get a hard drop, and late replies are ignored.
+ */
+
+#ifndef STETRIS_PROTOCOL_H
+#define STETRIS_PROTOCOL_H
+
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_plugin.h"             // for enum stetrisKey, STETRIS_MAX_INPUT
+
+#define STETRIS_PROTOCOL_VERSION 1
+#define STETRIS_FRAME_HEADER 8          // bytes before the payload
+#define STETRIS_SNAPSHOT_SIZE 24        // bytes per game in a DECIDE frame
+#define STETRIS_MAX_PAYLOAD 16384       // larger frames are a protocol error
+
+enum stetrisMessage
+{
+    STETRIS_MSG_HELLO = 1,
+    STETRIS_MSG_DECIDE,
+    STETRIS_MSG_INPUT,
+    STETRIS_MSG_END_GAME,
+    STETRIS_MSG_BYE,
+};
+
+static inline void stetrisPut16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void stetrisPut32(uint8_t *p, uint32_t v)
+{
+    stetrisPut16(p, v);
+    stetrisPut16(p + 2, v >> 16);
+}
+
+static inline void stetrisPut64(uint8_t *p, uint64_t v)
+{
+    stetrisPut32(p, v);
+    stetrisPut32(p + 4, v >> 32);
+}
+
+static inline uint16_t stetrisGet16(uint8_t const *p)
+{
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+static inline uint32_t stetrisGet32(uint8_t const *p)
+{
+    return stetrisGet16(p) | (uint32_t)stetrisGet16(p + 2) << 16;
+}
+
+static inline uint64_t stetrisGet64(uint8_t const *p)
+{
+    return stetrisGet32(p) | (uint64_t)stetrisGet32(p + 4) << 32;
+}
+
+/**
+ * Writes a frame header for a payload of length bytes.
+ */
+static inline void stetrisPutHeader(uint8_t *p, uint32_t length, uint16_t type, uint16_t count)
+{
+    stetrisPut32(p, length);
+    stetrisPut16(p + 4, type);
+    stetrisPut16(p + 6, count);
+}
+
+#endif // STETRIS_PROTOCOL_H
@@ -0,0 +1,81 @@
+/**
+ * @file stetris_puzzle.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief "Clear the board in N tiles" puzzles written by stetris_puzzles.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Loading and writing of puzzle files, see stetris_puzzle.h.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() with -std=c99
+
+#include "stetris_puzzle.h"
+
+#include <fcntl.h>                      // for open()
+#include <stdio.h>                      // for FILE, fwrite()
+#include <string.h>                     // for memcmp, memcpy, memset
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/stat.h>                   // for fstat()
+#include <unistd.h>                     // for close()
+
+/**
+ * Maps a puzzle file. Returns false if it cannot be read, is not a puzzle
+ * file or holds no puzzles.
+ */
+bool puzzleLoad(puzzleSet *set, char const *path)
+{
+    memset(set, 0, sizeof(*set));
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(puzzleHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    puzzleHeader const *header = map;
+    if (memcmp(header->magic, PUZZLE_MAGIC, sizeof(header->magic)) != 0 || header->version != PUZZLE_VERSION ||
+        header->count == 0 || (size_t)st.st_size != sizeof(puzzleHeader) + header->count * sizeof(puzzleEntry))
+    {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    set->map = map;
+    set->size = st.st_size;
+    set->count = header->count;
+    set->puzzles = (puzzleEntry const *)(header + 1);
+    return true;
+}
+
+void puzzleUnload(puzzleSet *set)
+{
+    if (set->map)
+        munmap(set->map, set->size);
+    set->map = NULL;
+}
+
+/**
+ * Writes count puzzles in the given order.
+ * Returns false if the file cannot be written.
+ */
+bool puzzleWrite(char const *path, puzzleEntry const *puzzles, uint64_t count)
+{
+    puzzleHeader header = {.version = PUZZLE_VERSION, .count = count};
+    memcpy(header.magic, PUZZLE_MAGIC, sizeof(header.magic));
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool const ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                    fwrite(puzzles, sizeof(puzzleEntry), count, f) == count;
+    return (fclose(f) == 0) && ok;
+}
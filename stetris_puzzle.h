@@ -0,0 +1,61 @@
+/**
+ * @file stetris_puzzle.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief "Clear the board in N tiles" puzzles written by stetris_puzzles.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A puzzle is a starting board and a fall speed from which exactly one
+ * sequence of N placements empties the board. The games load them with
+ * --puzzle FILE instead of starting on an empty playfield. The file is
+ * mapped read-only:
+ *   puzzleHeader, then count puzzleEntry
+ * The solution is stored as one byte per tile: the lock cell y * 8 + x,
+ * PUZZLE_ORPHAN for a tile left behind by a row clear and PUZZLE_CLEARED
+ * for a hard drop that clears the bottom row in the same tick.
+ */
+
+#ifndef STETRIS_PUZZLE_H
+#define STETRIS_PUZZLE_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for fixed width integer types
+
+#define PUZZLE_MAGIC "SPZL"
+#define PUZZLE_VERSION 1
+#define PUZZLE_MAX_PIECES 8
+#define PUZZLE_ORPHAN 0x40
+#define PUZZLE_CLEARED 0x80
+
+typedef struct
+{
+    char magic[4];                      // PUZZLE_MAGIC
+    uint32_t version;                   // PUZZLE_VERSION
+    uint64_t count;
+} puzzleHeader;
+
+typedef struct
+{
+    uint64_t board;                     // settled board the first tile spawns on
+    uint8_t period;                     // nextGameTick of the first tile, lowered by level ups as usual
+    uint8_t pieces;                     // tiles of the solution
+    uint8_t rows;                       // rows the solution clears
+    uint8_t reserved;
+    uint32_t choices;                   // placements to choose from along the solution, for sorting by difficulty
+    uint8_t solution[PUZZLE_MAX_PIECES];
+} puzzleEntry;
+
+typedef struct
+{
+    void *map;                          // mapped puzzle file
+    size_t size;
+    uint64_t count;
+    puzzleEntry const *puzzles;
+} puzzleSet;
+
+bool puzzleLoad(puzzleSet *set, char const *path);
+void puzzleUnload(puzzleSet *set);
+bool puzzleWrite(char const *path, puzzleEntry const *puzzles, uint64_t count);
+
+#endif // STETRIS_PUZZLE_H
@@ -0,0 +1,532 @@
+/**
+ * @file stetris_puzzles.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Generates "clear the board in N tiles" puzzles for --puzzle.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The search runs backwards from the empty board: layer d holds every board
+ * from which some sequence of d placements at the puzzle speed empties the
+ * board, with the number of such sequences. The predecessors of a board are
+ * found by taking one cell away, or by undoing a row clear and then taking
+ * one cell away; every candidate is then checked forwards with
+ * engineGenPlacements(), whose successors are looked up in the previous
+ * layer to count its solutions. Both passes are spread over a thread pool.
+ * The boards of layer N with exactly one solution are the puzzles. Each one
+ * is verified independently by a forward enumeration of its placement
+ * sequences, and its solution is replayed through engineApply() in a real
+ * game before it is written.
+ * Every solution clears --rows rows. The cells of a board and the tiles
+ * left tell how many rows are still to clear, and thereby the speed the next
+ * tile falls at after the level ups of the rows already cleared. The level
+ * ups follow --rows-per-level and --levels, which must match the games.
+ */
+
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for malloc(), qsort(), exit()
+#include <string.h>                     // for strcmp, memset
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_puzzle.h"
+#include "stetris_args.h"
+
+#define CHUNK 256                       // boards per pool task
+#define MEMO_SLOTS (1 << 18)            // forward enumeration memo per task, power of two
+#define TOP_ROW ROW_MASK(0)
+#define BOTTOM_ROW ROW_MASK(GRID_Y - 1)
+
+typedef struct
+{
+    unsigned int pieces;                // tiles of a solution
+    unsigned int rows;                  // rows cleared by a solution
+    unsigned int period;                // nextGameTick of the first tile
+    uint64_t count;                     // puzzles written at most
+    unsigned long seed;                 // picks the puzzles written if there are more
+    unsigned int threads;               // 0 for one per CPU
+    char const *out;                    // puzzle file
+} puzzlesOptions;
+
+/**
+ * Boards that empty the board in d placements, sorted by board.
+ */
+typedef struct
+{
+    uint64_t board;
+    uint32_t solutions;                 // saturates at 2, only 1 matters
+} layerEntry;
+
+typedef struct
+{
+    layerEntry *entries;
+    uint64_t count;
+} layer;
+
+/**
+ * One backwards step, run in parallel: candidates from the boards of the
+ * previous layer, then their solutions counted forwards.
+ */
+typedef struct
+{
+    puzzlesOptions const *opt;
+    layer const *previous;
+    unsigned int depth;
+    uint64_t **found;                   // candidates of every task, sorted and unique
+    uint64_t *foundCount;
+    uint64_t const *candidates;         // all candidates, sorted and unique
+    layerEntry *counted;                // solutions of candidates[i]
+    uint64_t candidateCount;
+    bool failed;                        // out of memory (atomic)
+} stepRun;
+
+/**
+ * Forward verification of the puzzles, run in parallel.
+ */
+typedef struct
+{
+    puzzlesOptions const *opt;
+    puzzleEntry *puzzles;
+    uint64_t count;
+    uint64_t rejected;                  // not unique or not playable (atomic)
+} verifyRun;
+
+typedef struct
+{
+    uint64_t board;
+    uint32_t stamp;                     // puzzle the entry belongs to, 0 for free
+    uint32_t depth;
+    uint32_t solutions;                 // up to 2
+} memoEntry;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--pieces N] [--rows R] [--period P] [--count C] [--seed S] [--threads N]"
+                    " [--out FILE] " ENGINE_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static int compareBoards(void const *x, void const *y)
+{
+    uint64_t const a = *(uint64_t const *)x, b = *(uint64_t const *)y;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Sorts boards and removes duplicates. Returns the number left.
+ */
+static uint64_t uniqueBoards(uint64_t *boards, uint64_t n)
+{
+    uint64_t kept = 0;
+    qsort(boards, n, sizeof(uint64_t), compareBoards);
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (kept == 0 || boards[kept - 1] != boards[i])
+            boards[kept++] = boards[i];
+    }
+    return kept;
+}
+
+static layerEntry const *findBoard(layer const *l, uint64_t board)
+{
+    uint64_t low = 0, high = l->count;
+    while (low < high)
+    {
+        uint64_t const mid = low + (high - low) / 2;
+        if (l->entries[mid].board == board)
+            return &l->entries[mid];
+        if (l->entries[mid].board < board)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NULL;
+}
+
+/**
+ * Generates the placements of a tile spawned on board with depth tiles left
+ * to empty it, at the speed of the level the game is at by then.
+ */
+static int generate(puzzlesOptions const *opt, uint64_t board, unsigned int depth, placement *moves)
+{
+    unsigned int const left = (__builtin_popcountll(board) + depth) / GRID_X;
+    unsigned int const levels = (opt->rows - left) / gameRules.rowsPerLevel;
+    unsigned int period = opt->period;
+    for (unsigned int l = 0; l < levels; l++)
+        period = engineNextPeriod(period);
+    return engineGenPlacements(board, SPAWN_X, 0, period, period, moves);
+}
+
+/**
+ * Collects the boards one placement before the boards of one chunk of the
+ * previous layer. A candidate only has to be a superset of the real
+ * predecessors; the forward pass drops the others.
+ */
+static void candidateTask(void *arg, unsigned int index)
+{
+    stepRun *r = arg;
+    uint64_t const begin = (uint64_t)index * CHUNK;
+    uint64_t const end = (r->previous->count - begin < CHUNK) ? r->previous->count : begin + CHUNK;
+    unsigned int const maxCells = r->opt->rows * GRID_X - r->depth;
+    uint64_t *out = malloc((end - begin) * 2 * MAX_PLACEMENTS * sizeof(uint64_t));
+    uint64_t n = 0;
+
+    if (!out)
+    {
+        __atomic_store_n(&r->failed, true, __ATOMIC_RELAXED);
+        return;
+    }
+    for (uint64_t i = begin; i < end; i++)
+    {
+        uint64_t const board = r->previous->entries[i].board;
+        // The lock of a cell, or a lock that filled the bottom row and was
+        // cleared with it (this covers orphans, which end in row 1 too)
+        uint64_t const before[2] = {board, (board & TOP_ROW) ? 0 : (board >> GRID_X) | BOTTOM_ROW};
+        for (unsigned int b = 0; b < 2; b++)
+        {
+            uint64_t cells = before[b];
+            while (cells)
+            {
+                uint64_t const cell = cells & -cells;
+                uint64_t const candidate = before[b] & ~cell;
+                cells &= cells - 1;
+                if (!boardOccupied(candidate, SPAWN_X, 0) && (unsigned int)__builtin_popcountll(candidate) <= maxCells)
+                    out[n++] = candidate;
+            }
+        }
+    }
+    r->found[index] = out;
+    r->foundCount[index] = uniqueBoards(out, n);
+}
+
+/**
+ * Counts the solutions of one chunk of candidates from their successors.
+ */
+static void countTask(void *arg, unsigned int index)
+{
+    stepRun *r = arg;
+    uint64_t const begin = (uint64_t)index * CHUNK;
+    uint64_t const end = (r->candidateCount - begin < CHUNK) ? r->candidateCount : begin + CHUNK;
+
+    for (uint64_t i = begin; i < end; i++)
+    {
+        placement moves[MAX_PLACEMENTS];
+        int const n = generate(r->opt, r->candidates[i], r->depth, moves);
+        uint32_t solutions = 0;
+        for (int m = 0; m < n && solutions < 2; m++)
+        {
+            layerEntry const *e = findBoard(r->previous, moves[m].board);
+            if (e)
+                solutions += e->solutions;
+        }
+        r->counted[i].board = r->candidates[i];
+        r->counted[i].solutions = solutions < 2 ? solutions : 2;
+    }
+}
+
+/**
+ * Builds layer depth from layer depth - 1. Returns false if out of memory.
+ */
+static bool stepBack(threadPool *pool, puzzlesOptions const *opt, layer const *previous, unsigned int depth,
+                     layer *next)
+{
+    unsigned int const tasks = (unsigned int)((previous->count + CHUNK - 1) / CHUNK);
+    stepRun run = {
+        .opt = opt,
+        .previous = previous,
+        .depth = depth,
+        .found = calloc(tasks, sizeof(uint64_t *)),
+        .foundCount = calloc(tasks, sizeof(uint64_t)),
+    };
+    bool ok = run.found && run.foundCount;
+
+    if (ok)
+    {
+        poolFor(pool, candidateTask, &run, tasks);
+        ok = !run.failed;
+    }
+    uint64_t total = 0;
+    for (unsigned int t = 0; ok && t < tasks; t++)
+        total += run.foundCount[t];
+    uint64_t *candidates = ok ? malloc((total ? total : 1) * sizeof(uint64_t)) : NULL;
+    if (candidates)
+    {
+        uint64_t n = 0;
+        for (unsigned int t = 0; t < tasks; t++)
+        {
+            memcpy(candidates + n, run.found[t], run.foundCount[t] * sizeof(uint64_t));
+            n += run.foundCount[t];
+        }
+        total = uniqueBoards(candidates, n);
+    }
+    for (unsigned int t = 0; run.found && t < tasks; t++)
+        free(run.found[t]);
+    free(run.found);
+    free(run.foundCount);
+
+    run.candidates = candidates;
+    run.candidateCount = total;
+    run.counted = candidates ? malloc((total ? total : 1) * sizeof(layerEntry)) : NULL;
+    if (!run.counted)
+    {
+        free(candidates);
+        return false;
+    }
+    poolFor(pool, countTask, &run, (unsigned int)((total + CHUNK - 1) / CHUNK));
+    free(candidates);
+
+    next->entries = run.counted;
+    next->count = 0;
+    for (uint64_t i = 0; i < total; i++)
+    {
+        if (run.counted[i].solutions)
+            next->entries[next->count++] = run.counted[i];
+    }
+    return true;
+}
+
+/**
+ * Counts the sequences of depth placements from board that end on the empty
+ * board, up to 2, memoized per puzzle. Boards with a cell too high to be
+ * cleared by the rows still to come are cut off.
+ */
+static uint32_t enumerate(puzzlesOptions const *opt, memoEntry *memo, uint32_t stamp, uint64_t board,
+                          unsigned int depth)
+{
+    unsigned int const left = (__builtin_popcountll(board) + depth) / GRID_X;
+    if (left < GRID_Y && (board & ((CELL_MASK(0, GRID_Y - left)) - 1)))
+        return 0;
+    if (depth == 0)
+        return board == 0;
+
+    uint64_t const key = (board ^ depth) * 0x9E3779B97F4A7C15ULL;
+    unsigned int slot = (unsigned int)(key >> 40) & (MEMO_SLOTS - 1);
+    for (unsigned int probe = 0; probe < 16; probe++, slot = (slot + 1) & (MEMO_SLOTS - 1))
+    {
+        memoEntry const *e = &memo[slot];
+        if (e->stamp != stamp)
+            break;
+        if (e->board == board && e->depth == depth)
+            return e->solutions;
+    }
+
+    placement moves[MAX_PLACEMENTS];
+    int const n = generate(opt, board, depth, moves);
+    uint32_t solutions = 0;
+    for (int m = 0; m < n && solutions < 2; m++)
+    {
+        // A placement that blocks the spawn cell ends the game
+        if (!boardOccupied(moves[m].board, SPAWN_X, 0))
+            solutions += enumerate(opt, memo, stamp, moves[m].board, depth - 1);
+    }
+    if (solutions > 2)
+        solutions = 2;
+
+    if (memo[slot].stamp != stamp)
+        memo[slot] = (memoEntry){.board = board, .stamp = stamp, .depth = depth, .solutions = solutions};
+    return solutions;
+}
+
+/**
+ * Returns a state with a tile just spawned on board, in a game like the ones
+ * the puzzles are played in.
+ */
+static engineState spawnOn(uint64_t board, unsigned int period)
+{
+    engineState s;
+    engineInit(&s, 1);
+    engineNewGame(&s);
+    s.nextGameTick = period;
+    engineSetBoard(&s, board);
+    return s;
+}
+
+/**
+ * Verifies one chunk of puzzles: the enumeration has to find exactly one
+ * solution, which is recorded and then replayed with engineApply().
+ * Rejected puzzles get pieces = 0.
+ */
+static void verifyTask(void *arg, unsigned int index)
+{
+    verifyRun *r = arg;
+    puzzlesOptions const *opt = r->opt;
+    uint64_t const begin = (uint64_t)index * CHUNK;
+    uint64_t const end = (r->count - begin < CHUNK) ? r->count : begin + CHUNK;
+    memoEntry *memo = calloc(MEMO_SLOTS, sizeof(memoEntry));
+
+    for (uint64_t i = begin; i < end; i++)
+    {
+        puzzleEntry *p = &r->puzzles[i];
+        uint32_t const stamp = (uint32_t)i + 1;
+
+        // Follow the only placement that leads to a solution
+        engineState s = spawnOn(p->board, opt->period);
+        uint64_t board = p->board;
+        bool ok = memo && enumerate(opt, memo, stamp, p->board, opt->pieces) == 1;
+        for (unsigned int d = opt->pieces; ok && d > 0; d--)
+        {
+            placement moves[MAX_PLACEMENTS];
+            int const n = generate(opt, board, d, moves);
+            int chosen = -1;
+            for (int m = 0; m < n && chosen < 0; m++)
+            {
+                if (!boardOccupied(moves[m].board, SPAWN_X, 0) &&
+                    enumerate(opt, memo, stamp, moves[m].board, d - 1))
+                    chosen = m;
+            }
+            ok = chosen >= 0 && engineApply(&s, &moves[chosen]);
+            if (!ok)
+                break;
+            placement const *m = &moves[chosen];
+            p->choices += n;
+            p->solution[opt->pieces - d] = (uint8_t)(m->y * GRID_X + m->x) | (m->orphan ? PUZZLE_ORPHAN : 0) |
+                                           (m->cleared ? PUZZLE_CLEARED : 0);
+            board = m->board;
+            ok = (s.occupied & ~CELL_MASK(s.activeX, s.activeY)) == board;
+        }
+        if (!ok || board != 0)
+        {
+            p->pieces = 0;
+            __atomic_fetch_add(&r->rejected, 1, __ATOMIC_RELAXED);
+        }
+    }
+    free(memo);
+}
+
+static int compareDifficulty(void const *x, void const *y)
+{
+    puzzleEntry const *a = x, *b = y;
+    if (a->choices != b->choices)
+        return (a->choices > b->choices) - (a->choices < b->choices);
+    return (a->board > b->board) - (a->board < b->board);
+}
+
+
+int main(int argc, char **argv)
+{
+    puzzlesOptions opt = {
+        .pieces = 6,
+        .rows = 3,
+        .period = 50,
+        .count = 1000,
+        .seed = 1,
+        .threads = 0,
+        .out = "stetris_puzzles.bin",
+    };
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "--pieces") == 0)
+            opt.pieces = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--rows") == 0)
+            opt.rows = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--period") == 0)
+            opt.period = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--count") == 0)
+            opt.count = parseNumberArg(argv[++i], UINT64_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--seed") == 0)
+            opt.seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--out") == 0)
+            opt.out = argv[++i];
+        else if (!engineParseRule(&gameRules, argc, argv, &i))
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.pieces == 0 || opt.pieces > PUZZLE_MAX_PIECES || opt.rows == 0 || opt.rows * GRID_X < opt.pieces ||
+        opt.rows >= GRID_Y || opt.period == 0 || opt.period > UINT8_MAX || opt.count == 0)
+        usage(argv[0]);
+
+    threadPool *pool = poolCreate(opt.threads);
+    layer current = {.entries = malloc(sizeof(layerEntry)), .count = 1};
+    if (!pool || !current.entries)
+    {
+        fprintf(stderr, "ERROR: could not start the puzzle generator\n");
+        return EXIT_FAILURE;
+    }
+    current.entries[0] = (layerEntry){.board = 0, .solutions = 1};
+    printf("Searching back %u tiles clearing %u rows from the empty board at period %u on %u threads\n",
+           opt.pieces, opt.rows, opt.period, poolThreads(pool));
+
+    double const start = botNow();
+    for (unsigned int depth = 1; depth <= opt.pieces; depth++)
+    {
+        layer next;
+        if (!stepBack(pool, &opt, &current, depth, &next))
+        {
+            fprintf(stderr, "ERROR: out of memory in layer %u\n", depth);
+            return EXIT_FAILURE;
+        }
+        free(current.entries);
+        current = next;
+
+        uint64_t unique = 0;
+        for (uint64_t i = 0; i < current.count; i++)
+            unique += current.entries[i].solutions == 1;
+        printf("Layer %u:     %12llu boards, %llu with one solution (%.1f s)\n", depth,
+               (unsigned long long)current.count, (unsigned long long)unique, (botNow() - start) / 1e6);
+    }
+
+    // Every board with one solution is a puzzle; a seeded sample if too many
+    uint64_t found = 0;
+    puzzleEntry *puzzles = malloc((current.count ? current.count : 1) * sizeof(puzzleEntry));
+    if (!puzzles)
+        return EXIT_FAILURE;
+    for (uint64_t i = 0; i < current.count; i++)
+    {
+        // Boards that clear fewer rows are only needed on the way
+        if (current.entries[i].solutions != 1 ||
+            __builtin_popcountll(current.entries[i].board) + opt.pieces != opt.rows * GRID_X)
+            continue;
+        puzzleEntry *p = &puzzles[found++];
+        memset(p, 0, sizeof(*p));
+        p->board = current.entries[i].board;
+        p->period = (uint8_t)opt.period;
+        p->pieces = (uint8_t)opt.pieces;
+        p->rows = (uint8_t)opt.rows;
+    }
+    free(current.entries);
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (opt.seed + 1);
+    for (uint64_t i = 0; i < found && i < opt.count; i++)
+    {
+        rng ^= rng << 13;       // xorshift64
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        uint64_t const j = i + rng % (found - i);
+        puzzleEntry const t = puzzles[i];
+        puzzles[i] = puzzles[j];
+        puzzles[j] = t;
+    }
+    if (found > opt.count)
+        found = opt.count;
+
+    verifyRun run = {.opt = &opt, .puzzles = puzzles, .count = found};
+    poolFor(pool, verifyTask, &run, (unsigned int)((found + CHUNK - 1) / CHUNK));
+    poolDestroy(pool);
+
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < found; i++)
+    {
+        if (puzzles[i].pieces)
+            puzzles[kept++] = puzzles[i];
+    }
+    qsort(puzzles, kept, sizeof(puzzleEntry), compareDifficulty);
+    if (kept == 0 || !puzzleWrite(opt.out, puzzles, kept))
+    {
+        fprintf(stderr, "ERROR: could not write %s\n", kept ? opt.out : "any puzzle");
+        return EXIT_FAILURE;
+    }
+    printf("Verified:     %12llu puzzles, %llu rejected\n", (unsigned long long)kept,
+           (unsigned long long)run.rejected);
+    printf("Puzzles:      %12s (%.1f KB) in %.1f s\n", opt.out,
+           (sizeof(puzzleHeader) + kept * sizeof(puzzleEntry)) / 1e3, (botNow() - start) / 1e6);
+    free(puzzles);
+    return run.rejected ? EXIT_FAILURE : EXIT_SUCCESS;
+}
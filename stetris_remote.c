@@ -0,0 +1,430 @@
+/**
+ * @file stetris_remote.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Host side of bots running as separate programs (--bot-remote, --bot-socket).
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Speaks the framed protocol of stetris_protocol.h over the pipes of a child
+ * process or over a Unix socket. Each decision call sends one DECIDE frame
+ * for a batch of games and collects INPUT replies until all have arrived or
+ * the --budget timeout has passed; games without a reply hard drop. Bytes of
+ * a reply that arrive late stay buffered and are discarded by request id.
+ */
+
+#define _GNU_SOURCE                     // Enables ppoll() with -std=c99
+
+#include "stetris_bot.h"
+#include "stetris_protocol.h"
+
+#include <errno.h>                      // for errno, EINTR
+#include <poll.h>                       // for ppoll()
+#include <signal.h>                     // for signal(), kill(), SIGKILL
+#include <stdio.h>                      // for fprintf(), fopen(), sscanf()
+#include <stdlib.h>                     // for calloc(), free()
+#include <string.h>                     // for memcpy, memmove, strncpy
+#include <sys/socket.h>                 // for socket(), connect()
+#include <sys/un.h>                     // for struct sockaddr_un
+#include <sys/wait.h>                   // for waitpid()
+#include <time.h>                       // for struct timespec, nanosleep()
+#include <unistd.h>                     // for pipe(), fork(), read(), write()
+
+#define HELLO_TIMEOUT_USEC 2000000      // time a bot gets to start and answer HELLO
+#define BYE_TIMEOUT_USEC 1000000        // time a bot gets to exit after BYE before it is killed
+
+struct remoteBot
+{
+    int in;                             // stream from the bot
+    int out;                            // stream to the bot, same as in for sockets
+    pid_t child;                        // bot process of --bot-remote, 0 for sockets
+    bool connected;                     // cleared on EOF, errors and protocol errors
+    uint32_t nextRequest;               // id of the next DECIDE snapshot
+    size_t buffered;                    // received bytes not parsed yet
+    uint8_t buffer[STETRIS_FRAME_HEADER + STETRIS_MAX_PAYLOAD];
+    uint8_t frame[STETRIS_FRAME_HEADER + 4 + PLUGIN_BATCH * STETRIS_SNAPSHOT_SIZE];  // DECIDE being sent
+    char name[64];
+};
+
+/**
+ * Writes all bytes to the bot. Returns false and disconnects on errors.
+ */
+static bool sendAll(remoteBot *r, uint8_t const *data, size_t size)
+{
+    while (r->connected && size > 0)
+    {
+        ssize_t const n = write(r->out, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            r->connected = false;
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+    return r->connected;
+}
+
+/**
+ * Waits until deadline (botNow() time) for bytes from the bot and buffers them.
+ * Returns false on timeout or when the bot is gone.
+ */
+static bool receive(remoteBot *r, double deadline)
+{
+    while (r->connected)
+    {
+        double const left = deadline - botNow();
+        if (left <= 0)
+            return false;
+        struct timespec const timeout = {.tv_sec = (time_t)(left / 1e6), .tv_nsec = (long)((long long)left % 1000000) * 1000};
+        struct pollfd p = {.fd = r->in, .events = POLLIN};
+        int const ready = ppoll(&p, 1, &timeout, NULL);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready == 0)
+            return false;
+
+        ssize_t const n = (ready > 0) ? read(r->in, r->buffer + r->buffered, sizeof(r->buffer) - r->buffered) : -1;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            r->connected = false;
+        else
+        {
+            r->buffered += n;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Finds the first complete frame in the buffer. Returns its total size, or
+ * 0 if no complete frame has arrived yet.
+ */
+static size_t peekFrame(remoteBot *r, uint16_t *type, uint16_t *count, uint8_t const **payload, uint32_t *length)
+{
+    if (r->buffered < STETRIS_FRAME_HEADER)
+        return 0;
+    *length = stetrisGet32(r->buffer);
+    *type = stetrisGet16(r->buffer + 4);
+    *count = stetrisGet16(r->buffer + 6);
+    *payload = r->buffer + STETRIS_FRAME_HEADER;
+    if (*length > STETRIS_MAX_PAYLOAD)
+    {
+        r->connected = false;   // the stream cannot be resynchronised
+        return 0;
+    }
+    return (r->buffered >= STETRIS_FRAME_HEADER + *length) ? STETRIS_FRAME_HEADER + *length : 0;
+}
+
+static void dropFrame(remoteBot *r, size_t size)
+{
+    r->buffered -= size;
+    memmove(r->buffer, r->buffer + size, r->buffered);
+}
+
+/**
+ * Starts CMD with /bin/sh, connected to its stdin and stdout.
+ */
+static bool spawnBot(remoteBot *r, char const *command)
+{
+    int toBot[2], fromBot[2];
+    if (pipe(toBot) != 0)
+        return false;
+    if (pipe(fromBot) != 0)
+    {
+        close(toBot[0]);
+        close(toBot[1]);
+        return false;
+    }
+
+    r->child = fork();
+    if (r->child == 0)
+    {
+        dup2(toBot[0], STDIN_FILENO);
+        dup2(fromBot[1], STDOUT_FILENO);
+        close(toBot[0]);
+        close(toBot[1]);
+        close(fromBot[0]);
+        close(fromBot[1]);
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+    close(toBot[0]);
+    close(fromBot[1]);
+    r->out = toBot[1];
+    r->in = fromBot[0];
+    if (r->child < 0)
+    {
+        close(r->out);
+        close(r->in);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Connects to a bot listening on a Unix socket.
+ */
+static bool connectBot(remoteBot *r, char const *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path, path);
+
+    r->in = r->out = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (r->in < 0)
+        return false;
+    if (connect(r->in, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(r->in);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Starts or connects to the bot of options.remoteCommand or
+ * options.remoteSocket and exchanges HELLO frames.
+ * Returns false and prints the reason if that fails.
+ */
+bool remoteOpen(bot *b)
+{
+    remoteBot *r = calloc(1, sizeof(*r));
+    if (!r)
+        return false;
+    b->remote = r;
+    r->in = r->out = -1;
+
+    // A bot that exits must not kill the game with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    bool const started = b->options.remoteCommand ? spawnBot(r, b->options.remoteCommand)
+                                                  : connectBot(r, b->options.remoteSocket);
+    if (!started)
+    {
+        fprintf(stderr, "ERROR: could not start remote bot\n");
+        r->in = r->out = -1;
+        return false;
+    }
+    r->connected = true;
+
+    uint8_t hello[STETRIS_FRAME_HEADER + 4];
+    stetrisPutHeader(hello, 4, STETRIS_MSG_HELLO, 0);
+    stetrisPut32(hello + STETRIS_FRAME_HEADER, STETRIS_PROTOCOL_VERSION);
+    sendAll(r, hello, sizeof(hello));
+
+    double const deadline = botNow() + HELLO_TIMEOUT_USEC;
+    uint16_t type, count;
+    uint8_t const *payload;
+    uint32_t length;
+    size_t size;
+    while (!(size = peekFrame(r, &type, &count, &payload, &length)) && receive(r, deadline))
+    {
+    }
+    if (!size || type != STETRIS_MSG_HELLO || length < 4 || stetrisGet32(payload) != STETRIS_PROTOCOL_VERSION)
+    {
+        fprintf(stderr, "ERROR: remote bot did not answer HELLO with protocol version %d\n", STETRIS_PROTOCOL_VERSION);
+        return false;
+    }
+    size_t const nameLength = (length - 4 < sizeof(r->name) - 1) ? length - 4 : sizeof(r->name) - 1;
+    memcpy(r->name, payload + 4, nameLength);
+    dropFrame(r, size);
+    return true;
+}
+
+/**
+ * Says BYE, closes the streams and reaps the bot process, killing it if it
+ * has not exited within BYE_TIMEOUT_USEC.
+ */
+void remoteClose(bot *b)
+{
+    remoteBot *r = b->remote;
+    if (!r)
+        return;
+
+    uint8_t bye[STETRIS_FRAME_HEADER];
+    stetrisPutHeader(bye, 0, STETRIS_MSG_BYE, 0);
+    sendAll(r, bye, sizeof(bye));
+    if (r->out >= 0 && r->out != r->in)
+        close(r->out);
+    if (r->in >= 0)
+        close(r->in);
+    if (r->child > 0)
+    {
+        struct timespec const poll = {.tv_sec = 0, .tv_nsec = 1000000};
+        double const deadline = botNow() + BYE_TIMEOUT_USEC;
+        pid_t done;
+        while ((done = waitpid(r->child, NULL, WNOHANG)) == 0 && botNow() < deadline)
+            nanosleep(&poll, NULL);
+        if (done == 0)
+        {
+            kill(r->child, SIGKILL);
+            waitpid(r->child, NULL, 0);
+        }
+    }
+    free(r);
+    b->remote = NULL;
+}
+
+/**
+ * Returns the name the bot sent in its HELLO frame.
+ */
+char const *remoteName(bot const *b)
+{
+    return b->remote->name;
+}
+
+/**
+ * Returns the CPU time the bot process of --bot-remote has used so far in
+ * microseconds, or 0 if it is unknown (--bot-socket, no /proc).
+ */
+double remoteCpuUSec(bot const *b)
+{
+    remoteBot const *r = b->remote;
+    char path[64];
+    unsigned long user = 0, system = 0;
+
+    if (!r || r->child <= 0)
+        return 0;
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)r->child);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    // utime and stime are fields 14 and 15, counted after the ")" ending the name
+    char line[512];
+    char const *fields = fgets(line, sizeof(line), f) ? strrchr(line, ')') : NULL;
+    if (!fields || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &user, &system) != 2)
+        user = system = 0;
+    fclose(f);
+    return (user + system) * 1e6 / sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * Stores the INPUT replies of a frame that belong to the current batch.
+ * Requests firstRequest .. firstRequest + count - 1 are games[index[i]].
+ * Returns the number of requests answered.
+ */
+static unsigned int takeReplies(bot *b, uint8_t const *payload, uint32_t length, uint16_t entries,
+                                uint32_t firstRequest, unsigned int count, pluginGame *games,
+                                uint32_t const *index, bool *answered, double start)
+{
+    unsigned int taken = 0;
+    uint32_t offset = 0;
+    for (uint16_t e = 0; e < entries && offset + 5 <= length; e++)
+    {
+        uint32_t const request = stetrisGet32(payload + offset);
+        uint8_t const keys = payload[offset + 4];
+        uint32_t const i = request - firstRequest;
+        offset += 5;
+        if (offset + keys > length)
+            break;
+        if (i < count && !answered[i] && keys <= STETRIS_MAX_INPUT)
+        {
+            pluginGame *g = &games[index[i]];
+            g->input.length = keys;
+            memcpy(g->input.keys, payload + offset, keys);
+            answered[i] = true;
+            taken++;
+
+            double const latency = botNow() - start;
+            if (latency > b->maxRequestUSec)
+                b->maxRequestUSec = latency;
+        }
+        offset += keys;
+    }
+    return taken;
+}
+
+/**
+ * Asks the bot for the input sequences of n games, in DECIDE frames of at
+ * most PLUGIN_BATCH games, each waiting at most options.budget microseconds.
+ */
+void remoteDecide(bot *b, engineState const *states, pluginGame *games, uint32_t const *index, unsigned int n)
+{
+    remoteBot *r = b->remote;
+    uint8_t *const frame = r->frame;
+
+    for (unsigned int first = 0; first < n; first += PLUGIN_BATCH)
+    {
+        unsigned int const count = (n - first < PLUGIN_BATCH) ? n - first : PLUGIN_BATCH;
+        uint32_t const firstRequest = r->nextRequest;
+        bool answered[PLUGIN_BATCH] = {false};
+        unsigned int replies = 0;
+        r->nextRequest += count;
+
+        uint32_t const length = 4 + count * STETRIS_SNAPSHOT_SIZE;
+        stetrisPutHeader(frame, length, STETRIS_MSG_DECIDE, count);
+        stetrisPut32(frame + STETRIS_FRAME_HEADER, b->options.budget);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            engineState const *s = &states[index[first + i]];
+            uint8_t *p = frame + STETRIS_FRAME_HEADER + 4 + i * STETRIS_SNAPSHOT_SIZE;
+            stetrisPut32(p, firstRequest + i);
+            stetrisPut16(p + 4, index[first + i]);
+            stetrisPut16(p + 6, s->level);
+            stetrisPut64(p + 8, s->occupied & ~CELL_MASK(s->activeX, s->activeY));
+            p[16] = s->activeX;
+            p[17] = s->activeY;
+            p[18] = engineKeysToGravity(s);
+            p[19] = s->nextGameTick;
+            stetrisPut32(p + 20, s->tiles);
+        }
+
+        double const start = botNow();
+        double const deadline = start + b->options.budget;
+        sendAll(r, frame, STETRIS_FRAME_HEADER + length);
+        while (replies < count && r->connected)
+        {
+            uint16_t type, entries;
+            uint8_t const *payload;
+            uint32_t size;
+            size_t const total = peekFrame(r, &type, &entries, &payload, &size);
+            if (!total)
+            {
+                if (!receive(r, deadline))
+                    break;
+                continue;
+            }
+            if (type == STETRIS_MSG_INPUT)
+                replies += takeReplies(b, payload, size, entries, firstRequest, count,
+                                       games, index + first, answered, start);
+            dropFrame(r, total);
+        }
+        b->uSecSearching += botNow() - start;
+        b->decisions += count;
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            pluginGame *g = &games[index[first + i]];
+            if (!answered[i])
+            {
+                // Default move of a request that timed out: drop the tile where it is
+                g->input.length = 1;
+                g->input.keys[0] = STETRIS_KEY_DOWN;
+                b->lateDecisions++;
+            }
+            g->position = 0;
+            g->tiles = states[index[first + i]].tiles;
+            g->planned = true;
+        }
+    }
+}
+
+/**
+ * Tells the bot that the game with this id has ended.
+ */
+void remoteEndGame(bot *b, pluginGame *g, uint32_t id)
+{
+    if (g->planned)
+    {
+        uint8_t frame[STETRIS_FRAME_HEADER + 4];
+        stetrisPutHeader(frame, 4, STETRIS_MSG_END_GAME, 1);
+        stetrisPut32(frame + STETRIS_FRAME_HEADER, id);
+        sendAll(b->remote, frame, sizeof(frame));
+    }
+    g->planned = false;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file stetris_remote_bot.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Runs a bot plugin as a separate program speaking stetris_protocol.h.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Serves the protocol on stdin/stdout, for
+ *   ./stetris_sim --bot-remote "./stetris_remote_bot ./stetris_plugin_example.so"
+ * or on a Unix socket with --listen PATH, for --bot-socket PATH. A crash or
+ * hang of the plugin then cannot take the game down with it. --delay USEC
+ * holds back every reply, to try out the game's timeout handling.
+ */
+
+#define _GNU_SOURCE                     // Enables usleep() with -std=c99
+
+#include <dlfcn.h>                      // for dlopen(), dlsym()
+#include <stdbool.h>                    // for bool
+#include <stdio.h>                      // for fprintf()
+#include <stdlib.h>                     // for exit()
+#include <string.h>                     // for strcmp, strlen, memcpy
+#include <sys/socket.h>                 // for socket(), bind(), listen(), accept()
+#include <sys/un.h>                     // for struct sockaddr_un
+#include <time.h>                       // for clock_gettime()
+#include <unistd.h>                     // for read(), write(), usleep(), unlink()
+
+#include "stetris_protocol.h"
+#include "stetris_args.h"
+
+#define MAX_BATCH (STETRIS_MAX_PAYLOAD / STETRIS_SNAPSHOT_SIZE)
+
+static uint8_t request[STETRIS_FRAME_HEADER + STETRIS_MAX_PAYLOAD];
+static uint8_t reply[STETRIS_FRAME_HEADER + MAX_BATCH * (5 + STETRIS_MAX_INPUT)];
+static stetrisSnapshot snapshots[MAX_BATCH];
+static stetrisInput inputs[MAX_BATCH];
+static uint32_t requests[MAX_BATCH];
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s PLUGIN.so [--plugin-args ARGS] [--listen PATH] [--delay USEC]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Returns the current monotonic time in microseconds, the clock of
+ * stetrisSnapshot.deadline.
+ */
+static inline uint64_t uSecNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Reads exactly size bytes. Returns false on EOF or errors.
+ */
+static bool readAll(int fd, uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t const n = read(fd, data, size);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, uint8_t const *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t const n = write(fd, data, size);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/**
+ * Answers the frames of one game until it says BYE or closes the stream.
+ */
+static void serve(int in, int out, stetrisPlugin const *plugin, void *bot, unsigned int delay)
+{
+    for (;;)
+    {
+        if (!readAll(in, request, STETRIS_FRAME_HEADER))
+            return;
+        uint32_t const length = stetrisGet32(request);
+        uint16_t const type = stetrisGet16(request + 4);
+        uint16_t const count = stetrisGet16(request + 6);
+        uint8_t const *payload = request + STETRIS_FRAME_HEADER;
+        if (length > STETRIS_MAX_PAYLOAD || !readAll(in, request + STETRIS_FRAME_HEADER, length))
+            return;
+
+        if (type == STETRIS_MSG_HELLO)
+        {
+            size_t const nameLength = strlen(plugin->name);
+            stetrisPutHeader(reply, 4 + nameLength, STETRIS_MSG_HELLO, 0);
+            stetrisPut32(reply + STETRIS_FRAME_HEADER, STETRIS_PROTOCOL_VERSION);
+            memcpy(reply + STETRIS_FRAME_HEADER + 4, plugin->name, nameLength);
+            if (!writeAll(out, reply, STETRIS_FRAME_HEADER + 4 + nameLength))
+                return;
+        }
+        else if (type == STETRIS_MSG_DECIDE && length >= 4 + (uint32_t)count * STETRIS_SNAPSHOT_SIZE)
+        {
+            uint64_t const deadline = uSecNow() + stetrisGet32(payload);
+            for (uint16_t i = 0; i < count; i++)
+            {
+                uint8_t const *p = payload + 4 + i * STETRIS_SNAPSHOT_SIZE;
+                requests[i] = stetrisGet32(p);
+                snapshots[i] = (stetrisSnapshot){
+                    .game = stetrisGet16(p + 4),
+                    .level = stetrisGet16(p + 6),
+                    .board = stetrisGet64(p + 8),
+                    .activeX = p[16],
+                    .activeY = p[17],
+                    .keysToGravity = p[18],
+                    .period = p[19],
+                    .tiles = stetrisGet32(p + 20),
+                    .deadline = deadline,
+                };
+                inputs[i].length = 0;
+            }
+            plugin->decide(bot, count, snapshots, inputs);
+            if (delay)
+                usleep(delay);
+
+            uint8_t *r = reply + STETRIS_FRAME_HEADER;
+            for (uint16_t i = 0; i < count; i++)
+            {
+                uint8_t const keys = (inputs[i].length < STETRIS_MAX_INPUT) ? inputs[i].length : STETRIS_MAX_INPUT;
+                stetrisPut32(r, requests[i]);
+                r[4] = keys;
+                memcpy(r + 5, inputs[i].keys, keys);
+                r += 5 + keys;
+            }
+            stetrisPutHeader(reply, r - reply - STETRIS_FRAME_HEADER, STETRIS_MSG_INPUT, count);
+            if (!writeAll(out, reply, r - reply))
+                return;
+        }
+        else if (type == STETRIS_MSG_END_GAME && plugin->endGame)
+        {
+            for (uint16_t i = 0; i < count && 4u * (i + 1) <= length; i++)
+                plugin->endGame(bot, stetrisGet32(payload + 4 * i));
+        }
+        else if (type == STETRIS_MSG_BYE)
+            return;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char const *pluginFile = NULL, *pluginArgs = NULL, *listenPath = NULL;
+    unsigned int delay = 0;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--plugin-args") == 0)
+            pluginArgs = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--listen") == 0)
+            listenPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--delay") == 0)
+            delay = parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (argv[i][0] != '-' && !pluginFile)
+            pluginFile = argv[i];
+        else
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (!pluginFile)
+        usage(argv[0]);
+
+    void *handle = dlopen(pluginFile, RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+    {
+        fprintf(stderr, "ERROR: could not load bot plugin: %s\n", dlerror());
+        return EXIT_FAILURE;
+    }
+    union
+    {
+        void *object;
+        stetrisPluginEntryFunction entry;
+    } symbol = {.object = dlsym(handle, STETRIS_PLUGIN_ENTRY)};
+    stetrisPlugin const *plugin = symbol.object ? symbol.entry() : NULL;
+    if (!plugin || plugin->abi != STETRIS_PLUGIN_ABI || !plugin->create || !plugin->decide)
+    {
+        fprintf(stderr, "ERROR: %s is not a bot plugin for interface version %d\n", pluginFile, STETRIS_PLUGIN_ABI);
+        return EXIT_FAILURE;
+    }
+    void *bot = plugin->create(pluginArgs);
+    if (!bot)
+    {
+        fprintf(stderr, "ERROR: bot plugin %s failed to start\n", plugin->name);
+        return EXIT_FAILURE;
+    }
+
+    if (!listenPath)
+        serve(STDIN_FILENO, STDOUT_FILENO, plugin, bot, delay);
+    else
+    {
+        struct sockaddr_un address = {.sun_family = AF_UNIX};
+        int const server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (strlen(listenPath) >= sizeof(address.sun_path) || server < 0)
+            usage(argv[0]);
+        strcpy(address.sun_path, listenPath);
+        unlink(listenPath);
+        if (bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 1) != 0)
+        {
+            fprintf(stderr, "ERROR: could not listen on %s\n", listenPath);
+            return EXIT_FAILURE;
+        }
+
+        // One game at a time, until the process is stopped
+        for (;;)
+        {
+            int const client = accept(server, NULL, NULL);
+            if (client < 0)
+                break;
+            serve(client, client, plugin, bot, delay);
+            close(client);
+        }
+        close(server);
+        unlink(listenPath);
+    }
+
+    if (plugin->destroy)
+        plugin->destroy(bot);
+    return EXIT_SUCCESS;
+}
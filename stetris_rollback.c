@@ -0,0 +1,429 @@
+/**
+ * @file stetris_rollback.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Rollback netplay of a two-player versus match between two processes.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * The session keeps the keys of both players per tick and a snapshot of the
+ * match before every tick that is not confirmed. A snapshot is a plain copy
+ * of the versusMatch, and a tick of both games costs well under a
+ * microsecond, so even a rollback over the whole window fits in one frame.
+ * The peer is the connection to the other side, with the latency injection
+ * used to test the netplay on one machine.
+ */
+
+#include "stetris_rollback.h"
+
+#include <errno.h>                      // for errno, EINTR, EAGAIN
+#include <poll.h>                       // for poll()
+#include <stdio.h>                      // for fprintf()
+#include <string.h>                     // for memcpy, memmove, memset, strlen, strcpy
+#include <sys/socket.h>                 // for socket(), bind(), listen(), accept(), connect(), send()
+#include <sys/un.h>                     // for struct sockaddr_un
+#include <time.h>                       // for clock_gettime()
+#include <unistd.h>                     // for read(), close(), unlink()
+
+#define NO_TICK UINT64_MAX
+
+/**
+ * Starts the session of player local (0 or 1) in a new match with seed.
+ */
+void rollbackInit(rollbackSession *r, unsigned int local, uint32_t seed)
+{
+    memset(r, 0, sizeof(*r));
+    matchInit(&r->match, 2, seed);
+    r->local = local;
+    r->rollbackFrom = NO_TICK;
+    r->nextCheck = ROLLBACK_CHECK;
+    r->checkSent = ROLLBACK_CHECK;
+    for (unsigned int i = 0; i < ROLLBACK_CHECKS; i++)
+        r->localHash[i].tick = r->remoteHash[i].tick = NO_TICK;
+}
+
+/**
+ * Returns true if another local key may be added, false while this side
+ * is a whole window ahead of the keys of the other.
+ */
+bool rollbackReady(rollbackSession const *r)
+{
+    // The keys of the other side may be ahead of this one
+    return r->localUntil < r->confirmed + ROLLBACK_WINDOW;
+}
+
+/**
+ * Adds the local key of the next tick without one. Keys added ahead of the
+ * tick in play are an input delay.
+ */
+void rollbackAddLocal(rollbackSession *r, uint8_t key)
+{
+    r->keys[r->localUntil % ROLLBACK_KEYS][r->local] = key;
+    r->localUntil++;
+}
+
+/**
+ * Adds the remote key of tick, which must be the first tick without one.
+ * A tick already played with another key is played again by the next
+ * rollbackAdvance(). Returns false if the key does not fit, which is a
+ * protocol error.
+ */
+bool rollbackAddRemote(rollbackSession *r, uint64_t tick, uint8_t key)
+{
+    unsigned int const remote = 1 - r->local;
+    uint64_t const oldest = r->tick < r->confirmed ? r->tick : r->confirmed;
+
+    if (tick != r->confirmed || tick - oldest >= ROLLBACK_KEYS)
+        return false;
+    uint8_t *slot = &r->keys[tick % ROLLBACK_KEYS][remote];
+    if (tick < r->tick && *slot != key && tick < r->rollbackFrom)
+        r->rollbackFrom = tick;
+    *slot = key;
+    r->confirmed++;
+    return true;
+}
+
+/**
+ * Returns the microseconds of the monotonic clock.
+ */
+uint64_t peerNow()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+/**
+ * Stores the hash of the match before tick t and compares it with the one
+ * of the other side.
+ */
+static void takeHash(rollbackSession *r, uint64_t t, uint64_t hash)
+{
+    unsigned int const i = (t / ROLLBACK_CHECK) % ROLLBACK_CHECKS;
+    r->localHash[i].tick = t;
+    r->localHash[i].hash = hash;
+    if (r->remoteHash[i].tick == t)
+    {
+        r->checks++;
+        r->desyncs += r->remoteHash[i].hash != hash;
+    }
+}
+
+/**
+ * Plays again the ticks since the first wrong prediction, if any, and then
+ * the next tick with a local key, predicting that the remote player
+ * pressed nothing if its key has not arrived.
+ * Returns false if there is no local key for the next tick yet.
+ */
+bool rollbackAdvance(rollbackSession *r)
+{
+    unsigned int const remote = 1 - r->local;
+
+    if (r->rollbackFrom != NO_TICK)
+    {
+        uint64_t const start = peerNow();
+        uint64_t const depth = r->tick - r->rollbackFrom;
+        r->match = r->snapshot[r->rollbackFrom % ROLLBACK_WINDOW];
+        for (uint64_t t = r->rollbackFrom; t < r->tick; t++)
+        {
+            r->snapshot[t % ROLLBACK_WINDOW] = r->match;
+            if (t >= r->confirmed)
+                r->keys[t % ROLLBACK_KEYS][remote] = 0;
+            matchStep(&r->match, r->keys[t % ROLLBACK_KEYS]);
+        }
+        r->rollbackFrom = NO_TICK;
+
+        double const uSec = (double)(peerNow() - start);
+        r->rollbacks++;
+        r->replayed += depth;
+        r->replayUSec += uSec;
+        if (depth > r->maxDepth)
+            r->maxDepth = depth;
+        if (uSec > r->maxReplayUSec)
+            r->maxReplayUSec = uSec;
+    }
+
+    bool const played = r->tick < r->localUntil && r->tick < r->confirmed + ROLLBACK_WINDOW;
+    if (played)
+    {
+        r->snapshot[r->tick % ROLLBACK_WINDOW] = r->match;
+        if (r->tick >= r->confirmed)
+            r->keys[r->tick % ROLLBACK_KEYS][remote] = 0;
+        matchStep(&r->match, r->keys[r->tick % ROLLBACK_KEYS]);
+        r->tick++;
+    }
+
+    // The match before a tick is final once the keys of all ticks before
+    // it are confirmed
+    uint64_t const final = r->confirmed < r->tick ? r->confirmed : r->tick;
+    for (; r->nextCheck <= final; r->nextCheck += ROLLBACK_CHECK)
+    {
+        if (r->nextCheck == r->tick)
+            takeHash(r, r->nextCheck, matchHash(&r->match));
+        else if (r->tick - r->nextCheck < ROLLBACK_WINDOW)
+            takeHash(r, r->nextCheck, matchHash(&r->snapshot[r->nextCheck % ROLLBACK_WINDOW]));
+    }
+    return played;
+}
+
+/**
+ * Plays what the keys received allow without a prediction: a pending
+ * replay and the ticks whose keys of both sides are known. For the end of
+ * a match, when the other side has left and no more keys will come.
+ */
+void rollbackSettle(rollbackSession *r)
+{
+    uint64_t const localUntil = r->localUntil;
+
+    if (r->localUntil > r->confirmed)
+        r->localUntil = r->confirmed;
+    while (rollbackAdvance(r))
+        ;
+    r->localUntil = localUntil;
+}
+
+/**
+ * Returns the next hash of this side to send to the other, if there is one.
+ */
+bool rollbackNextCheck(rollbackSession *r, uint64_t *tick, uint64_t *hash)
+{
+    for (; r->checkSent < r->nextCheck; r->checkSent += ROLLBACK_CHECK)
+    {
+        rollbackHash const *h = &r->localHash[(r->checkSent / ROLLBACK_CHECK) % ROLLBACK_CHECKS];
+        if (h->tick == r->checkSent)
+        {
+            *tick = h->tick;
+            *hash = h->hash;
+            r->checkSent += ROLLBACK_CHECK;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Compares the hash of the match before tick of the other side with the
+ * one of this side, now or once this side gets there.
+ */
+void rollbackRemoteCheck(rollbackSession *r, uint64_t tick, uint64_t hash)
+{
+    unsigned int const i = (tick / ROLLBACK_CHECK) % ROLLBACK_CHECKS;
+    r->remoteHash[i].tick = tick;
+    r->remoteHash[i].hash = hash;
+    if (r->localHash[i].tick == tick)
+    {
+        r->checks++;
+        r->desyncs += r->localHash[i].hash != hash;
+    }
+}
+
+/**
+ * Writes all bytes to the other side. Closes the peer on errors.
+ */
+static void sendAll(netPeer *p, uint8_t const *data, size_t size)
+{
+    while (p->fd >= 0 && size > 0)
+    {
+        ssize_t const n = send(p->fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            close(p->fd);
+            p->fd = -1;
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+static void peerInit(netPeer *p, int fd)
+{
+    unsigned long const delay = p->delayUSec, jitter = p->jitterUSec;
+    memset(p, 0, offsetof(netPeer, due));
+    p->fd = fd;
+    p->delayUSec = delay;
+    p->jitterUSec = jitter;
+    p->rng = (uint32_t)peerNow() | 1;
+    p->buffered = 0;
+}
+
+static bool socketAddress(struct sockaddr_un *address, char const *path)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path))
+        return false;
+    strcpy(address->sun_path, path);
+    return true;
+}
+
+/**
+ * Waits on the Unix socket path for the other side to connect. The latency
+ * fields of p are kept. Returns false and prints the reason on errors, or
+ * silently when a signal handler without SA_RESTART interrupts the wait.
+ */
+bool peerListen(netPeer *p, char const *path)
+{
+    struct sockaddr_un address;
+    int const listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    peerInit(p, -1);
+    if (!socketAddress(&address, path) || listener < 0)
+        return false;
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0)
+    {
+        fprintf(stderr, "ERROR: could not listen on %s\n", path);
+        close(listener);
+        return false;
+    }
+    p->fd = accept(listener, NULL, NULL);
+    close(listener);
+    unlink(path);
+    return p->fd >= 0;
+}
+
+/**
+ * Connects to the other side waiting on the Unix socket path. The latency
+ * fields of p are kept. Returns false and prints the reason on errors.
+ */
+bool peerConnect(netPeer *p, char const *path)
+{
+    struct sockaddr_un address;
+
+    peerInit(p, socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (p->fd < 0 || !socketAddress(&address, path) ||
+        connect(p->fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "ERROR: could not connect to %s\n", path);
+        peerClose(p);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Sends a frame after the injected latency, right away without one.
+ */
+void peerSend(netPeer *p, uint16_t type, uint16_t count, uint8_t const *payload, uint32_t length)
+{
+    if (p->fd < 0 || STETRIS_FRAME_HEADER + length > PEER_FRAME)
+        return;
+    if (p->count == PEER_QUEUE)
+    {
+        // Nothing is lost on a stream: the oldest frame goes out early
+        sendAll(p, p->frames[p->head], p->length[p->head]);
+        p->head = (p->head + 1) % PEER_QUEUE;
+        p->count--;
+    }
+
+    unsigned int const i = (p->head + p->count) % PEER_QUEUE;
+    uint64_t due = peerNow() + p->delayUSec;
+    if (p->jitterUSec)
+    {
+        p->rng ^= p->rng << 13;
+        p->rng ^= p->rng >> 17;
+        p->rng ^= p->rng << 5;
+        due += p->rng % (p->jitterUSec + 1);
+    }
+    // A frame cannot overtake the ones before it
+    if (due < p->lastDue)
+        due = p->lastDue;
+    p->lastDue = due;
+    stetrisPutHeader(p->frames[i], length, type, count);
+    memcpy(p->frames[i] + STETRIS_FRAME_HEADER, payload, length);
+    p->length[i] = (uint16_t)(STETRIS_FRAME_HEADER + length);
+    p->due[i] = due;
+    p->count++;
+    peerFlush(p);
+}
+
+/**
+ * Sends the queued frames whose latency has passed.
+ */
+void peerFlush(netPeer *p)
+{
+    uint64_t const now = peerNow();
+    while (p->count && p->due[p->head] <= now)
+    {
+        sendAll(p, p->frames[p->head], p->length[p->head]);
+        p->head = (p->head + 1) % PEER_QUEUE;
+        p->count--;
+    }
+}
+
+/**
+ * Reads what the other side has sent, waiting up to timeout milliseconds
+ * for the first byte. Returns false when the other side is gone.
+ */
+bool peerReceive(netPeer *p, int timeout)
+{
+    struct pollfd fd = {.fd = p->fd, .events = POLLIN};
+    if (p->fd < 0)
+        return false;
+    if (poll(&fd, 1, timeout) <= 0)
+        return true;
+
+    ssize_t const n = read(p->fd, p->buffer + p->buffered, sizeof(p->buffer) - p->buffered);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return true;
+    if (n <= 0)
+    {
+        close(p->fd);
+        p->fd = -1;
+        return false;
+    }
+    p->buffered += n;
+    return true;
+}
+
+/**
+ * Returns the size of the first received frame, or 0 if it has not arrived
+ * completely. Closes the peer on frames that are too long.
+ */
+size_t peerFrame(netPeer *p, uint16_t *type, uint16_t *count, uint32_t *length)
+{
+    if (p->buffered < STETRIS_FRAME_HEADER)
+        return 0;
+    *length = stetrisGet32(p->buffer);
+    *type = stetrisGet16(p->buffer + 4);
+    *count = stetrisGet16(p->buffer + 6);
+    if (*length > STETRIS_MAX_PAYLOAD)
+    {
+        peerClose(p);
+        return 0;
+    }
+    return (p->buffered >= STETRIS_FRAME_HEADER + *length) ? STETRIS_FRAME_HEADER + *length : 0;
+}
+
+/**
+ * Removes the first received frame of size bytes.
+ */
+void peerDrop(netPeer *p, size_t size)
+{
+    p->buffered -= size;
+    memmove(p->buffer, p->buffer + size, p->buffered);
+}
+
+/**
+ * Sends the queued frames and BYE at once and closes the connection.
+ */
+void peerClose(netPeer *p)
+{
+    if (p->fd < 0)
+        return;
+    while (p->count)
+    {
+        sendAll(p, p->frames[p->head], p->length[p->head]);
+        p->head = (p->head + 1) % PEER_QUEUE;
+        p->count--;
+    }
+    uint8_t bye[STETRIS_FRAME_HEADER];
+    stetrisPutHeader(bye, 0, STETRIS_MSG_BYE, 0);
+    sendAll(p, bye, sizeof(bye));
+    if (p->fd >= 0)
+        close(p->fd);
+    p->fd = -1;
+    p->buffered = 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file stetris_rollback.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Rollback netplay of a two-player versus match between two processes.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Both sides run the whole match (stetris_match.h) and only exchange keys.
+ * A side does not wait for the keys of the other: it predicts that the
+ * remote player pressed nothing, plays on and keeps a snapshot of the match
+ * before every tick that is not confirmed yet. When a remote key arrives
+ * for a tick that was played with a wrong prediction, the match is restored
+ * from the snapshot of that tick and the ticks since are played again with
+ * matchStep(), all before the next frame is drawn. A side that gets
+ * ROLLBACK_WINDOW ticks ahead of the confirmed keys waits for the other.
+ * Every ROLLBACK_CHECK ticks both sides exchange a hash of the confirmed
+ * match, which finds any desynchronisation.
+ *
+ * Frames have the header of stetris_protocol.h, on a Unix socket:
+ *
+ *   NET_HELLO  u32 ROLLBACK_VERSION, u32 seed, u32 rounds, the rules: u32
+ *              tick time in microseconds, u32 rows per level, u32 start
+ *              period, u32 level bands, MAX_LEVEL_BANDS x u32 up to,
+ *              MAX_LEVEL_BANDS x u32 step (host to guest; the guest answers
+ *              with the version alone)
+ *   NET_KEYS   u32 tick, count keys of the sender for that tick and the
+ *              following ones, one byte each
+ *   NET_CHECK  u32 tick, u64 hash of the match before that tick
+ *   BYE        no payload, either side ends the match
+ *
+ * The peer can delay its frames by a fixed latency and random jitter to
+ * test the netplay on one machine; frames keep their order, like on a
+ * stream.
+ */
+
+#ifndef STETRIS_ROLLBACK_H
+#define STETRIS_ROLLBACK_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_match.h"
+#include "stetris_protocol.h"           // for the frame header and byte order helpers
+
+#define ROLLBACK_VERSION 1
+#define ROLLBACK_WINDOW 64              // unconfirmed ticks a side may play, a power of 2
+#define ROLLBACK_KEYS (2 * ROLLBACK_WINDOW) // ticks of keys kept, the other side may be ahead
+#define ROLLBACK_MAX_DELAY 8            // ticks of input delay at most
+#define ROLLBACK_CHECK 32               // ticks between hashes of the match
+#define ROLLBACK_CHECKS 16              // hashes kept for comparison
+#define PEER_QUEUE 1024                 // delayed frames in flight
+#define PEER_FRAME 128                  // bytes of a frame the peer sends
+
+enum stetrisNetMessage
+{
+    STETRIS_MSG_NET_HELLO = 32,         // after the messages of the game server
+    STETRIS_MSG_NET_KEYS,
+    STETRIS_MSG_NET_CHECK,
+};
+
+typedef struct
+{
+    uint64_t tick;                      // tick of the hash, UINT64_MAX for none
+    uint64_t hash;
+} rollbackHash;
+
+typedef struct
+{
+    versusMatch match;                  // the match before tick, with predicted keys
+    unsigned int local;                 // player of this side
+    uint64_t tick;                      // next tick to play
+    uint64_t confirmed;                 // remote keys are known for the ticks before this
+    uint64_t localUntil;                // local keys are known for the ticks before this
+    uint64_t rollbackFrom;              // first tick played with a wrong prediction, UINT64_MAX for none
+    versusMatch snapshot[ROLLBACK_WINDOW];      // the match before tick t at t % ROLLBACK_WINDOW
+    uint8_t keys[ROLLBACK_KEYS][2];     // keys of tick t at t % ROLLBACK_KEYS, the remote one maybe predicted
+    uint64_t nextCheck;                 // tick of the next hash to take
+    uint64_t checkSent;                 // tick of the next hash to send
+    rollbackHash localHash[ROLLBACK_CHECKS];
+    rollbackHash remoteHash[ROLLBACK_CHECKS];
+
+    unsigned long long rollbacks;       // restores from a snapshot
+    unsigned long long replayed;        // ticks played again
+    unsigned long long maxDepth;        // most ticks played again at once
+    unsigned long long checks;          // hashes compared
+    unsigned long long desyncs;         // hashes that differed
+    double replayUSec;                  // time spent replaying
+    double maxReplayUSec;               // longest replay
+} rollbackSession;
+
+void rollbackInit(rollbackSession *r, unsigned int local, uint32_t seed);
+bool rollbackReady(rollbackSession const *r);
+void rollbackAddLocal(rollbackSession *r, uint8_t key);
+bool rollbackAddRemote(rollbackSession *r, uint64_t tick, uint8_t key);
+bool rollbackAdvance(rollbackSession *r);
+void rollbackSettle(rollbackSession *r);
+bool rollbackNextCheck(rollbackSession *r, uint64_t *tick, uint64_t *hash);
+void rollbackRemoteCheck(rollbackSession *r, uint64_t tick, uint64_t hash);
+
+/**
+ * One end of the connection, with the injected latency.
+ */
+typedef struct
+{
+    int fd;                             // -1 once the connection is gone
+    unsigned long delayUSec;            // added to every frame sent
+    unsigned long jitterUSec;           // random extra delay, up to this
+    uint32_t rng;                       // of the jitter
+    uint64_t lastDue;                   // release time of the last frame queued
+    unsigned int head, count;           // ring of queued frames
+    uint64_t due[PEER_QUEUE];           // release time of each frame, in microseconds
+    uint16_t length[PEER_QUEUE];
+    uint8_t frames[PEER_QUEUE][PEER_FRAME];
+    size_t buffered;                    // received bytes not parsed yet
+    uint8_t buffer[STETRIS_FRAME_HEADER + STETRIS_MAX_PAYLOAD];
+} netPeer;
+
+bool peerListen(netPeer *p, char const *path);
+bool peerConnect(netPeer *p, char const *path);
+void peerSend(netPeer *p, uint16_t type, uint16_t count, uint8_t const *payload, uint32_t length);
+void peerFlush(netPeer *p);
+bool peerReceive(netPeer *p, int timeout);
+size_t peerFrame(netPeer *p, uint16_t *type, uint16_t *count, uint32_t *length);
+void peerDrop(netPeer *p, size_t size);
+void peerClose(netPeer *p);
+uint64_t peerNow();
+
+#endif // STETRIS_ROLLBACK_H
@@ -37,6 +37,12 @@
 #include <poll.h>                       // for non-blocking input handling
 #include <termios.h>                    // for console input handling
 #include <signal.h>                     // for signal handling
+#include <sys/time.h>                   // for gettimeofday()
+
+#include "stetris_bot.h"                // for the autoplayer (--bot)
+#include "stetris_puzzle.h"             // for puzzle starting boards (--puzzle)
+#include "stetris_shm.h"                // for publishing the state to other processes (--publish)
+#include "stetris_server.h"             // for playing on a stetrisd server (--connect)
 
 /**
  * Game state bit field definitions.
@@ -90,9 +96,9 @@ typedef struct
 {
     coord const grid;                     // playfield bounds
     color_t const blockColor[6];          // color of the blocks
-    unsigned long const uSecTickTime;     // tick rate
-    unsigned long const rowsPerLevel;     // speed up after clearing rows
-    unsigned long const initNextGameTick; // initial value of nextGameTick
+    unsigned long uSecTickTime;           // tick rate, set from gameRules
+    unsigned long rowsPerLevel;           // speed up after clearing rows
+    unsigned long initNextGameTick;       // initial value of nextGameTick
 
     unsigned int tiles; // number of tiles played
     unsigned int rows;  // number of rows cleared
@@ -117,6 +123,12 @@ gameConfig game = {
     .rowsPerLevel = 2,
     .initNextGameTick = 50,
 };
+
+puzzleSet puzzles;          // starting boards loaded with --puzzle
+uint64_t nextPuzzle = 0;    // puzzle the next game starts with
+shmRing publishRing;        // ring the state is written to every tick with --publish
+serverClient server;        // session on stetrisd with --connect
+
 struct fb_t {
     uint16_t pixel[8][8];
 };
@@ -155,6 +167,8 @@ void placeTile();
 bool clearFullRows();
 void gameTick();
 void gameLoop();
+void snapshotGame(engineState *s);
+void restoreGame(engineState const *s);
 
 
 /**
@@ -569,24 +583,35 @@ bool clearRow()
 
 /**
  * Advances the game to the next level by incrementing the level counter
- * and adjusting the nextGameTick value to increase game speed.
+ * and adjusting the nextGameTick value to increase game speed, with the
+ * level schedule of gameRules (--levels).
  */
 void advanceLevel()
 {
     game.level++;
-    switch (game.nextGameTick)
+    game.nextGameTick = engineNextPeriod(game.nextGameTick);
+}
+
+/**
+ * Fills the empty playfield of a new game with the board of the next puzzle
+ * loaded with --puzzle and starts the game at the speed of the puzzle.
+ */
+void loadPuzzle()
+{
+    if (!puzzles.count)
+        return;
+    puzzleEntry const *p = &puzzles.puzzles[nextPuzzle];
+    nextPuzzle = (nextPuzzle + 1) % puzzles.count;
+    for (unsigned int y = 0; y < game.grid.y; y++)
     {
-    case 1:
-        break;
-    case 2 ... 10:
-        game.nextGameTick--;
-        break;
-    case 11 ... 20:
-        game.nextGameTick -= 2;
-        break;
-    default:
-        game.nextGameTick -= 10;
+        for (unsigned int x = 0; x < game.grid.x; x++)
+        {
+            coord const target = {x, y};
+            if (boardOccupied(p->board, x, y))
+                newTile(target);
+        }
     }
+    game.nextGameTick = p->period;
 }
 
 /**
@@ -602,6 +627,7 @@ void newGame()
     game.tick = 0;
     game.level = 0;
     resetPlayfield();
+    loadPuzzle();
 }
 
 /**
@@ -697,6 +723,60 @@ bool sTetris(int const key)
     return playfieldChanged;
 }
 
+/**
+ * Copies the playfield and counters of the global game into an engine state,
+ * which is what the bot plans on.
+ */
+void snapshotGame(engineState *s)
+{
+    memset(s, 0, sizeof(*s));
+    for (unsigned int y = 0; y < game.grid.y; y++)
+    {
+        for (unsigned int x = 0; x < game.grid.x; x++)
+        {
+            if (game.playfield[y][x].occupied)
+                s->occupied |= CELL_MASK(x, y);
+        }
+    }
+    s->activeX = game.activeTile.x;
+    s->activeY = game.activeTile.y;
+    s->state = game.state;
+    s->rowsPerLevel = game.rowsPerLevel;
+    s->tiles = game.tiles;
+    s->rows = game.rows;
+    s->score = game.score;
+    s->level = game.level;
+    s->tick = game.tick;
+    s->nextGameTick = game.nextGameTick;
+    s->initNextGameTick = game.initNextGameTick;
+}
+
+/**
+ * Copies an engine state into the global game, the inverse of snapshotGame().
+ * With --connect the game runs on stetrisd and is shown from its state.
+ */
+void restoreGame(engineState const *s)
+{
+    for (unsigned int y = 0; y < game.grid.y; y++)
+    {
+        for (unsigned int x = 0; x < game.grid.x; x++)
+        {
+            int const color = engineColorAt(s, x, y);
+            game.playfield[y][x].occupied = color >= 0;
+            game.playfield[y][x].color = (color >= 0) ? game.blockColor[color] : black;
+        }
+    }
+    game.activeTile.x = s->activeX;
+    game.activeTile.y = s->activeY;
+    game.state = s->state;
+    game.tiles = s->tiles;
+    game.rows = s->rows;
+    game.score = s->score;
+    game.level = s->level;
+    game.tick = s->tick;
+    game.nextGameTick = s->nextGameTick;
+}
+
 /**
  * Converts a timespec structure to microseconds.
  */
@@ -708,8 +788,48 @@ inline unsigned long uSecFromTimespec(struct timespec const ts)
 
 int main(int argc, char **argv)
 {
-    (void)argc;     // Unused parameter
-    (void)argv;     // Unused parameter
+    botOptions botOpt = defaultBotOptions;  // --bot lets the bot play as attract mode
+    bot gameBot;
+
+    char const *puzzleFile = NULL;          // --puzzle replaces the empty starting playfield
+    char const *publishFile = NULL;         // --publish shares the state with other processes
+    char const *connectPath = NULL;         // --connect plays on a stetrisd server
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--puzzle") == 0)
+            puzzleFile = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--publish") == 0)
+            publishFile = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--connect") == 0)
+            connectPath = argv[++i];
+        else if (!engineParseRule(&gameRules, argc, argv, &i) && !botParseOption(&botOpt, argc, argv, &i))
+        {
+            fprintf(stderr, "Usage: %s [--puzzle FILE] [--publish FILE] [--connect PATH] " ENGINE_USAGE " " BOT_USAGE "\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    game.uSecTickTime = gameRules.uSecTickTime;
+    game.rowsPerLevel = gameRules.rowsPerLevel;
+    game.initNextGameTick = gameRules.initNextGameTick;
+    if (puzzleFile && !puzzleLoad(&puzzles, puzzleFile))
+    {
+        fprintf(stderr, "ERROR: could not load puzzles from %s\n", puzzleFile);
+        return EXIT_FAILURE;
+    }
+    if (publishFile && !shmCreate(&publishRing, publishFile, SHM_DEFAULT_SLOTS))
+    {
+        fprintf(stderr, "ERROR: could not create the ring in %s\n", publishFile);
+        return EXIT_FAILURE;
+    }
+    if (connectPath)
+    {
+        if (!clientConnect(&server, connectPath, (uint32_t)time(NULL)))
+            return EXIT_FAILURE;
+        game.uSecTickTime = server.uSecTickTime;
+    }
+    if (!botCreate(&gameBot, &botOpt))
+        return EXIT_FAILURE;
 
     // Allocate the playing field structure
     game.rawPlayfield = (tile *)malloc(game.grid.x * game.grid.y * sizeof(tile));
@@ -743,10 +863,37 @@ int main(int argc, char **argv)
         gettimeofday(&sTv, NULL);
 
         int key = readSenseHatJoystick();
+        if (!key && botOpt.enabled)
+        {
+            // A key from the player takes precedence over the bot
+            engineState snapshot;
+            snapshotGame(&snapshot);
+            key = botNextKey(&gameBot, &snapshot);
+        }
         if (key == KEY_ENTER)
             break;
 
-        bool playfieldChanged = sTetris(key);
+        bool playfieldChanged;
+        if (connectPath)
+        {
+            // The game runs on the server, which sends back what changed
+            if (key)
+                clientSendKey(&server, key);
+            int const polled = clientPoll(&server);
+            if (polled < 0)
+                break;
+            if (polled > 0)
+                restoreGame(&server.state);
+            playfieldChanged = polled > 0;
+        }
+        else
+            playfieldChanged = sTetris(key);
+        if (publishRing.map)
+        {
+            engineState published;
+            snapshotGame(&published);
+            shmPublish(&publishRing, 0, &published);
+        }
         renderSenseHatMatrix(playfieldChanged);
 
         // Wait for next tick
@@ -759,5 +906,10 @@ int main(int argc, char **argv)
         game.tick = (game.tick + 1) % game.nextGameTick;
     }
     cleanUp();  
+    botDestroy(&gameBot);
+    puzzleUnload(&puzzles);
+    shmDetach(&publishRing);
+    if (connectPath)
+        clientClose(&server);
     return EXIT_SUCCESS;
 }
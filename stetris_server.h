@@ -0,0 +1,89 @@
+/**
+ * @file stetris_server.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Protocol of the stetrisd game server and the client side used by the frontends.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * stetrisd hosts many games in one process. A frontend or bot connects to its
+ * Unix socket and gets a game of its own, a session, which runs at the tick
+ * rate of the server whether the client sends keys or not. Messages are
+ * frames with the header of stetris_protocol.h (u32 payload length, u16
+ * type, u16 count); all integers are little endian.
+ *
+ *   JOIN      u32 STETRIS_SESSION_VERSION, u32 seed (client to server)
+ *   WELCOME   u32 STETRIS_SESSION_VERSION, u32 session, u32 tick time in
+ *             microseconds (server to client)
+ *   KEYS      count keys, one byte each (KEY_LEFT & 0xFF, ...); each is the
+ *             input of one tick, in order (client to server)
+ *   HOLD      u8 key held down from now on, 0 releases it; the key is
+ *             played at once and LEFT and RIGHT repeat while held, at the
+ *             rate of the server (client to server)
+ *   STATE     count is a set of SESSION_DELTA_* flags; u32 server tick, then
+ *             the fields of every flag set, in the order of the flags
+ *             (server to client)
+ *   BYE       no payload, either side closes the stream
+ *
+ * A STATE frame only carries what changed since the last STATE frame of the
+ * session, so an idle game costs nothing between gravity steps. A slow
+ * client misses intermediate states, never the latest one.
+ */
+
+#ifndef STETRIS_SERVER_H
+#define STETRIS_SERVER_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_engine.h"
+#include "stetris_protocol.h"           // for the frame header and byte order helpers
+
+#define STETRIS_SESSION_VERSION 1
+#define STETRISD_SOCKET "/tmp/stetrisd.sock"
+
+enum stetrisSessionMessage
+{
+    STETRIS_MSG_JOIN = 16,              // after the messages of the bot protocol
+    STETRIS_MSG_WELCOME,
+    STETRIS_MSG_KEYS,
+    STETRIS_MSG_STATE,
+    STETRIS_MSG_HOLD,
+};
+
+/**
+ * Fields of a STATE frame, with their payload.
+ */
+#define SESSION_DELTA_BOARD (1 << 0)    // u64 occupied, 3 x u64 colorPlane
+#define SESSION_DELTA_ACTIVE (1 << 1)   // u8 activeX, u8 activeY
+#define SESSION_DELTA_STATE (1 << 2)    // u8 state
+#define SESSION_DELTA_COUNTERS (1 << 3) // u32 tiles, rows, score, level
+#define SESSION_DELTA_SPEED (1 << 4)    // u32 tick, u32 nextGameTick, sent with every other field
+#define SESSION_DELTA_ALL 0x1F
+#define SESSION_STATE_MAX (4 + 32 + 2 + 1 + 16 + 8)
+
+size_t sessionPutState(uint8_t *payload, uint16_t flags, uint32_t serverTick, engineState const *s);
+bool sessionGetState(uint8_t const *payload, uint32_t length, uint16_t flags, engineState *s);
+uint16_t sessionDelta(engineState const *sent, engineState const *s);
+
+/**
+ * Client side of one session.
+ */
+typedef struct
+{
+    int fd;                             // -1 once the server is gone
+    uint32_t session;                   // id the server gave the session
+    unsigned long uSecTickTime;         // tick rate of the server
+    uint32_t serverTick;                // of the last STATE frame
+    engineState state;                  // game as of the last STATE frame
+    size_t buffered;                    // received bytes not parsed yet
+    uint8_t buffer[STETRIS_FRAME_HEADER + STETRIS_MAX_PAYLOAD];
+} serverClient;
+
+bool clientConnect(serverClient *c, char const *path, uint32_t seed);
+bool clientSendKey(serverClient *c, int key);
+bool clientHoldKey(serverClient *c, int key);
+int clientPoll(serverClient *c);
+void clientClose(serverClient *c);
+
+#endif // STETRIS_SERVER_H
@@ -0,0 +1,245 @@
+/**
+ * @file stetris_shm.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Shared-memory ring of game states for agents in other processes.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Publishing and reading of the ring, see stetris_shm.h. The slot data is
+ * written and read with plain stores and loads between the two seq updates,
+ * as in any seqlock; the seq words and the counters of the header are only
+ * accessed atomically.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() and syscall() with -std=c99
+
+#include "stetris_shm.h"
+
+#include <errno.h>                      // for errno, ETIMEDOUT
+#include <fcntl.h>                      // for open()
+#include <limits.h>                     // for INT_MAX
+#include <linux/futex.h>                // for FUTEX_WAIT, FUTEX_WAKE
+#include <string.h>                     // for memcmp, memcpy, memset
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/stat.h>                   // for fstat()
+#include <sys/syscall.h>                // for SYS_futex
+#include <time.h>                       // for struct timespec
+#include <unistd.h>                     // for close(), ftruncate(), syscall()
+
+static size_t ringSize(uint32_t slots)
+{
+    return sizeof(shmHeader) + (size_t)slots * sizeof(shmSlot);
+}
+
+/**
+ * Maps a ring file of size bytes read-write and shared.
+ */
+static void *mapRing(int fd, size_t size)
+{
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/**
+ * Checks the header of a mapped ring of size bytes.
+ */
+static bool validRing(shmHeader const *header, size_t size)
+{
+    return memcmp(header->magic, SHM_MAGIC, sizeof(header->magic)) == 0 && header->version == SHM_VERSION &&
+           header->slotSize == sizeof(shmSlot) && header->slots != 0 && (header->slots & (header->slots - 1)) == 0 &&
+           size == ringSize(header->slots);
+}
+
+/**
+ * Creates the ring file path with slots slots, rounded up to a power of
+ * two, and maps it for publishing. An existing ring of the same size is
+ * reused and continues with its next frame, so readers that attached to it
+ * before the publisher (re)started keep reading.
+ * Returns false if the file cannot be created or mapped.
+ */
+bool shmCreate(shmRing *ring, char const *path, uint32_t slots)
+{
+    memset(ring, 0, sizeof(*ring));
+    uint32_t n = 1;
+    while (n < slots && n < (1u << 30))
+        n <<= 1;
+
+    int const fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    size_t const size = ringSize(n);
+    struct stat st;
+    void *map = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == size)
+    {
+        map = mapRing(fd, size);
+        if (map && (!validRing(map, size) || ((shmHeader *)map)->slots != n))
+            memset(map, 0, size);
+    }
+    else if (ftruncate(fd, 0) == 0 && ftruncate(fd, size) == 0)
+        map = mapRing(fd, size);
+    close(fd);
+    if (!map)
+        return false;
+
+    ring->map = map;
+    ring->size = size;
+    ring->header = map;
+    ring->slots = (shmSlot *)(ring->header + 1);
+    if (memcmp(ring->header->magic, SHM_MAGIC, sizeof(ring->header->magic)) != 0)
+    {
+        ring->header->version = SHM_VERSION;
+        ring->header->slots = n;
+        ring->header->slotSize = sizeof(shmSlot);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(ring->header->magic, SHM_MAGIC, sizeof(ring->header->magic));
+    }
+    return true;
+}
+
+/**
+ * Maps the ring file path for reading. The first frame shmNext() returns
+ * is the next one published.
+ * Returns false if it cannot be mapped or is not a ring file.
+ */
+bool shmAttach(shmRing *ring, char const *path)
+{
+    memset(ring, 0, sizeof(*ring));
+    int const fd = open(path, O_RDWR);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void *map = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shmHeader))
+        map = mapRing(fd, st.st_size);
+    close(fd);
+    if (!map)
+        return false;
+
+    if (!validRing(map, st.st_size))
+    {
+        munmap(map, st.st_size);
+        return false;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    ring->map = map;
+    ring->size = st.st_size;
+    ring->header = map;
+    ring->slots = (shmSlot *)(ring->header + 1);
+    ring->next = __atomic_load_n(&ring->header->next, __ATOMIC_ACQUIRE);
+    return true;
+}
+
+void shmDetach(shmRing *ring)
+{
+    if (ring->map)
+        munmap(ring->map, ring->size);
+    memset(ring, 0, sizeof(*ring));
+}
+
+static long futex(uint32_t *word, int op, uint32_t value, struct timespec const *timeout)
+{
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+/**
+ * Writes game state s as the next frame, marked with game. Safe to call
+ * from several threads at once, as long as fewer than slots frames are
+ * being written at any time.
+ */
+void shmPublish(shmRing *ring, uint32_t game, engineState const *s)
+{
+    shmHeader *header = ring->header;
+    uint32_t const frame = __atomic_fetch_add(&header->next, 1, __ATOMIC_RELAXED);
+    shmSlot *slot = &ring->slots[frame & (header->slots - 1)];
+
+    __atomic_store_n(&slot->seq, 2 * frame + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->game = game;
+    slot->occupied = s->occupied;
+    slot->activeX = s->activeX;
+    slot->activeY = s->activeY;
+    slot->state = s->state;
+    slot->tiles = s->tiles;
+    slot->rows = s->rows;
+    slot->score = s->score;
+    slot->level = s->level;
+    slot->tick = s->tick;
+    slot->nextGameTick = s->nextGameTick;
+    __atomic_store_n(&slot->seq, 2 * frame + 2, __ATOMIC_RELEASE);
+
+    // Pairs with the increment of waiters in shmNext(): either the reader
+    // sees the new seq or this sees the reader
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->waiters, __ATOMIC_RELAXED))
+        futex(&slot->seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/**
+ * Returns the slot of the next frame, waiting up to timeoutMs milliseconds
+ * for it to be published (forever if negative). The slot is read in place;
+ * check shmValid() after reading it. Frames skipped because the reader fell
+ * a ring behind are added to *lost.
+ * Returns NULL on timeout.
+ */
+shmSlot const *shmNext(shmRing *ring, int timeoutMs, uint32_t *lost)
+{
+    shmHeader *header = ring->header;
+    uint32_t const slots = header->slots;
+    struct timespec const timeout = {timeoutMs / 1000, (long)(timeoutMs % 1000) * 1000000};
+
+    for (;;)
+    {
+        shmSlot *slot = &ring->slots[ring->next & (slots - 1)];
+        uint32_t const expected = 2 * ring->next + 2;
+        uint32_t const seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == expected)
+        {
+            ring->seq = seq;
+            ring->next++;
+            return slot;
+        }
+        if ((int32_t)(seq - expected) > 0)
+        {
+            // Overwritten by a later frame: skip to half a ring behind the
+            // publishers, leaving room to catch up
+            uint32_t const newest = __atomic_load_n(&header->next, __ATOMIC_RELAXED);
+            uint32_t const skipTo = newest - slots / 2;
+            if ((int32_t)(skipTo - ring->next) > 0)
+            {
+                if (lost)
+                    *lost += skipTo - ring->next;
+                ring->next = skipTo;
+            }
+            else
+            {
+                if (lost)
+                    (*lost)++;
+                ring->next++;
+            }
+            continue;
+        }
+        if (timeoutMs == 0)
+            return NULL;
+
+        __atomic_fetch_add(&header->waiters, 1, __ATOMIC_SEQ_CST);
+        long const r = futex(&slot->seq, FUTEX_WAIT, seq, timeoutMs < 0 ? NULL : &timeout);
+        int const error = errno;
+        __atomic_fetch_sub(&header->waiters, 1, __ATOMIC_RELAXED);
+        if (r != 0 && error == ETIMEDOUT)
+            return NULL;
+    }
+}
+
+/**
+ * Returns true if slot, the last one returned by shmNext(), still holds the
+ * frame it was returned with, i.e. everything read from it is consistent.
+ */
+bool shmValid(shmRing const *ring, shmSlot const *slot)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == ring->seq;
+}
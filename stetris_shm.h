@@ -0,0 +1,79 @@
+/**
+ * @file stetris_shm.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Shared-memory ring of game states for agents in other processes.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A game started with --publish FILE writes its state after every tick into
+ * the next slot of a ring in FILE (best on a tmpfs such as /dev/shm), and any
+ * number of processes that map the same file read it in place: no pipe, no
+ * socket and no serialisation, the slot is the engine state itself. The file
+ * is laid out as
+ *   shmHeader, then slots shmSlot
+ * Frame f goes to slot f % slots. The seq word of a slot is a seqlock and
+ * the futex readers sleep on: 2f + 1 while frame f is written, 2f + 2 once
+ * it is complete. A reader checks with shmValid() after using a slot that it
+ * was not overwritten meanwhile; one that falls more than a ring behind
+ * skips ahead and counts the frames it lost. Publishing never waits for the
+ * readers.
+ */
+
+#ifndef STETRIS_SHM_H
+#define STETRIS_SHM_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for fixed width integer types
+
+#include "stetris_engine.h"
+
+#define SHM_MAGIC "SOBS"
+#define SHM_VERSION 1
+#define SHM_DEFAULT_SLOTS 4096
+
+typedef struct
+{
+    char magic[4];                      // SHM_MAGIC, written last by shmCreate()
+    uint32_t version;                   // SHM_VERSION
+    uint32_t slots;                     // a power of two
+    uint32_t slotSize;                  // sizeof(shmSlot)
+    uint32_t next;                      // frames handed out to publishers so far
+    uint32_t waiters;                   // readers asleep on a slot
+} __attribute__((aligned(64))) shmHeader;
+
+typedef struct
+{
+    uint32_t seq;                       // seqlock and futex word, see above
+    uint32_t game;                      // which game of the publisher, 0 for a single game
+    uint64_t occupied;                  // as engineState, including the active tile
+    uint8_t activeX;
+    uint8_t activeY;
+    uint8_t state;
+    uint8_t reserved;
+    uint32_t tiles;
+    uint32_t rows;
+    uint32_t score;
+    uint32_t level;
+    uint32_t tick;
+    uint32_t nextGameTick;
+} __attribute__((aligned(64))) shmSlot;   // one cache line, so publishers on other cores do not share lines
+
+typedef struct
+{
+    void *map;                          // mapped ring file
+    size_t size;
+    shmHeader *header;
+    shmSlot *slots;
+    uint32_t next;                      // reader: frame shmNext() returns next
+    uint32_t seq;                       // reader: seq of the slot shmNext() returned last
+} shmRing;
+
+bool shmCreate(shmRing *ring, char const *path, uint32_t slots);
+bool shmAttach(shmRing *ring, char const *path);
+void shmDetach(shmRing *ring);
+void shmPublish(shmRing *ring, uint32_t game, engineState const *s);
+shmSlot const *shmNext(shmRing *ring, int timeoutMs, uint32_t *lost);
+bool shmValid(shmRing const *ring, shmSlot const *slot);
+
+#endif // STETRIS_SHM_H
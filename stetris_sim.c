@@ -0,0 +1,834 @@
+/**
+ * @file stetris_sim.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Headless simulator that lets the bot play many seeded games.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Runs the game engine without rendering and without waiting for the tick
+ * time, so it can be used for load tests and to measure bot strength.
+ * Every game is seeded with seed + game index and is fully reproducible.
+ * --publish FILE writes the state after every tick into a shared-memory ring
+ * for agents in other processes, see stetris_shm.h.
+ * --workers N forks N processes, each pinned to a core, that play
+ * consecutive shards of the seeds with a bot of their own. They add the
+ * counters of every finished game with atomics to totals in a shared
+ * mapping, which the parent reports live and at the end, so a worker that
+ * crashes loses only the game it was playing and its unplayed seeds.
+ * --checkpoint FILE saves the run every --checkpoint-interval seconds: the
+ * parent asks the workers to copy their game in progress into their record
+ * at the next new tile and writes the records to FILE while they play on.
+ * --resume continues a run with the same options from FILE, with the same
+ * results as without the interruption for bots that decide by the game
+ * state alone.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_gettime() with -std=c99
+
+#include <limits.h>                     // for PATH_MAX
+#include <sched.h>                      // for sched_setaffinity(), CPU_SET, sched_yield()
+#include <signal.h>                     // for SIGKILL
+#include <stdio.h>                      // for printf(), fprintf(), fopen(), rename()
+#include <stdlib.h>                     // for exit()
+#include <string.h>                     // for strcmp, strsignal, memcmp, memcpy
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/prctl.h>                  // for prctl()
+#include <sys/wait.h>                   // for waitpid(), WIFEXITED
+#include <time.h>                       // for clock_gettime, nanosleep
+#include <unistd.h>                     // for fork(), sysconf(), isatty(), _exit()
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_shm.h"
+#include "stetris_args.h"
+
+#define MAX_WORKERS 256
+#define HISTOGRAM_BUCKETS 33            // tiles per game by bit length, 0 to 32
+#define CHECKPOINT_MAGIC "SCKP"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_WAIT_USEC 2000000    // longest wait for the workers to reach a new tile
+
+typedef struct
+{
+    unsigned long games;                // number of games to play
+    unsigned long seed;                 // seed of the first game
+    unsigned long maxTiles;             // stop a game after this many tiles
+    unsigned long batch;                // games played side by side with a plugin or remote bot
+    shmRing *publish;                   // --publish ring every tick is written to, NULL if none
+    unsigned int workers;               // processes playing shards of the games, 0 for one per CPU
+    bool histogram;                     // print the distribution of tiles per game
+    char const *checkpoint;             // file the run is saved to, NULL for none
+    unsigned long checkpointInterval;   // seconds between checkpoints
+    bool resume;                        // continue the run saved in checkpoint
+} simOptions;
+
+typedef struct
+{
+    unsigned long long ticks;           // game ticks simulated
+    unsigned long long tiles;           // tiles played
+    unsigned long long rows;            // rows cleared
+    unsigned long long score;           // sum of final scores
+    unsigned long maxLevel;             // highest level reached
+    unsigned long capped;               // games stopped by maxTiles
+    unsigned long games;                // games finished
+    double maxDecisionUSec;             // slowest botNextKey() call
+    unsigned long tileHistogram[HISTOGRAM_BUCKETS];     // games with tiles in [2^(i-1), 2^i)
+} simResult;
+
+/**
+ * Record of one worker in the shared mapping, written only by the worker
+ * under the seqlock seq and copied by the parent into checkpoints. It is
+ * complete on its own: the worker continues from it on --resume.
+ */
+typedef struct
+{
+    uint32_t seq;                       // odd while the worker rewrites the record
+    uint32_t epoch;                     // checkpoint request answered last
+    uint32_t inGame;                    // 1 if game and current hold a game in progress
+    uint32_t reserved;
+    engineState game;                   // the game in progress, at a new tile
+    simResult current;                  // its counters so far
+    simResult res;                      // games finished, as added to the totals
+    unsigned long long decisions;       // counters of the bot of the worker
+    unsigned long long nodes;
+    double uSecSearching;
+} simWorker;
+
+/**
+ * Mapping shared by the parent and the workers.
+ */
+typedef struct
+{
+    simResult res;                      // totals of all workers, updated with atomics
+    uint32_t checkpoint;                // checkpoint requested last by the parent
+    simWorker workers[MAX_WORKERS];
+} simShared;
+
+/**
+ * A shard of games as played by one worker, or by the process itself when
+ * there are no workers; record is NULL then.
+ */
+typedef struct
+{
+    simOptions const *opt;
+    bot *b;
+    simResult *total;                   // totals of all workers
+    simResult finished;                 // games finished by this worker
+    simWorker *record;                  // its record in the shared mapping
+    uint32_t const *checkpoint;         // checkpoint requested by the parent
+} simShard;
+
+/**
+ * Header of a checkpoint file, followed by one simWorker per worker. The
+ * options must match those of the run that is resumed.
+ */
+typedef struct
+{
+    char magic[4];                      // CHECKPOINT_MAGIC
+    uint32_t version;                   // CHECKPOINT_VERSION
+    uint64_t games;
+    uint64_t seed;
+    uint64_t maxTiles;
+    uint64_t batch;
+    uint32_t workers;
+    uint32_t botKind;
+    uint32_t workerSize;                // sizeof(simWorker)
+    uint32_t reserved;
+    engineRules rules;                  // gameRules of the run
+} checkpointHeader;
+
+/**
+ * Returns the current monotonic time in microseconds.
+ */
+static inline double uSecNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--games N] [--seed S] [--max-tiles N] [--batch N] [--publish FILE] [--workers N]"
+                    " [--histogram] [--checkpoint FILE [--checkpoint-interval SEC] [--resume]]"
+                    " " ENGINE_USAGE " " BOT_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Adds the counters of a finished game to the result.
+ */
+static void finishGame(engineState const *s, simResult *res)
+{
+    if (s->state != GAMEOVER)
+        res->capped++;
+    res->tiles += s->tiles;
+    res->rows += s->rows;
+    res->score += s->score;
+    if (s->level > res->maxLevel)
+        res->maxLevel = s->level;
+    res->games++;
+    res->tileHistogram[s->tiles ? 32 - __builtin_clz(s->tiles) : 0]++;
+}
+
+static void atomicMax(unsigned long *target, unsigned long value)
+{
+    unsigned long current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange_n(target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/**
+ * Raises a double to value with a compare and swap loop.
+ */
+static void atomicMaxDouble(double *target, double value)
+{
+    double current;
+    __atomic_load(target, &current, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange(target, &current, &value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/**
+ * Adds the result of finished games to the totals, which may be shared
+ * with other processes playing at the same time.
+ */
+static void addResult(simResult *total, simResult const *res)
+{
+    __atomic_fetch_add(&total->ticks, res->ticks, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total->tiles, res->tiles, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total->rows, res->rows, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total->score, res->score, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total->capped, res->capped, __ATOMIC_RELAXED);
+    atomicMax(&total->maxLevel, res->maxLevel);
+    atomicMaxDouble(&total->maxDecisionUSec, res->maxDecisionUSec);
+    for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (res->tileHistogram[i])
+            __atomic_fetch_add(&total->tileHistogram[i], res->tileHistogram[i], __ATOMIC_RELAXED);
+    }
+    // Last, so games is never ahead of the counters it averages
+    __atomic_fetch_add(&total->games, res->games, __ATOMIC_RELEASE);
+}
+
+/**
+ * Runs one engine step. A hard drop that ends the game would also restart
+ * it in the same step, so the key does not restart it here and the game
+ * ends in GAMEOVER with its own counters.
+ * With --publish the state after the step is published as game seed.
+ */
+static void stepGame(engineState *s, int const key, uint32_t seed, simOptions const *opt, simResult *res)
+{
+    engineStepNoRestart(s, key);
+    res->ticks++;
+    if (opt->publish)
+        shmPublish(opt->publish, seed, s);
+}
+
+/**
+ * Saves the state of the worker of sh into its record: game and current
+ * are the game in progress and its counters, or NULL between games. This
+ * answers the checkpoint requested last.
+ */
+static void saveRecord(simShard *sh, engineState const *game, simResult const *current)
+{
+    simWorker *r = sh->record;
+    uint32_t const request = __atomic_load_n(sh->checkpoint, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->inGame = game != NULL;
+    if (game)
+    {
+        r->game = *game;
+        r->current = *current;
+    }
+    r->res = sh->finished;
+    r->decisions = sh->b->decisions;
+    r->nodes = sh->b->nodes;
+    r->uSecSearching = sh->b->uSecSearching;
+    r->epoch = request;
+    __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Returns true if the parent asked for a checkpoint the worker of sh has
+ * not answered yet.
+ */
+static bool checkpointWanted(simShard const *sh)
+{
+    return sh->record && __atomic_load_n(sh->checkpoint, __ATOMIC_RELAXED) != sh->record->epoch;
+}
+
+/**
+ * Returns true if the bot makes a new decision in state s. It carries
+ * nothing over from the previous decision but its counters then, so a game
+ * saved at this point continues the same way.
+ */
+static bool atDecision(bot const *b, engineState const *s)
+{
+    if (botIsExternal(b))
+        return pluginNeedsDecision(&b->game, s);
+    return !b->planned || b->tiles != s->tiles;
+}
+
+/**
+ * Plays one game with the bot until game over or until maxTiles tiles,
+ * from the start or from a saved state resume with counters res.
+ */
+static void playGame(simShard *sh, uint32_t seed, engineState const *resume, simResult *res)
+{
+    engineState s;
+    bot *b = sh->b;
+
+    if (resume)
+        s = *resume;
+    else
+    {
+        engineInit(&s, seed);
+        engineStep(&s, KEY_UP);     // any key starts a new game
+    }
+
+    while (s.state != GAMEOVER && s.tiles < sh->opt->maxTiles)
+    {
+        if (checkpointWanted(sh) && atDecision(b, &s))
+            saveRecord(sh, &s, res);
+
+        double const start = uSecNow();
+        int const key = botNextKey(b, &s);
+        double const elapsed = uSecNow() - start;
+        if (elapsed > res->maxDecisionUSec)
+            res->maxDecisionUSec = elapsed;
+
+        stepGame(&s, key, seed, sh->opt, res);
+    }
+    finishGame(&s, res);
+}
+
+/**
+ * Plays count games side by side with a plugin or remote bot, seeded from
+ * seed on. All games that wait for a decision in a tick are passed to the
+ * bot in one batched call.
+ */
+static void playExternalBatch(uint32_t seed, unsigned long count, simOptions const *opt, bot *b, simResult *res)
+{
+    engineState states[PLUGIN_BATCH];
+    pluginGame games[PLUGIN_BATCH];
+    bool running[PLUGIN_BATCH];
+    uint32_t waiting[PLUGIN_BATCH];
+    unsigned long left = count;
+
+    memset(games, 0, sizeof(games));
+    for (unsigned long i = 0; i < count; i++)
+    {
+        engineInit(&states[i], seed + i);
+        engineStep(&states[i], KEY_UP);
+        running[i] = true;
+    }
+
+    while (left > 0)
+    {
+        unsigned int n = 0;
+        for (unsigned long i = 0; i < count; i++)
+        {
+            if (running[i] && pluginNeedsDecision(&games[i], &states[i]))
+                waiting[n++] = i;
+        }
+        if (n > 0)
+        {
+            double const start = uSecNow();
+            botDecideExternal(b, states, games, waiting, n);
+            double const elapsed = uSecNow() - start;
+            if (elapsed > res->maxDecisionUSec)
+                res->maxDecisionUSec = elapsed;
+        }
+
+        for (unsigned long i = 0; i < count; i++)
+        {
+            if (!running[i])
+                continue;
+            stepGame(&states[i], pluginNextKey(&games[i]), seed + i, opt, res);
+            if (states[i].state == GAMEOVER || states[i].tiles >= opt->maxTiles)
+            {
+                finishGame(&states[i], res);
+                botEndExternalGame(b, &games[i], i);
+                running[i] = false;
+                left--;
+            }
+        }
+    }
+}
+
+/**
+ * Adds finished games to the totals and to the worker's own result, and
+ * saves its record.
+ */
+static void addGames(simShard *sh, simResult const *res)
+{
+    addResult(sh->total, res);
+    addResult(&sh->finished, res);
+    if (sh->record)
+        saveRecord(sh, NULL, NULL);
+}
+
+/**
+ * Plays count games from game first on, skipping those finished already
+ * and continuing the game in progress when resuming.
+ */
+static void playShard(simShard *sh, unsigned long first, unsigned long count)
+{
+    simOptions const *opt = sh->opt;
+    unsigned long g = first + sh->finished.games;
+
+    if (sh->record && sh->record->inGame && g < first + count)
+    {
+        simResult res = sh->record->current;
+        playGame(sh, (uint32_t)(opt->seed + g), &sh->record->game, &res);
+        addGames(sh, &res);
+        g++;
+    }
+    while (g < first + count)
+    {
+        simResult res = {0};
+        unsigned long n = 1;
+        if (botIsExternal(sh->b) && opt->batch > 1)
+        {
+            // Saved between batches only, the games of a batch are not
+            n = (first + count - g < opt->batch) ? first + count - g : opt->batch;
+            playExternalBatch((uint32_t)(opt->seed + g), n, opt, sh->b, &res);
+        }
+        else
+            playGame(sh, (uint32_t)(opt->seed + g), NULL, &res);
+        addGames(sh, &res);
+        g += n;
+    }
+}
+
+/**
+ * Pins the calling process to one core.
+ */
+static void pinToCore(unsigned int core)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        fprintf(stderr, "WARNING: could not pin worker to core %u\n", core);
+}
+
+/**
+ * The first game of the shard of worker w.
+ */
+static unsigned long shardStart(simOptions const *opt, unsigned int w)
+{
+    return (unsigned long)((unsigned long long)opt->games * w / opt->workers);
+}
+
+/**
+ * Body of worker process w: plays its shard, continuing from its record,
+ * which is empty unless resuming. Does not return.
+ */
+static void runWorker(simOptions const *opt, botOptions const *botOpt, simShared *shared, unsigned int w)
+{
+    long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    bot b;
+    simShard sh = {
+        .opt = opt,
+        .b = &b,
+        .total = &shared->res,
+        .record = &shared->workers[w],
+        .checkpoint = &shared->checkpoint,
+    };
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL);   // no orphans playing on if the parent is killed
+    pinToCore(w % (cpus > 0 ? cpus : 1));
+    if (!botCreate(&b, botOpt))
+        _exit(EXIT_FAILURE);
+    sh.finished = sh.record->res;
+    b.decisions = sh.record->decisions;
+    b.nodes = sh.record->nodes;
+    b.uSecSearching = sh.record->uSecSearching;
+
+    unsigned long const first = shardStart(opt, w);
+    playShard(&sh, first, shardStart(opt, w + 1) - first);
+    botDestroy(&b);
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Copies the record of a worker that may be writing it at the same time.
+ */
+static void readRecord(simWorker const *r, simWorker *copy)
+{
+    for (;;)
+    {
+        uint32_t const seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+        memcpy(copy, r, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == seq)
+            return;
+    }
+}
+
+/**
+ * Writes the records of all workers to opt->checkpoint, through a
+ * temporary file renamed over it, so there is always one complete
+ * checkpoint. Returns false on errors.
+ */
+static bool writeCheckpoint(simOptions const *opt, botOptions const *botOpt, simShared const *shared)
+{
+    char temp[PATH_MAX];
+    checkpointHeader header = {
+        .magic = CHECKPOINT_MAGIC,
+        .version = CHECKPOINT_VERSION,
+        .games = opt->games,
+        .seed = opt->seed,
+        .maxTiles = opt->maxTiles,
+        .batch = opt->batch,
+        .workers = opt->workers,
+        .botKind = botOpt->kind,
+        .workerSize = sizeof(simWorker),
+    };
+    memcpy(&header.rules, &gameRules, sizeof(gameRules));  // with its padding, as compared on --resume
+
+    snprintf(temp, sizeof(temp), "%s.tmp", opt->checkpoint);
+    FILE *f = fopen(temp, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (unsigned int w = 0; ok && w < opt->workers; w++)
+    {
+        simWorker record;
+        readRecord(&shared->workers[w], &record);
+        ok = fwrite(&record, sizeof(record), 1, f) == 1;
+    }
+    ok = (fclose(f) == 0) && ok;
+    return ok && rename(temp, opt->checkpoint) == 0;
+}
+
+/**
+ * Loads the records of a checkpoint of the same run into the shared
+ * mapping and adds them up into its totals. Returns false if the file
+ * cannot be read or belongs to another run.
+ */
+static bool loadCheckpoint(simOptions const *opt, botOptions const *botOpt, simShared *shared)
+{
+    checkpointHeader header;
+    FILE *f = fopen(opt->checkpoint, "rb");
+    if (!f)
+        return false;
+
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CHECKPOINT_VERSION && header.workerSize == sizeof(simWorker) &&
+              header.games == opt->games && header.seed == opt->seed && header.maxTiles == opt->maxTiles &&
+              header.batch == opt->batch && header.workers == opt->workers && header.botKind == botOpt->kind &&
+              memcmp(&header.rules, &gameRules, sizeof(gameRules)) == 0;
+    for (unsigned int w = 0; ok && w < opt->workers; w++)
+    {
+        simWorker *r = &shared->workers[w];
+        ok = fread(r, sizeof(*r), 1, f) == 1;
+        r->seq = 0;
+        r->epoch = 0;
+        addResult(&shared->res, &r->res);
+    }
+    fclose(f);
+    return ok;
+}
+
+/**
+ * Forks the workers and waits for all of them while printing the progress
+ * to stderr and, with --checkpoint, saving the run every interval. Returns
+ * how many of them did not exit cleanly.
+ */
+static unsigned int runWorkers(simOptions const *opt, botOptions const *botOpt, simShared *shared)
+{
+    pid_t pids[MAX_WORKERS];
+    unsigned int running = 0, failed = 0;
+
+    fflush(stdout);
+    for (unsigned int w = 0; w < opt->workers; w++)
+    {
+        pids[w] = fork();
+        if (pids[w] == 0)
+            runWorker(opt, botOpt, shared, w);
+        if (pids[w] < 0)
+        {
+            fprintf(stderr, "ERROR: could not fork worker %u\n", w);
+            failed++;
+        }
+        else
+            running++;
+    }
+
+    bool const tty = isatty(STDERR_FILENO);
+    double const start = uSecNow();
+    double lastReport = start;
+    double nextCheckpoint = start + opt->checkpointInterval * 1e6;
+    double requested = 0;               // time of the pending checkpoint request, 0 if none
+    unsigned long long const ticksBefore = shared->res.ticks;
+    while (running > 0)
+    {
+        int status;
+        pid_t const pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0)
+        {
+            unsigned int w = 0;
+            while (w < opt->workers && pids[w] != pid)
+                w++;
+            if (w == opt->workers)
+                continue;
+            pids[w] = 0;
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            {
+                unsigned long const first = shardStart(opt, w);
+                simWorker record;
+                readRecord(&shared->workers[w], &record);
+                failed++;
+                fprintf(stderr, "%sWorker %u (seeds %lu to %lu) %s %s after %lu of %lu games\n", tty ? "\n" : "", w,
+                        opt->seed + first, opt->seed + shardStart(opt, w + 1) - 1,
+                        WIFSIGNALED(status) ? "killed by" : "failed", WIFSIGNALED(status) ? strsignal(WTERMSIG(status)) : "",
+                        record.res.games, shardStart(opt, w + 1) - first);
+            }
+            continue;
+        }
+
+        struct timespec const pause = {0, 100000000};
+        nanosleep(&pause, NULL);
+        double const now = uSecNow();
+        if (opt->checkpoint && !requested && now >= nextCheckpoint)
+        {
+            // Every worker saves its game at the next new tile
+            __atomic_add_fetch(&shared->checkpoint, 1, __ATOMIC_RELEASE);
+            requested = now;
+        }
+        if (requested)
+        {
+            uint32_t const request = __atomic_load_n(&shared->checkpoint, __ATOMIC_RELAXED);
+            bool answered = true;
+            for (unsigned int w = 0; w < opt->workers; w++)
+            {
+                if (pids[w] > 0 && __atomic_load_n(&shared->workers[w].epoch, __ATOMIC_ACQUIRE) != request)
+                    answered = false;
+            }
+            // A worker that does not answer in time is saved as of its last answer
+            if (answered || now - requested >= CHECKPOINT_WAIT_USEC)
+            {
+                if (!writeCheckpoint(opt, botOpt, shared))
+                    fprintf(stderr, "%sWARNING: could not write checkpoint %s\n", tty ? "\n" : "", opt->checkpoint);
+                requested = 0;
+                nextCheckpoint = now + opt->checkpointInterval * 1e6;
+            }
+        }
+        if (now - lastReport >= 1e6)
+        {
+            lastReport = now;
+            unsigned long const games = __atomic_load_n(&shared->res.games, __ATOMIC_ACQUIRE);
+            unsigned long long const ticks = __atomic_load_n(&shared->res.ticks, __ATOMIC_RELAXED) - ticksBefore;
+            fprintf(stderr, "%s%lu/%lu games, %u workers running, %.0f ticks/s%s", tty ? "\r" : "", games, opt->games,
+                    running, ticks / ((now - start) / 1e6), tty ? "   " : "\n");
+        }
+    }
+    if (tty && uSecNow() - start >= 1e6)
+        fputc('\n', stderr);
+    if (opt->checkpoint && !writeCheckpoint(opt, botOpt, shared))
+        fprintf(stderr, "WARNING: could not write checkpoint %s\n", opt->checkpoint);
+    return failed;
+}
+
+/**
+ * Prints the distribution of tiles per game, one line per power of two.
+ */
+static void printHistogram(simResult const *res)
+{
+    unsigned long most = 1;
+    for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        if (res->tileHistogram[i] > most)
+            most = res->tileHistogram[i];
+
+    printf("Tiles per game:\n");
+    for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (!res->tileHistogram[i])
+            continue;
+        unsigned long const low = i ? 1UL << (i - 1) : 0;
+        unsigned long const high = i ? (1UL << i) - 1 : 0;
+        printf("  %10lu - %-10lu %10lu  ", low, high, res->tileHistogram[i]);
+        for (unsigned long bar = 0; bar < 40 * res->tileHistogram[i] / most; bar++)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    simOptions opt = {
+        .games = 100,
+        .seed = 1,
+        .maxTiles = 10000,
+        .batch = 1,
+        .workers = 1,
+        .histogram = false,
+        .checkpoint = NULL,
+        .checkpointInterval = 60,
+        .resume = false,
+    };
+    botOptions botOpt = defaultBotOptions;
+    bot b;
+    shmRing ring;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--games") == 0)
+            opt.games = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0)
+            opt.seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--max-tiles") == 0)
+            opt.maxTiles = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--batch") == 0)
+            opt.batch = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--publish") == 0)
+        {
+            if (!shmCreate(&ring, argv[++i], SHM_DEFAULT_SLOTS))
+            {
+                fprintf(stderr, "ERROR: could not create the ring in %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            opt.publish = &ring;
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--workers") == 0)
+            opt.workers = parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--histogram") == 0)
+            opt.histogram = true;
+        else if (i + 1 < argc && strcmp(argv[i], "--checkpoint") == 0)
+            opt.checkpoint = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--checkpoint-interval") == 0)
+            opt.checkpointInterval = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--resume") == 0)
+            opt.resume = true;
+        else if (!engineParseRule(&gameRules, argc, argv, &i) && !botParseOption(&botOpt, argc, argv, &i))
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.workers == 0)
+    {
+        long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        opt.workers = cpus > 0 ? cpus : 1;
+    }
+    if (opt.workers > opt.games)
+        opt.workers = opt.games;
+    if (opt.games == 0 || opt.batch == 0 || opt.batch > PLUGIN_BATCH || opt.workers > MAX_WORKERS ||
+        (opt.resume && !opt.checkpoint))
+        usage(argv[0]);
+
+    // Checkpoints are written by the parent while a worker plays, even a single one
+    bool const forked = opt.workers > 1 || opt.checkpoint;
+    simResult res = {0};
+    unsigned long long decisions = 0, nodes = 0, ticksBefore = 0;
+    double uSecSearching = 0;
+    unsigned int failed = 0;
+    double const start = uSecNow();
+    if (!forked)
+    {
+        simShard sh = {.opt = &opt, .b = &b, .total = &res};
+        if (!botCreate(&b, &botOpt))
+            return EXIT_FAILURE;
+        playShard(&sh, 0, opt.games);
+        decisions = b.decisions;
+        nodes = b.nodes;
+        uSecSearching = b.uSecSearching;
+    }
+    else
+    {
+        simShared *shared = mmap(NULL, sizeof(simShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shared == MAP_FAILED)
+        {
+            fprintf(stderr, "ERROR: could not map the shared totals\n");
+            return EXIT_FAILURE;
+        }
+        memset(shared, 0, sizeof(*shared));
+        if (opt.resume && !loadCheckpoint(&opt, &botOpt, shared))
+        {
+            fprintf(stderr, "ERROR: %s is not a checkpoint of a run with these options\n", opt.checkpoint);
+            return EXIT_FAILURE;
+        }
+        ticksBefore = shared->res.ticks;
+        // Every worker is pinned to one core, so its search runs there too
+        if (botOpt.threads == 0)
+            botOpt.threads = 1;
+        failed = runWorkers(&opt, &botOpt, shared);
+        res = shared->res;
+        for (unsigned int w = 0; w < opt.workers; w++)
+        {
+            decisions += shared->workers[w].decisions;
+            nodes += shared->workers[w].nodes;
+            uSecSearching += shared->workers[w].uSecSearching;
+        }
+        munmap(shared, sizeof(*shared));
+    }
+    double const seconds = (uSecNow() - start) / 1e6;
+    double const games = res.games ? res.games : 1;
+
+    printf("Games:        %10lu (%lu reached --max-tiles)\n", res.games, res.capped);
+    printf("Tiles/game:   %10.1f\n", res.tiles / games);
+    printf("Rows/game:    %10.1f\n", res.rows / games);
+    printf("Score/game:   %10.1f\n", res.score / games);
+    printf("Max level:    %10lu\n", res.maxLevel);
+    printf("Ticks/sec:    %10.0f\n", (res.ticks - ticksBefore) / seconds);
+    printf("Max decision: %10.1f us (tick is %lu us)\n", res.maxDecisionUSec, gameRules.uSecTickTime);
+    printf("Decisions:    %10llu (%.1f us each)\n", decisions, uSecSearching / decisions);
+    if (opt.histogram)
+        printHistogram(&res);
+    if (forked)
+    {
+        if (botOpt.kind != BOT_PLUGIN && botOpt.kind != BOT_REMOTE)
+            printf("Nodes/sec:    %10.0f (per worker)\n", nodes / (uSecSearching / 1e6));
+        printf("Workers:      %10u (%u failed, %lu games not played)\n", opt.workers, failed, opt.games - res.games);
+    }
+    else
+    {
+        if (!botIsExternal(&b))
+            printf("Nodes/sec:    %10.0f (%u threads)\n", b.nodes / (b.uSecSearching / 1e6), poolThreads(b.pool));
+        if (b.oracle.map)
+            printf("Oracle:       %10llu decisions from the solver table\n", b.oracleDecisions);
+        if (b.book.map)
+            printf("Book:         %10llu decisions from the opening book\n", b.bookDecisions);
+        if (b.mlp.map)
+            printf("Evaluator:    %10s network kernel\n", b.mlp.kernelName);
+        if (botOpt.kind == BOT_EXPECTIMAX)
+        {
+            printf("Avg depth:    %10.2f\n", (double)b.depthSum / b.decisions);
+            ttStats const *t = &b.probeStats;
+            printf("TT probes:    %10llu (%.1f%% hits, %.1f%% collisions, %u MB)\n", t->probes,
+                   100.0 * t->hits / (t->probes ? t->probes : 1),
+                   100.0 * t->collisions / (t->probes ? t->probes : 1), botOpt.ttMegabytes);
+        }
+        if (botOpt.kind == BOT_MCTS)
+            printf("Playouts/sec: %10.0f\n", b.playouts / (b.uSecSearching / 1e6));
+        if (botOpt.kind == BOT_PLUGIN)
+            printf("Plugin:       %10s (%llu decisions after --budget)\n", b.plugin->name, b.lateDecisions);
+        if (botOpt.kind == BOT_REMOTE)
+            printf("Remote bot:   %10s (%llu timed out, slowest reply %.1f us)\n", remoteName(&b), b.lateDecisions,
+                   b.maxRequestUSec);
+
+        botDestroy(&b);
+    }
+    if (opt.publish)
+        shmDetach(opt.publish);
+    // The totals of the other workers are printed, but the run is not complete
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file stetris_solve.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Tables of exact survival values written by stetris_solver.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Tables are mapped read-only, so the pages of a large table are loaded
+ * on demand and shared by all processes using it.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() with -std=c99
+
+#include "stetris_solve.h"
+
+#include <fcntl.h>                      // for open()
+#include <stdio.h>                      // for FILE, fwrite()
+#include <string.h>                     // for memcmp, memcpy, memset
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/stat.h>                   // for fstat()
+#include <unistd.h>                     // for close()
+
+/**
+ * Maps a table file. Returns false if it cannot be read or is not a table.
+ */
+bool solveLoad(solveTable *t, char const *path)
+{
+    memset(t, 0, sizeof(*t));
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(solveHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    solveHeader const *header = map;
+    if (memcmp(header->magic, SOLVE_MAGIC, sizeof(header->magic)) != 0 || header->version != SOLVE_VERSION ||
+        (size_t)st.st_size != sizeof(solveHeader) + header->states * (sizeof(uint64_t) + sizeof(uint16_t)))
+    {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    t->map = map;
+    t->size = st.st_size;
+    t->period = header->period;
+    t->complete = header->complete != 0;
+    t->states = header->states;
+    t->boards = (uint64_t const *)(header + 1);
+    t->values = (uint16_t const *)(t->boards + t->states);
+    return true;
+}
+
+void solveUnload(solveTable *t)
+{
+    if (t->map)
+        munmap(t->map, t->size);
+    t->map = NULL;
+}
+
+/**
+ * Returns the value of board, or -1 if it is not in the table.
+ */
+int solveLookup(solveTable const *t, uint64_t board)
+{
+    uint64_t low = 0, high = t->states;
+    while (low < high)
+    {
+        uint64_t const middle = low + (high - low) / 2;
+        if (t->boards[middle] < board)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return (low < t->states && t->boards[low] == board) ? t->values[low] : -1;
+}
+
+/**
+ * Writes a table of states boards, sorted ascending, and their values.
+ * Returns false if the file cannot be written.
+ */
+bool solveWrite(char const *path, uint32_t period, bool complete,
+                uint64_t const *boards, uint16_t const *values, uint64_t states)
+{
+    solveHeader header = {.version = SOLVE_VERSION, .period = period, .complete = complete, .states = states};
+    memcpy(header.magic, SOLVE_MAGIC, sizeof(header.magic));
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool const ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                    fwrite(boards, sizeof(uint64_t), states, f) == states &&
+                    fwrite(values, sizeof(uint16_t), states, f) == states;
+    return (fclose(f) == 0) && ok;
+}
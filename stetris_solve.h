@@ -0,0 +1,53 @@
+/**
+ * @file stetris_solve.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Tables of exact survival values written by stetris_solver.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A table holds, for every board reachable at one fall speed, the most
+ * tiles that can still be played from it with perfect play, counting the
+ * tile that has just spawned. The key is the settled board when a new tile
+ * appears in column SPAWN_X of row 0 with period keys left before it falls.
+ * The file is mapped read-only:
+ *   solveHeader, then states sorted boards (uint64), then states values (uint16)
+ */
+
+#ifndef STETRIS_SOLVE_H
+#define STETRIS_SOLVE_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for fixed width integer types
+
+#define SOLVE_MAGIC "SSOL"
+#define SOLVE_VERSION 1
+#define SOLVE_FOREVER 0xFFFF            // value of boards from which the game never has to end
+
+typedef struct
+{
+    char magic[4];                      // SOLVE_MAGIC
+    uint32_t version;                   // SOLVE_VERSION
+    uint32_t period;                    // nextGameTick the table was solved for
+    uint32_t complete;                  // 0 if the state limit cut the search, values are lower bounds
+    uint64_t states;
+} solveHeader;
+
+typedef struct
+{
+    void *map;                          // mapped table file
+    size_t size;
+    uint32_t period;
+    bool complete;
+    uint64_t states;
+    uint64_t const *boards;             // sorted
+    uint16_t const *values;
+} solveTable;
+
+bool solveLoad(solveTable *t, char const *path);
+void solveUnload(solveTable *t);
+int solveLookup(solveTable const *t, uint64_t board);
+bool solveWrite(char const *path, uint32_t period, bool complete,
+                uint64_t const *boards, uint16_t const *values, uint64_t states);
+
+#endif // STETRIS_SOLVE_H
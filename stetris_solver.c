@@ -0,0 +1,341 @@
+/**
+ * @file stetris_solver.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Exhaustive solver for survival in the 8x8 single tile game.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * At a fixed fall speed the game is a deterministic graph: tiles are single
+ * cells and only their color is random, so the future of a decision depends
+ * on nothing but the settled board when the tile spawns. That board is the
+ * canonical key of a state; colors, counters and the tick phase are dropped.
+ * (Mirroring is no symmetry, since tiles spawn in column 3 of 8.)
+ * The solver enumerates every board reachable from the empty one with a
+ * breadth-first frontier expanded in parallel into a lock-free hash set,
+ * storing the successor edges of each state. Values are then computed by
+ * a memoised DP over the edge arrays: after sweep k, V(s) is the most tiles
+ * playable from s within k tiles. States still at V = k after a sweep form a
+ * shrinking set; once it stops shrinking, each of its states has a
+ * successor inside it and can be played forever. All other values are exact.
+ * The result is written as a sorted table (stetris_solve.h) that bots load
+ * with --oracle. Every phase reports its throughput, which makes the solver
+ * a benchmark of the move generator and of the memory system.
+ */
+
+#define _GNU_SOURCE                     // Enables mmap() flags with -std=c99
+
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for malloc(), qsort(), exit()
+#include <string.h>                     // for strcmp
+#include <sys/mman.h>                   // for mmap(), munmap()
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_solve.h"
+#include "stetris_args.h"
+
+#define CHUNK 4096                      // states per pool task
+#define NO_STATE UINT32_MAX             // successor cut off by --max-states, valued 0
+#define DEAD_END (UINT32_MAX - 1)       // successor where no new tile can spawn
+
+typedef struct
+{
+    unsigned int period;                // nextGameTick to solve for
+    unsigned long maxStates;            // stop the enumeration after this many boards
+    unsigned int threads;               // 0 for one per CPU
+    char const *out;                    // table file
+} solverOptions;
+
+/**
+ * Enumerated states and the hash set mapping boards to their index.
+ * Arrays are reserved with mmap() for the worst case and only the touched
+ * pages are backed by memory. Hash keys are stored inverted, so the zeroed
+ * pages read as empty: the full board is no state, its spawn cell is taken.
+ */
+typedef struct
+{
+    solverOptions const *opt;
+    uint64_t *keys;                     // ~board, 0 for an empty slot
+    uint32_t *ids;                      // state index + 1, 0 until published
+    uint64_t mask;                      // hash slots - 1
+    uint64_t *boards;                   // by state index, in breadth-first order
+    uint32_t *edgeStart;                // first edge of each state
+    uint8_t *edgeCount;
+    uint32_t *edges;                    // successor state indices, NO_STATE or DEAD_END
+    uint32_t states;                    // states enumerated (atomic)
+    uint64_t edgeTotal;                 // edges allocated (atomic)
+    uint32_t layerBegin, layerEnd;      // frontier being expanded
+    bool truncated;                     // --max-states was reached (atomic)
+    uint16_t *value;                    // V after the last sweep
+    uint16_t *next;                     // V after the current sweep
+    uint16_t horizon;                   // k + 1 of the current sweep
+    uint32_t growing;                   // states with V = horizon after the sweep (atomic)
+} solver;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--period P] [--max-states N] [--threads N] [--out FILE]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Reserves zero filled memory that is only backed by pages once they are touched.
+ */
+static void *reserve(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/**
+ * Returns the index of board, adding it as a new state if it is not known.
+ * Returns NO_STATE if it is new and the state limit has been reached; such
+ * boards do not claim a slot, so the probes of a truncated set still end.
+ */
+static uint32_t findOrAdd(solver *v, uint64_t board)
+{
+    uint64_t const key = ~board;
+    uint64_t slot = boardHash(board) & v->mask;
+
+    for (;;)
+    {
+        uint64_t current = __atomic_load_n(&v->keys[slot], __ATOMIC_ACQUIRE);
+        if (current == 0 && __atomic_load_n(&v->states, __ATOMIC_RELAXED) >= v->opt->maxStates)
+        {
+            __atomic_store_n(&v->truncated, true, __ATOMIC_RELAXED);
+            return NO_STATE;
+        }
+        if (current == 0 &&
+            __atomic_compare_exchange_n(&v->keys[slot], &current, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            uint32_t const id = __atomic_fetch_add(&v->states, 1, __ATOMIC_RELAXED);
+            if (id >= v->opt->maxStates)
+            {
+                __atomic_store_n(&v->truncated, true, __ATOMIC_RELAXED);
+                __atomic_store_n(&v->ids[slot], NO_STATE, __ATOMIC_RELEASE);
+                return NO_STATE;
+            }
+            v->boards[id] = board;
+            __atomic_store_n(&v->ids[slot], id + 1, __ATOMIC_RELEASE);
+            return id;
+        }
+        if (current == key)
+        {
+            // Another thread may have claimed the slot and not published the index yet
+            uint32_t id;
+            while ((id = __atomic_load_n(&v->ids[slot], __ATOMIC_ACQUIRE)) == 0)
+            {
+            }
+            return (id == NO_STATE) ? NO_STATE : id - 1;
+        }
+        if (current != 0)
+            slot = (slot + 1) & v->mask;
+    }
+}
+
+/**
+ * Generates the placements of the frontier states of one chunk and records
+ * their successors, adding the new ones to the next frontier.
+ */
+static void expandTask(void *arg, unsigned int index)
+{
+    solver *v = arg;
+    unsigned int const period = v->opt->period;
+    uint32_t const begin = v->layerBegin + index * CHUNK;
+    uint32_t const end = (v->layerEnd - begin < CHUNK) ? v->layerEnd : begin + CHUNK;
+    placement moves[MAX_PLACEMENTS];
+
+    for (uint32_t s = begin; s < end; s++)
+    {
+        // Every tile spawns with period keys left, see engineSetBoard()
+        int const n = engineGenPlacements(v->boards[s], SPAWN_X, 0, period, period, moves);
+        uint64_t const first = __atomic_fetch_add(&v->edgeTotal, n, __ATOMIC_RELAXED);
+        v->edgeStart[s] = (uint32_t)first;
+        v->edgeCount[s] = n;
+        for (int i = 0; i < n; i++)
+        {
+            v->edges[first + i] = boardOccupied(moves[i].board, SPAWN_X, 0) ? DEAD_END
+                                                                              : findOrAdd(v, moves[i].board);
+        }
+    }
+}
+
+/**
+ * Runs one DP sweep over a chunk of states.
+ */
+static void sweepTask(void *arg, unsigned int index)
+{
+    solver *v = arg;
+    uint32_t const begin = index * CHUNK;
+    uint32_t const end = (v->states - begin < CHUNK) ? v->states : begin + CHUNK;
+    uint32_t growing = 0;
+
+    for (uint32_t s = begin; s < end; s++)
+    {
+        uint32_t const *e = &v->edges[v->edgeStart[s]];
+        uint16_t best = 0;
+        for (unsigned int i = 0; i < v->edgeCount[s]; i++)
+        {
+            if (e[i] < DEAD_END && v->value[e[i]] > best)
+                best = v->value[e[i]];
+        }
+        v->next[s] = best + 1;
+        growing += (best + 1 == v->horizon);
+    }
+    __atomic_fetch_add(&v->growing, growing, __ATOMIC_RELAXED);
+}
+
+/**
+ * Orders (board, state) pairs by board.
+ */
+typedef struct
+{
+    uint64_t board;
+    uint32_t state;
+} tableEntry;
+
+static int compareEntries(void const *x, void const *y)
+{
+    tableEntry const *a = x, *b = y;
+    return (a->board > b->board) - (a->board < b->board);
+}
+
+
+int main(int argc, char **argv)
+{
+    solverOptions opt = {
+        .period = 1,
+        .maxStates = 1UL << 25,
+        .threads = 0,
+        .out = "stetris_solve.tbl",
+    };
+    static solver v;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "--period") == 0)
+            opt.period = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--max-states") == 0)
+            opt.maxStates = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--out") == 0)
+            opt.out = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.period == 0 || opt.maxStates == 0 || opt.maxStates >= DEAD_END)
+        usage(argv[0]);
+
+    // Hash set at most half full; past the limit every thread may claim one
+    // more slot before it sees the limit, see findOrAdd()
+    threadPool *pool = poolCreate(opt.threads);
+    uint64_t slots = 1;
+    while (pool && slots < 2 * (opt.maxStates + poolThreads(pool) + 1))
+        slots *= 2;
+    v.opt = &opt;
+    v.mask = slots - 1;
+    v.keys = reserve(slots * sizeof(uint64_t));
+    v.ids = reserve(slots * sizeof(uint32_t));
+    v.boards = reserve(opt.maxStates * sizeof(uint64_t));
+    v.edgeStart = reserve(opt.maxStates * sizeof(uint32_t));
+    v.edgeCount = reserve(opt.maxStates);
+    v.edges = reserve(opt.maxStates * MAX_PLACEMENTS * sizeof(uint32_t));
+    if (!v.keys || !v.ids || !v.boards || !v.edgeStart || !v.edgeCount || !v.edges || !pool)
+    {
+        fprintf(stderr, "ERROR: could not reserve memory for %lu states\n", opt.maxStates);
+        return EXIT_FAILURE;
+    }
+    printf("Solving period %u on %u threads\n", opt.period, poolThreads(pool));
+
+    // Breadth-first enumeration, one frontier layer (tile) at a time
+    double start = botNow();
+    findOrAdd(&v, 0);
+    unsigned int layers = 0;
+    for (v.layerEnd = 0; v.layerEnd < v.states && v.layerEnd < opt.maxStates; layers++)
+    {
+        v.layerBegin = v.layerEnd;
+        v.layerEnd = (v.states < opt.maxStates) ? v.states : (uint32_t)opt.maxStates;
+        poolFor(pool, expandTask, &v, (v.layerEnd - v.layerBegin + CHUNK - 1) / CHUNK);
+    }
+    if (v.states > opt.maxStates)
+        v.states = (uint32_t)opt.maxStates;
+    double seconds = (botNow() - start) / 1e6;
+    printf("States:       %10u in %u layers%s\n", v.states, layers, v.truncated ? " (cut by --max-states)" : "");
+    printf("Edges:        %10llu (%.1f per state)\n", (unsigned long long)v.edgeTotal, (double)v.edgeTotal / v.states);
+    printf("Expansion:    %10.0f states/s, %.0f placements/s\n", v.states / seconds, v.edgeTotal / seconds);
+    munmap(v.keys, slots * sizeof(uint64_t));
+    munmap(v.ids, slots * sizeof(uint32_t));
+
+    // DP sweeps until the set of states that are still growing is stable
+    start = botNow();
+    v.value = calloc(v.states, sizeof(uint16_t));
+    v.next = calloc(v.states, sizeof(uint16_t));
+    if (!v.value || !v.next)
+    {
+        fprintf(stderr, "ERROR: could not allocate the values of %u states\n", v.states);
+        return EXIT_FAILURE;
+    }
+    uint32_t growing = UINT32_MAX;
+    unsigned int sweeps = 0;
+    for (v.horizon = 1; v.horizon < SOLVE_FOREVER; v.horizon++)
+    {
+        v.growing = 0;
+        poolFor(pool, sweepTask, &v, (v.states + CHUNK - 1) / CHUNK);
+        uint16_t *swap = v.value;
+        v.value = v.next;
+        v.next = swap;
+        sweeps++;
+        if (v.growing == growing)
+            break;
+        growing = v.growing;
+    }
+    for (uint32_t s = 0; s < v.states; s++)
+    {
+        if (v.value[s] == v.horizon)
+            v.value[s] = SOLVE_FOREVER;
+    }
+    seconds = (botNow() - start) / 1e6;
+    printf("Sweeps:       %10u (%.0f edges/s)\n", sweeps, (double)v.edgeTotal * sweeps / seconds);
+    printf("Forever:      %10u states (%.1f%%)\n", growing, 100.0 * growing / v.states);
+    if (v.value[0] == SOLVE_FOREVER)
+        printf("Empty board:  survives forever\n");
+    else
+        printf("Empty board:  %10u tiles at most\n", v.value[0]);
+    munmap(v.edges, opt.maxStates * MAX_PLACEMENTS * sizeof(uint32_t));
+    munmap(v.edgeStart, opt.maxStates * sizeof(uint32_t));
+    munmap(v.edgeCount, opt.maxStates);
+    poolDestroy(pool);
+
+    // Sorted table, reusing the boards array for the sorted boards
+    tableEntry *entries = malloc(v.states * sizeof(tableEntry));
+    if (!entries)
+    {
+        fprintf(stderr, "ERROR: could not allocate the table\n");
+        return EXIT_FAILURE;
+    }
+    for (uint32_t s = 0; s < v.states; s++)
+        entries[s] = (tableEntry){.board = v.boards[s], .state = s};
+    qsort(entries, v.states, sizeof(tableEntry), compareEntries);
+    for (uint32_t i = 0; i < v.states; i++)
+    {
+        v.boards[i] = entries[i].board;
+        v.next[i] = v.value[entries[i].state];
+    }
+    if (!solveWrite(opt.out, opt.period, !v.truncated, v.boards, v.next, v.states))
+    {
+        fprintf(stderr, "ERROR: could not write %s\n", opt.out);
+        return EXIT_FAILURE;
+    }
+    printf("Table:        %10s (%.1f MB)\n", opt.out,
+           (sizeof(solveHeader) + v.states * (sizeof(uint64_t) + sizeof(uint16_t))) / 1e6);
+    return EXIT_SUCCESS;
+}
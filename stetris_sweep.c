@@ -0,0 +1,574 @@
+/**
+ * @file stetris_sweep.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Parameter sweep of the game rules for balancing the difficulty.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Plays --games seeded games with a fixed bot for every parameter set of a
+ * grid over the rules of ENGINE_USAGE and prints a table of game length,
+ * score and level distributions per set:
+ *   ./stetris_sweep --start-period 30,50,70 --rows-per-level 1-4 --noise 0.05
+ * Every axis takes a comma separated list of values and ranges LO-HI or
+ * LO-HI/STEP; --levels takes schedules separated by ';'. The grid is the
+ * product of all axes, or --sample N random sets of it. All sets play the
+ * same seeds, so they differ by their rules only.
+ * The sets are handed out to --workers forked processes, each with a bot of
+ * its own, since the rules are per process (gameRules). The results are
+ * written into a shared mapping. The bot plays far better than a human and
+ * drops every tile at once, so the speed of the rules would not matter to
+ * it: --think TICKS makes it wait after each new tile while the tile falls,
+ * and --noise P replaces its key by a random one with probability P per
+ * tick, from a generator seeded per game. Without them games rarely end
+ * before --max-tiles.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_gettime() and MAP_ANONYMOUS with -std=c99
+
+#include <ctype.h>                      // for isalnum()
+#include <sched.h>                      // for sched_setaffinity(), CPU_SET
+#include <signal.h>                     // for SIGKILL
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for strtoul(), qsort(), exit()
+#include <string.h>                     // for strcmp, strchr, strncpy, memset
+#include <sys/mman.h>                   // for mmap(), munmap()
+#include <sys/prctl.h>                  // for prctl()
+#include <sys/wait.h>                   // for waitpid()
+#include <time.h>                       // for clock_gettime, nanosleep
+#include <unistd.h>                     // for fork(), sysconf(), isatty(), _exit()
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_args.h"
+
+#define MAX_VALUES 256                  // values of one axis
+#define MAX_SCHEDULES 16
+#define MAX_SETS 4096
+#define MAX_WORKERS 256
+#define SCHEDULE_TEXT 96
+
+/**
+ * The values of one rule to sweep.
+ */
+typedef struct
+{
+    unsigned int count;
+    unsigned long values[MAX_VALUES];
+} sweepAxis;
+
+typedef struct
+{
+    unsigned long games;                // games per parameter set
+    unsigned long seed;                 // seed of the first game of every set
+    unsigned long maxTiles;             // stop a game after this many tiles
+    unsigned long sample;               // random sets of the grid to play, 0 for all
+    unsigned int workers;               // 0 for one per CPU
+    unsigned long think;                // ticks without a key after each new tile
+    double noise;                       // chance of a random key per tick
+    bool csv;                           // print the table as CSV
+    sweepAxis tickUSec;
+    sweepAxis rowsPerLevel;
+    sweepAxis startPeriod;
+    unsigned int schedules;
+    engineRules levels[MAX_SCHEDULES];  // level schedules to sweep, other fields unused
+} sweepOptions;
+
+/**
+ * Result of one parameter set, in the shared mapping.
+ */
+typedef struct
+{
+    engineRules rules;
+    uint32_t done;                      // 1 once the worker wrote the result
+    unsigned long games;
+    unsigned long capped;               // games stopped by --max-tiles
+    double tiles[3];                    // tiles per game: 10th, 50th and 90th percentile
+    double seconds;                     // median game length at the tick rate of the set
+    double score[4];                    // mean and percentiles
+    double level;                       // mean final level
+    unsigned long maxLevel;
+} sweepResult;
+
+typedef struct
+{
+    uint32_t next;                      // next set to hand out
+    unsigned int sets;
+    sweepResult results[MAX_SETS];
+} sweepShared;
+
+/**
+ * Final counters of one game.
+ */
+typedef struct
+{
+    uint32_t tiles;
+    uint32_t score;
+    uint32_t level;
+    uint64_t ticks;
+} gameLength;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--games N] [--seed S] [--max-tiles N] [--workers N] [--sample N] [--think TICKS] [--noise P] [--csv]"
+                    " [--tick-usec LIST] [--rows-per-level LIST] [--start-period LIST] [--levels S1;S2;...] "
+                    BOT_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Parses a list of values and ranges, "10,20,30-50/10". Returns false if
+ * it is malformed, holds 0 or a value above UINT32_MAX, or more than
+ * MAX_VALUES values.
+ */
+static bool parseAxis(sweepAxis *axis, char const *text)
+{
+    axis->count = 0;
+    for (;;)
+    {
+        char *end;
+        // strtoul() would skip blanks and take a sign
+        if (!isalnum((unsigned char)*text))
+            return false;
+        unsigned long const low = strtoul(text, &end, 0);
+        unsigned long high = low, step = 1;
+        if (end == text || low == 0 || low > UINT32_MAX)
+            return false;
+        if (*end == '-')
+        {
+            text = end + 1;
+            if (!isalnum((unsigned char)*text))
+                return false;
+            high = strtoul(text, &end, 0);
+            if (end == text || high < low || high > UINT32_MAX)
+                return false;
+            if (*end == '/')
+            {
+                text = end + 1;
+                if (!isalnum((unsigned char)*text))
+                    return false;
+                step = strtoul(text, &end, 0);
+                if (end == text || step == 0)
+                    return false;
+            }
+        }
+        for (unsigned long v = low; v <= high; v += step)
+        {
+            if (axis->count == MAX_VALUES)
+                return false;
+            axis->values[axis->count++] = v;
+        }
+        text = end;
+        if (*text == '\0')
+            return true;
+        if (*text++ != ',')
+            return false;
+    }
+}
+
+/**
+ * Parses level schedules separated by ';'.
+ */
+static bool parseSchedules(sweepOptions *opt, char const *text)
+{
+    opt->schedules = 0;
+    while (*text)
+    {
+        char one[SCHEDULE_TEXT];
+        char const *end = strchr(text, ';');
+        size_t const length = end ? (size_t)(end - text) : strlen(text);
+        if (length >= sizeof(one) || opt->schedules == MAX_SCHEDULES)
+            return false;
+        memcpy(one, text, length);
+        one[length] = '\0';
+        opt->levels[opt->schedules] = gameRules;
+        if (!engineParseLevels(&opt->levels[opt->schedules++], one))
+            return false;
+        text += length + (end != NULL);
+    }
+    return opt->schedules > 0;
+}
+
+static uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * Returns the rules of grid entry index, the axes varying fastest from the
+ * tick rate to the level schedule.
+ */
+static engineRules gridEntry(sweepOptions const *opt, unsigned long index)
+{
+    engineRules r = opt->levels[0];
+
+    r.uSecTickTime = opt->tickUSec.values[index % opt->tickUSec.count];
+    index /= opt->tickUSec.count;
+    r.rowsPerLevel = opt->rowsPerLevel.values[index % opt->rowsPerLevel.count];
+    index /= opt->rowsPerLevel.count;
+    r.initNextGameTick = opt->startPeriod.values[index % opt->startPeriod.count];
+    index /= opt->startPeriod.count;
+    engineRules const *levels = &opt->levels[index % opt->schedules];
+    r.levelBands = levels->levelBands;
+    memcpy(r.levelUpTo, levels->levelUpTo, sizeof(r.levelUpTo));
+    memcpy(r.levelStep, levels->levelStep, sizeof(r.levelStep));
+    return r;
+}
+
+/**
+ * Fills the parameter sets of shared from the grid, or a random sample of
+ * it. Returns false if there are more than MAX_SETS.
+ */
+static bool buildSets(sweepOptions const *opt, sweepShared *shared)
+{
+    unsigned long long const grid = (unsigned long long)opt->tickUSec.count * opt->rowsPerLevel.count *
+                                    opt->startPeriod.count * opt->schedules;
+    unsigned long const sets = (opt->sample && opt->sample < grid) ? opt->sample : grid;
+    if (sets > MAX_SETS)
+        return false;
+
+    unsigned long *picked = malloc(sets * sizeof(*picked));
+    uint64_t rng = (opt->seed + 1) * 0x9E3779B97F4A7C15ULL;
+    if (!picked)
+        return false;
+    for (unsigned long i = 0; i < sets; i++)
+    {
+        if (sets == grid)
+        {
+            picked[i] = i;
+            continue;
+        }
+        // Distinct random entries, in the order drawn
+        bool fresh;
+        do
+        {
+            picked[i] = nextRandom(&rng) % grid;
+            fresh = true;
+            for (unsigned long j = 0; j < i && fresh; j++)
+                fresh = picked[j] != picked[i];
+        } while (!fresh);
+    }
+    for (unsigned long i = 0; i < sets; i++)
+        shared->results[i].rules = gridEntry(opt, picked[i]);
+    shared->sets = sets;
+    free(picked);
+    return true;
+}
+
+/**
+ * Plays one game under gameRules. The player waits think ticks after each
+ * new tile before following the bot, so the tile falls meanwhile, and with
+ * noise a random key replaces the one of the bot now and then.
+ */
+static gameLength playGame(uint32_t seed, sweepOptions const *opt, bot *b)
+{
+    static int const keys[] = {0, KEY_LEFT, KEY_RIGHT, KEY_DOWN};
+    uint64_t rng = seed * 0xD1B54A32D192ED03ULL + 1;
+    uint64_t const threshold = (uint64_t)(opt->noise * (double)UINT64_MAX);
+    gameLength length = {0};
+    uint32_t lastTiles = 0;
+    unsigned long waited = 0;
+    engineState s;
+
+    engineInit(&s, seed);
+    engineStep(&s, KEY_UP);     // any key starts a new game
+    while (s.state != GAMEOVER && s.tiles < opt->maxTiles)
+    {
+        if (s.tiles != lastTiles)
+        {
+            lastTiles = s.tiles;
+            waited = 0;
+        }
+        int key = 0;
+        if (waited++ >= opt->think)
+            key = botNextKey(b, &s);
+        if (opt->noise > 0 && nextRandom(&rng) < threshold)
+            key = keys[nextRandom(&rng) % 4];
+
+        engineStepNoRestart(&s, key);
+        length.ticks++;
+    }
+    length.tiles = s.tiles;
+    length.score = s.score;
+    length.level = s.level;
+    return length;
+}
+
+static int compareUInt32(void const *a, void const *b)
+{
+    uint32_t const x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+    return (x > y) - (x < y);
+}
+
+static int compareUInt64(void const *a, void const *b)
+{
+    uint64_t const x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns the value at fraction q of sorted values.
+ */
+static double percentile32(uint32_t const *sorted, unsigned long n, double q)
+{
+    return sorted[(unsigned long)(q * (n - 1) + 0.5)];
+}
+
+/**
+ * Plays the games of one parameter set and writes its result.
+ */
+static void playSet(sweepOptions const *opt, bot *b, sweepResult *r, uint32_t *tiles, uint32_t *scores,
+                    uint64_t *ticks)
+{
+    double scoreSum = 0, levelSum = 0;
+    unsigned long maxLevel = 0, capped = 0;
+
+    gameRules = r->rules;
+    for (unsigned long g = 0; g < opt->games; g++)
+    {
+        gameLength const l = playGame((uint32_t)(opt->seed + g), opt, b);
+        tiles[g] = l.tiles;
+        scores[g] = l.score;
+        ticks[g] = l.ticks;
+        scoreSum += l.score;
+        levelSum += l.level;
+        if (l.level > maxLevel)
+            maxLevel = l.level;
+        if (l.tiles >= opt->maxTiles)
+            capped++;
+    }
+    qsort(tiles, opt->games, sizeof(*tiles), compareUInt32);
+    qsort(scores, opt->games, sizeof(*scores), compareUInt32);
+    qsort(ticks, opt->games, sizeof(*ticks), compareUInt64);
+
+    r->games = opt->games;
+    r->capped = capped;
+    r->tiles[0] = percentile32(tiles, opt->games, 0.1);
+    r->tiles[1] = percentile32(tiles, opt->games, 0.5);
+    r->tiles[2] = percentile32(tiles, opt->games, 0.9);
+    r->seconds = ticks[(opt->games - 1) / 2] * (r->rules.uSecTickTime / 1e6);
+    r->score[0] = scoreSum / opt->games;
+    r->score[1] = percentile32(scores, opt->games, 0.1);
+    r->score[2] = percentile32(scores, opt->games, 0.5);
+    r->score[3] = percentile32(scores, opt->games, 0.9);
+    r->level = levelSum / opt->games;
+    r->maxLevel = maxLevel;
+    __atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Body of worker w: plays the sets it takes from shared until none are
+ * left. Does not return.
+ */
+static void runWorker(sweepOptions const *opt, botOptions const *botOpt, sweepShared *shared, unsigned int w)
+{
+    long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    bot b;
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    CPU_ZERO(&set);
+    CPU_SET(w % (cpus > 0 ? cpus : 1), &set);
+    sched_setaffinity(0, sizeof(set), &set);
+
+    uint32_t *tiles = malloc(opt->games * sizeof(*tiles));
+    uint32_t *scores = malloc(opt->games * sizeof(*scores));
+    uint64_t *ticks = malloc(opt->games * sizeof(*ticks));
+    if (!tiles || !scores || !ticks || !botCreate(&b, botOpt))
+        _exit(EXIT_FAILURE);
+    for (;;)
+    {
+        uint32_t const i = __atomic_fetch_add(&shared->next, 1, __ATOMIC_RELAXED);
+        if (i >= shared->sets)
+            break;
+        playSet(opt, &b, &shared->results[i], tiles, scores, ticks);
+    }
+    botDestroy(&b);
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Forks the workers and waits for them, printing the progress to stderr.
+ * Returns how many of them did not exit cleanly.
+ */
+static unsigned int runWorkers(sweepOptions const *opt, botOptions const *botOpt, sweepShared *shared)
+{
+    unsigned int running = 0, failed = 0;
+    bool const tty = isatty(STDERR_FILENO);
+
+    fflush(stdout);
+    for (unsigned int w = 0; w < opt->workers; w++)
+    {
+        pid_t const pid = fork();
+        if (pid == 0)
+            runWorker(opt, botOpt, shared, w);
+        if (pid < 0)
+            failed++;
+        else
+            running++;
+    }
+    while (running > 0)
+    {
+        int status;
+        pid_t const pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0)
+        {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+                failed++;
+            continue;
+        }
+        struct timespec const pause = {1, 0};
+        nanosleep(&pause, NULL);
+
+        unsigned int done = 0;
+        for (unsigned int i = 0; i < shared->sets; i++)
+            done += __atomic_load_n(&shared->results[i].done, __ATOMIC_ACQUIRE);
+        fprintf(stderr, "%s%u/%u sets, %u workers running%s", tty ? "\r" : "", done, shared->sets, running,
+                tty ? "   " : "\n");
+    }
+    if (tty)
+        fputc('\n', stderr);
+    return failed;
+}
+
+/**
+ * Prints the results of all sets, as a table or as CSV. Sets lost with a
+ * failed worker are left out.
+ */
+static void printResults(sweepOptions const *opt, sweepShared const *shared)
+{
+    if (opt->csv)
+        printf("tick_usec,rows_per_level,start_period,levels,games,capped,tiles_p10,tiles_p50,tiles_p90,"
+               "seconds_p50,score_mean,score_p10,score_p50,score_p90,level_mean,level_max\n");
+    else
+        printf("%6s %4s %6s %-22s %6s %26s %9s %34s %13s\n", "tick", "rows", "period", "levels", "capped",
+               "tiles p10 / p50 / p90", "p50 time", "score mean / p10 / p50 / p90", "level mean/max");
+
+    for (unsigned int i = 0; i < shared->sets; i++)
+    {
+        sweepResult const *r = &shared->results[i];
+        char levels[SCHEDULE_TEXT];
+        if (!r->done)
+            continue;
+        engineFormatLevels(&r->rules, levels, sizeof(levels));
+        if (opt->csv)
+            printf("%lu,%u,%u,\"%s\",%lu,%lu,%.0f,%.0f,%.0f,%.2f,%.1f,%.0f,%.0f,%.0f,%.2f,%lu\n", r->rules.uSecTickTime,
+                   r->rules.rowsPerLevel, r->rules.initNextGameTick, levels, r->games, r->capped, r->tiles[0],
+                   r->tiles[1], r->tiles[2], r->seconds, r->score[0], r->score[1], r->score[2], r->score[3], r->level,
+                   r->maxLevel);
+        else
+            printf("%6lu %4u %6u %-22s %5.1f%% %8.0f / %6.0f / %6.0f %8.1fs %10.1f / %6.0f / %6.0f / %6.0f %7.2f/%lu\n",
+                   r->rules.uSecTickTime, r->rules.rowsPerLevel, r->rules.initNextGameTick, levels,
+                   100.0 * r->capped / r->games, r->tiles[0], r->tiles[1], r->tiles[2], r->seconds, r->score[0],
+                   r->score[1], r->score[2], r->score[3], r->level, r->maxLevel);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    sweepOptions opt = {
+        .games = 100,
+        .seed = 1,
+        .maxTiles = 10000,
+        .sample = 0,
+        .workers = 0,
+        .think = 0,
+        .noise = 0.0,
+        .csv = false,
+        .tickUSec = {1, {gameRules.uSecTickTime}},
+        .rowsPerLevel = {1, {gameRules.rowsPerLevel}},
+        .startPeriod = {1, {gameRules.initNextGameTick}},
+        .schedules = 1,
+        .levels = {gameRules},
+    };
+    botOptions botOpt = defaultBotOptions;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool ok = true;
+        if (i + 1 < argc && strcmp(argv[i], "--games") == 0)
+            opt.games = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0)
+            opt.seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--max-tiles") == 0)
+            opt.maxTiles = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--workers") == 0)
+            opt.workers = parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--sample") == 0)
+            opt.sample = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--think") == 0)
+            opt.think = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--noise") == 0)
+            opt.noise = parseRealArg(argv[++i], &ok);
+        else if (strcmp(argv[i], "--csv") == 0)
+            opt.csv = true;
+        else if (i + 1 < argc && strcmp(argv[i], "--tick-usec") == 0)
+            ok = parseAxis(&opt.tickUSec, argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--rows-per-level") == 0)
+            ok = parseAxis(&opt.rowsPerLevel, argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--start-period") == 0)
+            ok = parseAxis(&opt.startPeriod, argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--levels") == 0)
+            ok = parseSchedules(&opt, argv[++i]);
+        else
+            ok = botParseOption(&botOpt, argc, argv, &i);
+        if (!ok)
+            usage(argv[0]);
+    }
+    for (unsigned int i = 0; i < opt.rowsPerLevel.count; i++)
+    {
+        if (opt.rowsPerLevel.values[i] > UINT8_MAX)
+            usage(argv[0]);
+    }
+    // The bot is created once per worker, before the rules of a set apply,
+    // so botCreate() cannot check the start periods of the sweep
+    for (unsigned int i = 0; i < opt.startPeriod.count; i++)
+    {
+        if ((botOpt.kind == BOT_PLUGIN || botOpt.kind == BOT_REMOTE) && opt.startPeriod.values[i] > UINT8_MAX)
+        {
+            fprintf(stderr, "ERROR: plugin and remote bots take a start period of at most %d\n", UINT8_MAX);
+            return EXIT_FAILURE;
+        }
+    }
+    if (opt.workers == 0)
+    {
+        long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        opt.workers = cpus > 0 ? cpus : 1;
+    }
+    if (opt.games == 0 || opt.workers > MAX_WORKERS || opt.noise < 0 || opt.noise > 1)
+        usage(argv[0]);
+    // Every worker is pinned to one core, so its search runs there too
+    if (botOpt.threads == 0)
+        botOpt.threads = 1;
+
+    sweepShared *shared = mmap(NULL, sizeof(sweepShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: could not map the shared results\n");
+        return EXIT_FAILURE;
+    }
+    memset(shared, 0, sizeof(*shared));
+    if (!buildSets(&opt, shared))
+    {
+        fprintf(stderr, "ERROR: more than %d parameter sets, use --sample\n", MAX_SETS);
+        return EXIT_FAILURE;
+    }
+    if (opt.workers > shared->sets)
+        opt.workers = shared->sets;
+
+    unsigned int const failed = runWorkers(&opt, &botOpt, shared);
+    printResults(&opt, shared);
+    if (failed)
+        fprintf(stderr, "%u workers failed, their sets are missing\n", failed);
+    munmap(shared, sizeof(*shared));
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
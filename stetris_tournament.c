@@ -0,0 +1,525 @@
+/**
+ * @file stetris_tournament.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Round-robin and Swiss tournaments between bots, with Elo ratings.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every entrant is a set of bot options, so built-in bots, plugins and
+ * remote bots can play each other:
+ *   ./stetris_tournament --entrant "--bot" --entrant "--bot=beam --depth 1"
+ * A match is --games seeded games; game g of every match uses seed + g and
+ * the same garbage board, so both bots of a match and all matches face the
+ * same piece sequences. The higher final score wins a game.
+ * The matches of a round are spread over the threads of a pool, each with
+ * its own bot instances. CPU time is accounted per entrant: the time of the
+ * thread playing its games, of the search threads of its bot (--threads)
+ * and, for --bot-remote, of the bot process. Threads a plugin starts itself
+ * are not counted.
+ * Ratings are the Bradley-Terry maximum likelihood fit of all game results
+ * on the Elo scale, with 95% confidence intervals from the Fisher
+ * information. Both include one virtual draw against a 0 rated player, so
+ * an entrant that won or lost everything still gets a finite rating.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_gettime() with -std=c99
+
+#include <math.h>                       // for log10(), sqrt(), fabs()
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for calloc(), free(), exit()
+#include <string.h>                     // for strcmp, strdup
+#include <time.h>                       // for clock_gettime
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_args.h"
+
+#define MAX_ENTRANTS 64
+#define MAX_ENTRANT_ARGS 32             // bot options in one --entrant string
+#define ELO_SCALE (400.0 / M_LN10)      // Elo points per unit of log strength
+#define CI_Z 1.96                       // 95% confidence
+
+typedef enum
+{
+    FORMAT_ROUND_ROBIN,                 // every entrant plays every other once
+    FORMAT_SWISS,                       // entrants with equal points are paired each round
+} tournamentFormat;
+
+typedef struct
+{
+    tournamentFormat format;
+    unsigned long rounds;               // Swiss rounds, 0 for enough to find a winner
+    unsigned long games;                // games per match
+    unsigned long seed;                 // seed of game 0 of every match
+    unsigned long maxTiles;             // stop a game after this many tiles
+    unsigned int garbage;               // garbage rows of the starting boards
+    unsigned int threads;               // 0 for one per CPU
+} tournamentOptions;
+
+typedef struct
+{
+    char const *name;                   // the --entrant string
+    botOptions options;
+    double points;                      // match points: 1 per match won, 1/2 per draw
+    bool bye;                           // had a Swiss round without opponent
+    unsigned long wins, draws, losses;  // games
+    unsigned long long score;           // sum of final scores
+    double cpuUSec;                     // CPU time used by all its games
+    double rating;                      // Elo, centered on the field
+    double interval;                    // half width of the 95% confidence interval
+} entrant;
+
+/**
+ * One match: entrant a against entrant b, with the final scores of both.
+ */
+typedef struct
+{
+    unsigned int a, b;
+    uint32_t *scores;                   // 2 * games: score of a, score of b
+} match;
+
+/**
+ * All matches of a round, run in parallel on the pool. Each match is split
+ * into splits tasks playing every splits-th game, to use all threads when
+ * there are fewer matches than threads.
+ */
+typedef struct
+{
+    tournamentOptions const *opt;
+    entrant const *entrants;
+    match *matches;
+    unsigned int splits;
+    double (*cpuUSec)[2];               // per task, of a and of b
+    bool failed;                        // a bot could not be created
+} roundRun;
+
+/**
+ * Games and points between every pair of entrants, [i][j] from i's view.
+ */
+static double gamesPlayed[MAX_ENTRANTS][MAX_ENTRANTS];
+static double gamePoints[MAX_ENTRANTS][MAX_ENTRANTS];
+static bool met[MAX_ENTRANTS][MAX_ENTRANTS];
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s --entrant \"BOT OPTIONS\" --entrant \"BOT OPTIONS\" ... [--swiss] [--rounds R]"
+                    " [--games N] [--seed S] [--max-tiles N] [--garbage ROWS] [--threads N]\n"
+                    "BOT OPTIONS: " BOT_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Returns the CPU time of the calling thread in microseconds.
+ */
+static double threadCpuUSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Parses the bot options of an --entrant string, like
+ * "--bot-remote './stetris_remote_bot bot.so'". Entrants search with one
+ * thread unless they ask for more, since the matches already run in parallel.
+ */
+static bool parseEntrant(entrant *e, char const *spec)
+{
+    char *copy = strdup(spec);
+    char *args[MAX_ENTRANT_ARGS + 1];
+    int count = 1;
+
+    if (!copy)
+        return false;
+    args[0] = "--bot";      // plays greedy without options
+    // Split at blanks; a value in single quotes may contain blanks itself
+    for (char *p = copy; *p;)
+    {
+        if (*p == ' ' || *p == '\t')
+        {
+            p++;
+            continue;
+        }
+        if (count == MAX_ENTRANT_ARGS + 1)
+            return false;
+        char const end = (*p == '\'') ? *p++ : ' ';
+        args[count++] = p;
+        while (*p && *p != end && (end == '\'' || *p != '\t'))
+            p++;
+        if (*p)
+            *p++ = '\0';
+    }
+
+    e->name = (count > 1) ? spec : "--bot";
+    e->options = defaultBotOptions;
+    e->options.threads = 1;
+    for (int i = 0; i < count; i++)
+    {
+        if (!botParseOption(&e->options, count, args, &i))
+        {
+            fprintf(stderr, "ERROR: unknown bot option %s in entrant \"%s\"\n", args[i], spec);
+            return false;
+        }
+    }
+    return true;    // copy stays referenced by the options
+}
+
+/**
+ * Plays one seeded game and returns its final score.
+ */
+static uint32_t playGame(bot *b, uint32_t seed, tournamentOptions const *opt)
+{
+    engineState s;
+
+    engineInit(&s, seed);
+    engineStep(&s, KEY_UP);     // any key starts a new game
+    engineSetBoard(&s, engineGarbageBoard(seed, opt->garbage));
+    while (s.state != GAMEOVER && s.tiles < opt->maxTiles)
+        engineStepNoRestart(&s, botNextKey(b, &s));
+
+    // The next game starts with tile 1 again, the bot must not reuse its plan
+    if (botIsExternal(b))
+        botEndExternalGame(b, &b->game, 0);
+    b->planned = false;
+    return s.score;
+}
+
+/**
+ * Plays game split, split + splits, ... of match index / splits, for both
+ * of its entrants.
+ */
+static void matchTask(void *arg, unsigned int index)
+{
+    roundRun *r = arg;
+    match *m = &r->matches[index / r->splits];
+    unsigned int const split = index % r->splits;
+    unsigned int const players[2] = {m->a, m->b};
+
+    for (int side = 0; side < 2; side++)
+    {
+        bot b;
+        if (!botCreate(&b, &r->entrants[players[side]].options))
+        {
+            __atomic_store_n(&r->failed, true, __ATOMIC_RELAXED);
+            return;
+        }
+
+        // The search threads of the bot started with it, so all their time counts
+        double const start = threadCpuUSec() + remoteCpuUSec(&b);
+        for (unsigned long g = split; g < r->opt->games; g += r->splits)
+            m->scores[2 * g + side] = playGame(&b, (uint32_t)(r->opt->seed + g), r->opt);
+        r->cpuUSec[index][side] = threadCpuUSec() + remoteCpuUSec(&b) + poolCpuUSec(b.pool) - start;
+        botDestroy(&b);
+    }
+}
+
+/**
+ * Plays all matches of a round in parallel and adds up their results.
+ * Returns false if a bot could not be created.
+ */
+static bool playRound(threadPool *pool, tournamentOptions const *opt, entrant *entrants,
+                      match *matches, unsigned int count)
+{
+    unsigned int splits = (poolThreads(pool) + count - 1) / count;
+    if (splits > opt->games)
+        splits = (unsigned int)opt->games;
+
+    roundRun run = {
+        .opt = opt,
+        .entrants = entrants,
+        .matches = matches,
+        .splits = splits,
+        .cpuUSec = calloc((size_t)count * splits, sizeof(*run.cpuUSec)),
+    };
+    for (unsigned int i = 0; i < count; i++)
+        matches[i].scores = calloc(2 * opt->games, sizeof(uint32_t));
+    bool ok = run.cpuUSec != NULL;
+    for (unsigned int i = 0; i < count; i++)
+        ok = ok && matches[i].scores;
+    if (ok)
+    {
+        poolFor(pool, matchTask, &run, count * splits);
+        ok = !run.failed;
+    }
+
+    for (unsigned int i = 0; ok && i < count; i++)
+    {
+        match const *m = &matches[i];
+        entrant *a = &entrants[m->a], *b = &entrants[m->b];
+        double pointsA = 0;
+
+        for (unsigned long g = 0; g < opt->games; g++)
+        {
+            uint32_t const scoreA = m->scores[2 * g], scoreB = m->scores[2 * g + 1];
+            a->score += scoreA;
+            b->score += scoreB;
+            if (scoreA > scoreB)
+            {
+                a->wins++;
+                b->losses++;
+                pointsA += 1;
+            }
+            else if (scoreA < scoreB)
+            {
+                b->wins++;
+                a->losses++;
+            }
+            else
+            {
+                a->draws++;
+                b->draws++;
+                pointsA += 0.5;
+            }
+        }
+        for (unsigned int s = 0; s < splits; s++)
+        {
+            a->cpuUSec += run.cpuUSec[i * splits + s][0];
+            b->cpuUSec += run.cpuUSec[i * splits + s][1];
+        }
+
+        double const pointsB = opt->games - pointsA;
+        gamesPlayed[m->a][m->b] += opt->games;
+        gamesPlayed[m->b][m->a] += opt->games;
+        gamePoints[m->a][m->b] += pointsA;
+        gamePoints[m->b][m->a] += pointsB;
+        met[m->a][m->b] = met[m->b][m->a] = true;
+        a->points += (pointsA > pointsB) ? 1 : (pointsA == pointsB) ? 0.5 : 0;
+        b->points += (pointsB > pointsA) ? 1 : (pointsA == pointsB) ? 0.5 : 0;
+        printf("  %-32.32s %6.1f - %-6.1f %.32s\n", a->name, pointsA, pointsB, b->name);
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+        free(matches[i].scores);
+    free(run.cpuUSec);
+    return ok;
+}
+
+/**
+ * Orders entrant indices by descending match points, then by their order
+ * on the command line.
+ */
+static entrant const *sortEntrants;
+
+static int comparePoints(void const *x, void const *y)
+{
+    unsigned int const i = *(unsigned int const *)x, j = *(unsigned int const *)y;
+    if (sortEntrants[i].points != sortEntrants[j].points)
+        return (sortEntrants[i].points < sortEntrants[j].points) ? 1 : -1;
+    return (i > j) - (i < j);
+}
+
+/**
+ * Pairs the entrants of a Swiss round: from the top of the standings, each
+ * unpaired entrant meets the next one it has not met yet, or the next one
+ * at all if it has met everybody. With an odd field, the lowest entrant
+ * without a bye so far sits out and gets a match point.
+ * Returns the number of matches.
+ */
+static unsigned int pairSwiss(entrant *entrants, unsigned int n, match *matches)
+{
+    unsigned int order[MAX_ENTRANTS];
+    bool paired[MAX_ENTRANTS] = {false};
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < n; i++)
+        order[i] = i;
+    sortEntrants = entrants;
+    qsort(order, n, sizeof(order[0]), comparePoints);
+
+    if (n % 2)
+    {
+        unsigned int k = n - 1;
+        while (k > 0 && entrants[order[k]].bye)
+            k--;
+        entrant *e = &entrants[order[k]];
+        e->bye = true;
+        e->points += 1;
+        paired[k] = true;
+        printf("  %-32.32s bye\n", e->name);
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (paired[i])
+            continue;
+        unsigned int partner = n;
+        for (unsigned int j = i + 1; j < n; j++)
+        {
+            if (!paired[j] && (partner == n || !met[order[i]][order[j]]))
+            {
+                partner = j;
+                if (!met[order[i]][order[j]])
+                    break;
+            }
+        }
+        if (partner == n)
+            break;
+        paired[i] = paired[partner] = true;
+        matches[count++] = (match){.a = order[i], .b = order[partner]};
+    }
+    return count;
+}
+
+/**
+ * Fits Bradley-Terry strengths to all game results with the MM algorithm
+ * and converts them to Elo ratings with confidence intervals.
+ */
+static void rate(entrant *entrants, unsigned int n)
+{
+    double strength[MAX_ENTRANTS], next[MAX_ENTRANTS];
+
+    for (unsigned int i = 0; i < n; i++)
+        strength[i] = 1;
+    for (int iteration = 0; iteration < 10000; iteration++)
+    {
+        double change = 0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            double points = 0.5, weight = 1 / (strength[i] + 1);    // virtual draw against strength 1
+            for (unsigned int j = 0; j < n; j++)
+            {
+                points += gamePoints[i][j];
+                weight += gamesPlayed[i][j] / (strength[i] + strength[j]);
+            }
+            next[i] = points / weight;
+            change = fmax(change, fabs(log(next[i] / strength[i])));
+        }
+        memcpy(strength, next, sizeof(double) * n);
+        if (change < 1e-9)
+            break;
+    }
+
+    double mean = 0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        double const p0 = strength[i] / (strength[i] + 1);
+        double information = p0 * (1 - p0);
+        for (unsigned int j = 0; j < n; j++)
+        {
+            double const p = strength[i] / (strength[i] + strength[j]);
+            information += gamesPlayed[i][j] * p * (1 - p);
+        }
+        entrants[i].rating = ELO_SCALE * log(strength[i]);
+        entrants[i].interval = CI_Z * ELO_SCALE / sqrt(information);
+        mean += entrants[i].rating / n;
+    }
+    for (unsigned int i = 0; i < n; i++)
+        entrants[i].rating -= mean;
+}
+
+static int compareRating(void const *x, void const *y)
+{
+    entrant const *a = x, *b = y;
+    return (a->rating < b->rating) - (a->rating > b->rating);
+}
+
+
+int main(int argc, char **argv)
+{
+    tournamentOptions opt = {
+        .format = FORMAT_ROUND_ROBIN,
+        .rounds = 0,
+        .games = 20,
+        .seed = 1,
+        .maxTiles = 1000,
+        .garbage = 4,
+        .threads = 0,
+    };
+    static entrant entrants[MAX_ENTRANTS];
+    static match matches[MAX_ENTRANTS * MAX_ENTRANTS / 2];
+    unsigned int n = 0;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--swiss") == 0)
+            opt.format = FORMAT_SWISS;
+        else if (i + 1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "--entrant") == 0)
+        {
+            if (n == MAX_ENTRANTS || !parseEntrant(&entrants[n++], argv[++i]))
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "--rounds") == 0)
+            opt.rounds = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--games") == 0)
+            opt.games = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--seed") == 0)
+            opt.seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--max-tiles") == 0)
+            opt.maxTiles = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--garbage") == 0)
+            opt.garbage = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (n < 2 || opt.games == 0)
+        usage(argv[0]);
+
+    unsigned long rounds = 1;
+    if (opt.format == FORMAT_SWISS)
+    {
+        rounds = opt.rounds;
+        for (unsigned int field = 1; opt.rounds == 0 && field < n; field *= 2)
+            rounds++;       // ceil(log2(n)) rounds
+        if (rounds > n - 1 + n % 2)
+            rounds = n - 1 + n % 2;
+    }
+
+    threadPool *pool = poolCreate(opt.threads);
+    if (!pool)
+    {
+        fprintf(stderr, "ERROR: could not start the tournament threads\n");
+        return EXIT_FAILURE;
+    }
+    printf("%s tournament of %u bots, %lu games per match on %u threads\n",
+           (opt.format == FORMAT_SWISS) ? "Swiss" : "Round-robin", n, opt.games, poolThreads(pool));
+
+    for (unsigned long round = 0; round < rounds; round++)
+    {
+        double const start = botNow();
+        unsigned int count = 0;
+        if (opt.format == FORMAT_SWISS)
+        {
+            printf("Round %lu\n", round + 1);
+            count = pairSwiss(entrants, n, matches);
+        }
+        else
+        {
+            for (unsigned int a = 0; a < n; a++)
+            {
+                for (unsigned int b = a + 1; b < n; b++)
+                    matches[count++] = (match){.a = a, .b = b};
+            }
+        }
+        if (!playRound(pool, &opt, entrants, matches, count))
+        {
+            fprintf(stderr, "ERROR: could not start the bots of a match\n");
+            return EXIT_FAILURE;
+        }
+        printf("  %u matches in %.1f s\n", count, (botNow() - start) / 1e6);
+    }
+    poolDestroy(pool);
+
+    rate(entrants, n);
+    qsort(entrants, n, sizeof(entrant), compareRating);
+    printf("\nRank     Elo   95%% CI  Points      W-D-L        Score/game  CPU ms/game  Bot\n");
+    for (unsigned int i = 0; i < n; i++)
+    {
+        entrant const *e = &entrants[i];
+        unsigned long const games = e->wins + e->draws + e->losses;
+        char record[32];
+        snprintf(record, sizeof(record), "%lu-%lu-%lu", e->wins, e->draws, e->losses);
+        printf("%4u %7.0f %8.0f %7.1f  %-18s %10.1f %12.2f  %s\n", i + 1, e->rating, e->interval, e->points,
+               record, games ? (double)e->score / games : 0.0, games ? e->cpuUSec / 1e3 / games : 0.0, e->name);
+    }
+    return EXIT_SUCCESS;
+}
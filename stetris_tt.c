@@ -0,0 +1,157 @@
+/**
+ * @file stetris_tt.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Lock-free transposition table shared by the search threads.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A board hashes to one bucket of TT_WAYS entries. Both words of an entry
+ * are read and written with relaxed atomics and no lock; the key is stored
+ * as board ^ data, so a probe only matches if both words belong to the
+ * same store. When a bucket is full, the entry of an older decision or
+ * else the shallowest entry is replaced.
+ */
+
+#define _GNU_SOURCE                     // Enables posix_memalign() with -std=c99
+
+#include "stetris_tt.h"
+#include "stetris_engine.h"
+
+#include <stdlib.h>                     // for posix_memalign(), free()
+#include <string.h>                     // for memset
+
+#define TT_WAYS 4                       // entries per bucket, one 64 byte cache line
+#define CACHE_LINE 64
+
+static inline uint64_t packData(ttData const *d, uint8_t const age)
+{
+    uint32_t value;
+    memcpy(&value, &d->value, sizeof(value));
+    return value | (uint64_t)d->depth << 32 | (uint64_t)d->period << 40 |
+           (uint64_t)d->move << 48 | (uint64_t)age << 56;
+}
+
+static inline void unpackData(uint64_t const packed, ttData *d)
+{
+    uint32_t const value = (uint32_t)packed;
+    memcpy(&d->value, &value, sizeof(value));
+    d->depth = packed >> 32;
+    d->period = packed >> 40;
+    d->move = packed >> 48;
+}
+
+/**
+ * Allocates a table of at most the given size; the number of buckets is
+ * rounded down to a power of two. Returns false if it cannot be allocated.
+ */
+bool ttCreate(transpositionTable *tt, size_t megabytes)
+{
+    size_t const bytes = (megabytes ? megabytes : 1) << 20;
+    size_t buckets = 1;
+    while (buckets * 2 * TT_WAYS * sizeof(ttEntry) <= bytes)
+        buckets *= 2;
+
+    size_t const size = buckets * TT_WAYS * sizeof(ttEntry);
+    if (posix_memalign((void **)&tt->entries, CACHE_LINE, size) != 0)
+    {
+        tt->entries = NULL;
+        return false;
+    }
+    memset(tt->entries, 0, size);
+    tt->bucketMask = buckets - 1;
+    tt->age = 0;
+    return true;
+}
+
+void ttDestroy(transpositionTable *tt)
+{
+    free(tt->entries);
+    tt->entries = NULL;
+}
+
+/**
+ * Starts a new decision; entries of earlier decisions are replaced first.
+ */
+void ttNewSearch(transpositionTable *tt)
+{
+    tt->age++;
+}
+
+/**
+ * Looks board up for a search of at least depth tiles with the given tick
+ * period. Returns true and fills out on a hit.
+ */
+bool ttProbe(transpositionTable const *tt, uint64_t const board, unsigned int const depth,
+             unsigned int const period, ttData *out, ttStats *stats)
+{
+    ttEntry const *bucket = &tt->entries[(boardHash(board) & tt->bucketMask) * TT_WAYS];
+    bool occupied = false;
+
+    stats->probes++;
+    for (unsigned int i = 0; i < TT_WAYS; i++)
+    {
+        uint64_t const data = __atomic_load_n(&bucket[i].data, __ATOMIC_RELAXED);
+        uint64_t const key = __atomic_load_n(&bucket[i].key, __ATOMIC_RELAXED);
+        if ((key ^ data) != board)
+        {
+            occupied |= key != 0;
+            continue;
+        }
+        unpackData(data, out);
+        if (out->period == period && out->depth >= depth)
+        {
+            stats->hits++;
+            return true;
+        }
+    }
+    if (occupied)
+        stats->collisions++;
+    return false;
+}
+
+/**
+ * Stores a search result. An entry of the same board is only overwritten by
+ * a search at least as deep or from a newer decision.
+ */
+void ttStore(transpositionTable *tt, uint64_t const board, ttData const *data)
+{
+    ttEntry *bucket = &tt->entries[(boardHash(board) & tt->bucketMask) * TT_WAYS];
+    ttEntry *victim = &bucket[0];
+    unsigned int victimRank = ~0u;
+
+    for (unsigned int i = 0; i < TT_WAYS; i++)
+    {
+        uint64_t const old = __atomic_load_n(&bucket[i].data, __ATOMIC_RELAXED);
+        uint64_t const key = __atomic_load_n(&bucket[i].key, __ATOMIC_RELAXED);
+        uint8_t const oldAge = old >> 56, oldDepth = old >> 32, oldPeriod = old >> 40;
+        if ((key ^ old) == board && oldPeriod == data->period)
+        {
+            if (oldDepth > data->depth && oldAge == tt->age)
+                return;
+            victim = &bucket[i];
+            break;
+        }
+
+        // Empty entries first, then older decisions, then shallower searches
+        unsigned int const rank = (key == 0) ? 0 : ((oldAge == tt->age) << 8 | oldDepth) + 1;
+        if (rank < victimRank)
+        {
+            victim = &bucket[i];
+            victimRank = rank;
+        }
+    }
+
+    uint64_t const packed = packData(data, tt->age);
+    __atomic_store_n(&victim->data, packed, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->key, board ^ packed, __ATOMIC_RELAXED);
+}
+
+/**
+ * Adds the counters of one search thread to sum; safe to call concurrently.
+ */
+void ttAddStats(ttStats *sum, ttStats const *stats)
+{
+    __atomic_fetch_add(&sum->probes, stats->probes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sum->hits, stats->hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sum->collisions, stats->collisions, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file stetris_tt.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Lock-free transposition table shared by the search threads.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Entries are 16 bytes and grouped into buckets of one cache line. Threads
+ * probe and store without locks; an entry whose two words were written by
+ * different threads is detected on probe and treated as a miss.
+ */
+
+#ifndef STETRIS_TT_H
+#define STETRIS_TT_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for uint64_t, uint8_t
+
+#define TT_NO_MOVE 0xFF                 // ttData.move when no best move is known
+
+/**
+ * One slot: key is the board XOR data, so a torn entry fails the key check.
+ */
+typedef struct
+{
+    uint64_t key;
+    uint64_t data;                      // packed ttData and age
+} ttEntry;
+
+/**
+ * Search result of a board, unpacked from ttEntry.data.
+ */
+typedef struct
+{
+    float value;
+    uint8_t depth;                      // following tiles searched
+    uint8_t period;                     // keys per row the value was computed for, at most 255
+    uint8_t move;                       // index of the best placement, or TT_NO_MOVE
+} ttData;
+
+/**
+ * Probe counters, kept by each search thread and summed afterwards.
+ */
+typedef struct
+{
+    unsigned long long probes;
+    unsigned long long hits;            // entry found with enough depth
+    unsigned long long collisions;      // misses where the bucket held other boards
+} ttStats;
+
+typedef struct
+{
+    ttEntry *entries;
+    uint64_t bucketMask;                // number of buckets - 1
+    uint8_t age;                        // generation, incremented per decision
+} transpositionTable;
+
+bool ttCreate(transpositionTable *tt, size_t megabytes);
+void ttDestroy(transpositionTable *tt);
+void ttNewSearch(transpositionTable *tt);
+bool ttProbe(transpositionTable const *tt, uint64_t board, unsigned int depth, unsigned int period,
+             ttData *out, ttStats *stats);
+void ttStore(transpositionTable *tt, uint64_t board, ttData const *data);
+void ttAddStats(ttStats *sum, ttStats const *stats);
+
+#endif // STETRIS_TT_H
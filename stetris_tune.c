@@ -0,0 +1,438 @@
+/**
+ * @file stetris_tune.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Genetic tuner for the evaluation weights of the bot.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every generation, each weight vector of the population plays the same
+ * seeded headless games with the greedy bot; its fitness is the mean score.
+ * All tiles are single cells and only their color is random, so the tile
+ * stream is the same for every seed; the seed instead stacks garbage of
+ * random height in the columns of the starting board.
+ * The games of all candidates are spread over the threads of a pool. The
+ * best vectors survive, the rest is bred by tournament selection, blend
+ * crossover and gaussian mutation. After every generation the population
+ * is checkpointed, so --resume continues an interrupted run, and the best
+ * weights so far are written to a file that --weights loads at startup.
+ * --mlp-out also writes them as an equivalent network for --mlp.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_gettime() with -std=c99
+
+#include <math.h>                       // for sqrt(), log(), cos()
+#include <stdio.h>                      // for printf(), fprintf(), FILE
+#include <stdlib.h>                     // for malloc(), free(), exit()
+#include <string.h>                     // for strcmp
+
+#include "stetris_engine.h"
+#include "stetris_bot.h"
+#include "stetris_args.h"
+
+#define TOURNAMENT 3                    // candidates drawn per parent selection
+#define CROSSOVER_RATE 0.7              // probability that a child has two parents
+#define MUTATION_RATE 0.3               // probability that a weight is mutated
+#define MUTATION_SIGMA 0.2              // standard deviation of a mutation
+#define MAX_POPULATION 1024
+
+typedef struct
+{
+    unsigned long population;           // weight vectors per generation
+    unsigned long generations;          // generations to run in total
+    unsigned long games;                // games per candidate and generation
+    unsigned long maxTiles;             // stop a game after this many tiles
+    unsigned long garbage;              // garbage rows of the starting boards
+    unsigned long seed;                 // seed of the first game and of the tuner
+    unsigned int threads;               // 0 for one per CPU
+    char const *checkpoint;             // population after every generation
+    char const *out;                    // best weights so far
+    char const *mlpOut;                 // best weights as a network file, NULL for none
+    bool resume;                        // continue from the checkpoint
+} tuneOptions;
+
+typedef struct
+{
+    botWeights weights;
+    double fitness;                     // mean score of the last generation
+} candidate;
+
+/**
+ * State of a run, saved in the checkpoint after every generation.
+ */
+typedef struct
+{
+    unsigned long generation;           // generations completed
+    uint64_t rng;                       // xorshift64 state of the tuner
+    candidate best;                     // best candidate of all generations
+    candidate population[MAX_POPULATION];
+} tuneState;
+
+/**
+ * All games of one generation, run in parallel on the pool.
+ */
+typedef struct
+{
+    tuneOptions const *opt;
+    candidate const *population;
+    uint32_t firstSeed;                 // seed of game 0 of this generation
+    uint32_t *scores;                   // population * games results
+} generationRun;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--population P] [--generations G] [--games N] [--max-tiles N] [--garbage ROWS]"
+                    " [--seed S]"
+                    " [--threads N] [--checkpoint FILE] [--out FILE] [--mlp-out FILE] [--resume]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Returns the next number of the tuner's xorshift64 generator.
+ */
+static uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * Returns a uniform number in [0, 1).
+ */
+static double uniform(uint64_t *state)
+{
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Returns a standard normal number (Box-Muller).
+ */
+static double gaussian(uint64_t *state)
+{
+    double const u = 1.0 - uniform(state);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * uniform(state));
+}
+
+/**
+ * Scales a weight vector to unit length. Moves are chosen by comparing
+ * evaluations, so only the direction of the vector matters.
+ */
+static void normalize(botWeights *w)
+{
+    double length = 0;
+    for (int i = 0; i < NUM_FEATURES; i++)
+        length += (double)w->weight[i] * w->weight[i];
+    length = sqrt(length);
+    if (length == 0)
+        return;
+    for (int i = 0; i < NUM_FEATURES; i++)
+        w->weight[i] /= length;
+}
+
+/**
+ * Plays one seeded game with the greedy bot and the given weights.
+ * Returns the final score.
+ */
+static uint32_t playGame(botWeights const *weights, uint32_t seed, tuneOptions const *opt)
+{
+    botOptions o = defaultBotOptions;
+    unsigned long const maxTiles = opt->maxTiles;
+    engineState s;
+    bot b;
+
+    botCreate(&b, &o);      // the greedy bot allocates nothing and cannot fail
+    b.weights = *weights;
+    engineInit(&s, seed);
+    engineStep(&s, KEY_UP);     // any key starts a new game
+    engineSetBoard(&s, engineGarbageBoard(seed, opt->garbage));
+    while (s.state != GAMEOVER && s.tiles < maxTiles)
+        engineStepNoRestart(&s, botNextKey(&b, &s));
+    botDestroy(&b);
+    return s.score;
+}
+
+/**
+ * Plays game index % games of candidate index / games.
+ */
+static void playTask(void *arg, unsigned int index)
+{
+    generationRun *r = arg;
+    unsigned long const games = r->opt->games;
+    r->scores[index] = playGame(&r->population[index / games].weights,
+                                r->firstSeed + (uint32_t)(index % games), r->opt);
+}
+
+/**
+ * Orders candidates by descending fitness.
+ */
+static int compareCandidates(void const *a, void const *b)
+{
+    double const fa = ((candidate const *)a)->fitness;
+    double const fb = ((candidate const *)b)->fitness;
+    return (fa < fb) - (fa > fb);
+}
+
+/**
+ * Picks the fittest of TOURNAMENT random candidates of a sorted population.
+ */
+static candidate const *selectParent(tuneState *t, unsigned long population)
+{
+    unsigned long best = population;
+    for (int i = 0; i < TOURNAMENT; i++)
+    {
+        unsigned long const c = nextRandom(&t->rng) % population;
+        if (c < best)
+            best = c;
+    }
+    return &t->population[best];
+}
+
+/**
+ * Replaces a population sorted by fitness with the next generation: the
+ * elite is kept, the others are bred from tournament selected parents.
+ */
+static void breed(tuneState *t, unsigned long population)
+{
+    static candidate next[MAX_POPULATION];
+    unsigned long const elite = (population + 7) / 8;
+
+    for (unsigned long i = 0; i < population; i++)
+    {
+        if (i < elite)
+        {
+            next[i] = t->population[i];
+            continue;
+        }
+        candidate const *a = selectParent(t, population);
+        candidate const *b = selectParent(t, population);
+        bool const cross = uniform(&t->rng) < CROSSOVER_RATE;
+        for (int f = 0; f < NUM_FEATURES; f++)
+        {
+            double const mix = cross ? uniform(&t->rng) : 1.0;
+            double w = mix * a->weights.weight[f] + (1.0 - mix) * b->weights.weight[f];
+            if (uniform(&t->rng) < MUTATION_RATE)
+                w += MUTATION_SIGMA * gaussian(&t->rng);
+            next[i].weights.weight[f] = (float)w;
+        }
+        normalize(&next[i].weights);
+        next[i].fitness = 0;
+    }
+    memcpy(t->population, next, population * sizeof(candidate));
+}
+
+/**
+ * Writes a weight vector as one line of the checkpoint.
+ */
+static void writeCandidate(FILE *f, char const *tag, candidate const *c)
+{
+    fprintf(f, "%s %.17g", tag, c->fitness);
+    for (int i = 0; i < NUM_FEATURES; i++)
+        fprintf(f, " %.9g", c->weights.weight[i]);
+    fprintf(f, "\n");
+}
+
+static bool readCandidate(FILE *f, char const *tag, candidate *c)
+{
+    char word[16];
+    if (fscanf(f, "%15s %lf", word, &c->fitness) != 2 || strcmp(word, tag) != 0)
+        return false;
+    for (int i = 0; i < NUM_FEATURES; i++)
+    {
+        if (fscanf(f, "%f", &c->weights.weight[i]) != 1)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the state of the run to a temporary file and renames it over the
+ * checkpoint, so an interrupted write never destroys the last checkpoint.
+ */
+static bool saveCheckpoint(tuneState const *t, tuneOptions const *opt)
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", opt->checkpoint);
+    FILE *f = fopen(tmp, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "stetris_tune 1 %d\n", NUM_FEATURES);
+    fprintf(f, "generation %lu\nrng %llu\npopulation %lu\n", t->generation,
+            (unsigned long long)t->rng, opt->population);
+    writeCandidate(f, "best", &t->best);
+    for (unsigned long i = 0; i < opt->population; i++)
+        writeCandidate(f, "candidate", &t->population[i]);
+    if (fclose(f) != 0)
+        return false;
+    return rename(tmp, opt->checkpoint) == 0;
+}
+
+/**
+ * Restores the state of an interrupted run. The population size of the
+ * checkpoint overrides --population. Returns false if the file is unusable.
+ */
+static bool loadCheckpoint(tuneState *t, tuneOptions *opt)
+{
+    FILE *f = fopen(opt->checkpoint, "r");
+    if (!f)
+        return false;
+
+    unsigned long long rng;
+    int version, features;
+    bool ok = fscanf(f, "stetris_tune %d %d generation %lu rng %llu population %lu", &version, &features,
+                     &t->generation, &rng, &opt->population) == 5 &&
+              version == 1 && features == NUM_FEATURES &&
+              opt->population > 0 && opt->population <= MAX_POPULATION &&
+              readCandidate(f, "best", &t->best);
+    for (unsigned long i = 0; ok && i < opt->population; i++)
+        ok = readCandidate(f, "candidate", &t->population[i]);
+    fclose(f);
+    t->rng = rng;
+    return ok;
+}
+
+/**
+ * Starts a run from the default weights and random directions.
+ */
+static void initPopulation(tuneState *t, tuneOptions const *opt)
+{
+    t->generation = 0;
+    t->rng = 0x9E3779B97F4A7C15ULL ^ opt->seed;
+    t->best.weights = defaultBotWeights;
+    t->best.fitness = -1;
+    t->population[0].weights = defaultBotWeights;
+    normalize(&t->population[0].weights);
+    for (unsigned long i = 1; i < opt->population; i++)
+    {
+        for (int f = 0; f < NUM_FEATURES; f++)
+            t->population[i].weights.weight[f] = (float)gaussian(&t->rng);
+        normalize(&t->population[i].weights);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    tuneOptions opt = {
+        .population = 24,
+        .generations = 30,
+        .games = 100,
+        .maxTiles = 500,
+        .garbage = 4,
+        .seed = 1,
+        .threads = 0,
+        .checkpoint = "stetris_tune.ckpt",
+        .out = "stetris_weights.txt",
+        .resume = false,
+    };
+    static tuneState t;
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--resume") == 0)
+            opt.resume = true;
+        else if (i + 1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "--population") == 0)
+            opt.population = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--generations") == 0)
+            opt.generations = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--games") == 0)
+            opt.games = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--max-tiles") == 0)
+            opt.maxTiles = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--garbage") == 0)
+            opt.garbage = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--seed") == 0)
+            opt.seed = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--threads") == 0)
+            opt.threads = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (strcmp(argv[i], "--checkpoint") == 0)
+            opt.checkpoint = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0)
+            opt.out = argv[++i];
+        else if (strcmp(argv[i], "--mlp-out") == 0)
+            opt.mlpOut = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.population < 2 || opt.population > MAX_POPULATION || opt.games == 0 ||
+        opt.population * opt.games > UINT32_MAX)
+        usage(argv[0]);
+
+    if (!opt.resume)
+        initPopulation(&t, &opt);
+    else if (!loadCheckpoint(&t, &opt))
+    {
+        fprintf(stderr, "ERROR: could not resume from %s\n", opt.checkpoint);
+        return EXIT_FAILURE;
+    }
+    else
+        printf("Resuming %s at generation %lu\n", opt.checkpoint, t.generation);
+
+    threadPool *pool = poolCreate(opt.threads);
+    uint32_t *scores = malloc(sizeof(uint32_t) * opt.population * opt.games);
+    if (!pool || !scores)
+    {
+        fprintf(stderr, "ERROR: could not start the tuner\n");
+        return EXIT_FAILURE;
+    }
+    printf("Tuning %lu candidates x %lu games on %u threads\n", opt.population, opt.games, poolThreads(pool));
+
+    while (t.generation < opt.generations)
+    {
+        double const start = botNow();
+        generationRun run = {
+            .opt = &opt,
+            .population = t.population,
+            .firstSeed = (uint32_t)(opt.seed + t.generation * opt.games),
+            .scores = scores,
+        };
+        poolFor(pool, playTask, &run, (unsigned int)(opt.population * opt.games));
+
+        double mean = 0;
+        for (unsigned long i = 0; i < opt.population; i++)
+        {
+            unsigned long long sum = 0;
+            for (unsigned long g = 0; g < opt.games; g++)
+                sum += scores[i * opt.games + g];
+            t.population[i].fitness = (double)sum / opt.games;
+            mean += t.population[i].fitness / opt.population;
+        }
+        qsort(t.population, opt.population, sizeof(candidate), compareCandidates);
+
+        candidate const *best = &t.population[0];
+        if (best->fitness > t.best.fitness)
+        {
+            t.best = *best;
+            float const *w = t.best.weights.weight;
+            if (!botSaveWeights(&t.best.weights, opt.out))
+                fprintf(stderr, "ERROR: could not write %s\n", opt.out);
+            if (opt.mlpOut && !mlpWriteLinear(opt.mlpOut, w[FEATURE_HEIGHT], w[FEATURE_HOLES], w[FEATURE_BUMPINESS]))
+                fprintf(stderr, "ERROR: could not write %s\n", opt.mlpOut);
+        }
+        printf("Generation %3lu: best %8.1f mean %8.1f weights", t.generation + 1, best->fitness, mean);
+        for (int f = 0; f < NUM_FEATURES; f++)
+            printf(" %6.3f", best->weights.weight[f]);
+        printf(" (%.1f s)\n", (botNow() - start) / 1e6);
+        fflush(stdout);
+
+        breed(&t, opt.population);
+        t.generation++;
+        if (!saveCheckpoint(&t, &opt))
+            fprintf(stderr, "ERROR: could not write %s\n", opt.checkpoint);
+    }
+
+    printf("Best fitness %.1f, weights written to %s\n", t.best.fitness, opt.out);
+    free(scores);
+    poolDestroy(pool);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,988 @@
+/**
+ * @file stetris_versus.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Versus mode: two to four players attack each other with garbage rows.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Every row a player clears sends a garbage row to an opponent; the rules
+ * of the match are in stetris_match.c.
+ * Each player is a thread with its own engine. The main thread is the clock:
+ * every tick it reads the input devices and sends each player a command
+ * with its key and the garbage it receives, then waits for the result of
+ * every player before routing the rows they cleared. The threads talk
+ * through single-producer single-consumer rings and sleep on futexes when
+ * their ring is empty, so the players move in lockstep without locks.
+ * A bot thinks on a thread of its own: its player sends it the state after
+ * every tick and takes the bot's keys from a ring without waiting for them,
+ * so a slow bot never delays the tick of the other players.
+ * With --listen PATH and --connect PATH two processes play a match of two
+ * players, one on each side, with the rollback of stetris_rollback.c;
+ * --delay and --jitter add latency to test it on one machine.
+ */
+
+#define _GNU_SOURCE                     // Enables clock_nanosleep() and syscall() with -std=c99
+
+#include <errno.h>                      // for errno, EINTR
+#include <fcntl.h>                      // for open(), O_RDONLY, O_NONBLOCK
+#include <limits.h>                     // for INT_MAX
+#include <linux/futex.h>                // for FUTEX_WAIT, FUTEX_WAKE
+#include <poll.h>                       // for poll()
+#include <pthread.h>                    // for pthread_create(), pthread_join()
+#include <signal.h>                     // for sigaction(), pthread_sigmask(), SIGINT, SIGTERM
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for calloc(), free()
+#include <string.h>                     // for strcmp, memcpy
+#include <sys/syscall.h>                // for SYS_futex
+#include <termios.h>                    // for console input handling
+#include <time.h>                       // for clock_gettime(), clock_nanosleep()
+#include <unistd.h>                     // for read(), close(), syscall(), isatty()
+
+#include "stetris_bot.h"
+#include "stetris_engine.h"
+#include "stetris_match.h"
+#include "stetris_rollback.h"
+#include "stetris_args.h"
+
+#define RING_SLOTS 64                   // messages per ring, a power of 2
+#define PENDING_KEYS 8                  // keys of a player waiting for their tick
+#define HELLO_TIMEOUT_MSEC 5000         // time the other side gets to answer NET_HELLO
+
+typedef enum
+{
+    INPUT_ARROWS,                       // arrow keys of the console
+    INPUT_WASD,                         // A, D and S of the console
+    INPUT_EVDEV,                        // input device, e.g. the Sense HAT joystick
+    INPUT_BOT,                          // the bot of the BOT_USAGE options
+} inputKind;
+
+/**
+ * Single-producer single-consumer ring of fixed size messages. head is
+ * written only by the producer and tail only by the consumer; the consumer
+ * sleeps on head while the ring is empty.
+ */
+typedef struct
+{
+    uint32_t head;                      // messages pushed (atomic, futex word)
+    uint32_t tail;                      // messages popped (atomic)
+    size_t size;                        // bytes per message
+    uint8_t *slots;
+} spscRing;
+
+/**
+ * Input of one tick of a player, from the main thread.
+ */
+typedef struct
+{
+    uint64_t tick;
+    bool stop;                          // end the thread
+    matchInput in;                      // round start or garbage before the key
+    uint8_t key;                        // KEY_* & 0xFF of the human, 0 for none
+} tickCommand;
+
+/**
+ * Outcome of one tick of a player, to the main thread.
+ */
+typedef struct
+{
+    uint64_t tick;
+    engineState game;                   // after the tick
+    uint8_t cleared;                    // rows cleared in the tick
+} tickResult;
+
+/**
+ * State a bot decides on, and the key it decides.
+ */
+typedef struct
+{
+    uint64_t tick;                      // of the state, or of the state the key was made for
+    bool stop;
+    uint8_t key;
+    engineState game;
+} botMessage;
+
+typedef struct
+{
+    inputKind input;
+    char const *device;                 // INPUT_EVDEV
+    int fd;                             // of device, -1 if none
+    pthread_t thread;                   // none in netplay, the main thread plays
+    bool threaded;
+    pthread_t botThread;
+    bot brain;                          // INPUT_BOT
+
+    spscRing commands;                  // main thread to player
+    spscRing results;                   // player to main thread
+    spscRing toBot;                     // states, player to bot
+    spscRing fromBot;                   // keys, bot to player
+
+    // Owned by the player thread
+    engineState game;
+    uint64_t keyedAt;                   // tick of the last key played
+
+    // Owned by the main thread
+    uint8_t keys[PENDING_KEYS];
+    unsigned int keyHead, keyCount;
+} player;
+
+typedef struct
+{
+    unsigned int players;
+    uint32_t seed;                      // seed of the first round
+    unsigned long rounds;               // stop after this many rounds, 0 to play on
+    char const *listenPath;             // host a netplay match on this socket
+    char const *connectPath;            // join the netplay match on this socket
+    unsigned long delayMSec;            // latency added to the frames sent
+    unsigned long jitterMSec;           // random latency added on top, up to this
+    unsigned int inputDelay;            // ticks before a local key is played in netplay
+} versusOptions;
+
+static versusOptions opt = {
+    .seed = 1,
+};
+static botOptions botOpt;
+static player players[MATCH_MAX_PLAYERS];
+static versusMatch match;               // the games as of the last tick
+static int netLocal = -1;               // player of this side in netplay, -1 for a local match
+static struct termios oldTermios;
+static bool rawConsole = false;
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--player arrows|wasd|bot|DEVICE]... [--seed S] [--rounds N]"
+                    " [--listen PATH | --connect PATH] [--delay MSEC] [--jitter MSEC] [--input-delay TICKS] "
+                    ENGINE_USAGE " " BOT_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void stopHandler(int signum)
+{
+    (void)signum;
+    stopping = 1;
+}
+
+static long futex(uint32_t *word, int op, uint32_t value)
+{
+    return syscall(SYS_futex, word, op, value, NULL, NULL, 0);
+}
+
+static bool ringCreate(spscRing *r, size_t size)
+{
+    r->head = r->tail = 0;
+    r->size = size;
+    r->slots = calloc(RING_SLOTS, size);
+    return r->slots != NULL;
+}
+
+/**
+ * Appends message to r and wakes its consumer. Returns false if r is full.
+ */
+static bool ringPush(spscRing *r, void const *message)
+{
+    uint32_t const head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SLOTS)
+        return false;
+    memcpy(r->slots + (head & (RING_SLOTS - 1)) * r->size, message, r->size);
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    futex(&r->head, FUTEX_WAKE_PRIVATE, INT_MAX);
+    return true;
+}
+
+/**
+ * Takes the oldest message of r into message. Returns false if r is empty.
+ */
+static bool ringPop(spscRing *r, void *message)
+{
+    uint32_t const tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+        return false;
+    memcpy(message, r->slots + (tail & (RING_SLOTS - 1)) * r->size, r->size);
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Takes the oldest message of r, sleeping until there is one.
+ */
+static void ringWait(spscRing *r, void *message)
+{
+    while (!ringPop(r, message))
+        futex(&r->head, FUTEX_WAIT_PRIVATE, __atomic_load_n(&r->tail, __ATOMIC_RELAXED));
+}
+
+/**
+ * Body of a player thread: plays the ticks the main thread sends.
+ */
+static void *runPlayer(void *arg)
+{
+    player *p = arg;
+    tickCommand c;
+
+    for (;;)
+    {
+        ringWait(&p->commands, &c);
+        if (c.stop)
+            break;
+        if (c.in.restart)
+            p->keyedAt = 0;
+
+        // A key of the bot counts if it was made for this tile after the
+        // last key played; the keys after the one taken are stale then
+        int key = c.key;
+        botMessage m;
+        while (ringPop(&p->fromBot, &m))
+        {
+            if (!key && !c.in.restart && m.game.tiles == p->game.tiles && m.tick >= p->keyedAt)
+                key = m.key;
+        }
+
+        tickResult r = {.tick = c.tick};
+        r.cleared = (uint8_t)matchPlay(&p->game, &c.in, key);
+        if (key)
+            p->keyedAt = c.tick;
+        r.game = p->game;
+        ringPush(&p->results, &r);
+
+        if (p->input == INPUT_BOT)
+        {
+            botMessage const state = {.tick = c.tick, .game = p->game};
+            ringPush(&p->toBot, &state);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Body of a bot thread: decides on the newest state of its player.
+ */
+static void *runBot(void *arg)
+{
+    player *p = arg;
+    botMessage m;
+
+    for (;;)
+    {
+        ringWait(&p->toBot, &m);
+        // A bot that fell behind skips to the newest state
+        while (!m.stop && ringPop(&p->toBot, &m))
+            ;
+        if (m.stop)
+            break;
+        if (!(m.game.state & ACTIVE))
+            continue;
+        m.key = (uint8_t)botNextKey(&p->brain, &m.game);
+        if (m.key)
+            ringPush(&p->fromBot, &m);
+    }
+    return NULL;
+}
+
+/**
+ * Queues key for player p, if p is a human.
+ */
+static void pressKey(player *p, int key)
+{
+    if (p->input == INPUT_BOT || p->keyCount == PENDING_KEYS)
+        return;
+    p->keys[(p->keyHead + p->keyCount) % PENDING_KEYS] = (uint8_t)key;
+    p->keyCount++;
+}
+
+/**
+ * Takes the next key pressed for p, 0 if there is none.
+ */
+static int popKey(player *p)
+{
+    if (!p->keyCount)
+        return 0;
+    int const key = p->keys[p->keyHead];
+    p->keyHead = (p->keyHead + 1) % PENDING_KEYS;
+    p->keyCount--;
+    return key;
+}
+
+/**
+ * Queues key for every player reading the console with input.
+ */
+static void consoleKey(inputKind input, int key)
+{
+    for (unsigned int i = 0; i < opt.players; i++)
+    {
+        if (players[i].input == input)
+            pressKey(&players[i], key);
+    }
+}
+
+/**
+ * Reads the keys of the console and the input devices. Returns false when
+ * Enter is pressed on the console.
+ */
+static bool readInput()
+{
+    struct pollfd pollStdin = {.fd = STDIN_FILENO, .events = POLLIN};
+    while (rawConsole && poll(&pollStdin, 1, 0) > 0)
+    {
+        unsigned char c;
+        if (read(STDIN_FILENO, &c, 1) != 1)
+            break;
+        if (c == '\n')
+            return false;
+        if (c == 27)
+        {
+            // Arrow keys arrive as ESC [ A..D
+            unsigned char sequence[2];
+            if (read(STDIN_FILENO, sequence, 2) != 2 || sequence[0] != '[')
+                continue;
+            int const arrows[4] = {KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT};
+            if (sequence[1] >= 'A' && sequence[1] <= 'D')
+                consoleKey(INPUT_ARROWS, arrows[sequence[1] - 'A']);
+            continue;
+        }
+        switch (c)
+        {
+        case 'a':
+            consoleKey(INPUT_WASD, KEY_LEFT);
+            break;
+        case 'd':
+            consoleKey(INPUT_WASD, KEY_RIGHT);
+            break;
+        case 's':
+            consoleKey(INPUT_WASD, KEY_DOWN);
+            break;
+        case 'w':
+            consoleKey(INPUT_WASD, KEY_UP);
+            break;
+        }
+    }
+
+    for (unsigned int i = 0; i < opt.players; i++)
+    {
+        player *p = &players[i];
+        struct input_event ev[16];
+        ssize_t n;
+        while (p->fd >= 0 && (n = read(p->fd, ev, sizeof(ev))) >= (ssize_t)sizeof(ev[0]))
+        {
+            for (unsigned int e = 0; e < n / sizeof(ev[0]); e++)
+            {
+                // Only presses, like the joystick of the Sense HAT frontends
+                if (ev[e].type != EV_KEY || ev[e].value != 1)
+                    continue;
+                switch (ev[e].code)
+                {
+                case KEY_LEFT:
+                case KEY_A:
+                    pressKey(p, KEY_LEFT);
+                    break;
+                case KEY_RIGHT:
+                case KEY_D:
+                    pressKey(p, KEY_RIGHT);
+                    break;
+                case KEY_DOWN:
+                case KEY_S:
+                    pressKey(p, KEY_DOWN);
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static char const *inputName(player const *p)
+{
+    static char const *const names[] = {"arrows", "wasd", "device", "bot"};
+    return names[p->input];
+}
+
+/**
+ * Returns the name of player i of the match.
+ */
+static char const *playerName(int i)
+{
+    if (netLocal < 0)
+        return inputName(&players[i]);
+    return (i == netLocal) ? inputName(&players[0]) : "remote";
+}
+
+/**
+ * Draws the boards side by side with the counters of every player.
+ */
+static void render(versusMatch const *m)
+{
+    static char const colors[NUM_COLORS] = {'R', 'G', 'B', 'M', 'C', 'Y'};
+
+    printf("\033[H");
+    printf("Round %u\n", m->round);
+    for (unsigned int i = 0; i < m->players; i++)
+        printf("P%u %-8s   ", i + 1, playerName(i));
+    printf("\n");
+    for (unsigned int i = 0; i < m->players; i++)
+        printf("----------   ");
+    printf("\n");
+    for (unsigned int y = 0; y < GRID_Y; y++)
+    {
+        for (unsigned int i = 0; i < m->players; i++)
+        {
+            engineState const *s = &m->game[i];
+            printf("|");
+            for (unsigned int x = 0; x < GRID_X; x++)
+            {
+                int const color = engineColorAt(s, x, y);
+                printf("%c", color < 0 ? ' ' : colors[color % NUM_COLORS]);
+            }
+            // The column of waiting garbage, one mark per row
+            printf("|%c  ", (GRID_Y - y <= m->incoming[i]) ? '#' : ' ');
+        }
+        printf("\n");
+    }
+    for (unsigned int i = 0; i < m->players; i++)
+        printf("----------   ");
+    printf("\n");
+    for (unsigned int i = 0; i < m->players; i++)
+        printf("Rows %6u   ", m->game[i].rows);
+    printf("\n");
+    for (unsigned int i = 0; i < m->players; i++)
+        printf("Sent %6u   ", m->sent[i]);
+    printf("\n");
+    for (unsigned int i = 0; i < m->players; i++)
+        printf("Wins %6u   ", m->wins[i]);
+    printf("\n");
+    for (unsigned int i = 0; i < m->players; i++)
+    {
+        bool const over = m->game[i].state == GAMEOVER;
+        printf("%-13s", (m->pause && m->winner == (int)i) ? "Winner" : over ? "Game Over" : "");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/**
+ * Parses the argument of --player into p.
+ */
+static bool parsePlayer(player *p, char const *text)
+{
+    p->fd = -1;
+    if (strcmp(text, "arrows") == 0)
+        p->input = INPUT_ARROWS;
+    else if (strcmp(text, "wasd") == 0)
+        p->input = INPUT_WASD;
+    else if (strcmp(text, "bot") == 0)
+        p->input = INPUT_BOT;
+    else if (text[0] == '/')
+    {
+        p->input = INPUT_EVDEV;
+        p->device = text;
+    }
+    else
+        return false;
+    return true;
+}
+
+static void restoreConsole()
+{
+    if (rawConsole)
+        tcsetattr(STDIN_FILENO, TCSANOW, &oldTermios);
+}
+
+/**
+ * Creates the rings, devices and bot of p and starts its threads, the
+ * player thread only if threaded.
+ */
+static bool startPlayer(player *p, bool threaded)
+{
+    if (!ringCreate(&p->commands, sizeof(tickCommand)) || !ringCreate(&p->results, sizeof(tickResult)) ||
+        !ringCreate(&p->toBot, sizeof(botMessage)) || !ringCreate(&p->fromBot, sizeof(botMessage)))
+        return false;
+    if (p->input == INPUT_EVDEV)
+    {
+        p->fd = open(p->device, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (p->fd < 0)
+        {
+            fprintf(stderr, "ERROR: could not open %s\n", p->device);
+            return false;
+        }
+    }
+    if (p->input == INPUT_BOT)
+    {
+        botOptions o = botOpt;
+        o.enabled = true;
+        if (!botCreate(&p->brain, &o) || pthread_create(&p->botThread, NULL, runBot, p) != 0)
+            return false;
+    }
+    p->threaded = threaded && pthread_create(&p->thread, NULL, runPlayer, p) == 0;
+    return p->threaded == threaded;
+}
+
+/**
+ * Stops the threads of p and frees what startPlayer() created.
+ */
+static void stopPlayer(player *p)
+{
+    if (p->threaded)
+    {
+        tickCommand const stop = {.stop = true};
+        ringPush(&p->commands, &stop);
+        pthread_join(p->thread, NULL);
+    }
+    if (p->input == INPUT_BOT)
+    {
+        // The player thread that sent the states is gone
+        botMessage const stop = {.stop = true};
+        while (!ringPush(&p->toBot, &stop))
+            ;
+        pthread_join(p->botThread, NULL);
+        botDestroy(&p->brain);
+    }
+    if (p->fd >= 0)
+        close(p->fd);
+    free(p->commands.slots);
+    free(p->results.slots);
+    free(p->toBot.slots);
+    free(p->fromBot.slots);
+}
+
+/**
+ * Adds uSec microseconds to t.
+ */
+static void addUSec(struct timespec *t, unsigned long uSec)
+{
+    t->tv_nsec += (long)(uSec % 1000000) * 1000;
+    t->tv_sec += uSec / 1000000 + t->tv_nsec / 1000000000;
+    t->tv_nsec %= 1000000000;
+}
+
+
+/**
+ * Sleeps until deadline and moves it on by one tick.
+ */
+static void waitTick(struct timespec *deadline)
+{
+    addUSec(deadline, gameRules.uSecTickTime);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR && !stopping)
+        ;
+}
+
+/**
+ * Plays the match of the players of this process, each on its thread.
+ */
+static void playLocal()
+{
+    matchInit(&match, opt.players, opt.seed);
+    match.rounds = (uint32_t)opt.rounds;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    for (uint64_t tick = 1; !stopping; tick++)
+    {
+        if (!readInput())
+            break;
+        if (matchOver(&match))
+            break;
+
+        // Every player plays the tick at the same time
+        matchInput in[MATCH_MAX_PLAYERS];
+        matchPrepare(&match, in);
+        for (unsigned int i = 0; i < opt.players; i++)
+        {
+            player *p = &players[i];
+            tickCommand c = {.tick = tick, .in = in[i]};
+            if (in[i].restart)
+                p->keyCount = 0;
+            else
+                c.key = (uint8_t)popKey(p);
+            ringPush(&p->commands, &c);
+        }
+
+        bool changed = false;
+        unsigned int cleared[MATCH_MAX_PLAYERS];
+        for (unsigned int i = 0; i < opt.players; i++)
+        {
+            tickResult r;
+            ringWait(&players[i].results, &r);
+            changed |= r.game.occupied != match.game[i].occupied || r.game.state != match.game[i].state;
+            match.game[i] = r.game;
+            cleared[i] = r.cleared;
+        }
+        changed |= matchFinish(&match, cleared);
+        if (changed)
+            render(&match);
+        waitTick(&deadline);
+    }
+}
+
+/**
+ * Waits for a frame of type from the other side, sending the delayed
+ * frames meanwhile. Returns its size, 0 on timeout or if the other side is
+ * gone.
+ */
+static size_t awaitFrame(netPeer *peer, uint16_t type, uint32_t *length)
+{
+    uint64_t const until = peerNow() + HELLO_TIMEOUT_MSEC * 1000ULL;
+    while (!stopping && peerNow() < until)
+    {
+        uint16_t frameType, count;
+        size_t const size = peerFrame(peer, &frameType, &count, length);
+        if (size && frameType == type)
+            return size;
+        if (size)
+            peerDrop(peer, size);
+        else
+        {
+            peerFlush(peer);
+            if (!peerReceive(peer, 10))
+                return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Agrees on the seed, rounds and rules with the other side: the host sends
+ * its own, the guest takes them. Returns false if the other side does not
+ * answer, runs another version or sends rules out of range.
+ */
+static bool hello(netPeer *peer, bool host)
+{
+    uint8_t payload[PEER_FRAME - STETRIS_FRAME_HEADER];
+    uint32_t length;
+
+    stetrisPut32(payload, ROLLBACK_VERSION);
+    if (host)
+    {
+        uint8_t *q = payload + 4;
+        stetrisPut32(q, opt.seed);
+        stetrisPut32(q + 4, (uint32_t)opt.rounds);
+        stetrisPut32(q + 8, (uint32_t)gameRules.uSecTickTime);
+        stetrisPut32(q + 12, gameRules.rowsPerLevel);
+        stetrisPut32(q + 16, gameRules.initNextGameTick);
+        stetrisPut32(q + 20, gameRules.levelBands);
+        q += 24;
+        for (unsigned int i = 0; i < MAX_LEVEL_BANDS; i++, q += 8)
+        {
+            stetrisPut32(q, gameRules.levelUpTo[i]);
+            stetrisPut32(q + 4, gameRules.levelStep[i]);
+        }
+        peerSend(peer, STETRIS_MSG_NET_HELLO, 0, payload, (uint32_t)(q - payload));
+        size_t const size = awaitFrame(peer, STETRIS_MSG_NET_HELLO, &length);
+        if (!size || length != 4 || stetrisGet32(peer->buffer + STETRIS_FRAME_HEADER) != ROLLBACK_VERSION)
+            return false;
+        peerDrop(peer, size);
+        return true;
+    }
+
+    size_t const size = awaitFrame(peer, STETRIS_MSG_NET_HELLO, &length);
+    uint8_t const *q = peer->buffer + STETRIS_FRAME_HEADER;
+    if (!size || length != 28 + 8 * MAX_LEVEL_BANDS || stetrisGet32(q) != ROLLBACK_VERSION)
+        return false;
+    opt.seed = stetrisGet32(q + 4);
+    opt.rounds = stetrisGet32(q + 8);
+    gameRules.uSecTickTime = stetrisGet32(q + 12);
+    gameRules.rowsPerLevel = stetrisGet32(q + 16);
+    gameRules.initNextGameTick = stetrisGet32(q + 20);
+    gameRules.levelBands = stetrisGet32(q + 24);
+    q += 28;
+    for (unsigned int i = 0; i < MAX_LEVEL_BANDS; i++, q += 8)
+    {
+        gameRules.levelUpTo[i] = stetrisGet32(q);
+        gameRules.levelStep[i] = stetrisGet32(q + 4);
+    }
+    peerDrop(peer, size);
+    peerSend(peer, STETRIS_MSG_NET_HELLO, 0, payload, 4);
+    // The ranges of engineParseRule(), the engine divides by both
+    if (gameRules.uSecTickTime == 0 || gameRules.rowsPerLevel < 1 || gameRules.rowsPerLevel > UINT8_MAX ||
+        gameRules.initNextGameTick < 1 || gameRules.levelBands < 1 || gameRules.levelBands > MAX_LEVEL_BANDS)
+        return false;
+    // The bot was created under the rules of the command line, see botCreate()
+    if (players[0].input == INPUT_BOT && (botOpt.kind == BOT_PLUGIN || botOpt.kind == BOT_REMOTE) &&
+        gameRules.initNextGameTick > UINT8_MAX)
+    {
+        fprintf(stderr, "ERROR: plugin and remote bots take a start period of at most %d\n", UINT8_MAX);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Sends the local key of the tick tick.
+ */
+static void sendKey(netPeer *peer, uint64_t tick, uint8_t key)
+{
+    uint8_t payload[5];
+    stetrisPut32(payload, (uint32_t)tick);
+    payload[4] = key;
+    peerSend(peer, STETRIS_MSG_NET_KEYS, 1, payload, sizeof(payload));
+}
+
+/**
+ * Handles the frames the other side has sent. Returns false when it is gone
+ * or broke the protocol.
+ */
+static bool receiveFrames(netPeer *peer, rollbackSession *session)
+{
+    uint16_t type, count;
+    uint32_t length;
+    size_t size;
+
+    if (!peerReceive(peer, 0))
+        return false;
+    while ((size = peerFrame(peer, &type, &count, &length)) > 0)
+    {
+        uint8_t const *q = peer->buffer + STETRIS_FRAME_HEADER;
+        switch (type)
+        {
+        case STETRIS_MSG_NET_KEYS:
+            if (length != 4u + count)
+                return false;
+            for (unsigned int k = 0; k < count; k++)
+            {
+                if (!rollbackAddRemote(session, stetrisGet32(q) + (uint64_t)k, q[4 + k]))
+                    return false;
+            }
+            break;
+        case STETRIS_MSG_NET_CHECK:
+            if (length != 12)
+                return false;
+            rollbackRemoteCheck(session, stetrisGet32(q), stetrisGet64(q + 4));
+            break;
+        case STETRIS_MSG_BYE:
+            return false;
+        }
+        peerDrop(peer, size);
+    }
+    return peer->fd >= 0;
+}
+
+/**
+ * Returns true if the boards, garbage or counters of a and b differ.
+ */
+static bool viewChanged(versusMatch const *a, versusMatch const *b)
+{
+    if (a->round != b->round || a->pause != b->pause)
+        return true;
+    for (unsigned int i = 0; i < a->players; i++)
+    {
+        if (a->game[i].occupied != b->game[i].occupied || a->game[i].state != b->game[i].state ||
+            a->incoming[i] != b->incoming[i] || a->wins[i] != b->wins[i])
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Plays a match of two processes with rollback: players[0] of this process
+ * is player 1 of the host or player 2 of the guest.
+ * Returns false if the other side could not be reached.
+ */
+static bool playOnline()
+{
+    static netPeer peer;
+    static rollbackSession session;
+    bool const host = opt.listenPath != NULL;
+
+    peer.delayUSec = opt.delayMSec * 1000;
+    peer.jitterUSec = opt.jitterMSec * 1000;
+    if (host)
+        printf("Waiting for the other side on %s\n", opt.listenPath);
+    if (!(host ? peerListen(&peer, opt.listenPath) : peerConnect(&peer, opt.connectPath)))
+        return false;
+    if (!hello(&peer, host))
+    {
+        fprintf(stderr, "ERROR: the other side did not agree on the version and rules\n");
+        peerClose(&peer);
+        return false;
+    }
+
+    netLocal = host ? 0 : 1;
+    rollbackInit(&session, (unsigned int)netLocal, opt.seed);
+    session.match.rounds = (uint32_t)opt.rounds;
+    // The keys of the input delay are played before the first local one
+    for (unsigned int i = 0; i < opt.inputDelay; i++)
+    {
+        sendKey(&peer, session.localUntil, 0);
+        rollbackAddLocal(&session, 0);
+    }
+
+    player *p = &players[0];
+    versusMatch shown = session.match;
+    uint64_t keyedAt = 0;               // tick of the last local key
+    unsigned long long stalls = 0;
+    bool gone = false;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    printf("\033[H\033[J");
+
+    while (!stopping)
+    {
+        if (!readInput())
+            break;
+        if (!receiveFrames(&peer, &session))
+        {
+            // The keys the other side sent before it left still count: its
+            // match may have ended at a tick this side has not confirmed
+            rollbackSettle(&session);
+            gone = !matchOver(&session.match);
+            break;
+        }
+        // A match that is over with predicted keys may go on after a rollback
+        if (session.confirmed >= session.tick && matchOver(&session.match))
+            break;
+
+        if (rollbackReady(&session))
+        {
+            // A key of the bot counts if it was made for the current tile
+            // on a state after the last key, as in runPlayer()
+            uint8_t key = (uint8_t)popKey(p);
+            botMessage m;
+            while (ringPop(&p->fromBot, &m))
+            {
+                if (!key && m.game.tiles == session.match.game[netLocal].tiles && m.tick > keyedAt)
+                    key = m.key;
+            }
+            if (key)
+                keyedAt = session.localUntil;
+            sendKey(&peer, session.localUntil, key);
+            rollbackAddLocal(&session, key);
+        }
+        else
+            stalls++;
+
+        if (rollbackAdvance(&session) && p->input == INPUT_BOT)
+        {
+            botMessage const state = {.tick = session.tick, .game = session.match.game[netLocal]};
+            ringPush(&p->toBot, &state);
+        }
+        uint64_t tick, hash;
+        while (rollbackNextCheck(&session, &tick, &hash))
+        {
+            uint8_t payload[12];
+            stetrisPut32(payload, (uint32_t)tick);
+            stetrisPut64(payload + 4, hash);
+            peerSend(&peer, STETRIS_MSG_NET_CHECK, 0, payload, sizeof(payload));
+        }
+        peerFlush(&peer);
+
+        if (viewChanged(&shown, &session.match))
+        {
+            shown = session.match;
+            render(&shown);
+        }
+        waitTick(&deadline);
+    }
+    if (viewChanged(&shown, &session.match))
+        render(&session.match);
+
+    peerClose(&peer);
+    match = session.match;
+    printf("\n");
+    if (gone)
+        printf("The other side has left\n");
+    printf("Netplay: %llu ticks, %llu stalled, %llu rollbacks replaying %llu ticks (at most %llu at once, "
+           "%.1f us on average, %.1f us at most), %llu checks, %llu desyncs\n",
+           (unsigned long long)session.tick, stalls, session.rollbacks, session.replayed, session.maxDepth,
+           session.rollbacks ? session.replayUSec / session.rollbacks : 0.0, session.maxReplayUSec, session.checks,
+           session.desyncs);
+    return true;
+}
+
+
+int main(int argc, char **argv)
+{
+    botOpt = defaultBotOptions;
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--player") == 0)
+        {
+            if (opt.players == MATCH_MAX_PLAYERS || !parsePlayer(&players[opt.players++], argv[++i]))
+                usage(argv[0]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0)
+            opt.seed = (uint32_t)parseNumberArg(argv[++i], UINT32_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--rounds") == 0)
+            opt.rounds = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--listen") == 0)
+            opt.listenPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--connect") == 0)
+            opt.connectPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--delay") == 0)
+            opt.delayMSec = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--jitter") == 0)
+            opt.jitterMSec = parseNumberArg(argv[++i], ULONG_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--input-delay") == 0)
+            opt.inputDelay = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (!engineParseRule(&gameRules, argc, argv, &i) && !botParseOption(&botOpt, argc, argv, &i))
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    bool const online = opt.listenPath || opt.connectPath;
+    if (opt.players == 0)
+    {
+        parsePlayer(&players[opt.players++], "arrows");
+        if (!online)
+            parsePlayer(&players[opt.players++], "bot");
+    }
+    // Netplay has one player on each side
+    if (online ? (opt.players != 1 || (opt.listenPath && opt.connectPath) || opt.inputDelay > ROLLBACK_MAX_DELAY)
+               : opt.players < 2)
+        usage(argv[0]);
+
+    bool console = false;
+    for (unsigned int i = 0; i < opt.players; i++)
+        console |= players[i].input == INPUT_ARROWS || players[i].input == INPUT_WASD;
+    if (console && isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &oldTermios) == 0)
+    {
+        struct termios raw = oldTermios;
+        raw.c_lflag &= ~(ICANON | ECHO);    // keys without Enter and echo
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        rawConsole = true;
+    }
+    // Without SA_RESTART, so that a host waiting in accept() can be stopped;
+    // the threads of the players block the signals, so they reach main
+    struct sigaction stop = {.sa_handler = stopHandler};
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    for (unsigned int i = 0; i < opt.players; i++)
+    {
+        if (!startPlayer(&players[i], !online))
+        {
+            fprintf(stderr, "ERROR: could not start player %u\n", i + 1);
+            restoreConsole();
+            return EXIT_FAILURE;
+        }
+    }
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, NULL);
+
+    bool played = true;
+    if (online)
+        played = playOnline();
+    else
+    {
+        printf("\033[H\033[J");
+        playLocal();
+    }
+
+    for (unsigned int i = 0; i < opt.players; i++)
+        stopPlayer(&players[i]);
+    restoreConsole();
+    if (!played)
+        return EXIT_FAILURE;
+    printf("\n");
+    for (unsigned int i = 0; i < match.players; i++)
+        printf("Player %u (%s): %u wins, %u garbage rows sent\n", i + 1, playerName((int)i), match.wins[i],
+               match.sent[i]);
+    return EXIT_SUCCESS;
+}
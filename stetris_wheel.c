@@ -0,0 +1,136 @@
+/**
+ * @file stetris_wheel.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Hierarchical hashed timer wheel for the timers of many games.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * A timer is put in the level whose slots are as wide as the distance to its
+ * tick allows, at the slot of its tick. When the wheel enters the first tick
+ * of a slot of level l > 0, the timers of that slot are added again and land
+ * in a lower level, so a timer moves at most WHEEL_LEVELS - 1 times before
+ * it fires and every slot of level 0 only holds timers of its own tick.
+ */
+
+#include "stetris_wheel.h"
+
+#include <string.h>                     // for memset
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_RANGE ((uint64_t)1 << (WHEEL_LEVELS * WHEEL_BITS))
+
+/**
+ * Empties the wheel and starts it at tick now.
+ */
+void wheelInit(timerWheel *w, uint64_t now)
+{
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+}
+
+/**
+ * Returns the slot of a timer due in tick due.
+ */
+static wheelTimer **slotOf(timerWheel *w, uint64_t due)
+{
+    // Timers due already fire in the next tick that runs
+    if (due < w->now)
+        due = w->now;
+    // Timers beyond the range wait in the last slot of the range and are
+    // placed again when the wheel gets there
+    if (due - w->now >= WHEEL_RANGE)
+        due = w->now + WHEEL_RANGE - 1;
+
+    uint64_t const distance = due - w->now;
+    unsigned int level = 0;
+    while (level + 1 < WHEEL_LEVELS && distance >= (uint64_t)1 << ((level + 1) * WHEEL_BITS))
+        level++;
+    return &w->slots[level][(due >> (level * WHEEL_BITS)) & WHEEL_MASK];
+}
+
+/**
+ * Schedules t to fire in tick due, or in the next tick if due has passed.
+ * A pending t is moved.
+ */
+void wheelAdd(timerWheel *w, wheelTimer *t, uint64_t due)
+{
+    wheelRemove(w, t);
+
+    wheelTimer **slot = slotOf(w, due);
+    t->due = due;
+    t->slot = slot;
+    t->prev = NULL;
+    t->next = *slot;
+    if (*slot)
+        (*slot)->prev = t;
+    *slot = t;
+    w->pending++;
+}
+
+/**
+ * Cancels t if it is pending.
+ */
+void wheelRemove(timerWheel *w, wheelTimer *t)
+{
+    if (!t->slot)
+        return;
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        *t->slot = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+    t->slot = NULL;
+    w->pending--;
+}
+
+/**
+ * Adds the timers of slot again, which moves them to lower levels.
+ */
+static void cascade(timerWheel *w, wheelTimer **slot)
+{
+    wheelTimer *t = *slot;
+
+    *slot = NULL;
+    while (t)
+    {
+        wheelTimer *const next = t->next;
+        t->slot = NULL;
+        w->pending--;
+        wheelAdd(w, t, t->due);
+        t = next;
+    }
+}
+
+/**
+ * Runs tick w->now: calls the fire function of every timer due in it with
+ * context and moves on to the next tick. A timer is no longer pending when
+ * it fires, so it may be added again; timers added for the tick being run
+ * fire in the next one.
+ */
+void wheelTick(timerWheel *w, void *context)
+{
+    // Bring down the slots of the higher levels that start in this tick
+    for (unsigned int level = 1; level < WHEEL_LEVELS; level++)
+    {
+        if (w->now & ((((uint64_t)1) << (level * WHEEL_BITS)) - 1))
+            break;
+        cascade(w, &w->slots[level][(w->now >> (level * WHEEL_BITS)) & WHEEL_MASK]);
+    }
+
+    // The due timers are moved to a list of their own first: fire may add
+    // timers to the slot being run, for the tick one turn ahead
+    wheelTimer **slot = &w->slots[0][w->now & WHEEL_MASK];
+    wheelTimer *expired = *slot;
+    *slot = NULL;
+    for (wheelTimer *t = expired; t; t = t->next)
+        t->slot = &expired;
+    w->now++;
+    while (expired)
+    {
+        // A timer may also cancel the timers after it
+        wheelTimer *const t = expired;
+        wheelRemove(w, t);
+        t->fire(t, context);
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file stetris_wheel.h
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Hierarchical hashed timer wheel for the timers of many games.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Timers are counted in ticks. Adding and removing a timer and finding the
+ * timers of a tick take constant time however many timers are pending and
+ * however far ahead they are, so games with slow gravity or no timer at all
+ * cost nothing in the ticks in between.
+ * The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots. Level 0 holds the
+ * timers of the next WHEEL_SLOTS ticks, one slot per tick; every further
+ * level covers WHEEL_SLOTS times as many ticks per slot, and its slots are
+ * moved down to the lower levels when the wheel reaches them. Timers further
+ * ahead than the whole wheel wait in the last level and move down when they
+ * come into range.
+ */
+
+#ifndef STETRIS_WHEEL_H
+#define STETRIS_WHEEL_H
+
+#include <stdbool.h>                    // for bool type
+#include <stddef.h>                     // for offsetof
+#include <stdint.h>                     // for fixed width integer types
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4                  // covers WHEEL_SLOTS^4 = 2^24 ticks
+
+typedef struct wheelTimer wheelTimer;
+typedef void (*wheelFire)(wheelTimer *t, void *context);
+
+/**
+ * Timer embedded in the struct it belongs to; see WHEEL_OWNER.
+ */
+struct wheelTimer
+{
+    wheelTimer *prev, *next;            // timers of the same slot
+    wheelTimer **slot;                  // NULL if the timer is not pending
+    uint64_t due;                       // tick in which the timer fires
+    wheelFire fire;                     // called in that tick, set by the owner
+};
+
+typedef struct
+{
+    uint64_t now;                       // next tick to run
+    unsigned int pending;
+    wheelTimer *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} timerWheel;
+
+/**
+ * Returns the struct of type owner whose member is timer t.
+ */
+#define WHEEL_OWNER(t, owner, member) ((owner *)((char *)(t) - offsetof(owner, member)))
+
+void wheelInit(timerWheel *w, uint64_t now);
+void wheelAdd(timerWheel *w, wheelTimer *t, uint64_t due);
+void wheelRemove(timerWheel *w, wheelTimer *t);
+void wheelTick(timerWheel *w, void *context);
+
+static inline bool wheelPending(wheelTimer const *t)
+{
+    return t->slot != NULL;
+}
+
+#endif // STETRIS_WHEEL_H
@@ -0,0 +1,650 @@
+/**
+ * @file stetrisd.c
+ * @author Lorang Strand
+ * @date 2026-10-17
+ * @brief Game server hosting many independent sessions in one process.
+ * @version 1.0
+ * This file is part of the Stetris project.
+ * Clients connect to a Unix socket (the frontends with --connect PATH, or
+ * bots) and get a game of their own that runs at the tick rate of the
+ * server; the protocol is described in stetris_server.h.
+ * The main thread only accepts connections and hands each one to the
+ * worker with the fewest sessions through a pipe. A worker owns its
+ * sessions completely: it waits in epoll for their sockets, its pipe and a
+ * timerfd that expires once per tick, so no locks are taken while playing.
+ * A game needs the engine only in ticks with a key or a gravity step; all
+ * other ticks just count. Every worker therefore keeps the timers of its
+ * sessions in a hierarchical timer wheel (stetris_wheel.c): one for the next
+ * tick that needs the engine and one for the auto-repeat of a held key, and
+ * a tick only touches the sessions whose timers fire in it. Games in the
+ * GAMEOVER state have no timer at all. Keys are played as soon as they
+ * arrive, one per tick, and the changed fields are sent back at once.
+ * The engine locks a tile in the gravity step that finds it blocked, without
+ * a lock delay, so there is no lock timer.
+ */
+
+#define _GNU_SOURCE                     // Enables accept4() and pipe2() with -std=c99
+
+#include <errno.h>                      // for errno, EINTR, EAGAIN
+#include <fcntl.h>                      // for O_CLOEXEC
+#include <pthread.h>                    // for pthread_create(), pthread_join()
+#include <signal.h>                     // for sigaction(), pthread_sigmask(), SIGINT, SIGTERM
+#include <stdio.h>                      // for printf(), fprintf()
+#include <stdlib.h>                     // for calloc(), free()
+#include <string.h>                     // for strcmp, strlen, strcpy, memcpy, memmove
+#include <sys/epoll.h>                  // for epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/socket.h>                 // for socket(), bind(), listen(), accept4(), send()
+#include <sys/timerfd.h>                // for timerfd_create(), timerfd_settime()
+#include <sys/un.h>                     // for struct sockaddr_un
+#include <unistd.h>                     // for read(), write(), close(), unlink()
+
+#include "stetris_engine.h"
+#include "stetris_server.h"
+#include "stetris_wheel.h"
+#include "stetris_args.h"
+
+#define MAX_WORKERS 64
+#define MAX_EVENTS 64                   // epoll events per wait
+#define KEY_QUEUE 16                    // keys waiting for their tick, more are dropped
+#define SESSION_MAX_PAYLOAD 256         // longer client frames are a protocol error
+#define OUT_BUFFER (2 * STETRIS_FRAME_HEADER + 12 + SESSION_STATE_MAX)
+
+typedef struct
+{
+    char const *socketPath;
+    unsigned int workers;
+    unsigned int maxSessions;
+    unsigned int repeatDelay;           // ticks from pressing a key to its first repeat
+    unsigned int repeatRate;            // ticks between repeats
+} serverOptions;
+
+typedef struct worker worker;
+typedef struct session session;
+
+/**
+ * One game and its connection. Owned by one worker.
+ */
+struct session
+{
+    int fd;
+    uint32_t id;
+    worker *owner;
+    session *prev, *next;               // sessions of the worker
+    wheelTimer step;                    // next tick that needs the engine
+    wheelTimer repeat;                  // next repeat of the held key
+
+    bool joined;                        // JOIN has been received
+    bool fresh;                         // no STATE frame has been sent yet
+    engineState game;
+    engineState sent;                   // game as of the last STATE frame
+    uint64_t lastTick;                  // the game has run all ticks before this one
+    uint8_t keys[KEY_QUEUE];            // ring of keys for the next ticks
+    unsigned int keyHead, keyCount;
+    uint8_t held;                       // key held down, 0 if none
+
+    size_t inLength;
+    uint8_t in[STETRIS_FRAME_HEADER + SESSION_MAX_PAYLOAD];
+    size_t outLength, outSent;
+    uint8_t out[OUT_BUFFER];
+    bool wantWrite;                     // EPOLLOUT is requested
+    bool closed;                        // freed after the epoll batch, see closeSession()
+};
+
+struct worker
+{
+    pthread_t thread;
+    int epoll;
+    int timer;                          // timerfd, expires every tick
+    int handoff[2];                     // pipe of new sessions from the main thread
+    uint64_t now;                       // tick in progress
+    session *sessions;
+    session *zombies;                   // closed in this epoll batch, linked by next
+    timerWheel wheel;
+    uint32_t sessionCount;              // (atomic)
+};
+
+static serverOptions opt = {
+    .socketPath = STETRISD_SOCKET,
+    .workers = 2,
+    .maxSessions = 1024,
+    .repeatDelay = 17,
+    .repeatRate = 5,
+};
+static worker workers[MAX_WORKERS];
+static uint32_t totalSessions;          // (atomic)
+static uint32_t nextSessionId = 1;      // (atomic)
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ * Prints the command line usage and exits.
+ */
+static void usage(char const *name)
+{
+    fprintf(stderr, "Usage: %s [--socket PATH] [--workers N] [--max-sessions N] [--repeat-delay TICKS] [--repeat-rate TICKS] " ENGINE_USAGE "\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void stopHandler(int signum)
+{
+    (void)signum;
+    stopping = 1;
+}
+
+/**
+ * Sets the step timer of g to the next tick in which its game needs the
+ * engine: the next queued key or gravity step. Games without either have
+ * no step timer.
+ */
+static void schedule(worker *w, session *g)
+{
+    engineState const *s = &g->game;
+
+    if (g->keyCount)
+        wheelAdd(&w->wheel, &g->step, g->lastTick);
+    else if (s->state & ACTIVE)
+        wheelAdd(&w->wheel, &g->step, g->lastTick + (s->tick == 0 ? 0 : s->nextGameTick - s->tick));
+    else
+        wheelRemove(&w->wheel, &g->step);
+}
+
+/**
+ * Queues key for the next free tick of g. Returns false if the queue is full.
+ */
+static bool queueKey(session *g, uint8_t key)
+{
+    if (g->keyCount == KEY_QUEUE)
+        return false;
+    g->keys[(g->keyHead + g->keyCount) % KEY_QUEUE] = key;
+    g->keyCount++;
+    return true;
+}
+
+/**
+ * Runs the game of g through all ticks before until. Ticks with a queued
+ * key or a gravity step are played with engineStep(); the others only
+ * advance the tick counter, which is all engineStep() would do in them.
+ */
+static void advance(session *g, uint64_t until)
+{
+    engineState *s = &g->game;
+
+    while (g->lastTick < until)
+    {
+        if (g->keyCount)
+        {
+            engineStep(s, g->keys[g->keyHead]);
+            g->keyHead = (g->keyHead + 1) % KEY_QUEUE;
+            g->keyCount--;
+            g->lastTick++;
+            continue;
+        }
+        if ((s->state & ACTIVE) && s->tick == 0)
+        {
+            engineStep(s, 0);
+            g->lastTick++;
+            continue;
+        }
+        uint64_t skip = until - g->lastTick;
+        if ((s->state & ACTIVE) && skip > s->nextGameTick - s->tick)
+            skip = s->nextGameTick - s->tick;
+        s->tick = (uint32_t)((s->tick + skip) % s->nextGameTick);
+        g->lastTick += skip;
+    }
+}
+
+/**
+ * Closes the connection of g. Later events of the same epoll batch, or a
+ * timer firing in the same tick, may still point at g, so it is only
+ * marked closed here and freed by freeZombies() after the batch.
+ */
+static void closeSession(worker *w, session *g)
+{
+    if (g->closed)
+        return;
+    g->closed = true;
+    wheelRemove(&w->wheel, &g->step);
+    wheelRemove(&w->wheel, &g->repeat);
+    if (g->prev)
+        g->prev->next = g->next;
+    else
+        w->sessions = g->next;
+    if (g->next)
+        g->next->prev = g->prev;
+    close(g->fd);
+    g->next = w->zombies;
+    w->zombies = g;
+    __atomic_fetch_sub(&w->sessionCount, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&totalSessions, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Frees the sessions closed since the last call.
+ */
+static void freeZombies(worker *w)
+{
+    while (w->zombies)
+    {
+        session *const g = w->zombies;
+        w->zombies = g->next;
+        free(g);
+    }
+}
+
+/**
+ * Sends what is buffered for g and then the fields of its game that changed
+ * since the last STATE frame, as long as the socket takes them. Waits for
+ * EPOLLOUT if it does not. Returns false if g has been closed.
+ */
+static bool flush(worker *w, session *g)
+{
+    for (;;)
+    {
+        if (g->outSent < g->outLength)
+        {
+            ssize_t const n = send(g->fd, g->out + g->outSent, g->outLength - g->outSent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+                break;
+            if (n <= 0)
+            {
+                closeSession(w, g);
+                return false;
+            }
+            g->outSent += n;
+            continue;
+        }
+        g->outLength = g->outSent = 0;
+
+        uint16_t const flags = g->fresh ? SESSION_DELTA_ALL : sessionDelta(&g->sent, &g->game);
+        if (!g->joined || !flags)
+            break;
+        size_t const length = sessionPutState(g->out + STETRIS_FRAME_HEADER, flags, (uint32_t)g->lastTick, &g->game);
+        stetrisPutHeader(g->out, (uint32_t)length, STETRIS_MSG_STATE, flags);
+        g->outLength = STETRIS_FRAME_HEADER + length;
+        g->sent = g->game;
+        g->fresh = false;
+    }
+
+    bool const wantWrite = g->outSent < g->outLength;
+    if (wantWrite != g->wantWrite)
+    {
+        struct epoll_event e = {.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0), .data.ptr = g};
+        epoll_ctl(w->epoll, EPOLL_CTL_MOD, g->fd, &e);
+        g->wantWrite = wantWrite;
+    }
+    return true;
+}
+
+/**
+ * Handles the complete frames received from g.
+ * Returns false if the session is to be closed.
+ */
+static bool handleFrames(worker *w, session *g)
+{
+    size_t used = 0;
+
+    while (g->inLength - used >= STETRIS_FRAME_HEADER)
+    {
+        uint8_t const *frame = g->in + used;
+        uint32_t const length = stetrisGet32(frame);
+        uint16_t const type = stetrisGet16(frame + 4);
+        uint16_t const count = stetrisGet16(frame + 6);
+        uint8_t const *payload = frame + STETRIS_FRAME_HEADER;
+        if (length > SESSION_MAX_PAYLOAD)
+            return false;
+        if (g->inLength - used < STETRIS_FRAME_HEADER + length)
+            break;
+        used += STETRIS_FRAME_HEADER + length;
+
+        switch (type)
+        {
+        case STETRIS_MSG_JOIN:
+            if (g->joined || length < 8 || stetrisGet32(payload) != STETRIS_SESSION_VERSION)
+                return false;
+            engineInit(&g->game, stetrisGet32(payload + 4) ? stetrisGet32(payload + 4) : g->id);
+            g->joined = true;
+            g->fresh = true;
+            g->lastTick = w->now;
+            stetrisPutHeader(g->out + g->outLength, 12, STETRIS_MSG_WELCOME, 0);
+            stetrisPut32(g->out + g->outLength + STETRIS_FRAME_HEADER, STETRIS_SESSION_VERSION);
+            stetrisPut32(g->out + g->outLength + STETRIS_FRAME_HEADER + 4, g->id);
+            stetrisPut32(g->out + g->outLength + STETRIS_FRAME_HEADER + 8, (uint32_t)gameRules.uSecTickTime);
+            g->outLength += STETRIS_FRAME_HEADER + 12;
+            break;
+        case STETRIS_MSG_KEYS:
+            if (!g->joined || count > length)
+                return false;
+            for (unsigned int i = 0; i < count && queueKey(g, payload[i]); i++)
+                ;
+            break;
+        case STETRIS_MSG_HOLD:
+            if (!g->joined || length < 1)
+                return false;
+            // The press is played like a key of KEYS, then LEFT and RIGHT repeat
+            g->held = payload[0];
+            if (g->held)
+                queueKey(g, g->held);
+            if (g->held == (KEY_LEFT & 0xFF) || g->held == (KEY_RIGHT & 0xFF))
+                wheelAdd(&w->wheel, &g->repeat, w->now + opt.repeatDelay);
+            else
+                wheelRemove(&w->wheel, &g->repeat);
+            break;
+        case STETRIS_MSG_BYE:
+            return false;
+        default:
+            break;      // unknown frames are skipped
+        }
+    }
+    g->inLength -= used;
+    memmove(g->in, g->in + used, g->inLength);
+    return true;
+}
+
+/**
+ * Handles the epoll events of session g.
+ */
+static void handleSession(worker *w, session *g, uint32_t events)
+{
+    bool open = !(events & EPOLLERR);
+
+    if (open && (events & EPOLLIN))
+    {
+        // Keys received now are played from the tick in progress on
+        if (g->joined)
+            advance(g, w->now);
+        for (;;)
+        {
+            ssize_t const n = read(g->fd, g->in + g->inLength, sizeof(g->in) - g->inLength);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+                break;
+            if (n <= 0)
+            {
+                open = false;
+                break;
+            }
+            g->inLength += n;
+            if (!handleFrames(w, g))
+            {
+                open = false;
+                break;
+            }
+        }
+        // The first queued key is played in the tick in progress
+        if (open && g->joined)
+            advance(g, w->now + 1);
+    }
+    if (!open || ((events & (EPOLLHUP | EPOLLRDHUP)) && !(events & EPOLLIN)))
+    {
+        closeSession(w, g);
+        return;
+    }
+    if (flush(w, g))
+        schedule(w, g);
+}
+
+/**
+ * Plays the tick in progress for g, whose step timer fired, and sends the
+ * changes.
+ */
+static void fireStep(wheelTimer *t, void *context)
+{
+    worker *const w = context;
+    session *const g = WHEEL_OWNER(t, session, step);
+
+    advance(g, w->now + 1);
+    if (flush(w, g))
+        schedule(w, g);
+}
+
+/**
+ * Repeats the held key of g, unless the keys before it have not been
+ * played yet.
+ */
+static void fireRepeat(wheelTimer *t, void *context)
+{
+    worker *const w = context;
+    session *const g = WHEEL_OWNER(t, session, repeat);
+
+    wheelAdd(&w->wheel, &g->repeat, w->now + opt.repeatRate);
+    advance(g, w->now);
+    if (g->keyCount || !(g->game.state & ACTIVE))
+        return;
+    queueKey(g, g->held);
+    advance(g, w->now + 1);
+    if (flush(w, g))
+        schedule(w, g);
+}
+
+/**
+ * Ends the tick in progress: runs the timers that fire in it.
+ */
+static void runTick(worker *w)
+{
+    wheelTick(&w->wheel, w);
+    w->now++;
+}
+
+/**
+ * Adds the sessions the main thread has handed over to the epoll set.
+ */
+static void takeSessions(worker *w)
+{
+    session *g;
+
+    while (read(w->handoff[0], &g, sizeof(g)) == sizeof(g))
+    {
+        g->owner = w;
+        g->step.fire = fireStep;
+        g->repeat.fire = fireRepeat;
+        g->next = w->sessions;
+        if (w->sessions)
+            w->sessions->prev = g;
+        w->sessions = g;
+        struct epoll_event e = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = g};
+        if (epoll_ctl(w->epoll, EPOLL_CTL_ADD, g->fd, &e) != 0)
+            closeSession(w, g);
+    }
+}
+
+/**
+ * Body of a worker thread.
+ */
+static void *runWorker(void *arg)
+{
+    worker *w = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!stopping)
+    {
+        int const n = epoll_wait(w->epoll, events, MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == &w->timer)
+            {
+                uint64_t expirations;
+                if (read(w->timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+                {
+                    while (expirations--)
+                        runTick(w);
+                }
+            }
+            else if (events[i].data.ptr == &w->handoff)
+                takeSessions(w);
+            else if (!((session *)events[i].data.ptr)->closed)
+                handleSession(w, events[i].data.ptr, events[i].events);
+        }
+        freeZombies(w);
+    }
+    while (w->sessions)
+        closeSession(w, w->sessions);
+    freeZombies(w);
+    return NULL;
+}
+
+/**
+ * Creates the epoll set, tick timer and handoff pipe of w and starts it.
+ */
+static bool startWorker(worker *w)
+{
+    struct itimerspec const period = {
+        .it_interval = {.tv_sec = gameRules.uSecTickTime / 1000000, .tv_nsec = gameRules.uSecTickTime % 1000000 * 1000},
+        .it_value = {.tv_sec = gameRules.uSecTickTime / 1000000, .tv_nsec = gameRules.uSecTickTime % 1000000 * 1000},
+    };
+
+    w->epoll = epoll_create1(EPOLL_CLOEXEC);
+    w->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (w->epoll < 0 || w->timer < 0 || pipe2(w->handoff, O_NONBLOCK | O_CLOEXEC) != 0 ||
+        timerfd_settime(w->timer, 0, &period, NULL) != 0)
+        return false;
+
+    struct epoll_event timer = {.events = EPOLLIN, .data.ptr = &w->timer};
+    struct epoll_event handoff = {.events = EPOLLIN, .data.ptr = &w->handoff};
+    return epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->timer, &timer) == 0 &&
+           epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->handoff[0], &handoff) == 0 &&
+           pthread_create(&w->thread, NULL, runWorker, w) == 0;
+}
+
+/**
+ * Creates the listening socket at path, replacing a stale one.
+ */
+static int listenOn(char const *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+
+    int const fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int main(int argc, char **argv)
+{
+    bool ok = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--socket") == 0)
+            opt.socketPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--workers") == 0)
+            opt.workers = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--max-sessions") == 0)
+            opt.maxSessions = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--repeat-delay") == 0)
+            opt.repeatDelay = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (i + 1 < argc && strcmp(argv[i], "--repeat-rate") == 0)
+            opt.repeatRate = (unsigned int)parseNumberArg(argv[++i], UINT_MAX, 0, &ok);
+        else if (!engineParseRule(&gameRules, argc, argv, &i))
+            usage(argv[0]);
+    }
+    if (!ok)
+        usage(argv[0]);
+    if (opt.workers == 0 || opt.workers > MAX_WORKERS || opt.maxSessions == 0 || opt.repeatRate == 0)
+        usage(argv[0]);
+
+    // Without SA_RESTART, so that accept() returns when stopping
+    struct sigaction stop = {.sa_handler = stopHandler};
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    // The workers inherit a mask that blocks the signals, so they always
+    // interrupt the accept() of the main thread
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    int const listener = listenOn(opt.socketPath);
+    if (listener < 0)
+    {
+        fprintf(stderr, "ERROR: could not listen on %s\n", opt.socketPath);
+        return EXIT_FAILURE;
+    }
+    for (unsigned int i = 0; i < opt.workers; i++)
+    {
+        if (!startWorker(&workers[i]))
+        {
+            fprintf(stderr, "ERROR: could not start worker %u\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, NULL);
+    printf("stetrisd: %u workers listening on %s, tick %lu us\n", opt.workers, opt.socketPath,
+           gameRules.uSecTickTime);
+    fflush(stdout);
+
+    unsigned long served = 0;
+    while (!stopping)
+    {
+        int const fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            continue;
+        if (__atomic_load_n(&totalSessions, __ATOMIC_RELAXED) >= opt.maxSessions)
+        {
+            close(fd);
+            continue;
+        }
+        session *g = calloc(1, sizeof(*g));
+        if (!g)
+        {
+            close(fd);
+            continue;
+        }
+        g->fd = fd;
+        g->id = __atomic_fetch_add(&nextSessionId, 1, __ATOMIC_RELAXED);
+
+        // The worker with the fewest sessions takes it
+        worker *w = &workers[0];
+        for (unsigned int i = 1; i < opt.workers; i++)
+        {
+            if (__atomic_load_n(&workers[i].sessionCount, __ATOMIC_RELAXED) <
+                __atomic_load_n(&w->sessionCount, __ATOMIC_RELAXED))
+                w = &workers[i];
+        }
+        __atomic_fetch_add(&w->sessionCount, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&totalSessions, 1, __ATOMIC_RELAXED);
+        if (write(w->handoff[1], &g, sizeof(g)) != sizeof(g))
+        {
+            __atomic_fetch_sub(&w->sessionCount, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_sub(&totalSessions, 1, __ATOMIC_RELAXED);
+            close(fd);
+            free(g);
+            continue;
+        }
+        served++;
+    }
+
+    // The workers see the flag at their next tick at the latest
+    for (unsigned int i = 0; i < opt.workers; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+
+        // Sessions handed over after the worker stopped
+        session *g;
+        while (read(workers[i].handoff[0], &g, sizeof(g)) == sizeof(g))
+        {
+            close(g->fd);
+            free(g);
+        }
+        close(workers[i].epoll);
+        close(workers[i].timer);
+        close(workers[i].handoff[0]);
+        close(workers[i].handoff[1]);
+    }
+    close(listener);
+    unlink(opt.socketPath);
+    printf("stetrisd: served %lu sessions\n", served);
+    return EXIT_SUCCESS;
+}